@@ -0,0 +1,1410 @@
+#include "Benchmarks.h"
+#include "../terrain/TerrainGenerator.h"
+#include "../terrain/HeightMapCodec.h"
+#include "../terrain/HeightPyramid.h"
+#include "../terrain/HydraulicErosion.h"
+#include "../terrain/TerrainShapes.h"
+#include "../noise/NoiseSource.h"
+#include "../noise/PerlinNoise.h"
+#include "../renderer/AdaptiveMesher.h"
+#include "../renderer/FrameGovernor.h"
+#include "../renderer/MeshExporter.h"
+#include "../renderer/MeshOptimizer.h"
+#include "../renderer/TerrainMeshBuilder.h"
+#include "../renderer/TerrainStreamer.h"
+#include "../utils/HeightConversion.h"
+#include "../utils/JobSystem.h"
+#include "../utils/MemoryPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    double elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    HeightMap benchmarkTerrain(int size) {
+        TerrainGenerator generator;
+        return generator.generateTerrain(size, size, 50.0f, 4, 0.5f, 2.0f);
+    }
+    
+    // Cheap four-octave input, so large erosion runs don't wait on generation
+    std::vector<float> erosionInput(const PerlinNoise& noise, int size, JobSystem& jobs) {
+        std::vector<float> heights(static_cast<size_t>(size) * size);
+        float baseFrequency = 8.0f / size;
+        jobs.parallelFor(0, size, 0, [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    float amplitude = 0.5f;
+                    float frequency = baseFrequency;
+                    float height = 0.5f;
+                    for (int octave = 0; octave < 4; ++octave) {
+                        height += noise.noise(x * frequency, y * frequency) * amplitude;
+                        amplitude *= 0.5f;
+                        frequency *= 2.0f;
+                    }
+                    heights[static_cast<size_t>(y) * size + x] = std::min(1.0f, std::max(0.0f, height));
+                }
+            }
+        });
+        return heights;
+    }
+    
+    // Milliseconds to evaluate kernel over a size x size grid, row batches
+    double timeKernel(const NoiseKernel& kernel, int size, float spacing, std::vector<float>& heights) {
+        std::vector<double> sampleX(size);
+        std::vector<double> sampleY(size);
+        NoiseRowScratch scratch;
+        heights.resize(static_cast<size_t>(size) * size);
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                sampleX[x] = x * spacing;
+                sampleY[x] = y * spacing;
+            }
+            kernel.sample(sampleX.data(), sampleY.data(), size, &heights[static_cast<size_t>(y) * size], scratch);
+        }
+        return elapsedMs(start);
+    }
+    
+    // Largest vertical distance between the heights and the triangle mesh,
+    // over every texel each triangle covers (edges included)
+    float meshError(const std::vector<float>& heights, int width, const std::vector<int>& vertexTexels,
+                    const std::vector<unsigned int>& indices) {
+        float maxError = 0.0f;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            int x[3], y[3];
+            float h[3];
+            for (int i = 0; i < 3; ++i) {
+                int texel = vertexTexels[indices[t + i]];
+                x[i] = texel % width;
+                y[i] = texel / width;
+                h[i] = heights[texel];
+            }
+            
+            // Integer edge functions, so texels on an edge are found exactly
+            long long area = static_cast<long long>(x[1] - x[0]) * (y[2] - y[0]) -
+                             static_cast<long long>(y[1] - y[0]) * (x[2] - x[0]);
+            if (area == 0) continue;
+            for (int py = std::min({y[0], y[1], y[2]}); py <= std::max({y[0], y[1], y[2]}); ++py) {
+                for (int px = std::min({x[0], x[1], x[2]}); px <= std::max({x[0], x[1], x[2]}); ++px) {
+                    long long w0 = static_cast<long long>(x[2] - x[1]) * (py - y[1]) -
+                                   static_cast<long long>(y[2] - y[1]) * (px - x[1]);
+                    long long w1 = static_cast<long long>(x[0] - x[2]) * (py - y[2]) -
+                                   static_cast<long long>(y[0] - y[2]) * (px - x[2]);
+                    long long w2 = area - w0 - w1;
+                    bool inside = area > 0 ? (w0 >= 0 && w1 >= 0 && w2 >= 0) : (w0 <= 0 && w1 <= 0 && w2 <= 0);
+                    if (!inside) continue;
+                    
+                    float surface = (h[0] * w0 + h[1] * w1 + h[2] * w2) / static_cast<float>(area);
+                    maxError = std::max(maxError, std::fabs(surface - heights[static_cast<size_t>(py) * width + px]));
+                }
+            }
+        }
+        return maxError;
+    }
+    
+    float floatFromBits(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+    // Equal bit for bit, or both NaN (F16C keeps payloads the scalar code drops)
+    bool sameFloat(float a, float b) {
+        return std::memcmp(&a, &b, sizeof(a)) == 0 || (std::isnan(a) && std::isnan(b));
+    }
+    
+    bool sameHalf(uint16_t a, uint16_t b) {
+        auto isNan = [](uint16_t half) { return (half & 0x7c00u) == 0x7c00u && (half & 0x03ffu) != 0; };
+        return a == b || (isNan(a) && isNan(b));
+    }
+    
+    void reportMismatches(const char* name, size_t mismatches, size_t count) {
+        std::cout << std::left << std::setw(14) << name << std::right << std::setw(10) << count << " values, "
+                  << mismatches << " differ" << std::endl;
+    }
+    
+    void reportOptimization(const std::string& name, std::vector<float>& vertices, int stride,
+                            std::vector<unsigned int>& indices) {
+        unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / stride);
+        float acmr16Before = MeshOptimizer::computeACMR(indices, vertexCount, 16);
+        
+        auto start = std::chrono::steady_clock::now();
+        MeshOptimizer::Stats stats = MeshOptimizer::optimize(vertices, stride, indices, true);
+        double ms = elapsedMs(start);
+        
+        float acmr16After = MeshOptimizer::computeACMR(indices, vertexCount, 16);
+        double invocationsBefore = static_cast<double>(stats.acmrBefore) * stats.triangleCount;
+        double invocationsAfter = static_cast<double>(stats.acmrAfter) * stats.triangleCount;
+        
+        std::cout << std::left << std::setw(22) << name << std::right
+                  << std::setw(10) << stats.triangleCount
+                  << std::setw(10) << stats.acmrBefore << std::setw(10) << stats.acmrAfter
+                  << std::setw(10) << acmr16Before << std::setw(10) << acmr16After
+                  << std::setw(12) << static_cast<long long>(invocationsBefore - invocationsAfter)
+                  << std::setw(9) << 100.0 * (1.0 - invocationsAfter / invocationsBefore) << "%"
+                  << std::setw(10) << ms << std::endl;
+    }
+}
+
+int Benchmarks::run(const std::string& name) {
+    if (name == "mesh") {
+        meshOptimization();
+        return 0;
+    }
+    if (name == "jobs") {
+        jobScaling();
+        return 0;
+    }
+    if (name == "erosion") {
+        erosion();
+        return 0;
+    }
+    if (name == "fields") {
+        derivedFields();
+        return 0;
+    }
+    if (name == "noise") {
+        noiseGradients();
+        std::cout << std::endl;
+        noiseBackends();
+        std::cout << std::endl;
+        noiseCoherence();
+        std::cout << std::endl;
+        noisePrecision();
+        return 0;
+    }
+    
+    if (name == "graph") {
+        noiseGraph();
+        return 0;
+    }
+    if (name == "codec") {
+        heightMapCodec();
+        return 0;
+    }
+    if (name == "export") {
+        meshExport();
+        return 0;
+    }
+    if (name == "memory") {
+        memoryPools();
+        return 0;
+    }
+    if (name == "storage") {
+        heightStorage();
+        return 0;
+    }
+    if (name == "pyramid") {
+        heightPyramid();
+        return 0;
+    }
+    if (name == "governor") {
+        frameGovernor();
+        return 0;
+    }
+    if (name == "climate") {
+        climate();
+        return 0;
+    }
+    if (name == "mesherror") {
+        return adaptiveMeshError() ? 0 : 1;
+    }
+    if (name == "simd") {
+        return simdPaths() ? 0 : 1;
+    }
+    
+    std::cerr << "Unknown benchmark '" << name << "'. Available: mesh, jobs, erosion, fields, noise, graph, codec, export, memory, storage, pyramid, governor, climate, mesherror, simd" << std::endl;
+    return 1;
+}
+
+void Benchmarks::meshOptimization() {
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Vertex cache optimization (FIFO cache 32 / 16)" << std::endl;
+    std::cout << std::left << std::setw(22) << "mesh" << std::right
+              << std::setw(10) << "tris" << std::setw(10) << "acmr32" << std::setw(10) << "opt32"
+              << std::setw(10) << "acmr16" << std::setw(10) << "opt16"
+              << std::setw(12) << "VS saved" << std::setw(10) << "saved"
+              << std::setw(10) << "ms" << std::endl;
+    
+    for (int size : { 256, 1024 }) {
+        HeightMap heightMap = benchmarkTerrain(size);
+        
+        // Shared-vertex grid in scan order, as used by the displacement path
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        for (int z = 0; z < size; ++z) {
+            for (int x = 0; x < size; ++x) {
+                vertices.insert(vertices.end(), {
+                    static_cast<float>(x), heightMap.getHeight(x, z), static_cast<float>(z)
+                });
+            }
+        }
+        for (int z = 0; z < size - 1; ++z) {
+            for (int x = 0; x < size - 1; ++x) {
+                unsigned int topLeft = z * size + x;
+                unsigned int bottomLeft = topLeft + size;
+                indices.insert(indices.end(), {
+                    topLeft, bottomLeft, topLeft + 1,
+                    topLeft + 1, bottomLeft, bottomLeft + 1
+                });
+            }
+        }
+        reportOptimization("grid " + std::to_string(size), vertices, 3, indices);
+        
+        // Adaptive mesh, emitted in RTIN traversal order
+        std::vector<float> heights(heightMap.getData(), heightMap.getData() + size * size);
+        AdaptiveMesher mesher(size, size, heights);
+        std::vector<int> vertexTexels;
+        mesher.build(0.01f, vertexTexels, indices);
+        vertices.clear();
+        for (int texel : vertexTexels) {
+            vertices.insert(vertices.end(), {
+                static_cast<float>(texel % size), heights[texel], static_cast<float>(texel / size)
+            });
+        }
+        reportOptimization("rtin " + std::to_string(size), vertices, 3, indices);
+    }
+}
+
+bool Benchmarks::adaptiveMeshError() {
+    const int sizes[][2] = { { 17, 17 }, { 64, 64 }, { 129, 129 }, { 200, 300 }, { 300, 200 }, { 513, 513 } };
+    const float maxErrors[] = { 0.0f, 0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.25f, 0.5f };
+    
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "Adaptive mesh error against the heightmap, every covered texel, heights 0.."
+              << TerrainMeshBuilder::verticalScale << std::endl;
+    std::cout << std::setw(10) << "size" << std::setw(10) << "max error" << std::setw(10) << "measured"
+              << std::setw(10) << "tris" << std::setw(10) << "of" << std::endl;
+    
+    bool withinBound = true;
+    for (const auto& size : sizes) {
+        int width = size[0];
+        int height = size[1];
+        TerrainGenerator generator;
+        HeightMap heightMap = generator.generateTerrain(width, height, 20.0f, 6, 0.5f, 2.0f);
+        std::vector<float> heights(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                heights[static_cast<size_t>(y) * width + x] = heightMap.getHeight(x, y) * TerrainMeshBuilder::verticalScale;
+            }
+        }
+        
+        AdaptiveMesher mesher(width, height, heights);
+        for (float maxError : maxErrors) {
+            std::vector<int> vertexTexels;
+            std::vector<unsigned int> indices;
+            mesher.build(maxError, vertexTexels, indices);
+            float measured = meshError(heights, width, vertexTexels, indices);
+            
+            // Float rounding in the interpolation, well below any useful bound
+            bool within = measured <= maxError + 1e-4f;
+            withinBound = withinBound && within;
+            std::cout << std::setw(10) << (std::to_string(width) + "x" + std::to_string(height))
+                      << std::setw(10) << maxError << std::setw(10) << measured
+                      << std::setw(10) << indices.size() / 3 << std::setw(10) << mesher.getFullGridTriangleCount()
+                      << (within ? "" : "  OVER") << std::endl;
+        }
+    }
+    std::cout << "Every mesh within its max error: " << (withinBound ? "yes" : "NO") << std::endl;
+    return withinBound;
+}
+
+bool Benchmarks::simdPaths() {
+#if defined(__F16C__)
+    const char* halfPath = "F16C";
+#elif defined(__SSE2__)
+    const char* halfPath = "SSE2";
+#else
+    const char* halfPath = "scalar";
+#endif
+    std::cout << "SIMD paths against the scalar calls" << std::endl;
+    std::cout << "Height conversion (" << halfPath << " half floats)" << std::endl;
+    
+    // Every 16-bit value; the odd count leaves a tail for the scalar loop
+    const size_t shortCount = 65536 - 3;
+    std::vector<uint16_t> shorts(shortCount);
+    for (size_t i = 0; i < shortCount; ++i) {
+        shorts[i] = static_cast<uint16_t>(i);
+    }
+    
+    // Every half as a float, the midpoints between neighbouring halves
+    // (rounding ties), values around the unorm range and random bit patterns
+    std::vector<float> floats;
+    for (size_t i = 0; i < shortCount; ++i) {
+        uint32_t bits;
+        float value = HeightConversion::halfToFloat(static_cast<uint16_t>(i));
+        std::memcpy(&bits, &value, sizeof(bits));
+        floats.push_back(value);
+        floats.push_back(floatFromBits(bits + 0x1000u));
+        floats.push_back(static_cast<float>(i) / 65535.0f - 0.25f);
+    }
+    unsigned int random = 12345u;
+    for (int i = 0; i < (1 << 20); ++i) {
+        random = random * 1664525u + 1013904223u;
+        floats.push_back(floatFromBits(random));
+    }
+    
+    std::vector<float> widened(shortCount);
+    std::vector<uint16_t> narrowed(floats.size());
+    size_t mismatches[4] = {};
+    
+    HeightConversion::fromHalf(shorts.data(), widened.data(), shortCount);
+    for (size_t i = 0; i < shortCount; ++i) {
+        mismatches[0] += !sameFloat(widened[i], HeightConversion::halfToFloat(shorts[i]));
+    }
+    HeightConversion::toHalf(floats.data(), narrowed.data(), floats.size());
+    for (size_t i = 0; i < floats.size(); ++i) {
+        mismatches[1] += !sameHalf(narrowed[i], HeightConversion::floatToHalf(floats[i]));
+    }
+    HeightConversion::fromUNorm16(shorts.data(), widened.data(), shortCount);
+    for (size_t i = 0; i < shortCount; ++i) {
+        mismatches[2] += !sameFloat(widened[i], HeightConversion::unorm16ToFloat(shorts[i]));
+    }
+    HeightConversion::toUNorm16(floats.data(), narrowed.data(), floats.size());
+    for (size_t i = 0; i < floats.size(); ++i) {
+        mismatches[3] += narrowed[i] != HeightConversion::floatToUNorm16(floats[i]);
+    }
+    
+    reportMismatches("fromHalf", mismatches[0], shortCount);
+    reportMismatches("toHalf", mismatches[1], floats.size());
+    reportMismatches("fromUNorm16", mismatches[2], shortCount);
+    reportMismatches("toUNorm16", mismatches[3], floats.size());
+
+
+#if defined(__SSSE3__)
+    const char* biomePath = "SSSE3";
+#else
+    const char* biomePath = "scalar";
+#endif
+    std::cout << "Biome classification (" << biomePath << " table lookup)" << std::endl;
+    
+    // Every (temperature, moisture) pair, one temperature per row
+    std::vector<uint8_t> temperature(65536);
+    std::vector<uint8_t> moisture(65536);
+    std::vector<uint8_t> biomes(65536);
+    for (size_t i = 0; i < temperature.size(); ++i) {
+        temperature[i] = static_cast<uint8_t>(i >> 8);
+        moisture[i] = static_cast<uint8_t>(i);
+    }
+    Biomes::classify(temperature.data(), moisture.data(), shortCount, biomes.data());
+    size_t biomeMismatches = 0;
+    for (size_t i = 0; i < shortCount; ++i) {
+        biomeMismatches += biomes[i] != static_cast<uint8_t>(Biomes::classify(temperature[i], moisture[i]));
+    }
+    reportMismatches("classify", biomeMismatches, shortCount);
+    
+    bool matches = mismatches[0] + mismatches[1] + mismatches[2] + mismatches[3] + biomeMismatches == 0;
+    std::cout << "Every SIMD result matches: " << (matches ? "yes" : "NO") << std::endl;
+    return matches;
+}
+
+void Benchmarks::jobScaling() {
+    const int size = 1024;
+    const int repeats = 3;
+    
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    if (JobSystem::getMaxThreads() > 0) {
+        maxThreads = std::min(maxThreads, JobSystem::getMaxThreads());
+    }
+    
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Job system scaling, " << size << "x" << size << " terrain, best of " << repeats << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "generate" << std::setw(12) << "mesh"
+              << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::endl;
+    
+    double baseline = 0.0;
+    for (int threads : threadCounts) {
+        JobSystem jobs(threads);
+        
+        TerrainGenerator generator;
+        generator.setJobSystem(&jobs);
+        TerrainMeshBuilder builder;
+        builder.setJobSystem(&jobs);
+        
+        double generateMs = 1e30;
+        double meshMs = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            HeightMap heightMap = generator.generateTerrain(size, size, 50.0f, 4, 0.5f, 2.0f);
+            generateMs = std::min(generateMs, elapsedMs(start));
+            
+            start = std::chrono::steady_clock::now();
+            TerrainFields fields;
+            builder.buildFields(heightMap, fields);
+            std::vector<MeshChunk> chunks = builder.buildTerrainChunks(heightMap);
+            meshMs = std::min(meshMs, elapsedMs(start));
+        }
+        
+        double total = generateMs + meshMs;
+        if (threads == 1) baseline = total;
+        double speedup = baseline / total;
+        
+        std::cout << std::setw(8) << jobs.getThreadCount()
+                  << std::setw(10) << generateMs << "ms" << std::setw(10) << meshMs << "ms"
+                  << std::setw(9) << speedup << "x" << std::setw(11) << 100.0 * speedup / threads << "%" << std::endl;
+    }
+}
+
+void Benchmarks::erosion() {
+    const uint32_t seed = 1234;
+    
+    ErosionSettings settings;
+    settings.dropletsPerTexel = 0.25f;
+    HydraulicErosion erosion(settings);
+    
+    JobSystem& jobs = JobSystem::instance();
+    PerlinNoise noise;
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Hydraulic erosion, " << settings.dropletsPerTexel << " droplets per texel, "
+              << jobs.getThreadCount() << " threads" << std::endl;
+    std::cout << std::setw(8) << "size" << std::setw(12) << "droplets" << std::setw(14) << "steps"
+              << std::setw(12) << "ms" << std::setw(12) << "Msteps/s" << std::setw(14) << "per thread" << std::endl;
+    
+    for (int size : { 1024, 4096, 8192 }) {
+        std::vector<float> heights = erosionInput(noise, size, jobs);
+        
+        HydraulicErosion::Stats stats;
+        auto start = std::chrono::steady_clock::now();
+        erosion.erode(heights.data(), size, size, seed, jobs, &stats);
+        double ms = elapsedMs(start);
+        
+        double stepsPerSecond = stats.steps / (ms / 1000.0) / 1e6;
+        std::cout << std::setw(8) << size << std::setw(12) << stats.droplets << std::setw(14) << stats.steps
+                  << std::setw(12) << ms << std::setw(12) << stepsPerSecond
+                  << std::setw(14) << stepsPerSecond / jobs.getThreadCount() << std::endl;
+    }
+    
+    // Same seed on one thread must give bit-identical heights
+    const int checkSize = 1024;
+    std::vector<float> parallel = erosionInput(noise, checkSize, jobs);
+    std::vector<float> serial = parallel;
+    erosion.erode(parallel.data(), checkSize, checkSize, seed, jobs);
+    JobSystem singleThread(1);
+    erosion.erode(serial.data(), checkSize, checkSize, seed, singleThread);
+    bool identical = std::memcmp(parallel.data(), serial.data(), parallel.size() * sizeof(float)) == 0;
+    std::cout << "Deterministic across thread counts: " << (identical ? "yes" : "NO") << std::endl;
+}
+
+void Benchmarks::derivedFields() {
+    const int repeats = 3;
+    
+    JobSystem& jobs = JobSystem::instance();
+    PerlinNoise noise;
+    TerrainMeshBuilder builder;
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Derived fields, one fused pass, " << jobs.getThreadCount() << " threads, best of "
+              << repeats << std::endl;
+    std::cout << std::setw(8) << "size" << std::setw(12) << "ms" << std::setw(14) << "Mtexels/s"
+              << std::setw(12) << "GB/s" << std::endl;
+    
+    for (int size : { 1024, 4096 }) {
+        std::vector<float> heights = erosionInput(noise, size, jobs);
+        HeightMap heightMap(size, size, heights.data());
+        
+        TerrainFields fields;
+        double ms = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            builder.buildFields(heightMap, fields);
+            ms = std::min(ms, elapsedMs(start));
+        }
+        
+        // 4 bytes of height in, 5 bytes of fields out per texel
+        double texels = static_cast<double>(size) * size;
+        std::cout << std::setw(8) << size << std::setw(12) << ms
+                  << std::setw(14) << texels / (ms / 1000.0) / 1e6
+                  << std::setw(12) << texels * 9.0 / (ms / 1000.0) / 1e9 << std::endl;
+    }
+}
+
+void Benchmarks::noiseGradients() {
+    const int size = 1024;
+    const float frequency = 1.0f / 37.0f;
+    const float epsilon = 1e-3f;
+    
+    PerlinNoise noise;
+    
+    // Each variant sums its results so the work cannot be optimized away
+    double sink = 0.0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            sink += noise.noise(x * frequency, y * frequency);
+        }
+    }
+    double valueMs = elapsedMs(start);
+    
+    // The usual workaround: two more samples for forward differences
+    start = std::chrono::steady_clock::now();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float value = noise.noise(x * frequency, y * frequency);
+            float dx = (noise.noise(x * frequency + epsilon, y * frequency) - value) / epsilon;
+            float dy = (noise.noise(x * frequency, y * frequency + epsilon) - value) / epsilon;
+            sink += value + dx + dy;
+        }
+    }
+    double differenceMs = elapsedMs(start);
+    
+    start = std::chrono::steady_clock::now();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float dx, dy;
+            float value = noise.noise(x * frequency, y * frequency, dx, dy);
+            sink += value + dx + dy;
+        }
+    }
+    double analyticMs = elapsedMs(start);
+    
+    // Accuracy against central differences, on a coarser grid
+    float maxError = 0.0f;
+    for (int y = 0; y < size; y += 8) {
+        for (int x = 0; x < size; x += 8) {
+            float sx = x * frequency;
+            float sy = y * frequency;
+            float dx, dy;
+            noise.noise(sx, sy, dx, dy);
+            float centralDx = (noise.noise(sx + epsilon, sy) - noise.noise(sx - epsilon, sy)) / (2.0f * epsilon);
+            float centralDy = (noise.noise(sx, sy + epsilon) - noise.noise(sx, sy - epsilon)) / (2.0f * epsilon);
+            maxError = std::max(maxError, std::max(std::fabs(dx - centralDx), std::fabs(dy - centralDy)));
+        }
+    }
+    
+    double points = static_cast<double>(size) * size;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Perlin noise, " << size << "x" << size << " points, one thread" << std::endl;
+    std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(12) << "ms"
+              << std::setw(14) << "ns/point" << std::endl;
+    std::cout << std::left << std::setw(28) << "value" << std::right << std::setw(12) << valueMs
+              << std::setw(14) << valueMs * 1e6 / points << std::endl;
+    std::cout << std::left << std::setw(28) << "value + 2 differences" << std::right << std::setw(12) << differenceMs
+              << std::setw(14) << differenceMs * 1e6 / points << std::endl;
+    std::cout << std::left << std::setw(28) << "value + analytic gradient" << std::right << std::setw(12) << analyticMs
+              << std::setw(14) << analyticMs * 1e6 / points << std::endl;
+    std::cout << std::setprecision(5) << "Max gradient error against central differences: " << maxError
+              << " (checksum " << sink << ")" << std::endl;
+}
+
+void Benchmarks::noiseBackends() {
+    const int size = 1024;
+    const float frequency = 1.0f / 37.0f;
+    const int directionBins = 32;
+    const NoiseType types[] = { NoiseType::Perlin, NoiseType::OpenSimplex2, NoiseType::Value, NoiseType::Cellular };
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Noise backends, " << size << "x" << size << " samples, one thread (Msamples/s)" << std::endl;
+    std::cout << std::left << std::setw(14) << "backend" << std::right << std::setw(10) << "single"
+              << std::setw(10) << "batch" << std::setw(10) << "gradient" << std::setw(9) << "mean"
+              << std::setw(9) << "stddev" << std::setw(9) << "min" << std::setw(9) << "max"
+              << std::setw(11) << "isotropy" << std::endl;
+    
+    std::vector<double> sampleX(size);
+    std::vector<double> sampleY(size);
+    std::vector<float> values(size);
+    double points = static_cast<double>(size) * size;
+    double checksum = 0.0;
+    
+    for (NoiseType type : types) {
+        std::unique_ptr<NoiseSource> noise = NoiseSource::create(type, 1234);
+        const NoiseSource& source = *noise;
+        double sink = 0.0;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                sink += source.noise(x * frequency, y * frequency);
+            }
+        }
+        double singleMs = elapsedMs(start);
+        
+        start = std::chrono::steady_clock::now();
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                sampleX[x] = x * frequency;
+                sampleY[x] = y * frequency;
+            }
+            source.noise(sampleX.data(), sampleY.data(), size, values.data());
+            sink += values[y];
+        }
+        double batchMs = elapsedMs(start);
+        
+        start = std::chrono::steady_clock::now();
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                float dx, dy;
+                sink += source.noise(x * frequency, y * frequency, dx, dy) + dx + dy;
+            }
+        }
+        double gradientMs = elapsedMs(start);
+        
+        // Untimed quality pass. Gradient directions are binned; lattice
+        // artifacts show up as bins along the axes or diagonals filling
+        // faster than the rest.
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        float minValue = 1e30f;
+        float maxValue = -1e30f;
+        std::vector<double> bins(directionBins, 0.0);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                float dx, dy;
+                float value = source.noise(x * frequency, y * frequency, dx, dy);
+                sum += value;
+                sumSquares += static_cast<double>(value) * value;
+                minValue = std::min(minValue, value);
+                maxValue = std::max(maxValue, value);
+                
+                float angle = std::atan2(dy, dx) + 3.14159265f;
+                int bin = std::min(directionBins - 1, static_cast<int>(angle / 6.2831853f * directionBins));
+                bins[bin] += 1.0;
+            }
+        }
+        
+        double mean = sum / points;
+        double deviation = std::sqrt(std::max(0.0, sumSquares / points - mean * mean));
+        double isotropy = *std::min_element(bins.begin(), bins.end()) / *std::max_element(bins.begin(), bins.end());
+        
+        std::cout << std::left << std::setw(14) << NoiseSource::getName(type) << std::right
+                  << std::setw(10) << points / (singleMs * 1000.0) << std::setw(10) << points / (batchMs * 1000.0)
+                  << std::setw(10) << points / (gradientMs * 1000.0) << std::setw(9) << mean
+                  << std::setw(9) << deviation << std::setw(9) << minValue << std::setw(9) << maxValue
+                  << std::setw(11) << isotropy << std::endl;
+        checksum += sink;
+    }
+    std::cout << "isotropy: least over most common gradient direction in " << directionBins
+              << " bins (1 = no preferred direction); checksum " << checksum << std::endl;
+}
+
+void Benchmarks::noiseGraph() {
+    const int size = 1024;
+    const float spacing = 1.0f / 50.0f;
+    
+    std::shared_ptr<const NoiseSource> simplex = NoiseSource::create(NoiseType::OpenSimplex2, 1);
+    std::shared_ptr<const NoiseSource> perlin = NoiseSource::create(NoiseType::Perlin, 2);
+    
+    // Ridged mountains masked by warped continents
+    auto continent = noiseFractal(simplex, 4, 0.5f, 2.0f, 4.0f);
+    auto mountains = noiseRidged(perlin, 6, 0.5f, 2.0f, 1.2f);
+    auto warpX = noiseFractal(simplex, 3, 0.5f, 2.0f, 1.5f, 17.3f, -41.9f);
+    auto warpY = noiseFractal(simplex, 3, 0.5f, 2.0f, 1.5f, -63.2f, 12.8f);
+    auto graph = noiseWarp(noiseSmoothstep(continent, -0.2f, 0.1f) * mountains, warpX, warpY, 0.6f);
+    
+    std::shared_ptr<const NoiseKernel> leaves[] = {
+        makeNoiseKernel(continent), makeNoiseKernel(mountains), makeNoiseKernel(warpX), makeNoiseKernel(warpY)
+    };
+    std::shared_ptr<const NoiseKernel> kernel = makeNoiseKernel(graph);
+    
+    std::vector<float> heights;
+    double leafMs = 0.0;
+    for (const std::shared_ptr<const NoiseKernel>& leaf : leaves) {
+        leafMs += timeKernel(*leaf, size, spacing, heights);
+    }
+    double batchMs = timeKernel(*kernel, size, spacing, heights);
+    
+    // The per-sample path must match the batch path bit for bit
+    bool identical = true;
+    auto start = std::chrono::steady_clock::now();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            identical &= kernel->sample(x * spacing, y * spacing) == heights[static_cast<size_t>(y) * size + x];
+        }
+    }
+    double singleMs = elapsedMs(start);
+    
+    double presetMs = timeKernel(*TerrainShapes::continents(3), size, spacing, heights);
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Noise graph (warped continents x ridged mountains), " << size << "x" << size
+              << " samples, one thread" << std::endl;
+    std::cout << std::left << std::setw(32) << "variant" << std::right << std::setw(12) << "ms"
+              << std::setw(14) << "vs leaves" << std::endl;
+    std::cout << std::left << std::setw(32) << "4 leaves, one pass each" << std::right << std::setw(12) << leafMs
+              << std::setw(14) << 1.0 << std::endl;
+    std::cout << std::left << std::setw(32) << "fused graph, row batches" << std::right << std::setw(12) << batchMs
+              << std::setw(14) << batchMs / leafMs << std::endl;
+    std::cout << std::left << std::setw(32) << "fused graph, per sample" << std::right << std::setw(12) << singleMs
+              << std::setw(14) << singleMs / leafMs << std::endl;
+    std::cout << std::left << std::setw(32) << "TerrainShapes::continents" << std::right << std::setw(12) << presetMs
+              << std::endl;
+    std::cout << "Per-sample and batch results identical: " << (identical ? "yes" : "NO") << std::endl;
+}
+
+void Benchmarks::noiseCoherence() {
+    const int width = 1024;
+    const int rows = 256;
+    const int cellSizes[] = { 2, 8, 50, 450 };
+    const NoiseType types[] = { NoiseType::Perlin, NoiseType::OpenSimplex2, NoiseType::Value, NoiseType::Cellular };
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Batch over per-sample speedup by lattice cell size in samples, " << width << "x" << rows
+              << ", one thread" << std::endl;
+    std::cout << std::left << std::setw(14) << "backend" << std::right;
+    for (int cellSize : cellSizes) {
+        std::cout << std::setw(10) << cellSize;
+    }
+    std::cout << std::setw(12) << "matches" << std::endl;
+    
+    std::vector<double> sampleX(width);
+    std::vector<double> sampleY(width);
+    std::vector<float> values(width);
+    double checksum = 0.0;
+    
+    for (NoiseType type : types) {
+        std::unique_ptr<NoiseSource> noise = NoiseSource::create(type, 99);
+        std::cout << std::left << std::setw(14) << NoiseSource::getName(type) << std::right;
+        bool matches = true;
+        
+        for (int cellSize : cellSizes) {
+            float frequency = 1.0f / cellSize;
+            double sink = 0.0;
+            
+            auto start = std::chrono::steady_clock::now();
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    sink += noise->noise(x * frequency + 0.37f, y * frequency + 0.61f);
+                }
+            }
+            double singleMs = elapsedMs(start);
+            
+            start = std::chrono::steady_clock::now();
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    sampleX[x] = x * frequency + 0.37f;
+                    sampleY[x] = y * frequency + 0.61f;
+                }
+                noise->noise(sampleX.data(), sampleY.data(), width, values.data());
+                sink += values[y];
+            }
+            double batchMs = elapsedMs(start);
+            
+            // The last row again, sample by sample
+            for (int x = 0; x < width; ++x) {
+                matches &= values[x] == noise->noise(sampleX[x], sampleY[x]);
+            }
+            checksum += sink;
+            std::cout << std::setw(9) << singleMs / batchMs << "x";
+        }
+        std::cout << std::setw(12) << (matches ? "yes" : "NO") << std::endl;
+    }
+    std::cout << "checksum " << checksum << std::endl;
+}
+
+void Benchmarks::noisePrecision() {
+    const int count = 1024;
+    const double spacing = 1.0 / 64.0;   // 64 samples per lattice cell
+    const double distances[] = { 0.0, 1e3, 1e5, 1e6, 1e8, 1e12 };
+    
+    PerlinNoise noise(7);
+    std::vector<double> sampleX(count);
+    std::vector<double> sampleY(count, 0.43);
+    std::vector<double> floatX(count);
+    std::vector<float> values(count);
+    std::vector<float> floatValues(count);
+    
+    std::cout << "Perlin noise along " << count << " samples, 1/64 cell apart, by distance from the origin" << std::endl;
+    std::cout << std::left << std::setw(16) << "cells out" << std::right << std::setw(18) << "float step"
+              << std::setw(16) << "float error" << std::setw(16) << "256 cells on" << std::endl;
+    
+    for (double distance : distances) {
+        for (int i = 0; i < count; ++i) {
+            sampleX[i] = distance + 0.37 + i * spacing;
+            floatX[i] = static_cast<float>(sampleX[i]);
+        }
+        noise.noise(sampleX.data(), sampleY.data(), count, values.data());
+        noise.noise(floatX.data(), sampleY.data(), count, floatValues.data());
+        
+        // What float coordinates would have sampled, against the exact values
+        float floatError = 0.0f;
+        bool repeats = true;
+        for (int i = 0; i < count; ++i) {
+            floatError = std::max(floatError, std::fabs(floatValues[i] - values[i]));
+            
+            // A 256-entry permutation table repeats the noise here
+            repeats &= noise.noise(sampleX[i] + 256.0, sampleY[i]) == values[i];
+        }
+        float position = static_cast<float>(distance + 0.37);
+        
+        std::cout << std::left << std::setw(16) << std::setprecision(0) << distance << std::right
+                  << std::setw(18) << std::setprecision(8) << std::nextafter(position, 2.0f * position + 1.0f) - position
+                  << std::setw(16) << std::setprecision(5) << floatError
+                  << std::setw(16) << (repeats ? "repeats" : "differs") << std::endl;
+    }
+    std::cout << "float step: spacing of float coordinates there, in cells; float error: largest change in value "
+              << "from rounding the coordinates to float" << std::endl;
+}
+
+void Benchmarks::heightMapCodec() {
+    const int size = 2048;
+    const int repeats = 3;
+    
+    JobSystem& jobs = JobSystem::instance();
+    JobSystem singleThread(1);
+    PerlinNoise noise;
+    std::vector<float> heights = erosionInput(noise, size, jobs);
+    double rawBytes = static_cast<double>(heights.size()) * sizeof(float);
+    
+    std::cout << std::fixed;
+    std::cout << "Heightmap codec, " << size << "x" << size << ", 128 texel tiles, best of " << repeats
+              << ", decode on 1 and " << jobs.getThreadCount() << " threads" << std::endl;
+    std::cout << std::setw(6) << "bits" << std::setw(12) << "bits/texel" << std::setw(8) << "ratio"
+              << std::setw(12) << "max error" << std::setw(12) << "bound" << std::setw(12) << "enc MB/s"
+              << std::setw(12) << "dec GB/s" << std::setw(12) << "all GB/s" << std::endl;
+    
+    bool roundTrips = true;
+    std::vector<float> decoded(heights.size());
+    for (int bitDepth : { 8, 12, 16, 24, 32 }) {
+        HeightMapCodecSettings settings;
+        settings.bitDepth = bitDepth;
+        HeightMapCodec codec(settings);
+        
+        std::vector<uint8_t> encoded;
+        double encodeMs = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            encoded = codec.encode(heights.data(), size, size, jobs);
+            encodeMs = std::min(encodeMs, elapsedMs(start));
+        }
+        
+        double decodeMs[2] = { 1e30, 1e30 };
+        JobSystem* decoders[2] = { &singleThread, &jobs };
+        for (int decoder = 0; decoder < 2; ++decoder) {
+            for (int i = 0; i < repeats; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                roundTrips &= HeightMapCodec::decode(encoded.data(), encoded.size(), decoded.data(), *decoders[decoder]);
+                decodeMs[decoder] = std::min(decodeMs[decoder], elapsedMs(start));
+            }
+        }
+        
+        HeightMapCodec::Info info;
+        HeightMapCodec::readInfo(encoded.data(), encoded.size(), info);
+        float maxError = 0.0f;
+        for (size_t i = 0; i < heights.size(); ++i) {
+            maxError = std::max(maxError, std::fabs(decoded[i] - heights[i]));
+        }
+        roundTrips &= maxError <= info.maxError;
+        
+        std::cout << std::setprecision(2) << std::setw(6) << bitDepth
+                  << std::setw(12) << encoded.size() * 8.0 / heights.size()
+                  << std::setw(8) << rawBytes / encoded.size()
+                  << std::scientific << std::setprecision(2) << std::setw(12) << maxError
+                  << std::setw(12) << info.maxError << std::fixed
+                  << std::setw(12) << rawBytes / (encodeMs / 1000.0) / 1e6
+                  << std::setw(12) << rawBytes / (decodeMs[0] / 1000.0) / 1e9
+                  << std::setw(12) << rawBytes / (decodeMs[1] / 1000.0) / 1e9 << std::endl;
+    }
+    std::cout << "Round trips within the error bound (exact at 32 bits): " << (roundTrips ? "yes" : "NO") << std::endl;
+}
+
+void Benchmarks::meshExport() {
+    const int size = 2048;
+    
+    JobSystem& jobs = JobSystem::instance();
+    JobSystem singleThread(1);
+    PerlinNoise noise;
+    std::vector<float> heights = erosionInput(noise, size, jobs);
+    HeightMap heightMap(size, size, heights.data());
+    TerrainMeshBuilder builder;
+    TerrainFields fields;
+    builder.buildFields(heightMap, fields);
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Mesh export, " << size << "x" << size << " regular grid with trees, built and written in "
+              << MeshExporter().getChunksPerBatch() << "-chunk batches" << std::endl;
+    std::cout << std::setw(8) << "format" << std::setw(10) << "threads" << std::setw(12) << "triangles"
+              << std::setw(10) << "MB" << std::setw(12) << "ms" << std::setw(10) << "MB/s" << std::endl;
+    
+    struct Target {
+        const char* name;
+        MeshFileFormat format;
+        const char* path;
+    };
+    const Target targets[] = {
+        { "glb", MeshFileFormat::Glb, "benchmark_export.glb" },
+        { "ply", MeshFileFormat::Ply, "benchmark_export.ply" }
+    };
+    for (const Target& target : targets) {
+        for (JobSystem* system : { &singleThread, &jobs }) {
+            MeshExporter exporter;
+            exporter.setJobSystem(system);
+            MeshExporter::Stats stats;
+            auto start = std::chrono::steady_clock::now();
+            bool written = exporter.exportTerrain(target.path, target.format, heightMap, fields, builder, true, &stats);
+            double ms = elapsedMs(start);
+            
+            double megabytes = stats.bytesWritten / 1e6;
+            std::cout << std::setw(8) << target.name << std::setw(10) << system->getThreadCount()
+                      << std::setw(12) << stats.terrainTriangles + stats.treeTriangles
+                      << std::setw(10) << megabytes << std::setw(12) << ms << std::setw(10) << megabytes / (ms / 1000.0)
+                      << (written ? "" : "  write failed") << std::endl;
+        }
+    }
+    std::remove("benchmark_export.glb");
+    std::remove("benchmark_export.ply");
+    std::remove("benchmark_export_trees.ply");
+}
+
+void Benchmarks::memoryPools() {
+    const int size = 513;
+    const int terrains = 8;
+    const MemorySubsystem subsystems[] = { MemorySubsystem::HeightMaps, MemorySubsystem::Scratch,
+                                           MemorySubsystem::MeshStaging };
+    
+    // The streamer's meshing stage, one terrain after another as the view
+    // pans; dropping each result evicts it like the renderer does
+    TerrainGenerator generator;
+    TerrainSeed seed = generator.createSeed(6);
+    TerrainMeshBuilder builder;
+    TerrainFields fields;
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Memory pools, " << terrains << " streamed " << size << "x" << size
+              << " terrains (generate, fields, terrain and tree meshes, evict)" << std::endl;
+    if (!MemoryTracker::isCountingHeap()) {
+        std::cout << "Heap columns need a build with TERRAIN_COUNT_HEAP_ALLOCATIONS" << std::endl;
+    }
+    std::cout << "Pool columns: requests served by the heap / from pooled memory" << std::endl;
+    std::cout << std::setw(8) << "terrain" << std::setw(13) << "heap allocs" << std::setw(10) << "heap MB";
+    for (MemorySubsystem subsystem : subsystems) {
+        std::cout << std::setw(14) << MemoryTracker::getName(subsystem);
+    }
+    std::cout << std::setw(10) << "ms" << std::endl;
+    
+    for (int terrain = 0; terrain < terrains; ++terrain) {
+        MemoryTracker::resetCounters();
+        uint64_t heapAllocations = MemoryTracker::getHeapAllocationCount();
+        uint64_t heapBytes = MemoryTracker::getHeapAllocatedBytes();
+        auto start = std::chrono::steady_clock::now();
+        
+        std::unique_ptr<StreamedTerrain> result(new StreamedTerrain());
+        result->heightMap = generator.generateTerrainAsync(seed, static_cast<int64_t>(terrain) * (size - 1), 0, size, size,
+                                                           1, 50.0f, 6, 0.5f, 2.0f).take();
+        builder.buildFields(*result->heightMap, fields);
+        result->terrainChunks = builder.buildTerrainChunks(*result->heightMap);
+        result->treeChunks = builder.buildTreeChunks(*result->heightMap, fields);
+        result.reset();
+        
+        double ms = elapsedMs(start);
+        std::cout << std::setw(8) << terrain + 1
+                  << std::setw(13) << MemoryTracker::getHeapAllocationCount() - heapAllocations
+                  << std::setw(10) << (MemoryTracker::getHeapAllocatedBytes() - heapBytes) / 1e6;
+        for (MemorySubsystem subsystem : subsystems) {
+            MemoryStats stats = MemoryTracker::getStats(subsystem);
+            std::cout << std::setw(14) << (std::to_string(stats.allocations) + "/" + std::to_string(stats.reuses));
+        }
+        std::cout << std::setw(10) << ms << std::endl;
+    }
+    
+    std::cout << std::setw(14) << "subsystem" << std::setw(10) << "live MB" << std::setw(10) << "pooled MB"
+              << std::setw(10) << "peak MB" << std::endl;
+    for (MemorySubsystem subsystem : subsystems) {
+        MemoryStats stats = MemoryTracker::getStats(subsystem);
+        std::cout << std::setw(14) << MemoryTracker::getName(subsystem) << std::setw(10) << stats.liveBytes / 1e6
+                  << std::setw(10) << stats.pooledBytes / 1e6 << std::setw(10) << stats.peakBytes / 1e6 << std::endl;
+    }
+}
+
+void Benchmarks::heightStorage() {
+    const int size = 4096;
+    const int repeats = 3;
+    
+    JobSystem& jobs = JobSystem::instance();
+    PerlinNoise noise;
+    TerrainMeshBuilder builder;
+    std::vector<float> heights = erosionInput(noise, size, jobs);
+    std::vector<float> widened(heights.size());
+    double texels = static_cast<double>(heights.size());
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Heightmap storage, " << size << "x" << size << ", best of " << repeats
+              << ", conversion on 1 thread, fields on " << jobs.getThreadCount() << std::endl;
+    std::cout << std::setw(10) << "storage" << std::setw(10) << "MB" << std::setw(14) << "narrow GB/s"
+              << std::setw(14) << "widen GB/s" << std::setw(12) << "max error" << std::setw(12) << "fields ms" << std::endl;
+    
+    const char* names[] = { "float32", "float16", "unorm16" };
+    HeightStorage storages[] = { HeightStorage::Float32, HeightStorage::Float16, HeightStorage::UNorm16 };
+    for (int type = 0; type < 3; ++type) {
+        HeightMap heightMap(size, size, storages[type]);
+        
+        // Bandwidth counts the float side, 4 bytes per texel
+        double narrowMs = 1e30;
+        double widenMs = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            for (int y = 0; y < size; ++y) {
+                heightMap.writeRow(y, 0, size, heights.data() + static_cast<size_t>(y) * size);
+            }
+            narrowMs = std::min(narrowMs, elapsedMs(start));
+            
+            start = std::chrono::steady_clock::now();
+            for (int y = 0; y < size; ++y) {
+                heightMap.readRow(y, 0, size, widened.data() + static_cast<size_t>(y) * size);
+            }
+            widenMs = std::min(widenMs, elapsedMs(start));
+        }
+        
+        float maxError = 0.0f;
+        for (size_t i = 0; i < heights.size(); ++i) {
+            maxError = std::max(maxError, std::fabs(widened[i] - heights[i]));
+        }
+        
+        TerrainFields fields;
+        double fieldsMs = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            builder.buildFields(heightMap, fields);
+            fieldsMs = std::min(fieldsMs, elapsedMs(start));
+        }
+        
+        std::cout << std::setprecision(2) << std::setw(10) << names[type]
+                  << std::setw(10) << heightMap.getRawSize() / (1024.0 * 1024.0)
+                  << std::setw(14) << texels * 4.0 / (narrowMs / 1000.0) / 1e9
+                  << std::setw(14) << texels * 4.0 / (widenMs / 1000.0) / 1e9
+                  << std::scientific << std::setw(12) << maxError << std::fixed
+                  << std::setw(12) << fieldsMs << std::endl;
+    }
+}
+
+void Benchmarks::heightPyramid() {
+    const int size = 4096;
+    const int rayCount = 4096;
+    const int repeats = 3;
+    // The fixed-step march picking used before, in texels
+    const float marchStep = 0.25f;
+    
+    JobSystem& jobs = JobSystem::instance();
+    PerlinNoise noise;
+    std::vector<float> heights = erosionInput(noise, size, jobs);
+    HeightMap heightMap(size, size, heights.data(), HeightStorage::UNorm16);
+    
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Height pyramid, " << size << "x" << size << " unorm16, best of " << repeats << ", "
+              << jobs.getThreadCount() << " threads" << std::endl;
+    
+    HeightPyramid pyramid;
+    double buildMs = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        pyramid.build(heightMap, jobs);
+        buildMs = std::min(buildMs, elapsedMs(start));
+    }
+    
+    // A brush-sized edit
+    HeightMapRect rect = { size / 2, size / 2, size / 2 + 64, size / 2 + 64 };
+    double updateMs = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        pyramid.update(heightMap, rect, jobs);
+        updateMs = std::min(updateMs, elapsedMs(start));
+    }
+    std::cout << "levels " << pyramid.getLevelCount() << ", " << pyramid.getByteSize() / (1024.0 * 1024.0)
+              << " MB, build " << buildMs << " ms, 64x64 update " << updateMs << " ms" << std::endl;
+    
+    // Camera-like rays: from above the terrain, spread over the map and every
+    // heading, looking down 15 to 60 degrees
+    std::vector<HeightRay> rays(rayCount);
+    for (int i = 0; i < rayCount; ++i) {
+        float heading = i * 2.39996f;
+        float pitch = (15.0f + 45.0f * ((i * 37) % rayCount) / rayCount) * 3.14159265f / 180.0f;
+        // Normalized height over the map's width, like the drawn terrain
+        float drop = std::tan(pitch) * 2.0f * TerrainMeshBuilder::horizontalScale /
+                     (TerrainMeshBuilder::verticalScale * (size - 1));
+        HeightRay& ray = rays[i];
+        ray.originX = size * (0.1f + 0.8f * ((i * 7919) % rayCount) / rayCount);
+        ray.originY = size * (0.1f + 0.8f * ((i * 104729) % rayCount) / rayCount);
+        ray.originZ = 1.1f;
+        ray.directionX = std::cos(heading);
+        ray.directionY = std::sin(heading);
+        ray.directionZ = -drop;
+        ray.maxDistance = 2.0f * size;
+    }
+    
+    std::vector<HeightRayHit> hits(rayCount);
+    double singleMs = 1e30;
+    double batchMs = 1e30;
+    int hitCount = 0;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (int ray = 0; ray < rayCount; ++ray) {
+            pyramid.raycast(heightMap, rays[ray], hits[ray]);
+        }
+        singleMs = std::min(singleMs, elapsedMs(start));
+        
+        start = std::chrono::steady_clock::now();
+        hitCount = pyramid.raycast(heightMap, rays.data(), rayCount, hits.data(), jobs);
+        batchMs = std::min(batchMs, elapsedMs(start));
+    }
+    
+    // The old march on a sample of the rays: how much slower, and whether
+    // both find the same surface (to within a step)
+    const int marchRays = 256;
+    int agree = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < marchRays; ++i) {
+        const HeightRay& ray = rays[i * (rayCount / marchRays)];
+        const HeightRayHit& hit = hits[i * (rayCount / marchRays)];
+        float distance = -1.0f;
+        for (float t = 0.0f; t <= ray.maxDistance; t += marchStep) {
+            float x = ray.originX + ray.directionX * t;
+            float y = ray.originY + ray.directionY * t;
+            if (x < 0.0f || y < 0.0f || x > size - 1 || y > size - 1) break;
+            if (ray.originZ + ray.directionZ * t <= heightMap.sampleBilinear(x, y)) {
+                distance = t;
+                break;
+            }
+        }
+        if (hit.hit ? distance >= hit.distance && distance <= hit.distance + marchStep : distance < 0.0f) agree++;
+    }
+    double marchMs = elapsedMs(start) * rayCount / marchRays;
+    
+    std::cout << rayCount << " rays, " << hitCount << " hit: 1 thread " << singleMs << " ms ("
+              << singleMs * 1000.0 / rayCount << " us/ray), batched " << batchMs << " ms" << std::endl;
+    std::cout << "march at " << marchStep << " texel: " << std::setprecision(1) << marchMs << " ms for "
+              << rayCount << " rays (" << marchMs / singleMs << "x), agrees on " << agree << "/" << marchRays
+              << std::endl;
+    
+    // Line of sight: segments of 32 to 256 texels between points just above
+    // the ground, anywhere on the map
+    std::vector<HeightRay> sightRays(rayCount);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (HeightRay& ray : sightRays) {
+        float x0 = 16.0f + unit(random) * (size - 32);
+        float y0 = 16.0f + unit(random) * (size - 32);
+        float heading = unit(random) * 6.2831853f;
+        float length = 32.0f + unit(random) * 224.0f;
+        float x1 = std::min(size - 2.0f, std::max(1.0f, x0 + std::cos(heading) * length));
+        float y1 = std::min(size - 2.0f, std::max(1.0f, y0 + std::sin(heading) * length));
+        float z0 = heightMap.sampleBilinear(x0, y0) + 0.01f;
+        float z1 = heightMap.sampleBilinear(x1, y1) + 0.01f;
+        float distance = std::sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+        ray = { x0, y0, z0, (x1 - x0) / distance, (y1 - y0) / distance, (z1 - z0) / distance, distance };
+    }
+    std::vector<HeightRayHit> sightHits(rayCount);
+    double sightMs = 1e30;
+    int blocked = 0;
+    for (int i = 0; i < repeats; ++i) {
+        start = std::chrono::steady_clock::now();
+        for (int ray = 0; ray < rayCount; ++ray) {
+            pyramid.raycast(heightMap, sightRays[ray], sightHits[ray]);
+        }
+        sightMs = std::min(sightMs, elapsedMs(start));
+        blocked = static_cast<int>(std::count_if(sightHits.begin(), sightHits.end(), [](const HeightRayHit& hit) { return hit.hit; }));
+    }
+    std::cout << std::setprecision(3) << rayCount << " line of sight rays, " << blocked << " blocked: 1 thread "
+              << sightMs << " ms (" << sightMs * 1000.0 / rayCount << " us/ray)" << std::endl;
+    
+    // Batched bilinear queries at the hit points
+    std::vector<float> sampleX(rayCount);
+    std::vector<float> sampleY(rayCount);
+    std::vector<float> sampled(rayCount);
+    for (int i = 0; i < rayCount; ++i) {
+        sampleX[i] = hits[i].hit ? hits[i].x : rays[i].originX;
+        sampleY[i] = hits[i].hit ? hits[i].y : rays[i].originY;
+    }
+    double sampleMs = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        start = std::chrono::steady_clock::now();
+        heightMap.sampleBilinear(sampleX.data(), sampleY.data(), rayCount, sampled.data());
+        sampleMs = std::min(sampleMs, elapsedMs(start));
+    }
+    std::cout << std::setprecision(1) << "bilinear: " << rayCount / (sampleMs / 1000.0) / 1e6
+              << " M samples/s" << std::endl;
+}
+
+void Benchmarks::frameGovernor() {
+    const float targetMs = 16.6f;
+    const float vsyncMs = 1000.0f / 60.0f;
+    const float runSeconds = 120.0f;
+    // Background remeshing: a new level draws this long after it is picked
+    const float remeshSeconds = 0.5f;
+    // Work per detail level relative to full detail: fewer triangles, then
+    // fewer trees and chunks past the far plane
+    const float levelCost[] = { 1.0f, 0.8f, 0.4f, 0.3f, 0.12f, 0.05f };
+    
+    struct Machine {
+        const char* name;
+        float fullDetailMs;     // Work time at full detail
+        float spikeFactor;      // Load multiplier from 30 s to 60 s (1 = none)
+    };
+    const Machine machines[] = {
+        { "fast GPU", 6.0f, 1.0f },
+        { "borderline", 21.0f, 1.0f },
+        { "background load", 9.0f, 3.0f },
+        { "software raster", 120.0f, 1.0f },
+    };
+    
+    FrameBudgetSettings settings;
+    settings.targetFrameMs = targetMs;
+    
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Frame governor, " << targetMs << " ms target, vsync " << vsyncMs << " ms, "
+              << runSeconds << " s per machine, meshes land " << remeshSeconds << " s after a change" << std::endl;
+    
+    for (const Machine& machine : machines) {
+        FrameGovernor governor;
+        governor.setSettings(settings);
+        
+        int drawnLevel = 0;
+        float remeshLeft = 0.0f;
+        int switches = 0;
+        float lastSwitch = 0.0f;
+        long long frames = 0;
+        long long overBudget = 0;
+        double totalWorkMs = 0.0;
+        unsigned int random = 12345u;
+        
+        for (float time = 0.0f; time < runSeconds; ) {
+            // +-10% frame to frame jitter
+            random = random * 1664525u + 1013904223u;
+            float jitter = 0.9f + 0.2f * (random >> 8) / 16777216.0f;
+            float load = time >= 30.0f && time < 60.0f ? machine.spikeFactor : 1.0f;
+            float workMs = machine.fullDetailMs * levelCost[drawnLevel] * load * jitter;
+            float frameSeconds = std::max(workMs, vsyncMs) / 1000.0f;
+            
+            if (governor.update(frameSeconds, workMs)) {
+                switches++;
+                lastSwitch = time;
+                remeshLeft = remeshSeconds;
+            }
+            if (remeshLeft > 0.0f) {
+                remeshLeft -= frameSeconds;
+                if (remeshLeft <= 0.0f) drawnLevel = governor.getLevel();
+            }
+            
+            frames++;
+            if (workMs > targetMs) overBudget++;
+            totalWorkMs += workMs;
+            time += frameSeconds;
+        }
+        
+        std::cout << std::setw(16) << machine.name << ": level " << governor.getLevel() + 1 << "/"
+                  << FrameGovernor::getLevelCount() << ", " << switches << " switches, last at " << lastSwitch
+                  << " s, " << totalWorkMs / frames << " ms average, " << 100.0 * overBudget / frames << "% of "
+                  << frames << " frames over budget"
+                  << std::endl;
+    }
+}
+
+void Benchmarks::climate() {
+    const int size = 1024;
+    const float scale = 200.0f;
+    const int octaves = 4;
+    const int repeats = 3;
+    
+    JobSystem& jobs = JobSystem::instance();
+    TerrainGenerator generator;
+    generator.setJobSystem(&jobs);
+    TerrainSeed seed = generator.createSeed(octaves);
+    
+    ClimateSettings settings;
+    settings.scale = 3.0f * 4.0f;
+    
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Climate fields, " << size << "x" << size << ", " << octaves << " octaves, best of " << repeats
+              << ", " << jobs.getThreadCount() << " threads" << std::endl;
+    
+    // Heights alone, then heights with both climate fields in the same pass
+    double heightMs = 1e30;
+    double fusedMs = 1e30;
+    std::unique_ptr<HeightMap> heightMap;
+    std::unique_ptr<ClimateMap> climate;
+    for (int i = 0; i < repeats; ++i) {
+        generator.setClimate(ClimateSettings());
+        auto start = std::chrono::steady_clock::now();
+        generator.generateTerrainAsync(seed, 0, 0, size, size, 1, scale, octaves, 0.5f, 2.0f).take();
+        heightMs = std::min(heightMs, elapsedMs(start));
+        
+        generator.setClimate(settings);
+        start = std::chrono::steady_clock::now();
+        TerrainTask task = generator.generateTerrainAsync(seed, 0, 0, size, size, 1, scale, octaves, 0.5f, 2.0f);
+        heightMap = task.take();
+        climate = task.takeClimate();
+        fusedMs = std::min(fusedMs, elapsedMs(start));
+    }
+    
+    // The same two fields as their own full-resolution passes, the way a
+    // second and third noise map would be generated
+    std::vector<float> separate(static_cast<size_t>(size) * size * 2);
+    double separateMs = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (int field = 0; field < 2; ++field) {
+            jobs.parallelFor(0, size, 0, [&](int firstRow, int endRow) {
+                std::vector<double> sampleX(size);
+                std::vector<double> sampleY(size);
+                FractalScratch scratch;
+                for (int y = firstRow; y < endRow; ++y) {
+                    for (int x = 0; x < size; ++x) {
+                        sampleX[x] = x / scale / settings.scale + seed.climateOffsets[field * 2];
+                        sampleY[x] = y / scale / settings.scale + seed.climateOffsets[field * 2 + 1];
+                    }
+                    seed.climate->fractalNoise(sampleX.data(), sampleY.data(), size, settings.octaves, 0.5f, 2.0f,
+                                               1.0f, &separate[(static_cast<size_t>(field) * size + y) * size], scratch);
+                }
+            });
+        }
+        separateMs = std::min(separateMs, elapsedMs(start));
+    }
+    
+    std::cout << "heights " << heightMs << " ms, with climate " << fusedMs << " ms (+"
+              << 100.0 * (fusedMs - heightMs) / heightMs << "%), two separate field passes " << separateMs
+              << " ms (+" << 100.0 * separateMs / heightMs << "%)" << std::endl;
+    
+    // Classification on one thread, texel by texel and in bulk
+    size_t texels = climate->biome.size();
+    std::vector<uint8_t> biomes(texels);
+    double scalarMs = 1e30;
+    double bulkMs = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t texel = 0; texel < texels; ++texel) {
+            biomes[texel] = static_cast<uint8_t>(Biomes::classify(climate->temperature[texel], climate->moisture[texel]));
+        }
+        scalarMs = std::min(scalarMs, elapsedMs(start));
+        
+        start = std::chrono::steady_clock::now();
+        Biomes::classify(climate->temperature.data(), climate->moisture.data(), texels, biomes.data());
+        bulkMs = std::min(bulkMs, elapsedMs(start));
+    }
+    bool same = biomes == climate->biome;
+    std::cout << std::setprecision(2) << "classify: per texel " << scalarMs << " ms, bulk " << bulkMs << " ms ("
+              << texels / (bulkMs / 1000.0) / 1e9 << " G texels/s), " << (same ? "same" : "DIFFERENT")
+              << " biomes" << std::endl;
+    
+    // Biome mix above the beaches
+    std::vector<size_t> biomeTexels(Biomes::count, 0);
+    size_t land = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (heightMap->getHeight(x, y) < settings.lapseHeight) continue;
+            biomeTexels[static_cast<int>(climate->getBiome(x, y))]++;
+            land++;
+        }
+    }
+    std::cout << std::setprecision(1) << "land biomes:";
+    for (int biome = 0; biome < Biomes::count; ++biome) {
+        std::cout << " " << Biomes::getName(static_cast<Biome>(biome)) << " "
+                  << 100.0 * biomeTexels[biome] / std::max<size_t>(land, 1) << "%";
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+
+// Headless benchmarks, run with: TerrainGenerator --benchmark <name>
+class Benchmarks {
+public:
+    // Returns a process exit code; unknown names list the available ones
+    static int run(const std::string& name);
+    
+    // Vertex cache optimization: ACMR and vertex shader invocations saved
+    static void meshOptimization();
+    
+    // Adaptive (RTIN) meshes checked against the heightmap at every texel
+    // they cover; false if any exceeds the requested max error
+    static bool adaptiveMeshError();
+    
+    // Bulk SIMD conversions (SSE2, or F16C when built with it) and biome
+    // classification against the scalar calls; false if any result differs
+    static bool simdPaths();
+    
+    // Job system scaling from 1 thread up to every core (or the thread cap)
+    static void jobScaling();
+    
+    // Hydraulic erosion throughput at 1k, 4k and 8k, and a determinism check
+    static void erosion();
+    
+    // Fused derived-field pass (normals, slope, curvature, occlusion)
+    static void derivedFields();
+    
+    // Noise value plus gradient: analytic derivatives against three evaluations
+    static void noiseGradients();
+    
+    // Every noise backend: single, batch and gradient throughput, value
+    // statistics and how evenly gradient directions spread
+    static void noiseBackends();
+    
+    // Batch (cell-coherent) against per-sample evaluation as lattice cells
+    // grow from 2 to 450 samples across
+    static void noiseCoherence();
+    
+    // Sub-cell precision far from the origin: double lattice coordinates
+    // against the float coordinates the generator used to pass
+    static void noisePrecision();
+    
+    // Composed noise graph, fused, against the cost of its leaves alone
+    static void noiseGraph();
+    
+    // Heightmap codec at 8 to 32 bits: size, error, encode and decode speed
+    static void heightMapCodec();
+    
+    // Streaming glb and PLY export of a terrain mesh, on 1 thread and all
+    static void meshExport();
+    
+    // Pool misses and heap allocations per streamed terrain, cold and once
+    // the pools are warm (heap counts need TERRAIN_COUNT_HEAP_ALLOCATIONS)
+    static void memoryPools();
+    
+    // Heightmap storage types: bytes, bulk narrow and widen speed, error,
+    // and the derived-field pass reading each
+    static void heightStorage();
+    
+    // Min/max pyramid: build and update time, ray casts on 1 thread and
+    // batched against the fixed-step march, and bilinear sampling speed
+    static void heightPyramid();
+    
+    // Frame governor driven by simulated machines: the level each settles
+    // on, how often it switches, and the share of frames over budget
+    static void frameGovernor();
+    
+    // Climate fields from the height pass against separate full-resolution
+    // passes, bulk biome classification, and the biome mix
+    static void climate();
+};
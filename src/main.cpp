@@ -1,10 +1,79 @@
+#include <cstdlib>
 #include <iostream>
-#include "terrain/TerrainGenerator.h"
+#include <string>
+#include <vector>
+#include "renderer/MeshExporter.h"
 #include "renderer/Renderer.h"
+#include "renderer/TerrainStreamer.h"
+#include "terrain/TerrainGenerator.h"
+#include "terrain/TerrainShapes.h"
+#include "bench/Benchmarks.h"
+#include "utils/JobSystem.h"
+
+namespace {
+    // Generate the requested terrain without a window and write its mesh,
+    // with trees, to path (.glb or .ply). Returns a process exit code.
+    int exportTerrain(const TerrainRequest& request, const std::string& path) {
+        MeshFileFormat format;
+        if (!MeshExporter::formatFromPath(path, format)) {
+            std::cerr << "Unknown mesh format '" << path << "': use .glb or .ply" << std::endl;
+            return 1;
+        }
+        
+        TerrainGenerator generator;
+        generator.setNoiseLayers(request.noiseLayers);
+        generator.setShape(request.shape);
+        generator.setErosion(request.erosion);
+        generator.setThermalErosion(request.thermalErosion);
+        generator.setSlopeDamping(request.slopeDamping);
+        generator.setHeightStorage(request.heightStorage);
+        TerrainSeed seed = generator.createSeed(request.octaves);
+        std::unique_ptr<HeightMap> heightMap = generator.generateTerrainAsync(
+            seed, request.originX, request.originY, request.width, request.height, 1, request.scale,
+            request.octaves, request.persistence, request.lacunarity).take();
+        
+        TerrainMeshBuilder builder;
+        builder.setTriangleStepSize(request.triangleStepSize);
+        builder.setMaxMeshError(request.maxMeshError);
+        builder.setTreeDensity(request.treeDensity);
+        TerrainFields fields;
+        builder.buildFields(*heightMap, fields);
+        
+        MeshExporter::Stats stats;
+        if (!MeshExporter().exportTerrain(path, format, *heightMap, fields, builder, true, &stats)) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << path << ": " << stats.terrainTriangles << " terrain and " << stats.treeTriangles
+                  << " tree triangles, " << stats.bytesWritten << " bytes" << std::endl;
+        return 0;
+    }
+}
 
-int main() {
+int main(int argc, char** argv) {
     std::cout << "Procedural Terrain Generator" << std::endl;
     
+    // Optional flags:
+    //   --threads <n>       cap worker threads (for shared machines)
+    //   --benchmark <name>  run a headless benchmark and exit
+    //   --export <file>     write the terrain mesh to a .glb or .ply file and exit
+    std::string benchmark;
+    std::string exportPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--threads") {
+            JobSystem::setMaxThreads(std::atoi(argv[i + 1]));
+        } else if (flag == "--benchmark") {
+            benchmark = argv[i + 1];
+        } else if (flag == "--export") {
+            exportPath = argv[i + 1];
+        }
+    }
+    
+    if (!benchmark.empty()) {
+        return Benchmarks::run(benchmark);
+    }
+    
     // Configuration
     int width = 256;
     int height = 256;
@@ -13,11 +82,79 @@ int main() {
     float persistence = 0.5f;
     float lacunarity = 2.0f;
     
-    // Generate terrain
-    TerrainGenerator terrainGenerator;
-    HeightMap heightMap = terrainGenerator.generateTerrain(
-        width, height, scale, octaves, persistence, lacunarity
-    );
+    // Displace a shared grid on the GPU instead of building the mesh on the CPU
+    bool gpuDisplacement = false;
+    
+    // Adaptive mesh vertical error in world units (0 = regular grid)
+    float maxMeshError = 0.0f;
+    
+    // Frame time to hold (ms): mesh detail, trees and draw distance drop
+    // while frames run over it (0 = always full detail)
+    float frameBudgetMs = 16.6f;
+    
+    // Show a coarse preview first and refine it in the background
+    bool progressivePreview = false;
+    
+    // Hydraulic erosion droplets per heightmap texel (0 = no erosion)
+    float erosionDropletsPerTexel = 1.0f;
+    
+    // Thermal erosion (talus relaxation) iterations to soften ridges (0 = off)
+    int thermalErosionIterations = 50;
+    
+    // Smooth noise detail on steep slopes, eroded-looking (0 = plain fractal noise)
+    float slopeDamping = 0.0f;
+    
+    // Heightmap storage: UNorm16 halves heightmap memory and texture uploads
+    // (1/65535 height steps); Float32 keeps exact heights
+    HeightStorage heightStorage = HeightStorage::UNorm16;
+    
+    // Noise backend of each octave, coarse to fine; the last one repeats.
+    // Perlin, OpenSimplex2 (no axis streaks), Value (cheap) or Cellular (basins)
+    std::vector<NoiseType> noiseLayers = { NoiseType::Perlin };
+    
+    // Generate warped continents with ridged mountains instead of the octave sum
+    bool continentShape = false;
+    
+    // Size of a moisture / temperature noise cell in noise units (texels /
+    // scale); their biomes color the ground (0 = height bands only)
+    float climateScale = 3.0f;
+    
+    ErosionSettings erosion;
+    erosion.dropletsPerTexel = erosionDropletsPerTexel;
+    
+    ThermalErosionSettings thermalErosion;
+    thermalErosion.iterations = thermalErosionIterations;
+    
+    ClimateSettings climate;
+    climate.scale = climateScale;
+    
+    // Headless export of the same terrain the window would stream in
+    if (!exportPath.empty()) {
+        TerrainRequest request;
+        request.id = 0;
+        request.originX = 0;
+        request.originY = 0;
+        request.width = width;
+        request.height = height;
+        request.scale = scale;
+        request.octaves = octaves;
+        request.persistence = persistence;
+        request.lacunarity = lacunarity;
+        request.triangleStepSize = 1;
+        request.maxMeshError = maxMeshError;
+        request.treeDensity = 1.0f;
+        request.buildTerrainMesh = true;
+        request.progressive = false;
+        request.erosion = erosion;
+        request.thermalErosion = thermalErosion;
+        request.slopeDamping = slopeDamping;
+        request.heightStorage = heightStorage;
+        request.noiseLayers = noiseLayers;
+        if (continentShape) {
+            request.shape = TerrainShapes::continents;
+        }
+        return exportTerrain(request, exportPath);
+    }
     
     // Create and configure renderer
     Renderer renderer;
@@ -26,9 +163,33 @@ int main() {
         return -1;
     }
     
+    renderer.setMaxMeshError(maxMeshError);
+    
+    FrameBudgetSettings frameBudget;
+    frameBudget.targetFrameMs = frameBudgetMs;
+    renderer.setFrameBudget(frameBudget);
+    
+    renderer.setProgressivePreview(progressivePreview);
+    
+    renderer.setErosion(erosion);
+    renderer.setThermalErosion(thermalErosion);
+    renderer.setSlopeDamping(slopeDamping);
+    renderer.setHeightStorage(heightStorage);
+    renderer.setNoiseLayers(noiseLayers);
+    renderer.setClimate(climate);
+    if (continentShape) {
+        renderer.setTerrainShape(TerrainShapes::continents);
+    }
+    if (gpuDisplacement) {
+        renderer.setRenderMode(TerrainRenderMode::GpuDisplacement);
+    }
+    
+    // Generate terrain in the background; it streams in while the window is live
+    renderer.requestTerrain(width, height, scale, octaves, persistence, lacunarity);
+    
     // Render loop
     while (!renderer.shouldClose()) {
-        renderer.renderTerrain(heightMap);
+        renderer.renderFrame();
         renderer.update();  // This now handles input and timing
     }
     
@@ -0,0 +1,94 @@
+#include "CellularNoise.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+CellularNoise::CellularNoise(uint32_t seed) : NoiseSource(seed) {}
+
+float CellularNoise::noise(double x, double y) const {
+    return sample(x, y, nullptr, nullptr);
+}
+
+float CellularNoise::noise(double x, double y, float& dx, float& dy) const {
+    return sample(x, y, &dx, &dy);
+}
+
+void CellularNoise::noise(const double* x, const double* y, int count, float* out) const {
+    // The nine candidate feature points, relative to the cell corner, are
+    // hashed once per cell
+    int64_t cellX = INT64_MIN;
+    int64_t cellY = INT64_MIN;
+    float featureX[9];
+    float featureY[9];
+    
+    for (int s = 0; s < count; ++s) {
+        float fx, fy;
+        int64_t X = splitCoordinate(x[s], fx);
+        int64_t Y = splitCoordinate(y[s], fy);
+        
+        if (X != cellX || Y != cellY) {
+            cellX = X;
+            cellY = Y;
+            for (int j = -1; j <= 1; ++j) {
+                for (int i = -1; i <= 1; ++i) {
+                    float offsetX, offsetY;
+                    featurePoint(X + i, Y + j, offsetX, offsetY);
+                    featureX[(j + 1) * 3 + i + 1] = i + offsetX;
+                    featureY[(j + 1) * 3 + i + 1] = j + offsetY;
+                }
+            }
+        }
+        
+        // Same search and order as sample()
+        float nearestSquared = 8.0f;
+        for (int k = 0; k < 9; ++k) {
+            float dx = featureX[k] - fx;
+            float dy = featureY[k] - fy;
+            nearestSquared = std::min(nearestSquared, dx * dx + dy * dy);
+        }
+        out[s] = 2.0f * std::sqrt(nearestSquared) - 1.0f;
+    }
+}
+
+float CellularNoise::sample(double x, double y, float* dx, float* dy) const {
+    float fx, fy;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    
+    // Nearest feature point in the 3x3 cells around the sample, as an
+    // offset from the sample
+    float nearestSquared = 8.0f;
+    float nearestX = 0.0f;
+    float nearestY = 0.0f;
+    for (int j = -1; j <= 1; ++j) {
+        for (int i = -1; i <= 1; ++i) {
+            float offsetX, offsetY;
+            featurePoint(X + i, Y + j, offsetX, offsetY);
+            float featureX = i + offsetX - fx;
+            float featureY = j + offsetY - fy;
+            float distanceSquared = featureX * featureX + featureY * featureY;
+            if (distanceSquared < nearestSquared) {
+                nearestSquared = distanceSquared;
+                nearestX = featureX;
+                nearestY = featureY;
+            }
+        }
+    }
+    
+    float distance = std::sqrt(nearestSquared);
+    
+    // 2 * distance - 1 grows at 2 units per unit, away from the feature
+    if (dx) {
+        float scale = distance > 0.0f ? -2.0f / distance : 0.0f;
+        *dx = nearestX * scale;
+        *dy = nearestY * scale;
+    }
+    return 2.0f * distance - 1.0f;
+}
+
+void CellularNoise::featurePoint(int64_t X, int64_t Y, float& offsetX, float& offsetY) const {
+    // Two unrelated 16-bit halves of the cell's hash, inside the jitter square
+    uint32_t hash = hashLattice(X, Y);
+    offsetX = 0.5f + jitter * (static_cast<float>(hash & 0xFFFF) / 65535.0f - 0.5f);
+    offsetY = 0.5f + jitter * (static_cast<float>(hash >> 16) / 65535.0f - 0.5f);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "NoiseSource.h"
+
+// Cellular (Worley) noise: the distance to the nearest feature point, one
+// jittered point per lattice cell, mapped from [0, about 1] to [-1, 1].
+// Gives round basins with sharp creases between them; the gradient points
+// away from the nearest feature point.
+class CellularNoise : public NoiseSource {
+public:
+    explicit CellularNoise(uint32_t seed);
+    
+    float noise(double x, double y) const override;
+    float noise(double x, double y, float& dx, float& dy) const override;
+    void noise(const double* x, const double* y, int count, float* out) const override;
+    
+    // How far a feature point may wander from its cell's center, as a share
+    // of the cell. Below 1 the 3x3 neighborhood always holds the nearest one.
+    static constexpr float jitter = 0.9f;
+
+private:
+    // Value, and the gradient when dx and dy are given
+    float sample(double x, double y, float* dx, float* dy) const;
+    
+    // Feature point position inside the cell (X, Y)
+    void featurePoint(int64_t X, int64_t Y, float& offsetX, float& offsetY) const;
+};
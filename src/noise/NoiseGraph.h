@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "NoiseSource.h"
+
+// Compile-time noise composition. Sources, combiners, domain warps and
+// curve remaps are nested expression types, so a whole terrain design
+// compiles into one inlined kernel:
+//
+//     auto land = noiseSmoothstep(noiseFractal(simplex, 4, 0.5f, 2.0f, 3.0f), -0.1f, 0.3f);
+//     auto height = noiseWarp(land * noiseRidged(perlin, 6, 0.5f, 2.0f, 0.5f), warpX, warpY, 0.4f);
+//     std::shared_ptr<const NoiseKernel> kernel = makeNoiseKernel(height);
+//
+// Every node evaluates either one sample, with no temporaries at all, or a
+// batch, where leaves use the backends' batch calls and inner nodes borrow
+// row-sized buffers from a NoiseRowScratch (never a full map). Both give
+// bit-identical results. Coordinates are doubles, as for NoiseSource, so
+// designs stay precise far from the origin.
+
+// Row buffers lent to nodes during batch evaluation, reused between calls
+class NoiseRowScratch {
+public:
+    NoiseRowScratch() : used(0), usedCoordinates(0) {}
+    
+    float* acquire(int count) {
+        if (used == rows.size()) {
+            rows.emplace_back();
+        }
+        std::vector<float>& row = rows[used++];
+        if (row.size() < static_cast<size_t>(count)) {
+            row.resize(count);
+        }
+        return row.data();
+    }
+    
+    // Rows are returned in reverse order of acquisition
+    void release(int count = 1) { used -= count; }
+    
+    // The same for rows of sample coordinates
+    double* acquireCoordinates(int count) {
+        if (usedCoordinates == coordinateRows.size()) {
+            coordinateRows.emplace_back();
+        }
+        std::vector<double>& row = coordinateRows[usedCoordinates++];
+        if (row.size() < static_cast<size_t>(count)) {
+            row.resize(count);
+        }
+        return row.data();
+    }
+    
+    void releaseCoordinates(int count = 1) { usedCoordinates -= count; }
+    
+    // Working space for NoiseSource::fractalNoise batches
+    FractalScratch fractal;
+
+private:
+    std::vector<std::vector<float>> rows;
+    std::vector<std::vector<double>> coordinateRows;
+    size_t used;
+    size_t usedCoordinates;
+};
+
+// Base of every node; only tags types for the operators below
+template <typename Derived>
+struct NoiseExpr {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+};
+
+struct NoiseConstant : NoiseExpr<NoiseConstant> {
+    float value;
+    
+    explicit NoiseConstant(float value) : value(value) {}
+    
+    float operator()(double, double) const { return value; }
+    void operator()(const double*, const double*, int count, float* out, NoiseRowScratch&) const {
+        std::fill(out, out + count, value);
+    }
+};
+
+// Fractal noise from one source, sampled at (x + offsetX, y + offsetY)
+struct NoiseFractal : NoiseExpr<NoiseFractal> {
+    std::shared_ptr<const NoiseSource> source;
+    int octaves;
+    float persistence;
+    float lacunarity;
+    float scale;
+    float offsetX;
+    float offsetY;
+    
+    float operator()(double x, double y) const {
+        return source->fractalNoise(x + offsetX, y + offsetY, octaves, persistence, lacunarity, scale);
+    }
+    
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        double* shiftedX = scratch.acquireCoordinates(count);
+        double* shiftedY = scratch.acquireCoordinates(count);
+        for (int i = 0; i < count; ++i) {
+            shiftedX[i] = x[i] + offsetX;
+            shiftedY[i] = y[i] + offsetY;
+        }
+        source->fractalNoise(shiftedX, shiftedY, count, octaves, persistence, lacunarity, scale, out, scratch.fractal);
+        scratch.releaseCoordinates(2);
+    }
+};
+
+// Ridged multifractal in [0, 1]: each octave folds the noise at zero into a
+// sharp crest, (1 - |n|)^2, and is weighted by the crest below it so detail
+// gathers along the ridgelines
+struct NoiseRidged : NoiseExpr<NoiseRidged> {
+    std::shared_ptr<const NoiseSource> source;
+    int octaves;
+    float persistence;
+    float lacunarity;
+    float scale;
+    
+    float operator()(double x, double y) const {
+        float total = 0.0f;
+        double frequency = 1.0 / scale;
+        float amplitude = 1.0f;
+        float maxValue = 0.0f;
+        float weight = 1.0f;
+        for (int i = 0; i < octaves; ++i) {
+            float ridge = 1.0f - std::fabs(source->noise(x * frequency, y * frequency));
+            ridge = ridge * ridge * weight;
+            total += ridge * amplitude;
+            weight = std::min(1.0f, ridge * 2.0f);
+            maxValue += amplitude;
+            frequency *= lacunarity;
+            amplitude *= persistence;
+        }
+        return total / maxValue;
+    }
+    
+    // Same operations per sample, in the same order
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        double* sampleX = scratch.acquireCoordinates(count);
+        double* sampleY = scratch.acquireCoordinates(count);
+        float* values = scratch.acquire(count);
+        float* weights = scratch.acquire(count);
+        std::fill(out, out + count, 0.0f);
+        std::fill(weights, weights + count, 1.0f);
+        
+        double frequency = 1.0 / scale;
+        float amplitude = 1.0f;
+        float maxValue = 0.0f;
+        for (int octave = 0; octave < octaves; ++octave) {
+            for (int i = 0; i < count; ++i) {
+                sampleX[i] = x[i] * frequency;
+                sampleY[i] = y[i] * frequency;
+            }
+            source->noise(sampleX, sampleY, count, values);
+            for (int i = 0; i < count; ++i) {
+                float ridge = 1.0f - std::fabs(values[i]);
+                ridge = ridge * ridge * weights[i];
+                out[i] += ridge * amplitude;
+                weights[i] = std::min(1.0f, ridge * 2.0f);
+            }
+            maxValue += amplitude;
+            frequency *= lacunarity;
+            amplitude *= persistence;
+        }
+        for (int i = 0; i < count; ++i) {
+            out[i] /= maxValue;
+        }
+        scratch.release(2);
+        scratch.releaseCoordinates(2);
+    }
+};
+
+// Combines two expressions per sample with Op::apply(a, b)
+template <typename A, typename B, typename Op>
+struct NoiseBinary : NoiseExpr<NoiseBinary<A, B, Op>> {
+    A a;
+    B b;
+    
+    NoiseBinary(const A& a, const B& b) : a(a), b(b) {}
+    
+    float operator()(double x, double y) const { return Op::apply(a(x, y), b(x, y)); }
+    
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        float* right = scratch.acquire(count);
+        a(x, y, count, out, scratch);
+        b(x, y, count, right, scratch);
+        for (int i = 0; i < count; ++i) {
+            out[i] = Op::apply(out[i], right[i]);
+        }
+        scratch.release();
+    }
+};
+
+struct NoiseAddOp { static float apply(float a, float b) { return a + b; } };
+struct NoiseSubtractOp { static float apply(float a, float b) { return a - b; } };
+struct NoiseMultiplyOp { static float apply(float a, float b) { return a * b; } };
+struct NoiseMinOp { static float apply(float a, float b) { return std::min(a, b); } };
+struct NoiseMaxOp { static float apply(float a, float b) { return std::max(a, b); } };
+
+// a where t is 0, b where t is 1
+template <typename A, typename B, typename T>
+struct NoiseBlend : NoiseExpr<NoiseBlend<A, B, T>> {
+    A a;
+    B b;
+    T t;
+    
+    NoiseBlend(const A& a, const B& b, const T& t) : a(a), b(b), t(t) {}
+    
+    float operator()(double x, double y) const {
+        float from = a(x, y);
+        return from + t(x, y) * (b(x, y) - from);
+    }
+    
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        float* to = scratch.acquire(count);
+        float* weight = scratch.acquire(count);
+        a(x, y, count, out, scratch);
+        b(x, y, count, to, scratch);
+        t(x, y, count, weight, scratch);
+        for (int i = 0; i < count; ++i) {
+            out[i] = out[i] + weight[i] * (to[i] - out[i]);
+        }
+        scratch.release(2);
+    }
+};
+
+// Curve remap: curve(a) per sample; curve is any float(float) callable
+template <typename A, typename Curve>
+struct NoiseMap : NoiseExpr<NoiseMap<A, Curve>> {
+    A a;
+    Curve curve;
+    
+    NoiseMap(const A& a, const Curve& curve) : a(a), curve(curve) {}
+    
+    float operator()(double x, double y) const { return curve(a(x, y)); }
+    
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        a(x, y, count, out, scratch);
+        for (int i = 0; i < count; ++i) {
+            out[i] = curve(out[i]);
+        }
+    }
+};
+
+// Domain warp: a sampled at (x + strength * warpX, y + strength * warpY)
+template <typename A, typename WX, typename WY>
+struct NoiseWarp : NoiseExpr<NoiseWarp<A, WX, WY>> {
+    A a;
+    WX warpX;
+    WY warpY;
+    float strength;
+    
+    NoiseWarp(const A& a, const WX& warpX, const WY& warpY, float strength)
+        : a(a), warpX(warpX), warpY(warpY), strength(strength) {}
+    
+    float operator()(double x, double y) const {
+        return a(x + strength * warpX(x, y), y + strength * warpY(x, y));
+    }
+    
+    void operator()(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const {
+        float* offsetX = scratch.acquire(count);
+        float* offsetY = scratch.acquire(count);
+        double* warpedX = scratch.acquireCoordinates(count);
+        double* warpedY = scratch.acquireCoordinates(count);
+        warpX(x, y, count, offsetX, scratch);
+        warpY(x, y, count, offsetY, scratch);
+        for (int i = 0; i < count; ++i) {
+            warpedX[i] = x[i] + strength * offsetX[i];
+            warpedY[i] = y[i] + strength * offsetY[i];
+        }
+        a(warpedX, warpedY, count, out, scratch);
+        scratch.releaseCoordinates(2);
+        scratch.release(2);
+    }
+};
+
+// Leaves
+
+inline NoiseConstant noiseConstant(float value) {
+    return NoiseConstant(value);
+}
+
+inline NoiseFractal noiseFractal(std::shared_ptr<const NoiseSource> source, int octaves, float persistence,
+                                 float lacunarity, float scale, float offsetX = 0.0f, float offsetY = 0.0f) {
+    NoiseFractal node;
+    node.source = source;
+    node.octaves = octaves;
+    node.persistence = persistence;
+    node.lacunarity = lacunarity;
+    node.scale = scale;
+    node.offsetX = offsetX;
+    node.offsetY = offsetY;
+    return node;
+}
+
+inline NoiseRidged noiseRidged(std::shared_ptr<const NoiseSource> source, int octaves, float persistence,
+                               float lacunarity, float scale) {
+    NoiseRidged node;
+    node.source = source;
+    node.octaves = octaves;
+    node.persistence = persistence;
+    node.lacunarity = lacunarity;
+    node.scale = scale;
+    return node;
+}
+
+// Combiners
+
+template <typename A, typename B>
+NoiseBinary<A, B, NoiseAddOp> operator+(const NoiseExpr<A>& a, const NoiseExpr<B>& b) {
+    return NoiseBinary<A, B, NoiseAddOp>(a.self(), b.self());
+}
+
+template <typename A, typename B>
+NoiseBinary<A, B, NoiseSubtractOp> operator-(const NoiseExpr<A>& a, const NoiseExpr<B>& b) {
+    return NoiseBinary<A, B, NoiseSubtractOp>(a.self(), b.self());
+}
+
+template <typename A, typename B>
+NoiseBinary<A, B, NoiseMultiplyOp> operator*(const NoiseExpr<A>& a, const NoiseExpr<B>& b) {
+    return NoiseBinary<A, B, NoiseMultiplyOp>(a.self(), b.self());
+}
+
+template <typename A>
+NoiseBinary<A, NoiseConstant, NoiseAddOp> operator+(const NoiseExpr<A>& a, float b) {
+    return NoiseBinary<A, NoiseConstant, NoiseAddOp>(a.self(), NoiseConstant(b));
+}
+
+template <typename A>
+NoiseBinary<NoiseConstant, A, NoiseAddOp> operator+(float a, const NoiseExpr<A>& b) {
+    return NoiseBinary<NoiseConstant, A, NoiseAddOp>(NoiseConstant(a), b.self());
+}
+
+template <typename A>
+NoiseBinary<A, NoiseConstant, NoiseSubtractOp> operator-(const NoiseExpr<A>& a, float b) {
+    return NoiseBinary<A, NoiseConstant, NoiseSubtractOp>(a.self(), NoiseConstant(b));
+}
+
+template <typename A>
+NoiseBinary<NoiseConstant, A, NoiseSubtractOp> operator-(float a, const NoiseExpr<A>& b) {
+    return NoiseBinary<NoiseConstant, A, NoiseSubtractOp>(NoiseConstant(a), b.self());
+}
+
+template <typename A>
+NoiseBinary<A, NoiseConstant, NoiseMultiplyOp> operator*(const NoiseExpr<A>& a, float b) {
+    return NoiseBinary<A, NoiseConstant, NoiseMultiplyOp>(a.self(), NoiseConstant(b));
+}
+
+template <typename A>
+NoiseBinary<NoiseConstant, A, NoiseMultiplyOp> operator*(float a, const NoiseExpr<A>& b) {
+    return NoiseBinary<NoiseConstant, A, NoiseMultiplyOp>(NoiseConstant(a), b.self());
+}
+
+template <typename A, typename B>
+NoiseBinary<A, B, NoiseMinOp> noiseMin(const NoiseExpr<A>& a, const NoiseExpr<B>& b) {
+    return NoiseBinary<A, B, NoiseMinOp>(a.self(), b.self());
+}
+
+template <typename A, typename B>
+NoiseBinary<A, B, NoiseMaxOp> noiseMax(const NoiseExpr<A>& a, const NoiseExpr<B>& b) {
+    return NoiseBinary<A, B, NoiseMaxOp>(a.self(), b.self());
+}
+
+template <typename A, typename B, typename T>
+NoiseBlend<A, B, T> noiseBlend(const NoiseExpr<A>& a, const NoiseExpr<B>& b, const NoiseExpr<T>& t) {
+    return NoiseBlend<A, B, T>(a.self(), b.self(), t.self());
+}
+
+template <typename A, typename WX, typename WY>
+NoiseWarp<A, WX, WY> noiseWarp(const NoiseExpr<A>& a, const NoiseExpr<WX>& warpX, const NoiseExpr<WY>& warpY,
+                               float strength) {
+    return NoiseWarp<A, WX, WY>(a.self(), warpX.self(), warpY.self(), strength);
+}
+
+// Curve remaps
+
+template <typename A, typename Curve>
+NoiseMap<A, Curve> noiseMap(const NoiseExpr<A>& a, const Curve& curve) {
+    return NoiseMap<A, Curve>(a.self(), curve);
+}
+
+template <typename A>
+auto noiseClamp(const NoiseExpr<A>& a, float low, float high) {
+    return noiseMap(a, [low, high](float value) { return std::min(high, std::max(low, value)); });
+}
+
+// 0 below edge0, 1 above edge1, smooth in between
+template <typename A>
+auto noiseSmoothstep(const NoiseExpr<A>& a, float edge0, float edge1) {
+    float inverseWidth = 1.0f / (edge1 - edge0);
+    return noiseMap(a, [edge0, inverseWidth](float value) {
+        float t = std::min(1.0f, std::max(0.0f, (value - edge0) * inverseWidth));
+        return t * t * (3.0f - 2.0f * t);
+    });
+}
+
+template <typename A>
+auto noiseAbs(const NoiseExpr<A>& a) {
+    return noiseMap(a, [](float value) { return std::fabs(value); });
+}
+
+// A finished expression behind a virtual interface, so non-template code
+// can hold it; one virtual call per sample or per batch
+class NoiseKernel {
+public:
+    virtual ~NoiseKernel() {}
+    
+    virtual float sample(double x, double y) const = 0;
+    virtual void sample(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const = 0;
+};
+
+template <typename E>
+class NoiseExprKernel : public NoiseKernel {
+public:
+    explicit NoiseExprKernel(const E& expression) : expression(expression) {}
+    
+    float sample(double x, double y) const override { return expression(x, y); }
+    
+    void sample(const double* x, const double* y, int count, float* out, NoiseRowScratch& scratch) const override {
+        expression(x, y, count, out, scratch);
+    }
+
+private:
+    E expression;
+};
+
+template <typename E>
+std::shared_ptr<const NoiseKernel> makeNoiseKernel(const NoiseExpr<E>& expression) {
+    return std::make_shared<NoiseExprKernel<E>>(expression.self());
+}
@@ -0,0 +1,143 @@
+#include "NoiseSource.h"
+#include "PerlinNoise.h"
+#include "OpenSimplexNoise.h"
+#include "ValueNoise.h"
+#include "CellularNoise.h"
+#include <algorithm>
+
+std::unique_ptr<NoiseSource> NoiseSource::create(NoiseType type, uint32_t seed) {
+    switch (type) {
+        case NoiseType::OpenSimplex2:
+            return std::unique_ptr<NoiseSource>(new OpenSimplexNoise(seed));
+        case NoiseType::Value:
+            return std::unique_ptr<NoiseSource>(new ValueNoise(seed));
+        case NoiseType::Cellular:
+            return std::unique_ptr<NoiseSource>(new CellularNoise(seed));
+        case NoiseType::Perlin:
+        default:
+            return std::unique_ptr<NoiseSource>(new PerlinNoise(seed));
+    }
+}
+
+const char* NoiseSource::getName(NoiseType type) {
+    switch (type) {
+        case NoiseType::OpenSimplex2: return "OpenSimplex2";
+        case NoiseType::Value: return "value";
+        case NoiseType::Cellular: return "cellular";
+        case NoiseType::Perlin:
+        default: return "Perlin";
+    }
+}
+
+float NoiseSource::fractalNoise(double x, double y, int octaves, float persistence, float lacunarity, float scale) const {
+    float total = 0.0f;
+    double frequency = 1.0 / scale;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;  // Used for normalizing the result
+    
+    // Add successive layers of noise
+    for (int i = 0; i < octaves; i++) {
+        // Add detailed features with increasing frequency and decreasing amplitude
+        total += noise(x * frequency, y * frequency) * amplitude;
+        
+        // Track the maximum possible amplitude sum for normalization
+        maxValue += amplitude;
+        
+        // Increase the frequency for the next octave
+        frequency *= lacunarity;
+        
+        // Decrease the amplitude for the next octave
+        amplitude *= persistence;
+    }
+    
+    // Normalize the result to a range of -1 to 1
+    return total / maxValue;
+}
+
+float NoiseSource::fractalNoise(double x, double y, int octaves, float persistence, float lacunarity, float scale,
+                                float& dx, float& dy) const {
+    float total = 0.0f;
+    float totalDx = 0.0f;
+    float totalDy = 0.0f;
+    double frequency = 1.0 / scale;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    
+    for (int i = 0; i < octaves; i++) {
+        float noiseDx, noiseDy;
+        total += noise(x * frequency, y * frequency, noiseDx, noiseDy) * amplitude;
+        
+        // Chain rule: the octave samples at x * frequency
+        totalDx += noiseDx * amplitude * static_cast<float>(frequency);
+        totalDy += noiseDy * amplitude * static_cast<float>(frequency);
+        
+        maxValue += amplitude;
+        frequency *= lacunarity;
+        amplitude *= persistence;
+    }
+    
+    dx = totalDx / maxValue;
+    dy = totalDy / maxValue;
+    return total / maxValue;
+}
+
+void NoiseSource::fractalNoise(const double* x, const double* y, int count, int octaves, float persistence,
+                               float lacunarity, float scale, float* out, FractalScratch& scratch) const {
+    scratch.x.resize(count);
+    scratch.y.resize(count);
+    scratch.values.resize(count);
+    double* sampleX = scratch.x.data();
+    double* sampleY = scratch.y.data();
+    float* values = scratch.values.data();
+    
+    std::fill(out, out + count, 0.0f);
+    double frequency = 1.0 / scale;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    
+    // Same operations per sample, in the same order, as the scalar version
+    for (int i = 0; i < octaves; i++) {
+        for (int j = 0; j < count; j++) {
+            sampleX[j] = x[j] * frequency;
+            sampleY[j] = y[j] * frequency;
+        }
+        noise(sampleX, sampleY, count, values);
+        for (int j = 0; j < count; j++) {
+            out[j] += values[j] * amplitude;
+        }
+        
+        maxValue += amplitude;
+        frequency *= lacunarity;
+        amplitude *= persistence;
+    }
+    
+    for (int j = 0; j < count; j++) {
+        out[j] /= maxValue;
+    }
+}
+
+float NoiseSource::dampedFractalNoise(double x, double y, int octaves, float persistence, float lacunarity,
+                                      float scale, float damping) const {
+    float total = 0.0f;
+    double frequency = 1.0 / scale;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    
+    // Slope of the octaves so far, in noise units per unit of frequency
+    float slopeX = 0.0f;
+    float slopeY = 0.0f;
+    
+    for (int i = 0; i < octaves; i++) {
+        float noiseDx, noiseDy;
+        float value = noise(x * frequency, y * frequency, noiseDx, noiseDy);
+        slopeX += noiseDx * amplitude;
+        slopeY += noiseDy * amplitude;
+        
+        total += value * amplitude / (1.0f + damping * (slopeX * slopeX + slopeY * slopeY));
+        maxValue += amplitude;
+        frequency *= lacunarity;
+        amplitude *= persistence;
+    }
+    
+    return total / maxValue;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class NoiseType {
+    Perlin,         // Gradient noise on a square lattice; faint axis-aligned streaks
+    OpenSimplex2,   // Gradient noise on a triangular lattice, three corners per sample
+    Value,          // Smoothed random lattice values: cheapest, blockiest
+    Cellular        // Distance to the nearest jittered feature point (Worley F1)
+};
+
+// Working space for batch fractal sums; reuse it between calls
+struct FractalScratch {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<float> values;
+};
+
+// A seeded 2D noise function with values in about [-1, 1]. Backends supply
+// single samples, samples with analytic derivatives and a batch call; the
+// fractal sums are built on those, so every backend gets them.
+//
+// Coordinates are doubles in lattice units. Backends split them into a
+// 64-bit lattice cell and a float offset inside it, and hash cells rather
+// than look them up in a 256-entry table, so the noise never repeats and
+// a sample a billion cells out is as precise as one at the origin.
+class NoiseSource {
+public:
+    virtual ~NoiseSource() {}
+    
+    virtual float noise(double x, double y) const = 0;
+    
+    // Value plus its partial derivatives with respect to x and y
+    virtual float noise(double x, double y, float& dx, float& dy) const = 0;
+    
+    // out[i] = noise(x[i], y[i]) for count samples, bit-identical to the
+    // single-sample call but with one virtual call for the whole batch
+    virtual void noise(const double* x, const double* y, int count, float* out) const = 0;
+    
+    float fractalNoise(double x, double y, int octaves, float persistence, float lacunarity, float scale) const;
+    
+    // Fractal noise and its derivatives with respect to x and y
+    float fractalNoise(double x, double y, int octaves, float persistence, float lacunarity, float scale,
+                       float& dx, float& dy) const;
+    
+    // Batch fractal noise, bit-identical to the single-sample version
+    void fractalNoise(const double* x, const double* y, int count, int octaves, float persistence, float lacunarity,
+                      float scale, float* out, FractalScratch& scratch) const;
+    
+    // Fractal noise where each octave is damped by the slope the octaves
+    // before it built up, 1 / (1 + damping * |gradient|^2): steep flanks stay
+    // smooth while flats and ridges keep their detail, like eroded terrain.
+    // damping 0 gives fractalNoise.
+    float dampedFractalNoise(double x, double y, int octaves, float persistence, float lacunarity, float scale,
+                             float damping) const;
+    
+    static std::unique_ptr<NoiseSource> create(NoiseType type, uint32_t seed);
+    static const char* getName(NoiseType type);
+
+protected:
+    explicit NoiseSource(uint32_t seed) : seed(seed * 0x9E3779B97F4A7C15ull) {}
+    
+    // 32 well-mixed bits for the lattice point (x, y, z) under this seed.
+    // z = 0 gives the 2D hash.
+    uint32_t hashLattice(int64_t x, int64_t y, int64_t z = 0) const {
+        uint64_t hash = seed ^ (static_cast<uint64_t>(x) * 0x5205402B9270C86Full) ^
+                        (static_cast<uint64_t>(y) * 0x598CD327003817B5ull) ^
+                        (static_cast<uint64_t>(z) * 0x5BCC226E9FA0BACBull);
+        return static_cast<uint32_t>((hash * 0x53A3F72DEEC546F5ull) >> 32);
+    }
+    
+    // Split a coordinate into its lattice cell and the offset inside it
+    static int64_t splitCoordinate(double x, float& offset) {
+        double cell = std::floor(x);
+        offset = static_cast<float>(x - cell);
+        return static_cast<int64_t>(cell);
+    }
+
+private:
+    uint64_t seed;
+};
@@ -0,0 +1,138 @@
+#include "OpenSimplexNoise.h"
+#include <climits>
+#include <cmath>
+
+namespace {
+    // Skew to the lattice's square basis and back: (sqrt(3) - 1) / 2 and
+    // (1 / sqrt(3) - 1) / 2
+    const double skew = 0.366025403784439;
+    const float unskew = -0.21132486540518713f;
+    
+    // Corner kernels are (0.5 - r^2)^4, zero past r^2 = 0.5
+    const float kernelRadiusSquared = 0.5f;
+    
+    // Brings the peak values to about +-1
+    const float normalizer = 0.01001634121365712f;
+}
+
+OpenSimplexNoise::OpenSimplexNoise(uint32_t seed) : NoiseSource(seed) {
+    // Unit directions every 15 degrees, offset so none lies on an axis
+    for (int i = 0; i < gradientCount; ++i) {
+        double angle = (7.5 + 15.0 * i) * 3.14159265358979323846 / 180.0;
+        gradients[i * 2] = static_cast<float>(std::cos(angle)) / normalizer;
+        gradients[i * 2 + 1] = static_cast<float>(std::sin(angle)) / normalizer;
+    }
+}
+
+float OpenSimplexNoise::noise(double x, double y) const {
+    return sample(x, y, nullptr, nullptr);
+}
+
+float OpenSimplexNoise::noise(double x, double y, float& dx, float& dy) const {
+    return sample(x, y, &dx, &dy);
+}
+
+void OpenSimplexNoise::noise(const double* x, const double* y, int count, float* out) const {
+    // The four corners of the skewed cell are hashed once per cell; each
+    // sample then uses three of them exactly as sample() does
+    int64_t cellX = INT64_MIN;
+    int64_t cellY = INT64_MIN;
+    const float* corners[4] = { nullptr, nullptr, nullptr, nullptr };   // (0,0), (1,1), (0,1), (1,0)
+    
+    for (int i = 0; i < count; ++i) {
+        double skewOffset = skew * (x[i] + y[i]);
+        double xs = x[i] + skewOffset;
+        double ys = y[i] + skewOffset;
+        double xsFloor = std::floor(xs);
+        double ysFloor = std::floor(ys);
+        float xi = static_cast<float>(xs - xsFloor);
+        float yi = static_cast<float>(ys - ysFloor);
+        
+        int64_t X = static_cast<int64_t>(xsFloor);
+        int64_t Y = static_cast<int64_t>(ysFloor);
+        if (X != cellX || Y != cellY) {
+            cellX = X;
+            cellY = Y;
+            corners[0] = getGradient(X, Y);
+            corners[1] = getGradient(X + 1, Y + 1);
+            corners[2] = getGradient(X, Y + 1);
+            corners[3] = getGradient(X + 1, Y);
+        }
+        
+        float t = (xi + yi) * unskew;
+        float x0 = xi + t;
+        float y0 = yi + t;
+        
+        float value = 0.0f;
+        float gradientX = 0.0f;
+        float gradientY = 0.0f;
+        addCorner(corners[0], x0, y0, value, gradientX, gradientY);
+        addCorner(corners[1], x0 - (1.0f + 2.0f * unskew), y0 - (1.0f + 2.0f * unskew), value, gradientX, gradientY);
+        if (y0 > x0) {
+            addCorner(corners[2], x0 - unskew, y0 - (1.0f + unskew), value, gradientX, gradientY);
+        } else {
+            addCorner(corners[3], x0 - (1.0f + unskew), y0 - unskew, value, gradientX, gradientY);
+        }
+        out[i] = value;
+    }
+}
+
+float OpenSimplexNoise::sample(double x, double y, float* dx, float* dy) const {
+    // Skewed in double, so large coordinates keep their fractional part
+    double skewOffset = skew * (x + y);
+    double xs = x + skewOffset;
+    double ys = y + skewOffset;
+    double xsFloor = std::floor(xs);
+    double ysFloor = std::floor(ys);
+    float xi = static_cast<float>(xs - xsFloor);
+    float yi = static_cast<float>(ys - ysFloor);
+    
+    int64_t X = static_cast<int64_t>(xsFloor);
+    int64_t Y = static_cast<int64_t>(ysFloor);
+    
+    // Offset from the base corner, back in input space
+    float t = (xi + yi) * unskew;
+    float x0 = xi + t;
+    float y0 = yi + t;
+    
+    float value = 0.0f;
+    float gradientX = 0.0f;
+    float gradientY = 0.0f;
+    
+    // The base corner, the opposite corner, and whichever of the other two
+    // shares the sample's triangle
+    addCorner(getGradient(X, Y), x0, y0, value, gradientX, gradientY);
+    addCorner(getGradient(X + 1, Y + 1), x0 - (1.0f + 2.0f * unskew), y0 - (1.0f + 2.0f * unskew),
+              value, gradientX, gradientY);
+    if (y0 > x0) {
+        addCorner(getGradient(X, Y + 1), x0 - unskew, y0 - (1.0f + unskew), value, gradientX, gradientY);
+    } else {
+        addCorner(getGradient(X + 1, Y), x0 - (1.0f + unskew), y0 - unskew, value, gradientX, gradientY);
+    }
+    
+    if (dx) {
+        *dx = gradientX;
+        *dy = gradientY;
+    }
+    return value;
+}
+
+const float* OpenSimplexNoise::getGradient(int64_t X, int64_t Y) const {
+    int index = static_cast<int>((static_cast<uint64_t>(hashLattice(X, Y)) * gradientCount) >> 32);
+    return &gradients[index * 2];
+}
+
+void OpenSimplexNoise::addCorner(const float* gradient, float cx, float cy,
+                                 float& value, float& gradientX, float& gradientY) const {
+    float a = kernelRadiusSquared - cx * cx - cy * cy;
+    if (a <= 0.0f) return;
+    
+    // d/dp of a^4 (g . p) with a = r0^2 - |p|^2 is a^4 g - 8 a^3 (g . p) p
+    float dot = gradient[0] * cx + gradient[1] * cy;
+    float a2 = a * a;
+    float a4 = a2 * a2;
+    float falloff = 8.0f * a2 * a * dot;
+    value += a4 * dot;
+    gradientX += a4 * gradient[0] - falloff * cx;
+    gradientY += a4 * gradient[1] - falloff * cy;
+}
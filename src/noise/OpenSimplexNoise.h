@@ -0,0 +1,30 @@
+#pragma once
+
+#include "NoiseSource.h"
+
+// 2D OpenSimplex2 (the fast variant): gradient noise on a triangular
+// lattice. Each sample sums three corner kernels instead of blending four
+// square-lattice corners, so there are no axis-aligned streaks, and 24
+// evenly spaced gradient directions keep the texture isotropic.
+class OpenSimplexNoise : public NoiseSource {
+public:
+    explicit OpenSimplexNoise(uint32_t seed);
+    
+    float noise(double x, double y) const override;
+    float noise(double x, double y, float& dx, float& dy) const override;
+    void noise(const double* x, const double* y, int count, float* out) const override;
+    
+    static const int gradientCount = 24;
+
+private:
+    float gradients[gradientCount * 2];
+    
+    // Value, and the gradient when dx and dy are given
+    float sample(double x, double y, float* dx, float* dy) const;
+    
+    // Gradient of the lattice corner (X, Y)
+    const float* getGradient(int64_t X, int64_t Y) const;
+    
+    // Add one corner's kernel at offset (cx, cy) from the sample
+    void addCorner(const float* gradient, float cx, float cy, float& value, float& gradientX, float& gradientY) const;
+};
@@ -1,27 +1,11 @@
 #include "PerlinNoise.h"
 #include <cmath>
-#include <cstdlib>
 #include <ctime>
-#include <algorithm>
+#include <climits>
 
-PerlinNoise::PerlinNoise() {
-    // Initialize the permutation array with values 0-255
-    for (int i = 0; i < 256; i++) {
-        p[i] = i;
-    }
-    
-    // Shuffle the permutation array
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
-    for (int i = 255; i > 0; i--) {
-        int j = rand() % (i + 1);
-        std::swap(p[i], p[j]);
-    }
-    
-    // Duplicate the permutation array
-    for (int i = 0; i < 256; i++) {
-        p[i + 256] = p[i];
-    }
-}
+PerlinNoise::PerlinNoise() : NoiseSource(static_cast<uint32_t>(std::time(nullptr))) {}
+
+PerlinNoise::PerlinNoise(uint32_t seed) : NoiseSource(seed) {}
 
 PerlinNoise::~PerlinNoise() {}
 
@@ -31,80 +15,197 @@ float PerlinNoise::fade(float t) const {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
+float PerlinNoise::fadeDerivative(float t) const {
+    // Derivative of the fade function: 30t^4 - 60t^3 + 30t^2
+    return 30 * t * t * (t * (t - 2) + 1);
+}
+
 float PerlinNoise::lerp(float t, float a, float b) const {
     // Linear interpolation
     return a + t * (b - a);
 }
 
-float PerlinNoise::grad(int hash, float x, float y, float z) const {
+float PerlinNoise::grad(uint32_t hash, float x, float y, float z) const {
     // Convert hash to 8 gradient directions
-    int h = hash & 15;
+    int h = static_cast<int>(hash & 15);
     float u = h < 8 ? x : y;
     float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
-float PerlinNoise::noise(float x, float y, float z) const {
-    // Find unit cube that contains the point
-    int X = static_cast<int>(std::floor(x)) & 255;
-    int Y = static_cast<int>(std::floor(y)) & 255;
-    int Z = static_cast<int>(std::floor(z)) & 255;
-    
-    // Find relative x, y, z of point in cube
-    x -= std::floor(x);
-    y -= std::floor(y);
-    z -= std::floor(z);
+void PerlinNoise::gradVector(uint32_t hash, float& gx, float& gy, float& gz) const {
+    // Mirrors grad(): u and v always pick two different axes
+    int h = static_cast<int>(hash & 15);
+    float su = (h & 1) == 0 ? 1.0f : -1.0f;
+    float sv = (h & 2) == 0 ? 1.0f : -1.0f;
+    gx = gy = gz = 0.0f;
+    if (h < 8) gx = su; else gy = su;
+    if (h < 4) gy = sv; else if (h == 12 || h == 14) gx = sv; else gz = sv;
+}
+
+float PerlinNoise::noise(double x, double y, double z) const {
+    // Find unit cube that contains the point, and the point's position in it
+    float fx, fy, fz;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    int64_t Z = splitCoordinate(z, fz);
     
     // Compute fade curves
-    float u = fade(x);
-    float v = fade(y);
-    float w = fade(z);
-    
-    // Hash coordinates of the 8 cube corners
-    int A = p[X] + Y;
-    int AA = p[A] + Z;
-    int AB = p[A + 1] + Z;
-    int B = p[X + 1] + Y;
-    int BA = p[B] + Z;
-    int BB = p[B + 1] + Z;
+    float u = fade(fx);
+    float v = fade(fy);
+    float w = fade(fz);
     
     // Add blended results from 8 corners of cube
-    return lerp(w, lerp(v, lerp(u, grad(p[AA], x, y, z),
-                                   grad(p[BA], x-1, y, z)),
-                           lerp(u, grad(p[AB], x, y-1, z),
-                                   grad(p[BB], x-1, y-1, z))),
-                   lerp(v, lerp(u, grad(p[AA+1], x, y, z-1),
-                                   grad(p[BA+1], x-1, y, z-1)),
-                           lerp(u, grad(p[AB+1], x, y-1, z-1),
-                                   grad(p[BB+1], x-1, y-1, z-1))));
+    return lerp(w, lerp(v, lerp(u, grad(hashLattice(X, Y, Z), fx, fy, fz),
+                                   grad(hashLattice(X + 1, Y, Z), fx-1, fy, fz)),
+                           lerp(u, grad(hashLattice(X, Y + 1, Z), fx, fy-1, fz),
+                                   grad(hashLattice(X + 1, Y + 1, Z), fx-1, fy-1, fz))),
+                   lerp(v, lerp(u, grad(hashLattice(X, Y, Z + 1), fx, fy, fz-1),
+                                   grad(hashLattice(X + 1, Y, Z + 1), fx-1, fy, fz-1)),
+                           lerp(u, grad(hashLattice(X, Y + 1, Z + 1), fx, fy-1, fz-1),
+                                   grad(hashLattice(X + 1, Y + 1, Z + 1), fx-1, fy-1, fz-1))));
 }
 
-float PerlinNoise::noise(float x, float y) const {
-    // Call the 3D noise function with z=0
-    return noise(x, y, 0.0f);
+float PerlinNoise::noise(double x, double y, double z, float& dx, float& dy, float& dz) const {
+    // Same lattice lookup as noise(x, y, z)
+    float fx, fy, fz;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    int64_t Z = splitCoordinate(z, fz);
+    
+    float u = fade(fx);
+    float v = fade(fy);
+    float w = fade(fz);
+    
+    // Corner hashes, ordered x fastest, then y, then z
+    const uint32_t hashes[8] = {
+        hashLattice(X, Y, Z), hashLattice(X + 1, Y, Z), hashLattice(X, Y + 1, Z), hashLattice(X + 1, Y + 1, Z),
+        hashLattice(X, Y, Z + 1), hashLattice(X + 1, Y, Z + 1), hashLattice(X, Y + 1, Z + 1),
+        hashLattice(X + 1, Y + 1, Z + 1)
+    };
+    
+    // Corner contributions, computed exactly as noise(x, y, z) does
+    float a = grad(hashes[0], fx, fy, fz);
+    float b = grad(hashes[1], fx - 1, fy, fz);
+    float c = grad(hashes[2], fx, fy - 1, fz);
+    float d = grad(hashes[3], fx - 1, fy - 1, fz);
+    float e = grad(hashes[4], fx, fy, fz - 1);
+    float f = grad(hashes[5], fx - 1, fy, fz - 1);
+    float g = grad(hashes[6], fx, fy - 1, fz - 1);
+    float h = grad(hashes[7], fx - 1, fy - 1, fz - 1);
+    
+    float ab = lerp(u, a, b);
+    float cd = lerp(u, c, d);
+    float ef = lerp(u, e, f);
+    float gh = lerp(u, g, h);
+    float lower = lerp(v, ab, cd);
+    float upper = lerp(v, ef, gh);
+    
+    // Each corner term is linear with the corner's gradient as its slope;
+    // blending those gives the first part of the derivative
+    float gradients[8][3];
+    for (int i = 0; i < 8; i++) {
+        gradVector(hashes[i], gradients[i][0], gradients[i][1], gradients[i][2]);
+    }
+    float blended[3];
+    for (int axis = 0; axis < 3; axis++) {
+        blended[axis] = lerp(w, lerp(v, lerp(u, gradients[0][axis], gradients[1][axis]),
+                                        lerp(u, gradients[2][axis], gradients[3][axis])),
+                                lerp(v, lerp(u, gradients[4][axis], gradients[5][axis]),
+                                        lerp(u, gradients[6][axis], gradients[7][axis])));
+    }
+    
+    // The second part comes from the fade weights moving
+    dx = blended[0] + fadeDerivative(fx) * lerp(w, lerp(v, b - a, d - c), lerp(v, f - e, h - g));
+    dy = blended[1] + fadeDerivative(fy) * lerp(w, cd - ab, gh - ef);
+    dz = blended[2] + fadeDerivative(fz) * (upper - lower);
+    
+    return lerp(w, lower, upper);
 }
 
-float PerlinNoise::fractalNoise(float x, float y, int octaves, float persistence, float lacunarity, float scale) const {
-    float total = 0.0f;
-    float frequency = 1.0f / scale;
-    float amplitude = 1.0f;
-    float maxValue = 0.0f;  // Used for normalizing the result
-    
-    // Add successive layers of noise
-    for (int i = 0; i < octaves; i++) {
-        // Add detailed features with increasing frequency and decreasing amplitude
-        total += noise(x * frequency, y * frequency) * amplitude;
+float PerlinNoise::noise(double x, double y) const {
+    // The 3D noise function with z=0
+    return noise2D(x, y);
+}
+
+void PerlinNoise::noise(const double* x, const double* y, int count, float* out) const {
+    // Neighboring samples of a row mostly share a lattice cell, so its four
+    // corners are hashed and their gradients looked up once per cell. The
+    // dot products below equal grad() exactly, so values match noise2D().
+    int64_t cellX = INT64_MIN;
+    int64_t cellY = INT64_MIN;
+    float gradients[4][3] = {};
+    
+    for (int i = 0; i < count; i++) {
+        float fx, fy;
+        int64_t X = splitCoordinate(x[i], fx);
+        int64_t Y = splitCoordinate(y[i], fy);
         
-        // Track the maximum possible amplitude sum for normalization
-        maxValue += amplitude;
+        if (X != cellX || Y != cellY) {
+            cellX = X;
+            cellY = Y;
+            gradVector(hashLattice(X, Y), gradients[0][0], gradients[0][1], gradients[0][2]);
+            gradVector(hashLattice(X + 1, Y), gradients[1][0], gradients[1][1], gradients[1][2]);
+            gradVector(hashLattice(X, Y + 1), gradients[2][0], gradients[2][1], gradients[2][2]);
+            gradVector(hashLattice(X + 1, Y + 1), gradients[3][0], gradients[3][1], gradients[3][2]);
+        }
         
-        // Increase the frequency for the next octave
-        frequency *= lacunarity;
+        float u = fade(fx);
+        float v = fade(fy);
         
-        // Decrease the amplitude for the next octave
-        amplitude *= persistence;
+        float a = gradients[0][0] * fx + gradients[0][1] * fy;
+        float b = gradients[1][0] * (fx - 1) + gradients[1][1] * fy;
+        float c = gradients[2][0] * fx + gradients[2][1] * (fy - 1);
+        float d = gradients[3][0] * (fx - 1) + gradients[3][1] * (fy - 1);
+        out[i] = lerp(v, lerp(u, a, b), lerp(u, c, d));
+    }
+}
+
+float PerlinNoise::noise2D(double x, double y) const {
+    // At z = 0 the fade weight w is 0, so noise(x, y, 0) is exactly the
+    // blend of the near face; the far face never needs hashing
+    float fx, fy;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    
+    float u = fade(fx);
+    float v = fade(fy);
+    
+    return lerp(v, lerp(u, grad(hashLattice(X, Y), fx, fy, 0.0f), grad(hashLattice(X + 1, Y), fx - 1, fy, 0.0f)),
+                   lerp(u, grad(hashLattice(X, Y + 1), fx, fy - 1, 0.0f),
+                           grad(hashLattice(X + 1, Y + 1), fx - 1, fy - 1, 0.0f)));
+}
+
+float PerlinNoise::noise(double x, double y, float& dx, float& dy) const {
+    // noise(x, y, z) at z = 0: the fade weight w is 0, so only the four
+    // corners of the near face count and the value is their blend exactly
+    float fx, fy;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    
+    float u = fade(fx);
+    float v = fade(fy);
+    
+    const uint32_t hashes[4] = { hashLattice(X, Y), hashLattice(X + 1, Y), hashLattice(X, Y + 1),
+                                 hashLattice(X + 1, Y + 1) };
+    
+    float a = grad(hashes[0], fx, fy, 0.0f);
+    float b = grad(hashes[1], fx - 1, fy, 0.0f);
+    float c = grad(hashes[2], fx, fy - 1, 0.0f);
+    float d = grad(hashes[3], fx - 1, fy - 1, 0.0f);
+    
+    float ab = lerp(u, a, b);
+    float cd = lerp(u, c, d);
+    
+    float gradients[4][3];
+    for (int i = 0; i < 4; i++) {
+        gradVector(hashes[i], gradients[i][0], gradients[i][1], gradients[i][2]);
     }
     
-    // Normalize the result to a range of -1 to 1
-    return total / maxValue;
+    dx = lerp(v, lerp(u, gradients[0][0], gradients[1][0]), lerp(u, gradients[2][0], gradients[3][0])) +
+         fadeDerivative(fx) * lerp(v, b - a, d - c);
+    dy = lerp(v, lerp(u, gradients[0][1], gradients[1][1]), lerp(u, gradients[2][1], gradients[3][1])) +
+         fadeDerivative(fy) * (cd - ab);
+    
+    return lerp(v, ab, cd);
 }
\ No newline at end of file
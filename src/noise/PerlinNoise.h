@@ -1,19 +1,32 @@
 #pragma once
 
-class PerlinNoise {
+#include "NoiseSource.h"
+
+class PerlinNoise : public NoiseSource {
 public:
     PerlinNoise();
+    explicit PerlinNoise(uint32_t seed);
     ~PerlinNoise();
     
-    float noise(float x, float y) const;
-    float noise(float x, float y, float z) const;
+    float noise(double x, double y) const override;
+    float noise(double x, double y, double z) const;
+    
+    // Same values, plus the analytic partial derivatives from the same corner
+    // hashes: one evaluation instead of three for normals or slopes
+    float noise(double x, double y, float& dx, float& dy) const override;
+    float noise(double x, double y, double z, float& dx, float& dy, float& dz) const;
     
-    float fractalNoise(float x, float y, int octaves, float persistence, float lacunarity, float scale) const;
+    void noise(const double* x, const double* y, int count, float* out) const override;
     
 private:
-    int p[512];
+    // noise(x, y, 0) from the four corners of the z = 0 face
+    float noise2D(double x, double y) const;
     
     float fade(float t) const;
+    float fadeDerivative(float t) const;
     float lerp(float t, float a, float b) const;
-    float grad(int hash, float x, float y, float z) const;
+    float grad(uint32_t hash, float x, float y, float z) const;
+    
+    // The gradient vector grad() takes the dot product with
+    void gradVector(uint32_t hash, float& gx, float& gy, float& gz) const;
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "ValueNoise.h"
+#include <climits>
+
+ValueNoise::ValueNoise(uint32_t seed) : NoiseSource(seed) {}
+
+float ValueNoise::noise(double x, double y) const {
+    return sample(x, y, nullptr, nullptr);
+}
+
+float ValueNoise::noise(double x, double y, float& dx, float& dy) const {
+    return sample(x, y, &dx, &dy);
+}
+
+void ValueNoise::noise(const double* x, const double* y, int count, float* out) const {
+    // Corner values are hashed once per lattice cell; the blend is the
+    // same arithmetic as sample()
+    int64_t cellX = INT64_MIN;
+    int64_t cellY = INT64_MIN;
+    float a = 0.0f, b = 0.0f, c = 0.0f, d = 0.0f;
+    
+    for (int i = 0; i < count; ++i) {
+        float fx, fy;
+        int64_t X = splitCoordinate(x[i], fx);
+        int64_t Y = splitCoordinate(y[i], fy);
+        
+        if (X != cellX || Y != cellY) {
+            cellX = X;
+            cellY = Y;
+            a = latticeValue(X, Y);
+            b = latticeValue(X + 1, Y);
+            c = latticeValue(X, Y + 1);
+            d = latticeValue(X + 1, Y + 1);
+        }
+        
+        float u = fx * fx * fx * (fx * (fx * 6 - 15) + 10);
+        float v = fy * fy * fy * (fy * (fy * 6 - 15) + 10);
+        float ab = a + u * (b - a);
+        float cd = c + u * (d - c);
+        out[i] = ab + v * (cd - ab);
+    }
+}
+
+float ValueNoise::sample(double x, double y, float* dx, float* dy) const {
+    float fx, fy;
+    int64_t X = splitCoordinate(x, fx);
+    int64_t Y = splitCoordinate(y, fy);
+    
+    // Quintic fade, 6t^5 - 15t^4 + 10t^3
+    float u = fx * fx * fx * (fx * (fx * 6 - 15) + 10);
+    float v = fy * fy * fy * (fy * (fy * 6 - 15) + 10);
+    
+    float a = latticeValue(X, Y);
+    float b = latticeValue(X + 1, Y);
+    float c = latticeValue(X, Y + 1);
+    float d = latticeValue(X + 1, Y + 1);
+    
+    float ab = a + u * (b - a);
+    float cd = c + u * (d - c);
+    
+    // Only the fade weights move with x and y
+    if (dx) {
+        float du = 30 * fx * fx * (fx * (fx - 2) + 1);
+        float dv = 30 * fy * fy * (fy * (fy - 2) + 1);
+        *dx = du * ((b - a) + v * ((d - c) - (b - a)));
+        *dy = dv * (cd - ab);
+    }
+    return ab + v * (cd - ab);
+}
+
+float ValueNoise::latticeValue(int64_t X, int64_t Y) const {
+    // The top 24 bits of the hash, spread evenly over [-1, 1]
+    return static_cast<float>(hashLattice(X, Y) >> 8) * (2.0f / 16777215.0f) - 1.0f;
+}
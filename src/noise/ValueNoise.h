@@ -0,0 +1,22 @@
+#pragma once
+
+#include "NoiseSource.h"
+
+// Value noise: a random height at every lattice point, blended with the
+// same quintic fade as Perlin noise. The cheapest backend, but its features
+// sit on the lattice and look blocky alone; it works best as a detail layer.
+class ValueNoise : public NoiseSource {
+public:
+    explicit ValueNoise(uint32_t seed);
+    
+    float noise(double x, double y) const override;
+    float noise(double x, double y, float& dx, float& dy) const override;
+    void noise(const double* x, const double* y, int count, float* out) const override;
+
+private:
+    // Value, and the gradient when dx and dy are given
+    float sample(double x, double y, float* dx, float* dy) const;
+    
+    // Height in [-1, 1] of the lattice point (X, Y)
+    float latticeValue(int64_t X, int64_t Y) const;
+};
@@ -0,0 +1,247 @@
+#include "AdaptiveMesher.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // One triangle of a tile's hierarchy, in tile-local sample coordinates:
+    // the hypotenuse ends, its midpoint and the midpoints of the children
+    struct TileTriangle {
+        short ax, ay, bx, by;
+        short mx, my;
+        short leftX, leftY;
+        short rightX, rightY;
+    };
+    
+    // Every triangle of the tile hierarchy, indexed by implicit id - 2, so
+    // coarser levels come first. All tiles share the same layout.
+    const std::vector<TileTriangle>& getTileTriangles() {
+        static const std::vector<TileTriangle> triangles = [] {
+            const int tileSize = AdaptiveMesher::tileCells;
+            std::vector<TileTriangle> result(tileSize * tileSize * 2 - 2);
+            
+            for (int i = 0; i < static_cast<int>(result.size()); ++i) {
+                // Decode the triangle's hypotenuse endpoints from its implicit id
+                int id = i + 2;
+                int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+                if (id & 1) {
+                    bx = by = cx = tileSize;    // Bottom-left root triangle
+                } else {
+                    ax = ay = cy = tileSize;    // Top-right root triangle
+                }
+                while ((id >>= 1) > 1) {
+                    int mx = (ax + bx) >> 1;
+                    int my = (ay + by) >> 1;
+                    if (id & 1) {               // Left child
+                        bx = ax; by = ay;
+                        ax = cx; ay = cy;
+                    } else {                    // Right child
+                        ax = bx; ay = by;
+                        bx = cx; by = cy;
+                    }
+                    cx = mx;
+                    cy = my;
+                }
+                
+                int mx = (ax + bx) >> 1;
+                int my = (ay + by) >> 1;
+                cx = mx + my - ay;
+                cy = my + ax - mx;
+                
+                TileTriangle& triangle = result[i];
+                triangle.ax = static_cast<short>(ax);
+                triangle.ay = static_cast<short>(ay);
+                triangle.bx = static_cast<short>(bx);
+                triangle.by = static_cast<short>(by);
+                triangle.mx = static_cast<short>(mx);
+                triangle.my = static_cast<short>(my);
+                triangle.leftX = static_cast<short>((ax + cx) >> 1);
+                triangle.leftY = static_cast<short>((ay + cy) >> 1);
+                triangle.rightX = static_cast<short>((bx + cx) >> 1);
+                triangle.rightY = static_cast<short>((by + cy) >> 1);
+            }
+            return result;
+        }();
+        return triangles;
+    }
+}
+
+AdaptiveMesher::AdaptiveMesher(int mapWidth, int mapHeight, const std::vector<float>& heights)
+    : mapWidth(mapWidth), mapHeight(mapHeight), tileX0(0), tileY0(0),
+      tilesX(getTileCount(mapWidth)), tilesY(getTileCount(mapHeight)) {
+    computeErrors([&](int y, int x0, int x1, float* row) {
+        std::copy(heights.begin() + static_cast<size_t>(y) * mapWidth + x0,
+                  heights.begin() + static_cast<size_t>(y) * mapWidth + x1, row);
+    });
+}
+
+AdaptiveMesher::AdaptiveMesher(int mapWidth, int mapHeight, int tileX0, int tileY0, int tileX1, int tileY1,
+                               const RowReader& readRow)
+    : mapWidth(mapWidth), mapHeight(mapHeight), tileX0(tileX0), tileY0(tileY0),
+      tilesX(tileX1 - tileX0), tilesY(tileY1 - tileY0) {
+    computeErrors(readRow);
+}
+
+void AdaptiveMesher::computeErrors(const RowReader& readRow) {
+    // Tiles past the map's last row / column are padded by clamping onto it;
+    // the padding is perfectly flat, so it never forces extra splits.
+    gridWidth = tilesX * tileCells + 1;
+    gridHeight = tilesY * tileCells + 1;
+    int firstX = tileX0 * tileCells;
+    int firstY = tileY0 * tileCells;
+    int mapColumns = std::min(gridWidth, mapWidth - firstX);
+    
+    std::vector<float> terrain(static_cast<size_t>(gridWidth) * gridHeight);
+    for (int y = 0; y < gridHeight; ++y) {
+        float* row = terrain.data() + static_cast<size_t>(y) * gridWidth;
+        readRow(std::min(firstY + y, mapHeight - 1), firstX, firstX + mapColumns, row);
+        std::fill(row + mapColumns, row + gridWidth, row[mapColumns - 1]);
+    }
+    
+    errors.assign(terrain.size(), 0.0f);
+    
+    // Walk the hierarchy a level at a time, finest first, across all tiles:
+    // each midpoint error then already includes the errors of its children,
+    // both tiles beside an edge included.
+    const std::vector<TileTriangle>& triangles = getTileTriangles();
+    int numParentTriangles = tileCells * tileCells - 2;
+    
+    for (int end = static_cast<int>(triangles.size()), begin = numParentTriangles; end > 0;
+         end = begin, begin = (begin + 2) / 2 - 2) {
+        for (int tileY = 0; tileY < tilesY; ++tileY) {
+            for (int tileX = 0; tileX < tilesX; ++tileX) {
+                const float* tile = terrain.data() + static_cast<size_t>(tileY) * tileCells * gridWidth + tileX * tileCells;
+                float* tileErrors = errors.data() + static_cast<size_t>(tileY) * tileCells * gridWidth + tileX * tileCells;
+                
+                for (int i = begin; i < end; ++i) {
+                    const TileTriangle& triangle = triangles[i];
+                    
+                    // The triangle's plane and a child's plane agree at the two vertices
+                    // they share and differ by the midpoint error at the third, so the
+                    // midpoint error plus the worse child's bound covers every texel.
+                    // Leaf children (unit legs) hold only their corner texels and are exact.
+                    float interpolated = (tile[triangle.ay * gridWidth + triangle.ax] +
+                                          tile[triangle.by * gridWidth + triangle.bx]) * 0.5f;
+                    int middle = triangle.my * gridWidth + triangle.mx;
+                    float triangleError = std::fabs(interpolated - tile[middle]);
+                    
+                    if (i < numParentTriangles) {
+                        triangleError += std::max(tileErrors[triangle.leftY * gridWidth + triangle.leftX],
+                                                  tileErrors[triangle.rightY * gridWidth + triangle.rightX]);
+                    }
+                    
+                    // Both triangles on this hypotenuse split together, so the midpoint
+                    // keeps the worse of the two, even across a tile edge
+                    tileErrors[middle] = std::max(tileErrors[middle], triangleError);
+                }
+            }
+        }
+    }
+}
+
+template <typename Emit>
+void AdaptiveMesher::processTriangle(int ax, int ay, int bx, int by, int cx, int cy,
+                                     float maxError, Emit& emit) const {
+    int mx = (ax + bx) >> 1;
+    int my = (ay + by) >> 1;
+    
+    if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[my * gridWidth + mx] > maxError) {
+        // Too much error: split along the hypotenuse midpoint
+        processTriangle(cx, cy, ax, ay, mx, my, maxError, emit);
+        processTriangle(bx, by, cx, cy, mx, my, maxError, emit);
+        return;
+    }
+    
+    // Map texels of the corners; drop triangles that collapse once the
+    // padding is clamped onto the map
+    int firstX = tileX0 * tileCells;
+    int firstY = tileY0 * tileCells;
+    ax = std::min(firstX + ax, mapWidth - 1);
+    ay = std::min(firstY + ay, mapHeight - 1);
+    bx = std::min(firstX + bx, mapWidth - 1);
+    by = std::min(firstY + by, mapHeight - 1);
+    cx = std::min(firstX + cx, mapWidth - 1);
+    cy = std::min(firstY + cy, mapHeight - 1);
+    if ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax) == 0) {
+        return;
+    }
+    
+    emit(ax, ay, bx, by, cx, cy);
+}
+
+template <typename Emit>
+void AdaptiveMesher::processTile(int tileX, int tileY, float maxError, Emit& emit) const {
+    // Tiles are always split apart; each starts from its two root triangles
+    int x0 = (tileX - tileX0) * tileCells;
+    int y0 = (tileY - tileY0) * tileCells;
+    int x1 = x0 + tileCells;
+    int y1 = y0 + tileCells;
+    processTriangle(x0, y0, x1, y1, x1, y0, maxError, emit);
+    processTriangle(x1, y1, x0, y0, x0, y1, maxError, emit);
+}
+
+void AdaptiveMesher::build(float maxError, std::vector<int>& vertexTexels, std::vector<unsigned int>& indices) const {
+    vertexTexels.clear();
+    indices.clear();
+    
+    // Texels are shared between neighbouring triangles; number each one once
+    std::vector<int> vertexIds(static_cast<size_t>(mapWidth) * mapHeight, -1);
+    auto vertexFor = [&](int x, int y) {
+        int texel = y * mapWidth + x;
+        if (vertexIds[texel] < 0) {
+            vertexIds[texel] = static_cast<int>(vertexTexels.size());
+            vertexTexels.push_back(texel);
+        }
+        return static_cast<unsigned int>(vertexIds[texel]);
+    };
+    
+    auto emit = [&](int ax, int ay, int bx, int by, int cx, int cy) {
+        indices.push_back(vertexFor(ax, ay));
+        indices.push_back(vertexFor(bx, by));
+        indices.push_back(vertexFor(cx, cy));
+    };
+    
+    for (int tileY = tileY0; tileY < tileY0 + tilesY; ++tileY) {
+        for (int tileX = tileX0; tileX < tileX0 + tilesX; ++tileX) {
+            processTile(tileX, tileY, maxError, emit);
+        }
+    }
+}
+
+void AdaptiveMesher::buildTile(int tileX, int tileY, float maxError,
+                               std::vector<int>& vertexTexels, std::vector<unsigned int>& indices) const {
+    vertexTexels.clear();
+    indices.clear();
+    
+    // A tile's vertices lie on its own (tileCells + 1)^2 samples
+    const int tileSamples = tileCells + 1;
+    int vertexIds[tileSamples * tileSamples];
+    std::fill(vertexIds, vertexIds + tileSamples * tileSamples, -1);
+    auto vertexFor = [&](int x, int y) {
+        int sample = (y - tileY * tileCells) * tileSamples + x - tileX * tileCells;
+        if (vertexIds[sample] < 0) {
+            vertexIds[sample] = static_cast<int>(vertexTexels.size());
+            vertexTexels.push_back(y * mapWidth + x);
+        }
+        return static_cast<unsigned int>(vertexIds[sample]);
+    };
+    
+    auto emit = [&](int ax, int ay, int bx, int by, int cx, int cy) {
+        indices.push_back(vertexFor(ax, ay));
+        indices.push_back(vertexFor(bx, by));
+        indices.push_back(vertexFor(cx, cy));
+    };
+    
+    processTile(tileX, tileY, maxError, emit);
+}
+
+int AdaptiveMesher::countTriangles(float maxError) const {
+    int count = 0;
+    auto emit = [&](int, int, int, int, int, int) { ++count; };
+    
+    for (int tileY = tileY0; tileY < tileY0 + tilesY; ++tileY) {
+        for (int tileX = tileX0; tileX < tileX0 + tilesX; ++tileX) {
+            processTile(tileX, tileY, maxError, emit);
+        }
+    }
+    return count;
+}
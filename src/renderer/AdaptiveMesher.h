@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Right-triangulated irregular network (RTIN) mesher.
+// The heightmap is covered by a binary hierarchy of right triangles; a
+// triangle is only split when a conservative bound on its vertical error
+// over every texel it covers exceeds the allowed error, so the mesh never
+// strays further than that from the heights. Flat areas such as flattened
+// water collapse into a handful of large triangles.
+//
+// The map is cut into square tiles of tileCells cells, each with its own
+// hierarchy. A split on a tile edge is decided by the worse of the two tiles
+// beside it, so neighbouring tiles meet without cracks, and a tile's
+// triangles only depend on its own heights and those of the four tiles
+// around it. An edit therefore reshapes a bounded set of tiles, which a
+// mesher over a window of tiles can triangulate again.
+class AdaptiveMesher {
+public:
+    // Fills row[0 .. x1 - x0) with the displayed heights of texels x0 .. x1 - 1
+    // of map row y, in the same units the error is measured in
+    using RowReader = std::function<void(int y, int x0, int x1, float* row)>;
+    
+    // heights holds mapWidth * mapHeight samples of the surface that will be
+    // displayed (row-major)
+    AdaptiveMesher(int mapWidth, int mapHeight, const std::vector<float>& heights);
+    
+    // Only the tiles [tileX0, tileX1) x [tileY0, tileY1). Errors on the outer
+    // edges of the window miss the tiles beyond it, so only tiles at least one
+    // tile inside the window (or on the map border) triangulate as in a mesher
+    // over the whole map.
+    AdaptiveMesher(int mapWidth, int mapHeight, int tileX0, int tileY0, int tileX1, int tileY1,
+                   const RowReader& readRow);
+    
+    // Triangulate within maxError. Each output vertex is a heightmap texel
+    // index (z * mapWidth + x); indices reference entries of vertexTexels.
+    void build(float maxError, std::vector<int>& vertexTexels, std::vector<unsigned int>& indices) const;
+    
+    // The same for a single tile of the window (map tile coordinates)
+    void buildTile(int tileX, int tileY, float maxError,
+                   std::vector<int>& vertexTexels, std::vector<unsigned int>& indices) const;
+    
+    // Number of triangles build() would emit, without producing the mesh
+    int countTriangles(float maxError) const;
+    
+    // Triangles in the regular two-per-cell grid, for comparison
+    int getFullGridTriangleCount() const { return (mapWidth - 1) * (mapHeight - 1) * 2; }
+    
+    // Tiles covering mapSize texels along one axis
+    static int getTileCount(int mapSize) { return std::max(1, (mapSize - 1 + tileCells - 1) / tileCells); }
+    
+    static constexpr int tileCells = 32;
+    
+private:
+    int mapWidth;
+    int mapHeight;
+    int tileX0, tileY0;     // Window, in map tiles
+    int tilesX, tilesY;
+    int gridWidth;          // tilesX * tileCells + 1 samples
+    int gridHeight;
+    std::vector<float> errors;
+    
+    void computeErrors(const RowReader& readRow);
+    
+    template <typename Emit>
+    void processTriangle(int ax, int ay, int bx, int by, int cx, int cy, float maxError, Emit& emit) const;
+    template <typename Emit>
+    void processTile(int tileX, int tileY, float maxError, Emit& emit) const;
+};
@@ -0,0 +1,274 @@
+#include "ChunkBatch.h"
+#include <algorithm>
+
+// Include GLFW and OpenGL headers
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+ChunkBatch::ChunkBatch(int stride, const std::vector<Attribute>& attributes)
+    : stride(stride), attributes(attributes),
+      vao(0), vbo(0), ibo(0), indirectBuffer(0),
+      useIndirect(false), visibleChunkCount(0),
+      usedVertices(0), usedIndices(0), vertexBufferCapacity(0), indexBufferCapacity(0) {}
+
+ChunkBatch::~ChunkBatch() {
+    release();
+}
+
+int ChunkBatch::addChunk(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                         const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    int chunk = reserveChunk(vertices.size(), indices.size(), boundsMin, boundsMax);
+    chunks[chunk].ready = true;
+    
+    stagingVertices.insert(stagingVertices.end(), vertices.begin(), vertices.end());
+    stagingIndices.insert(stagingIndices.end(), indices.begin(), indices.end());
+    return chunk;
+}
+
+int ChunkBatch::reserveChunk(size_t vertexFloats, size_t indexCount,
+                             const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    Chunk chunk;
+    chunk.firstIndex = static_cast<unsigned int>(usedIndices);
+    chunk.indexCount = static_cast<unsigned int>(indexCount);
+    chunk.baseVertex = static_cast<int>(usedVertices);
+    chunk.vertexCapacity = vertexFloats / stride;
+    chunk.indexCapacity = indexCount;
+    chunk.boundsMin = boundsMin;
+    chunk.boundsMax = boundsMax;
+    chunk.ready = false;
+    
+    usedVertices += vertexFloats / stride;
+    usedIndices += indexCount;
+    
+    chunks.push_back(chunk);
+    return static_cast<int>(chunks.size()) - 1;
+}
+
+void ChunkBatch::upload() {
+    if (chunks.empty()) return;
+    
+    createBuffers(stagingVertices.data(), stagingVertices.size() * sizeof(float),
+                  stagingIndices.data(), stagingIndices.size() * sizeof(unsigned int));
+    
+    // Geometry now lives on the GPU; drop the CPU copies
+    std::vector<float>().swap(stagingVertices);
+    std::vector<unsigned int>().swap(stagingIndices);
+}
+
+void ChunkBatch::allocate(size_t vertexFloatCapacity, size_t indexCapacity) {
+    // Buffers are created empty and filled chunk by chunk
+    createBuffers(nullptr, vertexFloatCapacity * sizeof(float), nullptr, indexCapacity * sizeof(unsigned int));
+}
+
+bool ChunkBatch::updateChunk(int chunk, const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                             const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    Chunk& target = chunks[chunk];
+    if (vao == 0) return false;
+    
+    size_t vertexCount = vertices.size() / stride;
+    if (vertexCount > target.vertexCapacity || indices.size() > target.indexCapacity) {
+        // Outgrown: move to a fresh range at the end with a quarter to spare,
+        // so a chunk edited again and again settles; the old range stays unused
+        size_t vertexCapacity = vertexCount + vertexCount / 4;
+        size_t indexCapacity = indices.size() + indices.size() / 4;
+        if (usedVertices + vertexCapacity > vertexBufferCapacity || usedIndices + indexCapacity > indexBufferCapacity) {
+            growBuffers(std::max(vertexBufferCapacity * 3 / 2, usedVertices + vertexCapacity),
+                        std::max(indexBufferCapacity * 3 / 2, usedIndices + indexCapacity));
+        }
+        
+        target.firstIndex = static_cast<unsigned int>(usedIndices);
+        target.baseVertex = static_cast<int>(usedVertices);
+        target.vertexCapacity = vertexCapacity;
+        target.indexCapacity = indexCapacity;
+        usedVertices += vertexCapacity;
+        usedIndices += indexCapacity;
+    }
+    
+    // Copy-write binding leaves the VAO's element buffer binding alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, getVertexOffsetBytes(chunk), vertices.size() * sizeof(float), vertices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, getIndexOffsetBytes(chunk), indices.size() * sizeof(unsigned int), indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    target.indexCount = static_cast<unsigned int>(indices.size());
+    target.boundsMin = boundsMin;
+    target.boundsMax = boundsMax;
+    target.ready = true;
+    return true;
+}
+
+void ChunkBatch::createBuffers(const void* vertexData, size_t vertexBytes, const void* indexData, size_t indexBytes) {
+    // One draw call per frame through glMultiDrawElementsIndirect when the
+    // driver has it (GL 4.3), otherwise glMultiDrawElementsBaseVertex (GL 3.2)
+#ifdef __APPLE__
+    useIndirect = false;
+#else
+    useIndirect = GLEW_ARB_multi_draw_indirect;
+#endif
+    
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    
+    glBindVertexArray(vao);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+    
+    setVertexLayout();
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    
+    vertexBufferCapacity = vertexBytes / (stride * sizeof(float));
+    indexBufferCapacity = indexBytes / sizeof(unsigned int);
+    
+    if (useIndirect) {
+        glGenBuffers(1, &indirectBuffer);
+    }
+}
+
+void ChunkBatch::setVertexLayout() {
+    // Attribute pointers capture the bound array buffer
+    for (const Attribute& attribute : attributes) {
+        glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+                              stride * sizeof(float), (void*)(attribute.offset * sizeof(float)));
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+void ChunkBatch::growBuffers(size_t vertexCapacity, size_t indexCapacity) {
+    // Copy the used ranges into larger buffers on the GPU, then point the
+    // VAO at those
+    unsigned int newBuffers[2];
+    glGenBuffers(2, newBuffers);
+    
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[0]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * stride * sizeof(float), nullptr, GL_STATIC_DRAW);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedVertices * stride * sizeof(float));
+    
+    glBindBuffer(GL_COPY_READ_BUFFER, ibo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedIndices * sizeof(unsigned int));
+    
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ibo);
+    vbo = newBuffers[0];
+    ibo = newBuffers[1];
+    
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    setVertexLayout();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    
+    vertexBufferCapacity = vertexCapacity;
+    indexBufferCapacity = indexCapacity;
+}
+
+void ChunkBatch::draw(const glm::mat4& viewProjection) {
+    visibleChunkCount = 0;
+    if (vao == 0) return;
+    
+    // Frustum planes from the combined matrix (Gribb/Hartmann)
+    glm::vec4 planes[6];
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            planes[i * 2][j] = viewProjection[j][3] + viewProjection[j][i];
+            planes[i * 2 + 1][j] = viewProjection[j][3] - viewProjection[j][i];
+        }
+    }
+    
+    commands.clear();
+    counts.clear();
+    offsets.clear();
+    baseVertices.clear();
+    
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.ready || chunk.indexCount == 0 || !isVisible(planes, chunk.boundsMin, chunk.boundsMax)) {
+            continue;
+        }
+        
+        if (useIndirect) {
+            commands.push_back({ chunk.indexCount, 1, chunk.firstIndex, chunk.baseVertex, 0 });
+        } else {
+            counts.push_back(static_cast<int>(chunk.indexCount));
+            offsets.push_back((const void*)(chunk.firstIndex * sizeof(unsigned int)));
+            baseVertices.push_back(chunk.baseVertex);
+        }
+        visibleChunkCount++;
+    }
+    
+    if (visibleChunkCount == 0) return;
+    
+    glBindVertexArray(vao);
+    
+    if (useIndirect) {
+        // Orphan and refill the command buffer each frame
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STREAM_DRAW);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, visibleChunkCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+                                      offsets.data(), visibleChunkCount, baseVertices.data());
+    }
+    
+    glBindVertexArray(0);
+}
+
+void ChunkBatch::release() {
+    if (vao != 0) {
+        glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+    
+    if (vbo != 0) {
+        glDeleteBuffers(1, &vbo);
+        vbo = 0;
+    }
+    
+    if (ibo != 0) {
+        glDeleteBuffers(1, &ibo);
+        ibo = 0;
+    }
+    
+    if (indirectBuffer != 0) {
+        glDeleteBuffers(1, &indirectBuffer);
+        indirectBuffer = 0;
+    }
+    
+    chunks.clear();
+    stagingVertices.clear();
+    stagingIndices.clear();
+    usedVertices = 0;
+    usedIndices = 0;
+    vertexBufferCapacity = 0;
+    indexBufferCapacity = 0;
+    visibleChunkCount = 0;
+}
+
+bool ChunkBatch::isVisible(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    for (int i = 0; i < 6; ++i) {
+        // Test the box corner furthest along the plane normal
+        glm::vec3 corner(planes[i].x >= 0.0f ? boundsMax.x : boundsMin.x,
+                         planes[i].y >= 0.0f ? boundsMax.y : boundsMin.y,
+                         planes[i].z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (planes[i].x * corner.x + planes[i].y * corner.y + planes[i].z * corner.z + planes[i].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
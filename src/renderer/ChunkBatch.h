@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// A set of mesh chunks sharing one vertex layout, suballocated from a single
+// vertex buffer and a single index buffer. Each frame the chunks inside the
+// view frustum are gathered into an indirect command buffer and submitted
+// with one multi-draw call, so draw cost does not grow with chunk count.
+class ChunkBatch {
+public:
+    struct Attribute {
+        unsigned int location;
+        int components;     // Floats in this attribute
+        int offset;         // Offset into the vertex, in floats
+    };
+    
+    // stride is the vertex size in floats
+    ChunkBatch(int stride, const std::vector<Attribute>& attributes);
+    ~ChunkBatch();
+    
+    ChunkBatch(const ChunkBatch&) = delete;
+    ChunkBatch& operator=(const ChunkBatch&) = delete;
+    
+    // Queue a chunk for the next upload. Indices are local to the chunk's
+    // vertices; bounds are the chunk's world-space AABB. Returns the chunk id.
+    int addChunk(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                 const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    
+    // Copy all queued chunks into the shared GPU buffers
+    void upload();
+    
+    // Streaming path: create empty shared buffers up front, reserve a range
+    // per chunk, fill the ranges (e.g. through an UploadRing) and mark each
+    // chunk ready. Only ready chunks are drawn.
+    void allocate(size_t vertexFloatCapacity, size_t indexCapacity);
+    int reserveChunk(size_t vertexFloats, size_t indexCount,
+                     const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    void markChunkReady(int chunk) { chunks[chunk].ready = true; }
+    
+    unsigned int getVertexBuffer() const { return vbo; }
+    unsigned int getIndexBuffer() const { return ibo; }
+    size_t getVertexOffsetBytes(int chunk) const { return chunks[chunk].baseVertex * stride * sizeof(float); }
+    size_t getIndexOffsetBytes(int chunk) const { return chunks[chunk].firstIndex * sizeof(unsigned int); }
+    
+    // Overwrite an uploaded chunk with glBufferSubData: in place while the new
+    // geometry fits the chunk's range, otherwise in a new range at the end of
+    // the buffers, which grow when full. Returns false if nothing is uploaded.
+    bool updateChunk(int chunk, const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                     const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    
+    // Cull against the view-projection frustum and draw the visible chunks
+    void draw(const glm::mat4& viewProjection);
+    
+    // Drop all chunks and GPU buffers
+    void release();
+    
+    bool isUploaded() const { return vao != 0; }
+    int getChunkCount() const { return static_cast<int>(chunks.size()); }
+    int getVisibleChunkCount() const { return visibleChunkCount; }
+    size_t getIndexCount() const { return usedIndices; }
+    
+private:
+    struct Chunk {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        int baseVertex;
+        size_t vertexCapacity;      // Reserved range, in vertices
+        size_t indexCapacity;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        bool ready;
+    };
+    
+    // Matches the GL DrawElementsIndirectCommand layout
+    struct DrawCommand {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+    
+    int stride;
+    std::vector<Attribute> attributes;
+    std::vector<Chunk> chunks;
+    
+    // CPU copies kept until upload
+    std::vector<float> stagingVertices;
+    std::vector<unsigned int> stagingIndices;
+    
+    unsigned int vao;
+    unsigned int vbo;
+    unsigned int ibo;
+    unsigned int indirectBuffer;
+    bool useIndirect;
+    int visibleChunkCount;
+    
+    // Space handed out so far and buffer sizes, in vertices and indices
+    size_t usedVertices;
+    size_t usedIndices;
+    size_t vertexBufferCapacity;
+    size_t indexBufferCapacity;
+    
+    // Per-frame submission lists, reused to avoid reallocation
+    std::vector<DrawCommand> commands;
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    std::vector<int> baseVertices;
+    
+    void createBuffers(const void* vertexData, size_t vertexBytes, const void* indexData, size_t indexBytes);
+    void setVertexLayout();
+    void growBuffers(size_t vertexCapacity, size_t indexCapacity);
+    
+    static bool isVisible(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
@@ -0,0 +1,108 @@
+#include "FrameGovernor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Full detail first. Mesh resolution goes before the far plane, which
+    // pops the most; trees thin out all the way down.
+    const DetailLevel detailLevels[] = {
+        { 1, 1.0f, 1.0f, 100.0f },
+        { 1, 2.0f, 0.75f, 100.0f },
+        { 2, 3.0f, 0.5f, 100.0f },
+        { 2, 4.0f, 0.35f, 16.0f },
+        { 4, 6.0f, 0.2f, 14.0f },
+        { 8, 8.0f, 0.0f, 12.0f },
+    };
+    const int detailLevelCount = sizeof(detailLevels) / sizeof(detailLevels[0]);
+    
+    // A step up undone within this many sustain periods counts as reverted
+    const float revertWindow = 2.0f;
+    // The step-up delay never grows past this many times its base
+    const float maxStepUpBackoff = 16.0f;
+}
+
+FrameBudgetSettings::FrameBudgetSettings()
+    : targetFrameMs(0.0f), overBudgetRatio(1.15f), overBudgetSeconds(0.5f),
+      underBudgetRatio(0.7f), underBudgetSeconds(3.0f), settleSeconds(1.0f),
+      smoothingSeconds(0.25f) {}
+
+FrameGovernor::FrameGovernor() {
+    reset();
+}
+
+void FrameGovernor::setSettings(const FrameBudgetSettings& newSettings) {
+    settings = newSettings;
+    reset();
+}
+
+void FrameGovernor::reset() {
+    level = 0;
+    averageFrameMs = 0.0f;
+    overBudgetTime = 0.0f;
+    underBudgetTime = 0.0f;
+    settleTime = 0.0f;
+    stepUpDelay = settings.underBudgetSeconds;
+    sinceStepUp = 1e30f;
+}
+
+int FrameGovernor::getLevelCount() {
+    return detailLevelCount;
+}
+
+const DetailLevel& FrameGovernor::getDetail(int level) {
+    return detailLevels[std::min(std::max(level, 0), detailLevelCount - 1)];
+}
+
+bool FrameGovernor::update(float frameSeconds, float workMs) {
+    if (!isEnabled() || !(frameSeconds > 0.0f) || !(workMs >= 0.0f)) return false;
+    
+    // Hitches (loading, a window drag) would swamp the average
+    float frameMs = std::min(workMs, 4.0f * settings.targetFrameMs);
+    sinceStepUp += frameSeconds;
+    
+    // Frame-rate independent smoothing: the weight follows the frame's length
+    float weight = 1.0f - std::exp(-frameSeconds / std::max(settings.smoothingSeconds, 1e-3f));
+    averageFrameMs = averageFrameMs > 0.0f ? averageFrameMs + (frameMs - averageFrameMs) * weight : frameMs;
+    
+    if (settleTime > 0.0f) {
+        settleTime -= frameSeconds;
+        return false;
+    }
+    
+    if (averageFrameMs > settings.targetFrameMs * settings.overBudgetRatio) {
+        overBudgetTime += frameSeconds;
+        underBudgetTime = 0.0f;
+    } else if (averageFrameMs < settings.targetFrameMs * settings.underBudgetRatio) {
+        underBudgetTime += frameSeconds;
+        overBudgetTime = 0.0f;
+    } else {
+        // In the dead band: hold
+        overBudgetTime = 0.0f;
+        underBudgetTime = 0.0f;
+    }
+    
+    int newLevel = level;
+    if (overBudgetTime >= settings.overBudgetSeconds && level + 1 < detailLevelCount) {
+        newLevel = level + 1;
+        // The last step up did not fit: wait longer before trying it again
+        if (sinceStepUp < revertWindow * stepUpDelay) {
+            stepUpDelay = std::min(stepUpDelay * 2.0f, settings.underBudgetSeconds * maxStepUpBackoff);
+        }
+    } else if (underBudgetTime >= stepUpDelay && level > 0) {
+        newLevel = level - 1;
+        sinceStepUp = 0.0f;
+    }
+    if (newLevel == level) {
+        // A level that has held for a while earns back the quick step up
+        if (sinceStepUp > revertWindow * stepUpDelay * 2.0f) {
+            stepUpDelay = settings.underBudgetSeconds;
+        }
+        return false;
+    }
+    
+    level = newLevel;
+    overBudgetTime = 0.0f;
+    underBudgetTime = 0.0f;
+    settleTime = settings.settleSeconds;
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+struct FrameBudgetSettings {
+    FrameBudgetSettings();
+    
+    float targetFrameMs;        // 0 disables the governor
+    float overBudgetRatio;      // Shed detail above target * this...
+    float overBudgetSeconds;    // ...sustained this long
+    float underBudgetRatio;     // Restore detail below target * this...
+    float underBudgetSeconds;   // ...sustained this long (doubles after each reverted step up)
+    float settleSeconds;        // Frames ignored after a change while rebuilds land
+    float smoothingSeconds;     // Time constant of the frame time average
+};
+
+// One rung of the detail ladder, relative to the configured detail
+struct DetailLevel {
+    int stepMultiplier;         // Times the configured triangle step size
+    float meshErrorScale;       // Times the configured adaptive mesh error
+    float treeDensity;          // Share of tree sites that get a tree
+    float drawDistance;         // Far plane, world units (the map is 10 across)
+};
+
+// Watches frame times against a budget and walks a fixed ladder of detail
+// levels: down a step when the smoothed frame time stays over budget, up a
+// step when it stays well under. The gap between the two thresholds, the
+// sustain times, and a settle period after every change (while the new
+// meshes build in the background) keep it from flapping between two levels;
+// a step up that has to be taken back soon after also makes the next one
+// wait twice as long.
+//
+// The governor only decides; the renderer applies a level. It holds no GL
+// state, so it can be driven with synthetic frame times.
+class FrameGovernor {
+public:
+    FrameGovernor();
+    
+    void setSettings(const FrameBudgetSettings& settings);
+    const FrameBudgetSettings& getSettings() const { return settings; }
+    bool isEnabled() const { return settings.targetFrameMs > 0.0f; }
+    
+    // Feed one frame: the wall time since the last one, which drives the
+    // timers, and its work time (the longer of CPU and GPU time, without
+    // waits for vsync), which is held against the budget. Returns true when
+    // the level changed.
+    bool update(float frameSeconds, float workMs);
+    
+    // Back to full detail with no history
+    void reset();
+    
+    // 0 is full detail, getLevelCount() - 1 the coarsest
+    int getLevel() const { return level; }
+    static int getLevelCount();
+    const DetailLevel& getDetail() const { return getDetail(level); }
+    static const DetailLevel& getDetail(int level);
+    
+    float getAverageFrameMs() const { return averageFrameMs; }
+
+private:
+    FrameBudgetSettings settings;
+    int level;
+    float averageFrameMs;       // Moving average of work time, 0 before the first frame
+    float overBudgetTime;       // Seconds the average has been over / under budget
+    float underBudgetTime;
+    float settleTime;           // Seconds left to ignore
+    float stepUpDelay;          // Current sustain time before a step up
+    float sinceStepUp;          // Seconds since the last step up
+};
@@ -0,0 +1,110 @@
+#include "MeshChunkPool.h"
+#include "../utils/MemoryPool.h"
+#include <utility>
+
+namespace {
+    // Recycled buffers looked at for one big enough, newest first
+    const size_t fitSearch = 16;
+    
+    // Free list slots reserved up front, so recycling rarely grows it
+    const size_t reservedChunks = 4096;
+    
+    size_t getCapacityBytes(const MeshChunk& chunk) {
+        return chunk.vertices.capacity() * sizeof(float) + chunk.indices.capacity() * sizeof(unsigned int);
+    }
+}
+
+MeshChunkPool::MeshChunkPool() : pooledBytes(0), cacheLimit(256 << 20) {
+    freeChunks.reserve(reservedChunks);
+}
+
+MeshChunkPool& MeshChunkPool::instance() {
+    static MeshChunkPool* pool = new MeshChunkPool();
+    return *pool;
+}
+
+MeshChunk MeshChunkPool::acquire(size_t vertexFloats, size_t indexCount) {
+    MeshChunk chunk;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeChunks.empty()) {
+            size_t pick = freeChunks.size() - 1;
+            for (size_t i = 0; i < fitSearch && i < freeChunks.size(); ++i) {
+                const MeshChunk& candidate = freeChunks[freeChunks.size() - 1 - i];
+                if (candidate.vertices.capacity() >= vertexFloats && candidate.indices.capacity() >= indexCount) {
+                    pick = freeChunks.size() - 1 - i;
+                    break;
+                }
+            }
+            std::swap(freeChunks[pick], freeChunks.back());
+            chunk = std::move(freeChunks.back());
+            freeChunks.pop_back();
+            
+            size_t bytes = getCapacityBytes(chunk);
+            pooledBytes -= bytes;
+            MemoryTracker::recordReuse(MemorySubsystem::MeshStaging);
+            MemoryTracker::recordBytes(MemorySubsystem::MeshStaging, 0, -static_cast<int64_t>(bytes));
+        } else {
+            MemoryTracker::recordAllocation(MemorySubsystem::MeshStaging);
+        }
+    }
+    
+    // A recycled buffer too small still has to grow once
+    if (chunk.vertices.capacity() < vertexFloats || chunk.indices.capacity() < indexCount) {
+        if (chunk.vertices.capacity() + chunk.indices.capacity() > 0) {
+            MemoryTracker::recordAllocation(MemorySubsystem::MeshStaging);
+        }
+        chunk.vertices.reserve(vertexFloats);
+        chunk.indices.reserve(indexCount);
+    }
+    return chunk;
+}
+
+void MeshChunkPool::recycle(MeshChunk& chunk) {
+    size_t bytes = getCapacityBytes(chunk);
+    if (bytes == 0) return;
+    
+    chunk.vertices.clear();
+    chunk.indices.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pooledBytes + bytes <= cacheLimit) {
+            freeChunks.push_back(std::move(chunk));
+            pooledBytes += bytes;
+            MemoryTracker::recordBytes(MemorySubsystem::MeshStaging, 0, static_cast<int64_t>(bytes));
+            return;
+        }
+    }
+    
+    // Over the limit: give the buffers back to the heap
+    std::vector<float>().swap(chunk.vertices);
+    std::vector<unsigned int>().swap(chunk.indices);
+}
+
+void MeshChunkPool::recycle(std::vector<MeshChunk>& chunks) {
+    for (MeshChunk& chunk : chunks) {
+        recycle(chunk);
+    }
+    chunks.clear();
+}
+
+void MeshChunkPool::setCacheLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cacheLimit = bytes;
+}
+
+void MeshChunkPool::trim() {
+    std::vector<MeshChunk> chunks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.swap(freeChunks);
+        freeChunks.reserve(reservedChunks);
+        MemoryTracker::recordBytes(MemorySubsystem::MeshStaging, 0, -static_cast<int64_t>(pooledBytes));
+        pooledBytes = 0;
+    }
+}
+
+size_t MeshChunkPool::getPooledBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pooledBytes;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "TerrainMeshBuilder.h"
+
+// Vertex and index buffers of evicted mesh chunks, handed to the chunks
+// built next, so streaming and sculpting rebuild meshes without going to
+// the heap. Buffers keep their capacity; a new chunk gets one with room
+// for its size when the pool has it, so mixed terrain and tree chunks
+// settle on buffers big enough for either. Thread safe.
+class MeshChunkPool {
+public:
+    static MeshChunkPool& instance();
+    
+    // An empty chunk with room for at least vertexFloats and indexCount
+    MeshChunk acquire(size_t vertexFloats = 0, size_t indexCount = 0);
+    
+    // Take the chunk's buffers for reuse; it is left empty
+    void recycle(MeshChunk& chunk);
+    // Every chunk in the list, which is then cleared
+    void recycle(std::vector<MeshChunk>& chunks);
+    
+    // Buffer bytes kept for reuse (default 256 MB); beyond it recycled
+    // buffers are freed
+    void setCacheLimit(size_t bytes);
+    void trim();
+    
+    size_t getPooledBytes() const;
+
+private:
+    MeshChunkPool();
+    
+    mutable std::mutex mutex;
+    std::vector<MeshChunk> freeChunks;
+    size_t pooledBytes;
+    size_t cacheLimit;
+};
@@ -0,0 +1,588 @@
+#include "MeshExporter.h"
+#include "MeshChunkPool.h"
+#include "../utils/JobSystem.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MESH_EXPORTER_POSIX_IO
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Both formats are little-endian, like every platform the renderer runs
+    // on, so vertex floats and indices are written as they are in memory
+    const size_t plyFaceBytes = 1 + 3 * sizeof(uint32_t);
+    
+    // The glb JSON is written last, into space reserved at the front:
+    // header, JSON chunk header and JSON, then the BIN chunk header
+    const size_t glbJsonCapacity = 4096;
+    const size_t glbBinOffset = 12 + 8 + glbJsonCapacity + 8;
+    
+    struct ByteSpan {
+        const void* data;
+        size_t size;
+    };
+    
+    // Append-only output file with vectored writes and in-place patches.
+    // POSIX systems use writev and pwrite on the descriptor; elsewhere each
+    // span is an fwrite. Errors stick, so callers check once at the end.
+    class OutputFile {
+    public:
+        OutputFile() : file(nullptr), written(0), failed(false) {}
+        ~OutputFile() { close(); }
+        
+        OutputFile(const OutputFile&) = delete;
+        OutputFile& operator=(const OutputFile&) = delete;
+        
+        bool open(const std::string& path) {
+            file = std::fopen(path.c_str(), "wb");
+            return file != nullptr;
+        }
+        
+        // Deleted automatically when closed
+        bool openTemporary() {
+            file = std::tmpfile();
+            return file != nullptr;
+        }
+        
+        bool close() {
+            if (file && std::fclose(file) != 0) {
+                failed = true;
+            }
+            file = nullptr;
+            return !failed;
+        }
+        
+        void append(const std::vector<ByteSpan>& spans) {
+            if (failed) return;
+#ifdef MESH_EXPORTER_POSIX_IO
+#ifdef IOV_MAX
+            const size_t maxVectors = IOV_MAX;
+#else
+            const size_t maxVectors = 16;
+#endif
+            std::vector<iovec> vectors;
+            size_t next = 0;
+            while (next < spans.size() && !failed) {
+                vectors.clear();
+                for (; next < spans.size() && vectors.size() < maxVectors; ++next) {
+                    if (spans[next].size > 0) {
+                        vectors.push_back({ const_cast<void*>(spans[next].data), spans[next].size });
+                    }
+                }
+                writeVectors(vectors);
+            }
+#else
+            for (const ByteSpan& span : spans) {
+                if (span.size > 0 && std::fwrite(span.data, 1, span.size, file) != span.size) {
+                    failed = true;
+                    return;
+                }
+                written += span.size;
+            }
+#endif
+        }
+        
+        void append(const void* data, size_t size) {
+            append(std::vector<ByteSpan>{ { data, size } });
+        }
+        
+        // Overwrite bytes already written, such as a header
+        void patch(size_t offset, const void* data, size_t size) {
+            if (failed) return;
+#ifdef MESH_EXPORTER_POSIX_IO
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            while (size > 0) {
+                ssize_t count = pwrite(fileno(file), bytes, size, static_cast<off_t>(offset));
+                if (count < 0 && errno == EINTR) continue;
+                if (count <= 0) {
+                    failed = true;
+                    return;
+                }
+                bytes += count;
+                offset += count;
+                size -= count;
+            }
+#else
+            if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0 ||
+                std::fwrite(data, 1, size, file) != size || std::fseek(file, 0, SEEK_END) != 0) {
+                failed = true;
+            }
+#endif
+        }
+        
+        // Copy everything written to other onto the end of this file
+        void appendFile(OutputFile& other) {
+            if (failed || other.failed) {
+                failed = true;
+                return;
+            }
+            std::vector<uint8_t> block(1 << 20);
+#ifdef MESH_EXPORTER_POSIX_IO
+            size_t offset = 0;
+            while (offset < other.written && !failed) {
+                size_t wanted = std::min(block.size(), other.written - offset);
+                ssize_t count = pread(fileno(other.file), block.data(), wanted, static_cast<off_t>(offset));
+                if (count < 0 && errno == EINTR) continue;
+                if (count <= 0) {
+                    failed = true;
+                    return;
+                }
+                append(block.data(), count);
+                offset += count;
+            }
+#else
+            if (std::fflush(other.file) != 0 || std::fseek(other.file, 0, SEEK_SET) != 0) {
+                failed = true;
+                return;
+            }
+            size_t count;
+            while (!failed && (count = std::fread(block.data(), 1, block.size(), other.file)) > 0) {
+                append(block.data(), count);
+            }
+#endif
+        }
+        
+        size_t size() const { return written; }
+    
+    private:
+        std::FILE* file;
+        size_t written;
+        bool failed;
+
+#ifdef MESH_EXPORTER_POSIX_IO
+        // writev until every vector is out; it may stop part way through one
+        void writeVectors(std::vector<iovec>& vectors) {
+            iovec* next = vectors.data();
+            int remaining = static_cast<int>(vectors.size());
+            while (remaining > 0) {
+                ssize_t count = writev(fileno(file), next, remaining);
+                if (count < 0 && errno == EINTR) continue;
+                if (count <= 0) {
+                    failed = true;
+                    return;
+                }
+                written += count;
+                while (remaining > 0 && static_cast<size_t>(count) >= next->iov_len) {
+                    count -= next->iov_len;
+                    ++next;
+                    --remaining;
+                }
+                if (remaining > 0) {
+                    next->iov_base = static_cast<uint8_t*>(next->iov_base) + count;
+                    next->iov_len -= count;
+                }
+            }
+        }
+#endif
+    };
+    
+    // Chunks of one mesh: already built, or built on demand a batch at a time
+    struct ChunkSource {
+        int count;
+        const std::vector<MeshChunk>* chunks;
+        std::function<MeshChunk(int)> build;
+    };
+    
+    ChunkSource builtChunks(const std::vector<MeshChunk>& chunks) {
+        return { static_cast<int>(chunks.size()), &chunks, nullptr };
+    }
+    
+    // One mesh of the file and what streaming it found out
+    struct MeshLayer {
+        const char* name;
+        bool terrain;           // Terrain attributes, otherwise a tree color
+        int vertexFloats;       // The builder's layout: 4 for terrain, 6 for trees
+        ChunkSource source;
+        size_t vertexCount;
+        size_t indexCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+    
+    MeshLayer makeLayer(const char* name, bool terrain, ChunkSource source) {
+        MeshLayer layer;
+        layer.name = name;
+        layer.terrain = terrain;
+        layer.vertexFloats = terrain ? 4 : 6;
+        layer.source = source;
+        layer.vertexCount = 0;
+        layer.indexCount = 0;
+        std::fill(layer.boundsMin, layer.boundsMin + 3, 1e30f);
+        std::fill(layer.boundsMax, layer.boundsMax + 3, -1e30f);
+        return layer;
+    }
+    
+    // A chunk's indices rebased onto the whole mesh's vertices, in the
+    // file's encoding, and the bounds of its vertex positions
+    struct SerializedChunk {
+        std::vector<uint8_t> indices;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+    
+    void serializeChunk(const MeshChunk& chunk, int vertexFloats, uint32_t vertexBase, bool plyFaces,
+                        SerializedChunk& out) {
+        const std::vector<unsigned int>& indices = chunk.indices;
+        size_t triangleCount = indices.size() / 3;
+        if (plyFaces) {
+            out.indices.resize(triangleCount * plyFaceBytes);
+            uint8_t* face = out.indices.data();
+            for (size_t triangle = 0; triangle < triangleCount; ++triangle, face += plyFaceBytes) {
+                uint32_t corners[3] = { vertexBase + indices[triangle * 3], vertexBase + indices[triangle * 3 + 1],
+                                        vertexBase + indices[triangle * 3 + 2] };
+                face[0] = 3;
+                std::memcpy(face + 1, corners, sizeof(corners));
+            }
+        } else {
+            out.indices.resize(triangleCount * 3 * sizeof(uint32_t));
+            uint8_t* index = out.indices.data();
+            for (size_t i = 0; i < triangleCount * 3; ++i, index += sizeof(uint32_t)) {
+                uint32_t value = vertexBase + indices[i];
+                std::memcpy(index, &value, sizeof(value));
+            }
+        }
+        
+        std::fill(out.boundsMin, out.boundsMin + 3, 1e30f);
+        std::fill(out.boundsMax, out.boundsMax + 3, -1e30f);
+        for (size_t vertex = 0; vertex + vertexFloats <= chunk.vertices.size(); vertex += vertexFloats) {
+            for (int axis = 0; axis < 3; ++axis) {
+                out.boundsMin[axis] = std::min(out.boundsMin[axis], chunk.vertices[vertex + axis]);
+                out.boundsMax[axis] = std::max(out.boundsMax[axis], chunk.vertices[vertex + axis]);
+            }
+        }
+    }
+    
+    // Write a mesh's vertices to out and its indices to spool, a batch of
+    // chunks at a time. Building and serialization run in parallel; the
+    // writes go out in chunk order.
+    bool streamLayer(MeshLayer& layer, bool plyFaces, int chunksPerBatch, JobSystem& jobs,
+                     OutputFile& out, OutputFile& spool) {
+        const ChunkSource& source = layer.source;
+        const int vertexFloats = layer.vertexFloats;
+        std::vector<MeshChunk> built;
+        std::vector<const MeshChunk*> batch;
+        std::vector<SerializedChunk> serialized;
+        std::vector<uint32_t> vertexBases;
+        std::vector<ByteSpan> spans;
+        
+        for (int first = 0; first < source.count; first += chunksPerBatch) {
+            int count = std::min(chunksPerBatch, source.count - first);
+            batch.resize(count);
+            if (source.chunks) {
+                for (int i = 0; i < count; ++i) {
+                    batch[i] = &(*source.chunks)[first + i];
+                }
+            } else {
+                // The last batch's buffers build this one
+                MeshChunkPool::instance().recycle(built);
+                built.resize(count);
+                jobs.parallelFor(0, count, 1, [&](int begin, int end) {
+                    for (int i = begin; i < end; ++i) {
+                        built[i] = source.build(first + i);
+                    }
+                });
+                for (int i = 0; i < count; ++i) {
+                    batch[i] = &built[i];
+                }
+            }
+            
+            // Indices are 32-bit in both formats
+            vertexBases.resize(count);
+            for (int i = 0; i < count; ++i) {
+                vertexBases[i] = static_cast<uint32_t>(layer.vertexCount);
+                layer.vertexCount += batch[i]->vertices.size() / vertexFloats;
+                layer.indexCount += batch[i]->indices.size() / 3 * 3;
+                if (layer.vertexCount > 0xFFFFFFFFu) return false;
+            }
+            
+            serialized.resize(count);
+            jobs.parallelFor(0, count, 1, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    serializeChunk(*batch[i], vertexFloats, vertexBases[i], plyFaces, serialized[i]);
+                }
+            });
+            
+            // Vertices go out straight from the chunks
+            spans.clear();
+            for (int i = 0; i < count; ++i) {
+                size_t vertexCount = batch[i]->vertices.size() / vertexFloats;
+                spans.push_back({ batch[i]->vertices.data(), vertexCount * vertexFloats * sizeof(float) });
+            }
+            out.append(spans);
+            
+            spans.clear();
+            for (int i = 0; i < count; ++i) {
+                spans.push_back({ serialized[i].indices.data(), serialized[i].indices.size() });
+                for (int axis = 0; axis < 3; ++axis) {
+                    layer.boundsMin[axis] = std::min(layer.boundsMin[axis], serialized[i].boundsMin[axis]);
+                    layer.boundsMax[axis] = std::max(layer.boundsMax[axis], serialized[i].boundsMax[axis]);
+                }
+            }
+            spool.append(spans);
+        }
+        MeshChunkPool::instance().recycle(built);
+        return true;
+    }
+    
+    void appendUint32(std::vector<uint8_t>& out, uint32_t value) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, sizeof(bytes));
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+    
+    std::string formatFloat(float value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", value);
+        return text;
+    }
+    
+    // glTF JSON describing the layers' meshes in the binary chunk: each
+    // mesh's vertices (interleaved) in layer order, then each mesh's indices
+    std::string glbJson(const std::vector<MeshLayer>& layers, size_t binLength) {
+        std::string nodes;
+        std::string meshes;
+        std::string bufferViews;
+        std::string accessors;
+        size_t vertexStart = 0;
+        size_t indexStart = 0;
+        for (const MeshLayer& layer : layers) {
+            indexStart += layer.vertexCount * layer.vertexFloats * sizeof(float);
+        }
+        
+        // Layers without triangles are left out
+        int meshIndex = 0;
+        for (const MeshLayer& layer : layers) {
+            size_t vertexBytes = layer.vertexFloats * sizeof(float);
+            size_t vertexLength = layer.vertexCount * vertexBytes;
+            size_t indexLength = layer.indexCount * sizeof(uint32_t);
+            if (layer.indexCount == 0) {
+                vertexStart += vertexLength;
+                continue;
+            }
+            
+            int view = meshIndex * 2;
+            int accessor = meshIndex * 3;
+            const char* separator = meshIndex > 0 ? "," : "";
+            nodes += std::string(separator) + "{\"name\":\"" + layer.name + "\",\"mesh\":" +
+                     std::to_string(meshIndex) + "}";
+            meshes += std::string(separator) + "{\"name\":\"" + layer.name + "\",\"primitives\":[{\"attributes\":{" +
+                      "\"POSITION\":" + std::to_string(accessor) + ",\"" +
+                      (layer.terrain ? "_TERRAIN" : "COLOR_0") + "\":" + std::to_string(accessor + 1) +
+                      "},\"indices\":" + std::to_string(accessor + 2) + ",\"mode\":4}]}";
+            bufferViews += std::string(separator) +
+                "{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexStart) + ",\"byteLength\":" +
+                std::to_string(vertexLength) + ",\"byteStride\":" + std::to_string(vertexBytes) +
+                ",\"target\":34962}," +
+                "{\"buffer\":0,\"byteOffset\":" + std::to_string(indexStart) +
+                ",\"byteLength\":" + std::to_string(indexLength) + ",\"target\":34963}";
+            accessors += std::string(separator) +
+                "{\"bufferView\":" + std::to_string(view) + ",\"componentType\":5126,\"count\":" +
+                std::to_string(layer.vertexCount) + ",\"type\":\"VEC3\",\"min\":[" +
+                formatFloat(layer.boundsMin[0]) + "," + formatFloat(layer.boundsMin[1]) + "," +
+                formatFloat(layer.boundsMin[2]) + "],\"max\":[" + formatFloat(layer.boundsMax[0]) + "," +
+                formatFloat(layer.boundsMax[1]) + "," + formatFloat(layer.boundsMax[2]) + "]}," +
+                "{\"bufferView\":" + std::to_string(view) + ",\"byteOffset\":12,\"componentType\":5126,\"count\":" +
+                std::to_string(layer.vertexCount) + ",\"type\":\"" + (layer.terrain ? "SCALAR" : "VEC3") + "\"}," +
+                "{\"bufferView\":" + std::to_string(view + 1) + ",\"componentType\":5125,\"count\":" +
+                std::to_string(layer.indexCount) + ",\"type\":\"SCALAR\"}";
+            vertexStart += vertexLength;
+            indexStart += indexLength;
+            ++meshIndex;
+        }
+        
+        std::string sceneNodes;
+        for (int i = 0; i < meshIndex; ++i) {
+            sceneNodes += (i > 0 ? "," : "") + std::to_string(i);
+        }
+        std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"TerrainGenerator MeshExporter\"},"
+                           "\"scene\":0,\"scenes\":[{\"nodes\":[" + sceneNodes + "]}]";
+        if (meshIndex > 0) {
+            json += ",\"nodes\":[" + nodes + "],\"meshes\":[" + meshes + "],\"buffers\":[{\"byteLength\":" +
+                    std::to_string(binLength) + "}],\"bufferViews\":[" + bufferViews + "],\"accessors\":[" +
+                    accessors + "]";
+        }
+        return json + "}";
+    }
+    
+    // Layers as one binary glTF: header, JSON chunk, BIN chunk. The JSON
+    // needs the final counts, so streaming starts after space reserved for
+    // it and it is patched in at the end.
+    bool writeGlb(const std::string& path, std::vector<MeshLayer>& layers, int chunksPerBatch, JobSystem& jobs,
+                  size_t& bytesWritten) {
+        OutputFile out;
+        OutputFile spool;
+        if (!out.open(path) || !spool.openTemporary()) return false;
+        
+        std::vector<uint8_t> reserved(glbBinOffset, ' ');
+        out.append(reserved.data(), reserved.size());
+        for (MeshLayer& layer : layers) {
+            if (!streamLayer(layer, false, chunksPerBatch, jobs, out, spool)) return false;
+        }
+        out.appendFile(spool);
+        
+        size_t binLength = out.size() - glbBinOffset;
+        size_t fileLength = out.size();
+        if (fileLength > 0xFFFFFFFFu) return false;
+        
+        std::string json = glbJson(layers, binLength);
+        size_t jsonLength = glbJsonCapacity;
+        if (binLength == 0) {
+            // No binary chunk: its header becomes JSON padding
+            jsonLength += 8;
+        }
+        if (json.size() > jsonLength) return false;
+        json.resize(jsonLength, ' ');
+        
+        std::vector<uint8_t> header;
+        header.insert(header.end(), { 'g', 'l', 'T', 'F' });
+        appendUint32(header, 2);
+        appendUint32(header, static_cast<uint32_t>(fileLength));
+        appendUint32(header, static_cast<uint32_t>(jsonLength));
+        header.insert(header.end(), { 'J', 'S', 'O', 'N' });
+        header.insert(header.end(), json.begin(), json.end());
+        if (binLength > 0) {
+            appendUint32(header, static_cast<uint32_t>(binLength));
+            header.insert(header.end(), { 'B', 'I', 'N', 0 });
+        }
+        out.patch(0, header.data(), header.size());
+        
+        bytesWritten += fileLength;
+        return out.close();
+    }
+    
+    std::string plyHeader(const MeshLayer& layer) {
+        // Counts are zero-padded to a fixed width, so the header can be
+        // written before they are known and patched in place
+        char counts[2][24];
+        std::snprintf(counts[0], sizeof(counts[0]), "%012llu", static_cast<unsigned long long>(layer.vertexCount));
+        std::snprintf(counts[1], sizeof(counts[1]), "%012llu", static_cast<unsigned long long>(layer.indexCount / 3));
+        const char* attributes = layer.terrain ?
+            "property float height\n" :
+            "property float red\nproperty float green\nproperty float blue\n";
+        return std::string("ply\nformat binary_little_endian 1.0\ncomment ") + layer.name +
+               " exported by TerrainGenerator\nelement vertex " + counts[0] +
+               "\nproperty float x\nproperty float y\nproperty float z\n" + attributes +
+               "element face " + counts[1] + "\nproperty list uchar uint vertex_indices\nend_header\n";
+    }
+    
+    bool writePly(const std::string& path, MeshLayer& layer, int chunksPerBatch, JobSystem& jobs,
+                  size_t& bytesWritten) {
+        OutputFile out;
+        OutputFile spool;
+        if (!out.open(path) || !spool.openTemporary()) return false;
+        
+        std::string header = plyHeader(layer);
+        out.append(header.data(), header.size());
+        if (!streamLayer(layer, true, chunksPerBatch, jobs, out, spool)) return false;
+        out.appendFile(spool);
+        
+        header = plyHeader(layer);
+        out.patch(0, header.data(), header.size());
+        
+        bytesWritten += out.size();
+        return out.close();
+    }
+    
+    // path with "_trees" before its extension
+    std::string treePath(const std::string& path) {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return path + "_trees";
+        }
+        return path.substr(0, dot) + "_trees" + path.substr(dot);
+    }
+    
+    bool writeLayers(const std::string& path, MeshFileFormat format, std::vector<MeshLayer>& layers,
+                     int chunksPerBatch, JobSystem& jobs, MeshExporter::Stats* stats) {
+        size_t bytesWritten = 0;
+        bool written = true;
+        if (format == MeshFileFormat::Glb) {
+            written = writeGlb(path, layers, chunksPerBatch, jobs, bytesWritten);
+        } else {
+            for (size_t i = 0; i < layers.size() && written; ++i) {
+                written = writePly(i == 0 ? path : treePath(path), layers[i], chunksPerBatch, jobs, bytesWritten);
+            }
+        }
+        
+        if (stats) {
+            *stats = { 0, 0, 0, 0, bytesWritten };
+            for (const MeshLayer& layer : layers) {
+                (layer.terrain ? stats->terrainVertices : stats->treeVertices) += layer.vertexCount;
+                (layer.terrain ? stats->terrainTriangles : stats->treeTriangles) += layer.indexCount / 3;
+            }
+        }
+        return written;
+    }
+}
+
+MeshExporter::MeshExporter() : chunksPerBatch(256), jobs(nullptr) {}
+
+JobSystem& MeshExporter::getJobSystem() const {
+    return jobs ? *jobs : JobSystem::instance();
+}
+
+bool MeshExporter::formatFromPath(const std::string& path, MeshFileFormat& format) {
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if (extension == "glb") {
+        format = MeshFileFormat::Glb;
+        return true;
+    }
+    if (extension == "ply") {
+        format = MeshFileFormat::Ply;
+        return true;
+    }
+    return false;
+}
+
+bool MeshExporter::exportTerrain(const std::string& path, MeshFileFormat format, const HeightMap& heightMap,
+                                 const TerrainFields& fields, const TerrainMeshBuilder& builder, bool includeTrees,
+                                 Stats* stats) const {
+    // Regular grid chunks build one batch at a time. The adaptive mesh and
+    // the trees are built whole (their chunks depend on each other) and
+    // only serialized in batches.
+    std::vector<MeshChunk> adaptiveChunks;
+    ChunkSource terrain;
+    if (builder.getMaxMeshError() > 0.0f) {
+        adaptiveChunks = builder.buildTerrainChunks(heightMap);
+        terrain = builtChunks(adaptiveChunks);
+    } else {
+        terrain.count = builder.getTerrainChunkCount(heightMap);
+        terrain.chunks = nullptr;
+        terrain.build = [&](int chunkIndex) { return builder.buildTerrainChunk(heightMap, chunkIndex); };
+    }
+    
+    std::vector<MeshChunk> treeChunks;
+    std::vector<MeshLayer> layers = { makeLayer("terrain", true, terrain) };
+    if (includeTrees) {
+        treeChunks = builder.buildTreeChunks(heightMap, fields);
+        layers.push_back(makeLayer("trees", false, builtChunks(treeChunks)));
+    }
+    return writeLayers(path, format, layers, chunksPerBatch, getJobSystem(), stats);
+}
+
+bool MeshExporter::exportChunks(const std::string& path, MeshFileFormat format,
+                                const std::vector<MeshChunk>& terrainChunks,
+                                const std::vector<MeshChunk>& treeChunks, Stats* stats) const {
+    std::vector<MeshLayer> layers = { makeLayer("terrain", true, builtChunks(terrainChunks)) };
+    // Tree chunk lists hold every chunk of the grid, often mostly empty
+    bool hasTrees = std::any_of(treeChunks.begin(), treeChunks.end(),
+                                [](const MeshChunk& chunk) { return !chunk.indices.empty(); });
+    if (hasTrees) {
+        layers.push_back(makeLayer("trees", false, builtChunks(treeChunks)));
+    }
+    return writeLayers(path, format, layers, chunksPerBatch, getJobSystem(), stats);
+}
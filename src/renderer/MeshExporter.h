@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "TerrainMeshBuilder.h"
+
+class JobSystem;
+
+enum class MeshFileFormat {
+    Glb,    // Binary glTF 2.0: terrain and trees as two meshes in one file
+    Ply     // Binary little-endian PLY: one mesh per file
+};
+
+// Writes terrain and tree meshes to binary mesh files without a GL context,
+// for offline tools. Meshes stream out a batch of chunks at a time: chunks
+// are built (or taken as given) and serialized in parallel, then written
+// with vectored writes straight from the chunk buffers. Vertex data is never
+// formatted; only indices are rebased. Indices go to a temporary spool file
+// while vertices stream, so memory stays at about one batch whatever the
+// map size.
+//
+// Vertices keep the builder's layout: terrain carries the color lookup
+// height after its position (the _TERRAIN attribute in glTF, a height
+// property in PLY), and trees an RGB color.
+class MeshExporter {
+public:
+    struct Stats {
+        size_t terrainVertices;
+        size_t terrainTriangles;
+        size_t treeVertices;
+        size_t treeTriangles;
+        size_t bytesWritten;
+    };
+    
+    MeshExporter();
+    
+    // Build the heightmap's terrain mesh with builder, chunk batch by chunk
+    // batch, and write it to path, with trees if includeTrees. PLY holds one
+    // mesh, so there the trees go to a second file with "_trees" before the
+    // extension. Returns false if a file cannot be written or is too large
+    // for the format (4 GB for glb).
+    bool exportTerrain(const std::string& path, MeshFileFormat format, const HeightMap& heightMap,
+                       const TerrainFields& fields, const TerrainMeshBuilder& builder, bool includeTrees,
+                       Stats* stats = nullptr) const;
+    
+    // Write chunks that are already built (in the builder's layouts), such
+    // as a streamed terrain's. Either list may be empty.
+    bool exportChunks(const std::string& path, MeshFileFormat format, const std::vector<MeshChunk>& terrainChunks,
+                      const std::vector<MeshChunk>& treeChunks, Stats* stats = nullptr) const;
+    
+    // Chunks built and serialized per batch; bounds memory use
+    void setChunksPerBatch(int chunks) { chunksPerBatch = chunks > 0 ? chunks : 1; }
+    int getChunksPerBatch() const { return chunksPerBatch; }
+    
+    // Scheduler for chunk building and serialization (default: JobSystem::instance())
+    void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+    
+    // Format from a path's extension (.glb or .ply); false if neither
+    static bool formatFromPath(const std::string& path, MeshFileFormat& format);
+
+private:
+    int chunksPerBatch;
+    JobSystem* jobs;
+    
+    JobSystem& getJobSystem() const;
+};
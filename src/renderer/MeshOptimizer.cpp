@@ -0,0 +1,331 @@
+#include "MeshOptimizer.h"
+#include "../utils/MemoryPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Forsyth scoring parameters (from "Linear-Speed Vertex Cache Optimisation")
+    const int scoringCacheSize = 32;
+    const float cacheDecayPower = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+    
+    float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;   // No triangles left to use this vertex
+        }
+        
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // Used by the last triangle; fixed score so strips are not favoured
+                score = lastTriangleScore;
+            } else {
+                float scaler = 1.0f / (scoringCacheSize - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+            }
+        }
+        
+        // Boost vertices with few triangles left so they get finished off
+        score += valenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -valenceBoostPower);
+        return score;
+    }
+    
+    float fifoACMR(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, int cacheSize) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) return 0.0f;
+        
+        // FIFO cache: a vertex hits if it entered within the last cacheSize misses
+        ScratchArena& arena = ScratchArena::forThread();
+        ScratchArena::Scope arenaScope(arena);
+        long long* timestamps = arena.allocate<long long>(vertexCount);
+        std::fill(timestamps, timestamps + vertexCount, -static_cast<long long>(cacheSize) - 1);
+        long long time = 0;
+        size_t misses = 0;
+        for (size_t i = 0; i < indexCount; ++i) {
+            unsigned int index = indices[i];
+            if (time - timestamps[index] > cacheSize) {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+        return static_cast<float>(misses) / triangleCount;
+    }
+}
+
+MeshOptimizer::Stats MeshOptimizer::optimize(std::vector<float>& vertices, int stride,
+                                             std::vector<unsigned int>& indices, bool reduceOverdraw) {
+    unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / stride);
+    
+    Stats stats;
+    stats.triangleCount = static_cast<unsigned int>(indices.size() / 3);
+    stats.acmrBefore = computeACMR(indices, vertexCount);
+    
+    optimizeVertexCache(indices, vertexCount);
+    if (reduceOverdraw) {
+        optimizeOverdraw(indices, vertices, stride);
+    }
+    optimizeVertexFetch(vertices, stride, indices);
+    
+    stats.acmrAfter = computeACMR(indices, vertexCount);
+    return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+    
+    // Working arrays come from the thread's arena, so meshing many chunks
+    // in a row never returns to the heap
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    
+    // Vertex -> triangle adjacency in compressed rows
+    unsigned int* remaining = arena.allocate<unsigned int>(vertexCount);
+    std::fill(remaining, remaining + vertexCount, 0u);
+    for (unsigned int index : indices) {
+        remaining[index]++;
+    }
+    
+    unsigned int* adjacencyOffset = arena.allocate<unsigned int>(vertexCount + 1);
+    adjacencyOffset[0] = 0;
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    }
+    
+    unsigned int* adjacency = arena.allocate<unsigned int>(indices.size());
+    unsigned int* fill = arena.allocate<unsigned int>(vertexCount);
+    std::copy(adjacencyOffset, adjacencyOffset + vertexCount, fill);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            adjacency[fill[v]++] = static_cast<unsigned int>(t);
+        }
+    }
+    
+    float* scores = arena.allocate<float>(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+    
+    bool* emitted = arena.allocate<bool>(triangleCount);
+    std::fill(emitted, emitted + triangleCount, false);
+    
+    unsigned int* output = arena.allocate<unsigned int>(indices.size());
+    size_t outputSize = 0;
+    
+    // The cache holds up to scoringCacheSize entries plus the three new ones
+    unsigned int cache[scoringCacheSize + 3];
+    unsigned int newCache[scoringCacheSize + 3];
+    int cacheSize = 0;
+    int newCacheSize = 0;
+    
+    size_t inputCursor = 0;
+    long long bestTriangle = 0;
+    
+    while (true) {
+        if (bestTriangle < 0) {
+            // Nothing in the cache touches a live triangle; resume in input order
+            while (inputCursor < triangleCount && emitted[inputCursor]) {
+                ++inputCursor;
+            }
+            if (inputCursor == triangleCount) break;
+            bestTriangle = static_cast<long long>(inputCursor);
+        }
+        
+        size_t t = static_cast<size_t>(bestTriangle);
+        emitted[t] = true;
+        
+        unsigned int triVertices[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        std::copy(triVertices, triVertices + 3, output + outputSize);
+        outputSize += 3;
+        
+        // Push the triangle's vertices to the front of the LRU cache
+        std::copy(triVertices, triVertices + 3, newCache);
+        newCacheSize = 3;
+        for (int i = 0; i < cacheSize; ++i) {
+            unsigned int v = cache[i];
+            if (v != triVertices[0] && v != triVertices[1] && v != triVertices[2]) {
+                newCache[newCacheSize++] = v;
+            }
+        }
+        
+        for (unsigned int v : triVertices) {
+            remaining[v]--;
+            
+            // Drop the triangle from the vertex's live adjacency
+            unsigned int begin = adjacencyOffset[v];
+            unsigned int end = begin + remaining[v] + 1;
+            for (unsigned int a = begin; a < end; ++a) {
+                if (adjacency[a] == t) {
+                    std::swap(adjacency[a], adjacency[end - 1]);
+                    break;
+                }
+            }
+        }
+        
+        // Rescore every vertex whose cache position changed, including the
+        // ones that just fell out of the cache
+        for (int i = 0; i < newCacheSize; ++i) {
+            unsigned int v = newCache[i];
+            int position = i < scoringCacheSize ? i : -1;
+            scores[v] = vertexScore(position, remaining[v]);
+        }
+        
+        // Only triangles touching the cache can change score; pick the best
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCacheSize; ++i) {
+            unsigned int v = newCache[i];
+            unsigned int begin = adjacencyOffset[v];
+            for (unsigned int a = begin; a < begin + remaining[v]; ++a) {
+                unsigned int tri = adjacency[a];
+                float score = scores[indices[tri * 3]] + scores[indices[tri * 3 + 1]] + scores[indices[tri * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = tri;
+                }
+            }
+        }
+        
+        cacheSize = std::min(newCacheSize, scoringCacheSize);
+        std::copy(newCache, newCache + cacheSize, cache);
+    }
+    
+    std::copy(output, output + outputSize, indices.begin());
+    indices.resize(outputSize);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices,
+                                     int stride, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / stride);
+    if (triangleCount == 0) return;
+    
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    
+    // Split the cache-ordered list into clusters at hard boundaries, i.e.
+    // triangles whose three vertices all miss the cache. Reordering whole
+    // clusters then barely affects vertex reuse.
+    size_t* clusterStarts = arena.allocate<size_t>(triangleCount + 1);
+    size_t clusterCount = 0;
+    int* timestamps = arena.allocate<int>(vertexCount);
+    std::fill(timestamps, timestamps + vertexCount, -defaultCacheSize - 1);
+    int time = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - timestamps[v] > defaultCacheSize) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (misses == 3) {
+            clusterStarts[clusterCount++] = t;
+        }
+    }
+    if (clusterCount < 2) return;
+    clusterStarts[clusterCount] = triangleCount;
+    
+    // Mesh centroid for the view-independent sort key
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            meshCentroid[k] += vertices[v * stride + k];
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        meshCentroid[k] /= vertexCount;
+    }
+    
+    struct Cluster {
+        size_t begin;
+        size_t end;
+        float sortKey;
+    };
+    Cluster* clusters = arena.allocate<Cluster>(clusterCount);
+    
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float totalArea = 0.0f;
+        
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            const float* p0 = &vertices[indices[t * 3] * stride];
+            const float* p1 = &vertices[indices[t * 3 + 1] * stride];
+            const float* p2 = &vertices[indices[t * 3 + 2] * stride];
+            
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            
+            for (int k = 0; k < 3; ++k) {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                normal[k] += n[k];
+            }
+            totalArea += area;
+        }
+        
+        float sortKey = 0.0f;
+        if (totalArea > 0.0f) {
+            float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int k = 0; k < 3; ++k) {
+                float direction = normalLength > 0.0f ? normal[k] / normalLength : 0.0f;
+                sortKey += (centroid[k] / totalArea - meshCentroid[k]) * direction;
+            }
+        }
+        clusters[c] = { clusterStarts[c], clusterStarts[c + 1], sortKey };
+    }
+    
+    // Clusters that face away from the middle of the mesh occlude the rest.
+    // Ties keep their order, as a stable sort would, without its buffer.
+    std::sort(clusters, clusters + clusterCount, [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey || (a.sortKey == b.sortKey && a.begin < b.begin);
+    });
+    
+    unsigned int* sorted = arena.allocate<unsigned int>(indices.size());
+    size_t sortedSize = 0;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        sortedSize = std::copy(indices.begin() + clusters[c].begin * 3, indices.begin() + clusters[c].end * 3,
+                               sorted + sortedSize) - sorted;
+    }
+    
+    // Keep the new order only if vertex reuse stays within the threshold
+    if (fifoACMR(sorted, sortedSize, vertexCount, defaultCacheSize) <=
+        computeACMR(indices, vertexCount) * threshold) {
+        std::copy(sorted, sorted + sortedSize, indices.begin());
+    }
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices) {
+    unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / stride);
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    unsigned int* remap = arena.allocate<unsigned int>(vertexCount);
+    std::fill(remap, remap + vertexCount, ~0u);
+    float* reordered = arena.allocate<float>(vertices.size());
+    
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == ~0u) {
+            std::copy(vertices.begin() + index * stride, vertices.begin() + (index + 1) * stride,
+                      reordered + static_cast<size_t>(next) * stride);
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    
+    // Unreferenced vertices are dropped; shrinking keeps the buffer
+    std::copy(reordered, reordered + static_cast<size_t>(next) * stride, vertices.begin());
+    vertices.resize(static_cast<size_t>(next) * stride);
+}
+
+float MeshOptimizer::computeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize) {
+    return fifoACMR(indices.data(), indices.size(), vertexCount, cacheSize);
+}
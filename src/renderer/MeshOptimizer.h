@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+// Index/vertex reordering for indexed triangle lists. Works on plain
+// vectors so it can run offline or at load time, before any GL upload.
+class MeshOptimizer {
+public:
+    struct Stats {
+        unsigned int triangleCount;
+        float acmrBefore;   // Average cache miss ratio (vertex shader runs per triangle)
+        float acmrAfter;
+    };
+    
+    // Full pass: vertex cache order, optional overdraw clustering, then
+    // vertex buffer reordering to match. stride is in floats and the first
+    // three floats of each vertex must be its position.
+    static Stats optimize(std::vector<float>& vertices, int stride,
+                          std::vector<unsigned int>& indices, bool reduceOverdraw = false);
+    
+    // Reorder triangles for post-transform vertex cache reuse (Forsyth)
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+    
+    // Reorder cache-optimized clusters so outward-facing ones draw first
+    // (Sander et al.). Rejected if it costs more than threshold x ACMR.
+    static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices,
+                                 int stride, float threshold = 1.05f);
+    
+    // Renumber vertices in first-use order so fetches walk memory linearly
+    static void optimizeVertexFetch(std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices);
+    
+    // Simulated FIFO post-transform cache misses per triangle
+    static float computeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount,
+                             int cacheSize = defaultCacheSize);
+    
+    static const int defaultCacheSize = 32;
+};
@@ -1,8 +1,11 @@
 #include "Renderer.h"
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <cmath>  // Add this at the top with your other includes
 #include "../camera/Camera.h"
+#include "MeshChunkPool.h"
+#include "../utils/JobSystem.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -21,8 +24,106 @@
 
 #include <GLFW/glfw3.h>
 
-// Basic shader sources
+// Terrain shader: color comes from a lookup texture indexed by height and
+// biome, blended to rock on steep slopes and scaled by the shade
 const char* vertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in float aHeight;
+    
+    out float terrainHeight;
+    out vec2 terrainUv;
+    
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform float horizontalScale;
+    
+    void main() {
+        gl_Position = projection * view * model * vec4(aPos, 1.0);
+        terrainUv = aPos.xz / (2.0 * horizontalScale) + 0.5;
+        terrainHeight = aHeight;
+    }
+)";
+
+// Shared by both terrain paths, each of which appends its terrainLighting
+const char* fragmentShaderSource = R"(
+    #version 330 core
+    in float terrainHeight;
+    in vec2 terrainUv;
+    out vec4 FragColor;
+    
+    uniform sampler2D colorLookup;    // Height across, one row per biome
+    uniform sampler2D biomeTexture;   // Biome index / 255 per heightmap texel
+    
+    // Land above the beaches turns to bare rock where it gets steep
+    const float landLevel = 0.35;
+    const vec3 rockColor = vec3(0.45, 0.4, 0.35);
+    
+    vec3 biomeColor(ivec2 texel, ivec2 size) {
+        float biome = floor(texelFetch(biomeTexture, clamp(texel, ivec2(0), size - 1), 0).r * 255.0 + 0.5);
+        float row = (biome + 0.5) / float(textureSize(colorLookup, 0).y);
+        return texture(colorLookup, vec2(terrainHeight, row)).rgb;
+    }
+    
+    // Slope (0 flat, 1 vertical) and lit brightness at this fragment
+    void terrainLighting(out float slope, out float shade);
+    
+    void main() {
+        // Biome indices can't be filtered; blend the colors of the four
+        // nearest texels instead, so borders don't show texel steps
+        ivec2 size = textureSize(biomeTexture, 0);
+        vec2 position = terrainUv * vec2(size - 1);
+        ivec2 base = ivec2(floor(position));
+        vec2 f = position - vec2(base);
+        vec3 color = mix(mix(biomeColor(base, size), biomeColor(base + ivec2(1, 0), size), f.x),
+                         mix(biomeColor(base + ivec2(0, 1), size), biomeColor(base + ivec2(1, 1), size), f.x), f.y);
+        
+        float slope, shade;
+        terrainLighting(slope, shade);
+        float rock = smoothstep(0.15, 0.35, slope) * step(landLevel, terrainHeight);
+        FragColor = vec4(mix(color, rockColor, rock) * shade, 1.0);
+    }
+)";
+
+// Mesh path lighting, per fragment from the field textures. Texel centers
+// sit on the mesh's vertices, so the layers filter between them like the
+// heights do. Must stay in sync with TerrainFields' encoding.
+const char* fieldLightingSource = R"(
+    uniform sampler2D fieldTextures[3];   // Normal x, normal z, occlusion per heightmap texel
+    uniform vec3 waterParams;             // waterLevel, transitionZone, waterDepthOffset
+    uniform vec4 lightParams;             // Sun direction, ambient share
+    
+    void terrainLighting(out float slope, out float shade) {
+        vec2 size = vec2(textureSize(fieldTextures[0], 0));
+        vec2 uv = (terrainUv * (size - 1.0) + 0.5) / size;
+        vec3 normal = vec3(texture(fieldTextures[0], uv).r, 0.0, texture(fieldTextures[1], uv).r);
+        normal.y = sqrt(max(0.0, 1.0 - dot(normal.xz, normal.xz)));
+        float occlusion = texture(fieldTextures[2], uv).r;
+        
+        // Flattened water is lit as level, open ground
+        if (terrainHeight < waterParams.x) {
+            normal = vec3(0.0, 1.0, 0.0);
+            occlusion = 1.0;
+        }
+        slope = 1.0 - normal.y;
+        shade = (lightParams.w + (1.0 - lightParams.w) * max(dot(normal, lightParams.xyz), 0.0)) * occlusion;
+    }
+)";
+
+// Displacement path lighting, interpolated from the vertex shader's normals
+const char* vertexLightingSource = R"(
+    in float terrainSlope;
+    in float terrainShade;
+    
+    void terrainLighting(out float slope, out float shade) {
+        slope = terrainSlope;
+        shade = terrainShade;
+    }
+)";
+
+// Tree shader: trees keep their baked per-vertex colors
+const char* treeVertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec3 aPos;
     layout (location = 1) in vec3 aColor;
@@ -39,7 +140,7 @@ const char* vertexShaderSource = R"(
     }
 )";
 
-const char* fragmentShaderSource = R"(
+const char* treeFragmentShaderSource = R"(
     #version 330 core
     in vec3 vertexColor;
     out vec4 FragColor;
@@ -49,12 +150,169 @@ const char* fragmentShaderSource = R"(
     }
 )";
 
+// Displacement shader: one shared index grid, no vertex buffer. Each vertex
+// derives its grid cell from gl_VertexID and reads its height from the
+// heightmap texture, so new terrain only needs a texture upload.
+const char* displacementVertexShaderSource = R"(
+    #version 330 core
+    
+    out float terrainHeight;
+    out float terrainSlope;
+    out float terrainShade;
+    out vec2 terrainUv;
+    
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    
+    uniform sampler2D heightTexture;
+    uniform ivec2 gridSize;   // Vertices per grid row / column
+    uniform int gridStep;     // Heightmap texels between grid vertices
+    uniform ivec2 mapSize;
+    uniform float horizontalScale;
+    uniform float verticalScale;
+    uniform vec3 waterParams; // waterLevel, transitionZone, waterDepthOffset
+    uniform vec4 lightParams; // Sun direction, ambient share
+    
+    // Must stay in sync with TerrainMeshBuilder::flattenWaterAreas
+    float flattenWaterAreas(float height) {
+        float flatLevel = waterParams.x - waterParams.z;
+        float t = clamp((height - waterParams.x) / waterParams.y, 0.0, 1.0);
+        float smoothT = t * t * (3.0 - 2.0 * t);
+        return height < waterParams.x ? flatLevel : mix(flatLevel, height, smoothT);
+    }
+    
+    void main() {
+        ivec2 cell = ivec2(gl_VertexID % gridSize.x, gl_VertexID / gridSize.x);
+        ivec2 texel = min(cell * gridStep, mapSize - 1);
+        float height = texelFetch(heightTexture, texel, 0).r;
+        
+        vec2 uv = vec2(texel) / vec2(mapSize - 1);
+        vec3 pos = vec3((uv.x * 2.0 - 1.0) * horizontalScale,
+                        flattenWaterAreas(height) * verticalScale,
+                        (uv.y * 2.0 - 1.0) * horizontalScale);
+        
+        gl_Position = projection * view * model * vec4(pos, 1.0);
+        terrainUv = uv;
+        terrainHeight = height;
+        
+        // Same central differences as TerrainFieldBuilder (no occlusion here)
+        float left = texelFetch(heightTexture, max(texel - ivec2(1, 0), ivec2(0)), 0).r;
+        float right = texelFetch(heightTexture, min(texel + ivec2(1, 0), mapSize - 1), 0).r;
+        float up = texelFetch(heightTexture, max(texel - ivec2(0, 1), ivec2(0)), 0).r;
+        float down = texelFetch(heightTexture, min(texel + ivec2(0, 1), mapSize - 1), 0).r;
+        float texelSpacing = 2.0 * horizontalScale / float(mapSize.x - 1);
+        vec2 gradient = vec2(right - left, down - up) * verticalScale / (2.0 * texelSpacing);
+        vec3 normal = normalize(vec3(-gradient.x, 1.0, -gradient.y));
+        
+        // Flattened water is lit as level ground
+        if (height < waterParams.x) normal = vec3(0.0, 1.0, 0.0);
+        terrainSlope = 1.0 - normal.y;
+        terrainShade = lightParams.w + (1.0 - lightParams.w) * max(dot(normal, lightParams.xyz), 0.0);
+    }
+)";
+
+// Number of texels in the terrain color lookup texture
+const int colorLookupSize = 1024;
+
+// Ground color of each biome at the bottom and top of the grass band, in
+// Biome order, and how far it reaches up into the mountain band. Grassland
+// keeps the original bands.
+const glm::vec3 biomeGroundColors[Biomes::count][2] = {
+    { glm::vec3(0.1f, 0.6f, 0.1f), glm::vec3(0.1f, 0.4f, 0.1f) },      // Grassland
+    { glm::vec3(0.08f, 0.45f, 0.1f), glm::vec3(0.05f, 0.32f, 0.08f) },  // Temperate forest
+    { glm::vec3(0.55f, 0.58f, 0.5f), glm::vec3(0.62f, 0.64f, 0.6f) },   // Tundra
+    { glm::vec3(0.12f, 0.35f, 0.22f), glm::vec3(0.1f, 0.28f, 0.2f) },   // Boreal forest
+    { glm::vec3(0.45f, 0.5f, 0.25f), glm::vec3(0.4f, 0.42f, 0.25f) },   // Shrubland
+    { glm::vec3(0.62f, 0.6f, 0.28f), glm::vec3(0.52f, 0.5f, 0.22f) },   // Savanna
+    { glm::vec3(0.85f, 0.75f, 0.5f), glm::vec3(0.8f, 0.66f, 0.45f) },   // Desert
+    { glm::vec3(0.05f, 0.5f, 0.15f), glm::vec3(0.03f, 0.38f, 0.1f) },   // Tropical forest
+};
+const float biomeMountainCover[Biomes::count] = { 0.0f, 0.5f, 0.6f, 0.5f, 0.4f, 0.4f, 0.7f, 0.5f };
+
+// Default upload budget for streamed terrain, in bytes per frame
+const size_t defaultUploadBudget = 4 * 1024 * 1024;
+
+std::unique_ptr<ChunkBatch> makeTerrainBatch() {
+    // Position + color lookup height
+    return std::unique_ptr<ChunkBatch>(new ChunkBatch(4, { { 0, 3, 0 }, { 1, 1, 3 } }));
+}
+
+std::unique_ptr<ChunkBatch> makeTreeBatch() {
+    // Position + color
+    return std::unique_ptr<ChunkBatch>(new ChunkBatch(6, { { 0, 3, 0 }, { 1, 3, 3 } }));
+}
+
+// Overwrite rebuilt chunks of an uploaded batch and hand their buffers back
+void updateChunks(ChunkBatch& batch, const std::vector<int>& chunks, std::vector<MeshChunk>& meshes) {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i] < batch.getChunkCount()) {
+            batch.updateChunk(chunks[i], meshes[i].vertices, meshes[i].indices, meshes[i].boundsMin, meshes[i].boundsMax);
+        }
+        // Every stroke rebuilds similar chunk sizes; keep the buffers
+        MeshChunkPool::instance().recycle(meshes[i]);
+    }
+}
+
+// Height texture format per heightmap storage. Texels upload in their
+// stored form; R16 fetches return the same [0, 1] heights as R32F.
+GLenum getHeightTextureFormat(HeightStorage storage) {
+    switch (storage) {
+        case HeightStorage::Float16: return GL_R16F;
+        case HeightStorage::UNorm16: return GL_R16;
+        default: return GL_R32F;
+    }
+}
+
+GLenum getHeightTexelType(HeightStorage storage) {
+    switch (storage) {
+        case HeightStorage::Float16: return GL_HALF_FLOAT;
+        case HeightStorage::UNorm16: return GL_UNSIGNED_SHORT;
+        default: return GL_FLOAT;
+    }
+}
+
+// Field layers in fieldTextures order. Normals are signed bytes and filter
+// as snorm; occlusion is unsigned.
+struct FieldLayerFormat {
+    GLenum internalFormat;
+    GLenum type;
+};
+const FieldLayerFormat fieldLayerFormats[] = {
+    { GL_R8_SNORM, GL_BYTE }, { GL_R8_SNORM, GL_BYTE }, { GL_R8, GL_UNSIGNED_BYTE }
+};
+
+const uint8_t* getFieldLayer(const TerrainFields& fields, int layer) {
+    switch (layer) {
+        case 0: return reinterpret_cast<const uint8_t*>(fields.normalX.data());
+        case 1: return reinterpret_cast<const uint8_t*>(fields.normalZ.data());
+        default: return fields.occlusion.data();
+    }
+}
+
 Renderer::Renderer() 
-    : window(nullptr), vao(0), vbo(0), ibo(0), shaderProgram(0),
+    : window(nullptr), shaderProgram(0),
+      terrainBatch(makeTerrainBatch()),
+      treeBatch(makeTreeBatch()),
+      treeShaderProgram(0),
+      colorLookupTexture(0), biomeTexture(0), fieldTextures{}, fieldTextureWidth(0), fieldTextureHeight(0),
+      renderMode(TerrainRenderMode::CpuMesh),
+      displacementProgram(0), heightTexture(0), gridVao(0), gridIbo(0),
+      gridIndicesCount(0), heightTextureWidth(0), heightTextureHeight(0),
+      heightTextureStorage(HeightStorage::Float32),
+      gridColumns(0), gridRows(0),
+      uploadBudget(defaultUploadBudget), progressivePreview(false), slopeDamping(0.0f),
+      heightStorage(HeightStorage::Float32), noiseLayers(1, NoiseType::Perlin),
+      pendingTerrainChunk(0), pendingTreeChunk(0),
+      pendingIndicesNext(false), pendingTextureRow(0), pendingFieldRow(0),
+      sculptBrush{ BrushMode::Raise, 8.0f, 0.25f, 0.0f, 8.0f },
+      sculpting(false), undoKeyDown(false), redoKeyDown(false), sourceRequestId(0),
+      maxMeshError(0.0f), gridStep(0), streamingRequest(), shownRequestId(0), remeshDirty{ 0, 0, 0, 0 },
+      frameTimerQueries{}, frameTimerIndex(0), frameTimersIssued(0), frameTimerRunning(false),
+      frameStartTime(0.0), gpuFrameMs(0.0f),
       camera(glm::vec3(0.0f, 10.0f, 5.0f)), // x, z, y postion of camera inital
       lastFrame(0.0f),
       deltaTime(0.0f),
-      totalIndicesCount(0),
       triangleStepSize(1) {} // Initialize with a reasonable default of 1
 
 Renderer::~Renderer() {
@@ -96,12 +354,46 @@ bool Renderer::initialize(int width, int height, const std::string& title) {
 #endif
     
     // Create and compile shaders
-    shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    std::string meshFragmentSource = std::string(fragmentShaderSource) + fieldLightingSource;
+    shaderProgram = createShaderProgram(vertexShaderSource, meshFragmentSource.c_str());
     if (shaderProgram == 0) {
         std::cerr << "Failed to create shader program" << std::endl;
         return false;
     }
     
+    treeShaderProgram = createShaderProgram(treeVertexShaderSource, treeFragmentShaderSource);
+    if (treeShaderProgram == 0) {
+        std::cerr << "Failed to create tree shader program" << std::endl;
+        return false;
+    }
+    
+    std::string displacementFragmentSource = std::string(fragmentShaderSource) + vertexLightingSource;
+    displacementProgram = createShaderProgram(displacementVertexShaderSource, displacementFragmentSource.c_str());
+    if (displacementProgram == 0) {
+        std::cerr << "Failed to create displacement shader program" << std::endl;
+        return false;
+    }
+    
+    // Terrain streams in across frames; pace them to the display
+    glfwSwapInterval(1);
+    
+    // Staging memory for streamed uploads
+    uploadRing.initialize();
+    
+    // GPU frame timers for the frame budget
+    glGenQueries(frameTimerCount, frameTimerQueries);
+    
+    // Look uniforms up once instead of every frame
+    cacheUniforms(shaderProgram, terrainUniforms);
+    cacheUniforms(treeShaderProgram, treeUniforms);
+    cacheUniforms(displacementProgram, displacementUniforms);
+    
+    // Bake the height band table into the color lookup texture
+    rebuildColorLookup();
+    
+    // Until terrain with climate streams in, everything is grassland
+    uploadBiomeTexture(nullptr);
+    
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
     
@@ -113,19 +405,450 @@ bool Renderer::shouldClose() {
 }
 
 void Renderer::renderTerrain(const HeightMap& heightMap) {
+    beginFrameTimer();
+    
     // Clear the screen
     glClearColor(0.392f, 0.584f, 0.929f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    // Set up terrain mesh if needed
-    if (vao == 0) {
+    if (renderMode == TerrainRenderMode::GpuDisplacement) {
+        // Heights live in a texture; the grid only depends on the map size
+        if (heightTexture == 0) {
+            uploadHeightTexture(heightMap);
+        }
+        if (gridVao == 0) {
+            setupDisplacementGrid(heightMap.getWidth(), heightMap.getHeight());
+        }
+    } else if (!terrainBatch->isUploaded()) {
+        // Set up terrain mesh if needed
         setupTerrainMesh(heightMap);
     }
     
+    if (!treeBatch->isUploaded()) {
+        setupTreeMesh(heightMap);
+    }
+    
     // Render the mesh
     renderMesh();
 }
 
+int Renderer::requestTerrain(int width, int height, float scale, int octaves, float persistence, float lacunarity) {
+    if (!streamer) {
+        streamer.reset(new TerrainStreamer());
+    }
+    
+    TerrainRequest request;
+    request.originX = 0;
+    request.originY = 0;
+    request.width = width;
+    request.height = height;
+    request.scale = scale;
+    request.octaves = octaves;
+    request.persistence = persistence;
+    request.lacunarity = lacunarity;
+    request.triangleStepSize = getDetailStepSize();
+    request.maxMeshError = getDetailMeshError();
+    request.treeDensity = getDetailTreeDensity();
+    // The displacement path only needs the heightmap and trees
+    request.buildTerrainMesh = renderMode == TerrainRenderMode::CpuMesh;
+    request.progressive = progressivePreview;
+    request.erosion = erosion;
+    request.thermalErosion = thermalErosion;
+    request.slopeDamping = slopeDamping;
+    request.heightStorage = heightStorage;
+    request.noiseLayers = noiseLayers;
+    request.shape = terrainShape;
+    request.climate = climate;
+    
+    int id = streamer->request(request);
+    if (id >= 0) {
+        request.id = id;
+        streamingRequest = request;
+    }
+    return id;
+}
+
+void Renderer::renderFrame() {
+    beginFrameTimer();
+    
+    // Clear the screen
+    glClearColor(0.392f, 0.584f, 0.929f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    
+    pumpStreaming();
+    
+    renderMesh();
+}
+
+// Move finished terrain from the streamer onto the GPU, a budget's worth per
+// frame. The old terrain keeps drawing until the new one is complete.
+void Renderer::pumpStreaming() {
+    if (!streamer) return;
+    
+    uploadRing.beginFrame(uploadBudget);
+    
+    if (!pendingTerrain) {
+        pendingTerrain = streamer->poll();
+        if (pendingTerrain) {
+            beginPendingTerrain();
+        }
+    }
+    
+    if (pendingTerrain &&
+        uploadPendingHeightRows() &&
+        uploadPendingFieldRows() &&
+        uploadPendingChunks(*pendingTerrainBatch, pendingTerrain->terrainChunks, pendingTerrainChunk) &&
+        uploadPendingChunks(*pendingTreeBatch, pendingTerrain->treeChunks, pendingTreeChunk)) {
+        // Swapping in the new batches frees the old terrain's buffers
+        terrainBatch = std::move(pendingTerrainBatch);
+        treeBatch = std::move(pendingTreeBatch);
+        terrainFields = std::move(pendingTerrain->fields);
+        
+        // The builder keeps the settings of the meshes on screen
+        meshBuilder.setTriangleStepSize(pendingTerrain->triangleStepSize);
+        meshBuilder.setMaxMeshError(pendingTerrain->maxMeshError);
+        meshBuilder.setTreeDensity(pendingTerrain->treeDensity);
+        
+        if (pendingTerrain->remeshed) {
+            // Same heightmap, editor and pyramid; the meshes were built
+            // before the latest strokes, so catch them up with those
+            HeightMapRect dirty = remeshDirty;
+            remeshDirty = { 0, 0, 0, 0 };
+            updateHeightRegion(*streamedHeightMap, dirty);
+        } else {
+            // The editor refers to the old heightmap; start over on the new one.
+            // Strokes deferred for the old one go with it.
+            editor.reset();
+            sculpting = false;
+            deferredSculpt.clear();
+            sourceRequestId = 0;
+            streamedHeightMap = std::move(pendingTerrain->heightMap);
+            streamedPyramid = std::move(pendingTerrain->pyramid);
+            editor.reset(new TerrainEditor(*streamedHeightMap));
+            sculptBrush.radius = std::max(4.0f, streamedHeightMap->getWidth() / 32.0f);
+            uploadBiomeTexture(pendingTerrain->climate.get());
+        }
+        
+        if (pendingTerrain->level == pendingTerrain->levelCount - 1) {
+            shownRequestId = pendingTerrain->requestId;
+        }
+        pendingTerrain.reset();
+        
+        // The detail level may have moved while this terrain was in flight
+        if (needsRemesh()) {
+            remeshTerrain();
+        }
+    }
+    
+    uploadRing.endFrame();
+}
+
+void Renderer::beginPendingTerrain() {
+    const HeightMap& heightMap = pendingTerrain->remeshed ? *streamedHeightMap : *pendingTerrain->heightMap;
+    
+    if (pendingTerrain->levelCount > 1) {
+        std::cout << "Terrain preview level " << pendingTerrain->level + 1 << "/" << pendingTerrain->levelCount
+                  << " (" << heightMap.getWidth() << "x" << heightMap.getHeight() << ")" << std::endl;
+    }
+    
+    if (pendingTerrain->terrainStats.triangleCount > 0 && pendingTerrain->maxMeshError > 0.0f) {
+        logOptimization("Adaptive terrain mesh", pendingTerrain->terrainStats);
+    }
+    if (pendingTerrain->treeStats.triangleCount > 0) {
+        logOptimization("Tree mesh", pendingTerrain->treeStats);
+    }
+    
+    // Size the new batches once and reserve every chunk (chunk i gets id i)
+    pendingTerrainBatch = makeTerrainBatch();
+    pendingTreeBatch = makeTreeBatch();
+    
+    const std::vector<MeshChunk>* chunkLists[2] = { &pendingTerrain->terrainChunks, &pendingTerrain->treeChunks };
+    ChunkBatch* batches[2] = { pendingTerrainBatch.get(), pendingTreeBatch.get() };
+    for (int i = 0; i < 2; ++i) {
+        size_t vertexFloats = 0;
+        size_t indexCount = 0;
+        for (const MeshChunk& chunk : *chunkLists[i]) {
+            vertexFloats += chunk.vertices.size();
+            indexCount += chunk.indices.size();
+        }
+        // Empty tree chunks are kept: sculpting can grow trees in them
+        if (chunkLists[i]->empty()) continue;
+        
+        batches[i]->allocate(vertexFloats, indexCount);
+        for (const MeshChunk& chunk : *chunkLists[i]) {
+            batches[i]->reserveChunk(chunk.vertices.size(), chunk.indices.size(), chunk.boundsMin, chunk.boundsMax);
+        }
+    }
+    
+    pendingTerrainChunk = 0;
+    pendingTreeChunk = 0;
+    pendingIndicesNext = false;
+    
+    if (renderMode == TerrainRenderMode::GpuDisplacement && !pendingTerrain->remeshed) {
+        // Rows stream straight into the live texture; only a resize or a
+        // storage change reallocates
+        bool resized = heightTexture == 0 || heightMap.getWidth() != heightTextureWidth ||
+                       heightMap.getHeight() != heightTextureHeight;
+        if (resized || heightMap.getStorage() != heightTextureStorage) {
+            allocateHeightTexture(heightMap.getWidth(), heightMap.getHeight(), heightMap.getStorage());
+        }
+        if (resized) {
+            releaseBuffers(gridVao, gridIbo);
+            setupDisplacementGrid(heightMap.getWidth(), heightMap.getHeight());
+        }
+        pendingTextureRow = 0;
+    } else {
+        pendingTextureRow = heightMap.getHeight();
+    }
+    
+    // The mesh path lights fragments from the fields. Remeshed terrain keeps
+    // the textures already drawn, which sculpting has kept current.
+    const TerrainFields* fields = pendingTerrain->fields.get();
+    if (renderMode == TerrainRenderMode::CpuMesh && fields && !pendingTerrain->remeshed) {
+        if (fieldTextures[0] == 0 || fields->width != fieldTextureWidth || fields->height != fieldTextureHeight) {
+            allocateFieldTextures(fields->width, fields->height);
+        }
+        pendingFieldRow = 0;
+    } else {
+        pendingFieldRow = fields ? fieldLayerCount * fields->height : 0;
+    }
+}
+
+// Upload chunks in order until the frame budget runs out. Returns true once
+// every chunk is on the GPU.
+bool Renderer::uploadPendingChunks(ChunkBatch& batch, const std::vector<MeshChunk>& chunks, size_t& cursor) {
+    while (cursor < chunks.size()) {
+        const MeshChunk& chunk = chunks[cursor];
+        int id = static_cast<int>(cursor);
+        
+        if (!pendingIndicesNext) {
+            if (!uploadRing.uploadBuffer(batch.getVertexBuffer(), batch.getVertexOffsetBytes(id),
+                                         chunk.vertices.data(), chunk.vertices.size() * sizeof(float))) {
+                return false;
+            }
+            pendingIndicesNext = true;
+        }
+        
+        if (!uploadRing.uploadBuffer(batch.getIndexBuffer(), batch.getIndexOffsetBytes(id),
+                                     chunk.indices.data(), chunk.indices.size() * sizeof(unsigned int))) {
+            return false;
+        }
+        pendingIndicesNext = false;
+        
+        batch.markChunkReady(id);
+        ++cursor;
+    }
+    return true;
+}
+
+// Upload the height texture for the displacement path in row bands
+bool Renderer::uploadPendingHeightRows() {
+    // Remeshed terrain keeps the texture already drawn
+    if (!pendingTerrain->heightMap) return true;
+    
+    const HeightMap& heightMap = *pendingTerrain->heightMap;
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    
+    // Bands of about a quarter of the budget so chunks can share the frame;
+    // 16-bit maps fit twice the rows
+    size_t texelBytes = HeightMap::getTexelBytes(heightMap.getStorage());
+    size_t rowBytes = static_cast<size_t>(mapWidth) * texelBytes;
+    int bandRows = static_cast<int>(std::max<size_t>(1, uploadBudget / 4 / rowBytes));
+    
+    while (pendingTextureRow < mapHeight) {
+        int rows = std::min(bandRows, mapHeight - pendingTextureRow);
+        const unsigned char* data = static_cast<const unsigned char*>(heightMap.getRawData()) + pendingTextureRow * rowBytes;
+        if (!uploadRing.uploadTextureRows(heightTexture, pendingTextureRow, mapWidth, rows, data,
+                                          getHeightTexelType(heightMap.getStorage()), texelBytes)) {
+            return false;
+        }
+        pendingTextureRow += rows;
+    }
+    return true;
+}
+
+// Upload the field textures for the mesh path in row bands, a layer at a time
+bool Renderer::uploadPendingFieldRows() {
+    if (!pendingTerrain->fields) return true;
+    
+    const TerrainFields& fields = *pendingTerrain->fields;
+    int bandRows = static_cast<int>(std::max<size_t>(1, uploadBudget / 4 / fields.width));
+    
+    while (pendingFieldRow < fieldLayerCount * fields.height) {
+        int layer = pendingFieldRow / fields.height;
+        int row = pendingFieldRow % fields.height;
+        int rows = std::min(bandRows, fields.height - row);
+        if (!uploadRing.uploadTextureRows(fieldTextures[layer], row, fields.width, rows,
+                                          getFieldLayer(fields, layer) + fields.index(0, row),
+                                          fieldLayerFormats[layer].type, 1)) {
+            return false;
+        }
+        pendingFieldRow += rows;
+    }
+    return true;
+}
+
+void Renderer::setRenderMode(TerrainRenderMode mode) {
+    renderMode = mode;
+}
+
+void Renderer::setMaxMeshError(float maxError) {
+    maxMeshError = maxError;
+    applyDetail();
+}
+
+void Renderer::setTriangleStepSize(int stepSize) {
+    triangleStepSize = stepSize > 0 ? stepSize : 1;
+    applyDetail();
+}
+
+void Renderer::setFrameBudget(const FrameBudgetSettings& settings) {
+    governor.setSettings(settings);
+    applyDetail();
+}
+
+int Renderer::getDetailStepSize() const {
+    return std::max(1, triangleStepSize) * governor.getDetail().stepMultiplier;
+}
+
+float Renderer::getDetailMeshError() const {
+    return maxMeshError * governor.getDetail().meshErrorScale;
+}
+
+float Renderer::getDetailTreeDensity() const {
+    return governor.getDetail().treeDensity;
+}
+
+void Renderer::applyDetail() {
+    // One index buffer, quick enough to swap between two frames
+    if (gridVao != 0 && gridStep != getDetailStepSize()) {
+        releaseBuffers(gridVao, gridIbo);
+        setupDisplacementGrid(heightTextureWidth, heightTextureHeight);
+    }
+    
+    if (needsRemesh()) {
+        remeshTerrain();
+    }
+}
+
+// Whether the meshes on screen were built with other settings than the
+// current detail asks for
+bool Renderer::needsRemesh() const {
+    if (!terrainBatch->isUploaded() && !treeBatch->isUploaded()) return false;
+    
+    if (meshBuilder.getTreeDensity() != getDetailTreeDensity()) return true;
+    return renderMode == TerrainRenderMode::CpuMesh &&
+           (meshBuilder.getTriangleStepSize() != getDetailStepSize() ||
+            meshBuilder.getMaxMeshError() != getDetailMeshError());
+}
+
+// Rebuild the terrain and tree meshes at the current detail. Streamed
+// terrain is remeshed in the background from its shared heightmap, and the
+// old meshes draw until the new ones are uploaded.
+void Renderer::remeshTerrain() {
+    if (!streamer) {
+        // renderTerrain rebuilds them on the next frame
+        releaseTerrainMesh();
+        treeBatch->release();
+        return;
+    }
+    
+    // Terrain still streaming in picks up the detail once it lands
+    if (!streamedHeightMap || shownRequestId != streamingRequest.id) return;
+    
+    TerrainRequest request = streamingRequest;
+    request.progressive = false;
+    request.triangleStepSize = getDetailStepSize();
+    request.maxMeshError = getDetailMeshError();
+    request.treeDensity = getDetailTreeDensity();
+    request.source = streamedHeightMap;
+    
+    int id = streamer->request(request);
+    if (id < 0) return;
+    
+    request.id = id;
+    request.source.reset();
+    streamingRequest = request;
+    sourceRequestId = id;
+    remeshDirty = { 0, 0, 0, 0 };
+}
+
+void Renderer::updateHeightMap(const HeightMap& heightMap) {
+    if (renderMode == TerrainRenderMode::GpuDisplacement) {
+        // A texture sub-upload replaces the whole CPU mesh rebuild. The upload
+        // takes on the new size, so compare against the old one first.
+        bool resized = heightMap.getWidth() != heightTextureWidth || heightMap.getHeight() != heightTextureHeight;
+        uploadHeightTexture(heightMap);
+        if (resized) {
+            releaseBuffers(gridVao, gridIbo);
+            setupDisplacementGrid(heightMap.getWidth(), heightMap.getHeight());
+        }
+    } else {
+        releaseTerrainMesh();
+    }
+    
+    // Fields belong to the old heights
+    terrainFields.reset();
+    
+    // Tree placement follows the terrain, rebuild it on the next frame
+    treeBatch->release();
+}
+
+void Renderer::updateHeightRegion(const HeightMap& heightMap, const HeightMapRect& rect) {
+    if (rect.isEmpty()) return;
+    
+    if (renderMode == TerrainRenderMode::GpuDisplacement) {
+        if (heightTexture == 0 || heightMap.getWidth() != heightTextureWidth || heightMap.getHeight() != heightTextureHeight) {
+            uploadHeightTexture(heightMap);
+            return;
+        }
+        
+        // Upload just the rect, reading rows out of the full map. Sculpting
+        // widens the map to floats; GL narrows them into a 16-bit texture.
+        size_t texelBytes = HeightMap::getTexelBytes(heightMap.getStorage());
+        const unsigned char* data = static_cast<const unsigned char*>(heightMap.getRawData()) +
+                                    (static_cast<size_t>(rect.y0) * heightMap.getWidth() + rect.x0) * texelBytes;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, static_cast<GLint>(texelBytes));
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, heightMap.getWidth());
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0, GL_RED,
+                        getHeightTexelType(heightMap.getStorage()), data);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    
+    bool meshUploaded = renderMode == TerrainRenderMode::CpuMesh && terrainBatch->isUploaded();
+    if (!meshUploaded && !treeBatch->isUploaded()) return;
+    
+    // Fields read the heights around the edit too, so they change further
+    // out; the mesh is lit from them, so those texels are uploaded again
+    HeightMapRect changed = { 0, 0, heightMap.getWidth(), heightMap.getHeight() };
+    if (terrainFields && terrainFields->width == heightMap.getWidth() && terrainFields->height == heightMap.getHeight()) {
+        changed = meshBuilder.updateFields(heightMap, rect, *terrainFields);
+    } else {
+        updateTerrainFields(heightMap);
+    }
+    
+    // Terrain vertices hold only heights, so just the chunks under the edit
+    // change, adaptive ones included; an adaptive chunk that grows moves
+    // within the batch
+    if (meshUploaded) {
+        uploadFieldTextures(*terrainFields, changed);
+        
+        std::vector<int> chunks = meshBuilder.getTerrainChunksInRect(heightMap, rect);
+        std::vector<MeshChunk> meshes = meshBuilder.rebuildTerrainChunks(heightMap, chunks);
+        updateChunks(*terrainBatch, chunks, meshes);
+    }
+    
+    // Trees follow the ground up and down, and come and go with its slope
+    if (treeBatch->isUploaded()) {
+        std::vector<int> chunks = meshBuilder.getTreeChunksInRect(heightMap, changed);
+        std::vector<MeshChunk> meshes = meshBuilder.rebuildTreeChunks(heightMap, *terrainFields, chunks);
+        updateChunks(*treeBatch, chunks, meshes);
+    }
+}
+
 void Renderer::update() {
     // Calculate delta time
     float currentFrame = glfwGetTime();
@@ -135,26 +858,95 @@ void Renderer::update() {
     // Handle input
     handleInput(deltaTime);
     
+    // Judge the frame by its work, measured before the swap waits for vsync
+    if (governor.update(deltaTime, endFrameTimer())) {
+        std::cout << "Frame budget: " << governor.getAverageFrameMs() << " ms average against "
+                  << governor.getSettings().targetFrameMs << " ms, detail level " << governor.getLevel() + 1
+                  << "/" << FrameGovernor::getLevelCount() << std::endl;
+        applyDetail();
+    }
+    
     // Swap buffers and poll events
     glfwSwapBuffers(window);
     glfwPollEvents();
 }
 
+void Renderer::beginFrameTimer() {
+    frameStartTime = glfwGetTime();
+    if (frameTimerQueries[0] == 0 || frameTimerRunning) return;
+    
+    // The oldest query in the ring was issued frameTimerCount frames ago and
+    // is normally done by now; reading it then never stalls the pipeline
+    unsigned int query = frameTimerQueries[frameTimerIndex];
+    if (frameTimersIssued >= frameTimerCount) {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            gpuFrameMs = static_cast<float>(elapsed / 1.0e6);
+        }
+    }
+    
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    frameTimerRunning = true;
+}
+
+float Renderer::endFrameTimer() {
+    if (frameTimerRunning) {
+        glEndQuery(GL_TIME_ELAPSED);
+        frameTimerRunning = false;
+        frameTimerIndex = (frameTimerIndex + 1) % frameTimerCount;
+        ++frameTimersIssued;
+    }
+    
+    // GPU time lags a few frames behind; a slow GPU shows up all the same
+    float cpuMs = static_cast<float>((glfwGetTime() - frameStartTime) * 1000.0);
+    return std::max(cpuMs, gpuFrameMs);
+}
+
 void Renderer::cleanup() {
+    // Stop the worker threads before any GL object goes away
+    if (streamer) {
+        streamer->stop();
+        streamer.reset();
+    }
+    pendingTerrain.reset();
+    pendingTerrainBatch.reset();
+    pendingTreeBatch.reset();
+    uploadRing.release();
+    
     // Delete OpenGL resources
-    if (vao != 0) {
-        glDeleteVertexArrays(1, &vao);
-        vao = 0;
+    if (frameTimerQueries[0] != 0) {
+        glDeleteQueries(frameTimerCount, frameTimerQueries);
+        std::fill(frameTimerQueries, frameTimerQueries + frameTimerCount, 0u);
     }
+    frameTimerRunning = false;
     
-    if (vbo != 0) {
-        glDeleteBuffers(1, &vbo);
-        vbo = 0;
+    releaseTerrainMesh();
+    treeBatch->release();
+    releaseBuffers(gridVao, gridIbo);
+    
+    if (colorLookupTexture != 0) {
+        glDeleteTextures(1, &colorLookupTexture);
+        colorLookupTexture = 0;
+    }
+    
+    if (biomeTexture != 0) {
+        glDeleteTextures(1, &biomeTexture);
+        biomeTexture = 0;
     }
     
-    if (ibo != 0) {
-        glDeleteBuffers(1, &ibo);
-        ibo = 0;
+    if (heightTexture != 0) {
+        glDeleteTextures(1, &heightTexture);
+        heightTexture = 0;
+    }
+    
+    if (fieldTextures[0] != 0) {
+        glDeleteTextures(fieldLayerCount, fieldTextures);
+        std::fill(fieldTextures, fieldTextures + fieldLayerCount, 0u);
+        fieldTextureWidth = 0;
+        fieldTextureHeight = 0;
     }
     
     if (shaderProgram != 0) {
@@ -162,6 +954,16 @@ void Renderer::cleanup() {
         shaderProgram = 0;
     }
     
+    if (treeShaderProgram != 0) {
+        glDeleteProgram(treeShaderProgram);
+        treeShaderProgram = 0;
+    }
+    
+    if (displacementProgram != 0) {
+        glDeleteProgram(displacementProgram);
+        displacementProgram = 0;
+    }
+    
     // Clean up GLFW
     if (window) {
         glfwDestroyWindow(window);
@@ -171,37 +973,48 @@ void Renderer::cleanup() {
     glfwTerminate();
 }
 
-// Helper function to flatten water areas
-float Renderer::flattenWaterAreas(float height) const {
-    // Define a higher water level to make more terrain underwater
-    const float waterLevel = 0.3f;  // Changed from 0.0f to make more terrain underwater
-    const float transitionZone = 0.2f;
-    const float waterDepthOffset = 0.03f;  // Smaller offset for a more subtle effect
-    
-    if (height < waterLevel) {
-        // All underwater terrain gets flattened to a constant level
-        return waterLevel - waterDepthOffset;
-    } 
-    else if (height < waterLevel + transitionZone) {
-        // Transition zone - gradually blend from flat to original height
-        float t = (height - waterLevel) / transitionZone;
-        float smoothT = t * t * (3.0f - 2.0f * t); // Smooth interpolation
-        return (waterLevel - waterDepthOffset) * (1.0f - smoothT) + height * smoothT;
+void Renderer::releaseTerrainMesh() {
+    terrainBatch->release();
+}
+
+void Renderer::releaseBuffers(unsigned int& vertexArray, unsigned int& buffer) {
+    if (vertexArray != 0) {
+        glDeleteVertexArrays(1, &vertexArray);
+        vertexArray = 0;
     }
     
-    // Above water transition zone - leave unchanged
-    return height;
+    if (buffer != 0) {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+}
+
+void Renderer::cacheUniforms(unsigned int program, ProgramUniforms& uniforms) {
+    uniforms.model = glGetUniformLocation(program, "model");
+    uniforms.view = glGetUniformLocation(program, "view");
+    uniforms.projection = glGetUniformLocation(program, "projection");
+    uniforms.colorLookup = glGetUniformLocation(program, "colorLookup");
+    uniforms.biomeTexture = glGetUniformLocation(program, "biomeTexture");
+    uniforms.fieldTextures = glGetUniformLocation(program, "fieldTextures");
+    uniforms.heightTexture = glGetUniformLocation(program, "heightTexture");
+    uniforms.gridSize = glGetUniformLocation(program, "gridSize");
+    uniforms.gridStep = glGetUniformLocation(program, "gridStep");
+    uniforms.mapSize = glGetUniformLocation(program, "mapSize");
+    uniforms.horizontalScale = glGetUniformLocation(program, "horizontalScale");
+    uniforms.verticalScale = glGetUniformLocation(program, "verticalScale");
+    uniforms.waterParams = glGetUniformLocation(program, "waterParams");
+    uniforms.lightParams = glGetUniformLocation(program, "lightParams");
 }
 
 // Get terrain color based on height
-glm::vec3 Renderer::getTerrainColor(float height) const {
+glm::vec3 Renderer::getTerrainColor(float height, Biome biome) const {
     // Define terrain thresholds - updated to match new water level
     const float waterLevel = 0.1f;  // Must match the water level in flattenWaterAreas
     const float sandLevel = 0.3f;
     const float grassLevel = 0.35f;
     const float rockLevel = 0.4f;
     const float snowLevel = 0.7f;
-
+    
     // Map height to color
     if (height < waterLevel) {
         // Deep water - dark blue
@@ -215,32 +1028,22 @@ glm::vec3 Renderer::getTerrainColor(float height) const {
         float t = (height - sandLevel) / (grassLevel - sandLevel);
         return glm::vec3(0.76f, 0.7f, 0.5f);
     } else if (height < rockLevel) {
-        // Grass/forest - green
+        // Grass/forest - the biome's ground cover
         float t = (height - grassLevel) / (rockLevel - grassLevel);
-        return glm::mix(glm::vec3(0.1f, 0.6f, 0.1f), glm::vec3(0.1f, 0.4f, 0.1f), t);
+        const glm::vec3* ground = biomeGroundColors[static_cast<int>(biome)];
+        return glm::mix(ground[0], ground[1], t);
     } else if (height < snowLevel) {
         // Rock/mountain - gray/brown with directional lighting
         float t = (height - rockLevel) / (snowLevel - rockLevel);
         
-        // Base mountain color 
+        // Base mountain color; lighting comes from the terrain's real
+        // normals and occlusion in the shader
         //glm::vec3 baseColor = glm::mix(glm::vec3(0.35f, 0.28f, 0.21f), glm::vec3(0.35f, 0.35f, 0.35f), t); //darker
-        glm::vec3 baseColor = glm::mix(glm::vec3(0.5f, 0.4f, 0.3f), glm::vec3(0.5f, 0.5f, 0.5f), t); //lighter
-        
-        // Apply directional lighting based on height
-        // This creates a simple shading effect where higher parts appear brighter
-        float lightIntensity = 0.6f + 0.4f * ((height - rockLevel) / (snowLevel - rockLevel));
-        
-        // Add variation based on position (creates ridge-like lighting)
-        // This simulates light coming from one direction
-        float xVariation = sin(height * 20.0f) * 0.15f;
-        float zVariation = cos(height * 15.0f) * 0.15f;
-        lightIntensity += xVariation + zVariation;
+        glm::vec3 rock = glm::mix(glm::vec3(0.5f, 0.4f, 0.3f), glm::vec3(0.5f, 0.5f, 0.5f), t); //lighter
         
-        // Clamp light intensity to reasonable range
-        lightIntensity = glm::clamp(lightIntensity, 0.5f, 1.0f);
-        
-        // Apply lighting to base color
-        return baseColor * lightIntensity;
+        // Ground cover thins out up the slopes
+        float cover = biomeMountainCover[static_cast<int>(biome)] * (1.0f - t) * (1.0f - t);
+        return glm::mix(rock, biomeGroundColors[static_cast<int>(biome)][1], cover);
     } else {
         // Snow - white
         float t = std::min((height - snowLevel) * 2.0f, 1.0f);
@@ -248,472 +1051,260 @@ glm::vec3 Renderer::getTerrainColor(float height) const {
     }
 }
 
-// Add triangular trees to vertices and indices arrays at specified position
-void Renderer::addTreeAt(std::vector<float>& vertices, std::vector<unsigned int>& indices, 
-                        float x, float y, float z, float scale, int& vertexCount) {
-    // Tree colors - dark to light green
-    glm::vec3 darkGreen(0.0f, 0.25f, 0.0f);   // Darker
-    glm::vec3 midGreen(0.0f, 0.3f, 0.0f);  // Darker
-    glm::vec3 lightGreen(0.0f, 0.35f, 0.0f); // Darker
-    
-    float treeHeight = 0.8f * scale;
-    float baseWidth = 0.2f * scale;
-    
-    // Tree trunk (brown)
-    float trunkHeight = 0.2f * scale;
-    glm::vec3 brown(0.45f, 0.30f, 0.15f);
-    
-    // Add trunk vertices
-    // Base of trunk
-    vertices.push_back(x - 0.05f * scale);  // x
-    vertices.push_back(y);                  // y
-    vertices.push_back(z - 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x + 0.05f * scale);  // x
-    vertices.push_back(y);                  // y
-    vertices.push_back(z - 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x + 0.05f * scale);  // x
-    vertices.push_back(y);                  // y
-    vertices.push_back(z + 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x - 0.05f * scale);  // x
-    vertices.push_back(y);                  // y
-    vertices.push_back(z + 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    // Top of trunk
-    vertices.push_back(x - 0.05f * scale);  // x
-    vertices.push_back(y + trunkHeight);    // y
-    vertices.push_back(z - 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x + 0.05f * scale);  // x
-    vertices.push_back(y + trunkHeight);    // y
-    vertices.push_back(z - 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x + 0.05f * scale);  // x
-    vertices.push_back(y + trunkHeight);    // y
-    vertices.push_back(z + 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    vertices.push_back(x - 0.05f * scale);  // x
-    vertices.push_back(y + trunkHeight);    // y
-    vertices.push_back(z + 0.05f * scale);  // z
-    vertices.push_back(brown.r);            // r
-    vertices.push_back(brown.g);            // g
-    vertices.push_back(brown.b);            // b
-    
-    // Trunk indices
-    unsigned int trunkBase = vertexCount;
-    
-    // Front face
-    indices.push_back(trunkBase);
-    indices.push_back(trunkBase + 1);
-    indices.push_back(trunkBase + 5);
-    
-    indices.push_back(trunkBase);
-    indices.push_back(trunkBase + 5);
-    indices.push_back(trunkBase + 4);
-    
-    // Right face
-    indices.push_back(trunkBase + 1);
-    indices.push_back(trunkBase + 2);
-    indices.push_back(trunkBase + 6);
-    
-    indices.push_back(trunkBase + 1);
-    indices.push_back(trunkBase + 6);
-    indices.push_back(trunkBase + 5);
-    
-    // Back face
-    indices.push_back(trunkBase + 2);
-    indices.push_back(trunkBase + 3);
-    indices.push_back(trunkBase + 7);
-    
-    indices.push_back(trunkBase + 2);
-    indices.push_back(trunkBase + 7);
-    indices.push_back(trunkBase + 6);
-    
-    // Left face
-    indices.push_back(trunkBase + 3);
-    indices.push_back(trunkBase);
-    indices.push_back(trunkBase + 4);
-    
-    indices.push_back(trunkBase + 3);
-    indices.push_back(trunkBase + 4);
-    indices.push_back(trunkBase + 7);
-    
-    vertexCount += 8;
-    
-    // Tree foliage (green triangular pyramids stacked)
-    // First layer (bottom)
-    float baseY = y + trunkHeight;
-    
-    // Bottom pyramid apex
-    vertices.push_back(x);                  // x
-    vertices.push_back(baseY + treeHeight * 0.6f); // y
-    vertices.push_back(z);                  // z
-    vertices.push_back(darkGreen.r);        // r
-    vertices.push_back(darkGreen.g);        // g
-    vertices.push_back(darkGreen.b);        // b
-    
-    // Bottom pyramid base vertices
-    vertices.push_back(x - baseWidth);      // x
-    vertices.push_back(baseY);              // y
-    vertices.push_back(z - baseWidth);      // z
-    vertices.push_back(darkGreen.r);        // r
-    vertices.push_back(darkGreen.g);        // g
-    vertices.push_back(darkGreen.b);        // b
-    
-    vertices.push_back(x + baseWidth);      // x
-    vertices.push_back(baseY);              // y
-    vertices.push_back(z - baseWidth);      // z
-    vertices.push_back(darkGreen.r);        // r
-    vertices.push_back(darkGreen.g);        // g
-    vertices.push_back(darkGreen.b);        // b
-    
-    vertices.push_back(x + baseWidth);      // x
-    vertices.push_back(baseY);              // y
-    vertices.push_back(z + baseWidth);      // z
-    vertices.push_back(darkGreen.r);        // r
-    vertices.push_back(darkGreen.g);        // g
-    vertices.push_back(darkGreen.b);        // b
-    
-    vertices.push_back(x - baseWidth);      // x
-    vertices.push_back(baseY);              // y
-    vertices.push_back(z + baseWidth);      // z
-    vertices.push_back(darkGreen.r);        // r
-    vertices.push_back(darkGreen.g);        // g
-    vertices.push_back(darkGreen.b);        // b
-    
-    // Add lower pyramid triangles
-    unsigned int lowerPyramidBase = vertexCount;
-    unsigned int lowerPyramidApex = lowerPyramidBase;
-    unsigned int lowerPyramidBottomLeft = lowerPyramidBase + 1;
-    unsigned int lowerPyramidBottomRight = lowerPyramidBase + 2;
-    unsigned int lowerPyramidTopRight = lowerPyramidBase + 3;
-    unsigned int lowerPyramidTopLeft = lowerPyramidBase + 4;
-    
-    // Four faces of the pyramid
-    indices.push_back(lowerPyramidApex);
-    indices.push_back(lowerPyramidBottomLeft);
-    indices.push_back(lowerPyramidBottomRight);
-    
-    indices.push_back(lowerPyramidApex);
-    indices.push_back(lowerPyramidBottomRight);
-    indices.push_back(lowerPyramidTopRight);
-    
-    indices.push_back(lowerPyramidApex);
-    indices.push_back(lowerPyramidTopRight);
-    indices.push_back(lowerPyramidTopLeft);
-    
-    indices.push_back(lowerPyramidApex);
-    indices.push_back(lowerPyramidTopLeft);
-    indices.push_back(lowerPyramidBottomLeft);
-    
-    vertexCount += 5;
-    
-    // Second layer (middle)
-    float midY = baseY + treeHeight * 0.4f;
-    float midWidth = baseWidth * 0.7f;
-    
-    // Middle pyramid apex
-    vertices.push_back(x);                  // x
-    vertices.push_back(midY + treeHeight * 0.4f); // y
-    vertices.push_back(z);                  // z
-    vertices.push_back(midGreen.r);         // r
-    vertices.push_back(midGreen.g);         // g
-    vertices.push_back(midGreen.b);         // b
-    
-    // Middle pyramid base vertices
-    vertices.push_back(x - midWidth);       // x
-    vertices.push_back(midY);               // y
-    vertices.push_back(z - midWidth);       // z
-    vertices.push_back(midGreen.r);         // r
-    vertices.push_back(midGreen.g);         // g
-    vertices.push_back(midGreen.b);         // b
-    
-    vertices.push_back(x + midWidth);       // x
-    vertices.push_back(midY);               // y
-    vertices.push_back(z - midWidth);       // z
-    vertices.push_back(midGreen.r);         // r
-    vertices.push_back(midGreen.g);         // g
-    vertices.push_back(midGreen.b);         // b
-    
-    vertices.push_back(x + midWidth);       // x
-    vertices.push_back(midY);               // y
-    vertices.push_back(z + midWidth);       // z
-    vertices.push_back(midGreen.r);         // r
-    vertices.push_back(midGreen.g);         // g
-    vertices.push_back(midGreen.b);         // b
-    
-    vertices.push_back(x - midWidth);       // x
-    vertices.push_back(midY);               // y
-    vertices.push_back(z + midWidth);       // z
-    vertices.push_back(midGreen.r);         // r
-    vertices.push_back(midGreen.g);         // g
-    vertices.push_back(midGreen.b);         // b
-    
-    // Add middle pyramid triangles
-    unsigned int midPyramidBase = vertexCount;
-    unsigned int midPyramidApex = midPyramidBase;
-    unsigned int midPyramidBottomLeft = midPyramidBase + 1;
-    unsigned int midPyramidBottomRight = midPyramidBase + 2;
-    unsigned int midPyramidTopRight = midPyramidBase + 3;
-    unsigned int midPyramidTopLeft = midPyramidBase + 4;
-    
-    // Four faces of the pyramid
-    indices.push_back(midPyramidApex);
-    indices.push_back(midPyramidBottomLeft);
-    indices.push_back(midPyramidBottomRight);
-    
-    indices.push_back(midPyramidApex);
-    indices.push_back(midPyramidBottomRight);
-    indices.push_back(midPyramidTopRight);
-    
-    indices.push_back(midPyramidApex);
-    indices.push_back(midPyramidTopRight);
-    indices.push_back(midPyramidTopLeft);
-    
-    indices.push_back(midPyramidApex);
-    indices.push_back(midPyramidTopLeft);
-    indices.push_back(midPyramidBottomLeft);
-    
-    vertexCount += 5;
-    
-    // Top layer (pointed top)
-    float topY = midY + treeHeight * 0.3f;
-    float topWidth = midWidth * 0.5f;
-    
-    // Top pyramid apex
-    vertices.push_back(x);                  // x
-    vertices.push_back(topY + treeHeight * 0.3f); // y
-    vertices.push_back(z);                  // z
-    vertices.push_back(lightGreen.r);       // r
-    vertices.push_back(lightGreen.g);       // g
-    vertices.push_back(lightGreen.b);       // b
-    
-    // Top pyramid base vertices
-    vertices.push_back(x - topWidth);       // x
-    vertices.push_back(topY);               // y
-    vertices.push_back(z - topWidth);       // z
-    vertices.push_back(lightGreen.r);       // r
-    vertices.push_back(lightGreen.g);       // g
-    vertices.push_back(lightGreen.b);       // b
-    
-    vertices.push_back(x + topWidth);       // x
-    vertices.push_back(topY);               // y
-    vertices.push_back(z - topWidth);       // z
-    vertices.push_back(lightGreen.r);       // r
-    vertices.push_back(lightGreen.g);       // g
-    vertices.push_back(lightGreen.b);       // b
-    
-    vertices.push_back(x + topWidth);       // x
-    vertices.push_back(topY);               // y
-    vertices.push_back(z + topWidth);       // z
-    vertices.push_back(lightGreen.r);       // r
-    vertices.push_back(lightGreen.g);       // g
-    vertices.push_back(lightGreen.b);       // b
-    
-    vertices.push_back(x - topWidth);       // x
-    vertices.push_back(topY);               // y
-    vertices.push_back(z + topWidth);       // z
-    vertices.push_back(lightGreen.r);       // r
-    vertices.push_back(lightGreen.g);       // g
-    vertices.push_back(lightGreen.b);       // b
-    
-    // Add top pyramid triangles
-    unsigned int topPyramidBase = vertexCount;
-    unsigned int topPyramidApex = topPyramidBase;
-    unsigned int topPyramidBottomLeft = topPyramidBase + 1;
-    unsigned int topPyramidBottomRight = topPyramidBase + 2;
-    unsigned int topPyramidTopRight = topPyramidBase + 3;
-    unsigned int topPyramidTopLeft = topPyramidBase + 4;
-    
-    // Four faces of the pyramid
-    indices.push_back(topPyramidApex);
-    indices.push_back(topPyramidBottomLeft);
-    indices.push_back(topPyramidBottomRight);
-    
-    indices.push_back(topPyramidApex);
-    indices.push_back(topPyramidBottomRight);
-    indices.push_back(topPyramidTopRight);
-    
-    indices.push_back(topPyramidApex);
-    indices.push_back(topPyramidTopRight);
-    indices.push_back(topPyramidTopLeft);
-    
-    indices.push_back(topPyramidApex);
-    indices.push_back(topPyramidTopLeft);
-    indices.push_back(topPyramidBottomLeft);
-    
-    vertexCount += 5;
+// Biome index per heightmap texel, or a single grassland texel without climate
+void Renderer::uploadBiomeTexture(const ClimateMap* climate) {
+    static const uint8_t grassland = static_cast<uint8_t>(Biome::Grassland);
+    int mapWidth = climate ? climate->width : 1;
+    int mapHeight = climate ? climate->height : 1;
+    const uint8_t* data = climate ? climate->biome.data() : &grassland;
+    
+    if (biomeTexture == 0) {
+        glGenTextures(1, &biomeTexture);
+    }
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, biomeTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, mapWidth, mapHeight, 0, GL_RED, GL_UNSIGNED_BYTE, data);
+    // Fetched per texel; the shader blends neighbors itself
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Renderer::setupTerrainMesh(const HeightMap& heightMap) {
-    int mapWidth = heightMap.getWidth();
-    int mapHeight = heightMap.getHeight();
-
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-
-    float horizontalScale = 5.0f;
-    float verticalScale = 4.0f;
-
-    int step = triangleStepSize;
-    if (step < 1) step = 1;
-
-    int vCols = (mapWidth + step - 1) / step;
-    int vRows = (mapHeight + step - 1) / step;
-
-    // Flat-shaded: each triangle gets its own vertices (no sharing)
-    for (int z = 0; z < vRows - 1; ++z) {
-        for (int x = 0; x < vCols - 1; ++x) {
-            int x0 = x * step;
-            int x1 = std::min((x + 1) * step, mapWidth - 1);
-            int z0 = z * step;
-            int z1 = std::min((z + 1) * step, mapHeight - 1);
+// Sample the height band table of every biome into a 2D texture, height
+// across and biome down, so the fragment shader can color terrain without
+// per-vertex colors. Only this texture needs rebuilding when a color band
+// changes; the mesh stays untouched.
+void Renderer::rebuildColorLookup() {
+    // One row of height bands per biome
+    std::vector<float> texels(colorLookupSize * Biomes::count * 3);
+    for (int biome = 0; biome < Biomes::count; ++biome) {
+        for (int i = 0; i < colorLookupSize; ++i) {
+            // Sample at texel centers so linear filtering reproduces the table exactly there
+            float height = (static_cast<float>(i) + 0.5f) / colorLookupSize;
+            glm::vec3 color = getTerrainColor(height, static_cast<Biome>(biome));
+            float* texel = &texels[(biome * colorLookupSize + i) * 3];
+            texel[0] = color.r;
+            texel[1] = color.g;
+            texel[2] = color.b;
+        }
+    }
+    
+    if (colorLookupTexture == 0) {
+        glGenTextures(1, &colorLookupTexture);
+    }
+    
+    // Rows are looked up at their centers, so filtering never mixes biomes
+    glBindTexture(GL_TEXTURE_2D, colorLookupTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, colorLookupSize, Biomes::count, 0, GL_RGB, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-            float h00 = heightMap.getHeight(x0, z0);
-            float h10 = heightMap.getHeight(x1, z0);
-            float h01 = heightMap.getHeight(x0, z1);
-            float h11 = heightMap.getHeight(x1, z1);
+void Renderer::updateTerrainFields(const HeightMap& heightMap) {
+    if (!terrainFields) {
+        terrainFields.reset(new TerrainFields());
+    }
+    meshBuilder.buildFields(heightMap, *terrainFields);
+}
 
-            float x00 = (static_cast<float>(x0) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
-            float z00 = (static_cast<float>(z0) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
-            float y00 = flattenWaterAreas(h00) * verticalScale;
+void Renderer::setupTerrainMesh(const HeightMap& heightMap) {
+    meshBuilder.setTriangleStepSize(getDetailStepSize());
+    meshBuilder.setMaxMeshError(getDetailMeshError());
+    if (!terrainFields) {
+        updateTerrainFields(heightMap);
+    }
+    uploadFieldTextures(*terrainFields, { 0, 0, terrainFields->width, terrainFields->height });
+    
+    MeshOptimizer::Stats stats;
+    for (const MeshChunk& chunk : meshBuilder.buildTerrainChunks(heightMap, &stats)) {
+        terrainBatch->addChunk(chunk.vertices, chunk.indices, chunk.boundsMin, chunk.boundsMax);
+    }
+    if (meshBuilder.getMaxMeshError() > 0.0f) {
+        logOptimization("Adaptive terrain mesh", stats);
+    }
+    
+    terrainBatch->upload();
+}
 
-            float x10 = (static_cast<float>(x1) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
-            float z10 = z00;
-            float y10 = flattenWaterAreas(h10) * verticalScale;
+void Renderer::setupTreeMesh(const HeightMap& heightMap) {
+    meshBuilder.setTreeDensity(getDetailTreeDensity());
+    if (!terrainFields) {
+        updateTerrainFields(heightMap);
+    }
+    
+    MeshOptimizer::Stats stats;
+    for (const MeshChunk& chunk : meshBuilder.buildTreeChunks(heightMap, *terrainFields, &stats)) {
+        treeBatch->addChunk(chunk.vertices, chunk.indices, chunk.boundsMin, chunk.boundsMax);
+    }
+    if (stats.triangleCount > 0) {
+        logOptimization("Tree mesh", stats);
+    }
+    
+    treeBatch->upload();
+}
 
-            float x01 = x00;
-            float z01 = (static_cast<float>(z1) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
-            float y01 = flattenWaterAreas(h01) * verticalScale;
+void Renderer::logOptimization(const std::string& meshName, const MeshOptimizer::Stats& stats) {
+    if (!loggedMeshes.insert(meshName).second) return;
+    
+    std::cout << meshName << ": ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter
+              << " (" << static_cast<long long>((stats.acmrBefore - stats.acmrAfter) * stats.triangleCount)
+              << " fewer vertex shader runs per draw)" << std::endl;
+}
 
-            float x11 = x10;
-            float z11 = z01;
-            float y11 = flattenWaterAreas(h11) * verticalScale;
+// Upload rect of every field layer, reading rows out of the full layers.
+// New storage is filled whole.
+void Renderer::uploadFieldTextures(const TerrainFields& fields, const HeightMapRect& rect) {
+    HeightMapRect upload = rect;
+    if (fieldTextures[0] == 0 || fields.width != fieldTextureWidth || fields.height != fieldTextureHeight) {
+        allocateFieldTextures(fields.width, fields.height);
+        upload = { 0, 0, fields.width, fields.height };
+    }
+    if (upload.isEmpty()) return;
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, fields.width);
+    for (int layer = 0; layer < fieldLayerCount; ++layer) {
+        glBindTexture(GL_TEXTURE_2D, fieldTextures[layer]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, upload.x0, upload.y0, upload.x1 - upload.x0, upload.y1 - upload.y0, GL_RED,
+                        fieldLayerFormats[layer].type, getFieldLayer(fields, layer) + fields.index(upload.x0, upload.y0));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
 
-            // Flat shading: Calculate proper surface normals for each triangle
-            // and use consistent coloring for better flat shading appearance
-            
-            // First triangle (topLeft, bottomLeft, topRight) - use average height for color
-            float avgHeight1 = (h00 + h01 + h10) / 3.0f;
-            glm::vec3 triColor1 = getTerrainColor(avgHeight1);
-            
-            unsigned int idx = vertices.size() / 6;
-            vertices.insert(vertices.end(), {
-                x00, y00, z00, triColor1.r, triColor1.g, triColor1.b,
-                x01, y01, z01, triColor1.r, triColor1.g, triColor1.b,
-                x10, y10, z10, triColor1.r, triColor1.g, triColor1.b
-            });
-            indices.push_back(idx);
-            indices.push_back(idx + 1);
-            indices.push_back(idx + 2);
-
-            // Second triangle (topRight, bottomLeft, bottomRight) - use average height for color
-            float avgHeight2 = (h10 + h01 + h11) / 3.0f;
-            glm::vec3 triColor2 = getTerrainColor(avgHeight2);
-            
-            idx = vertices.size() / 6;
-            vertices.insert(vertices.end(), {
-                x10, y10, z10, triColor2.r, triColor2.g, triColor2.b,
-                x01, y01, z01, triColor2.r, triColor2.g, triColor2.b,
-                x11, y11, z11, triColor2.r, triColor2.g, triColor2.b
-            });
-            indices.push_back(idx);
-            indices.push_back(idx + 1);
-            indices.push_back(idx + 2);
-        }
+// (Re)create the field texture storage without filling it
+void Renderer::allocateFieldTextures(int mapWidth, int mapHeight) {
+    if (fieldTextures[0] == 0) {
+        glGenTextures(fieldLayerCount, fieldTextures);
     }
+    
+    for (int layer = 0; layer < fieldLayerCount; ++layer) {
+        glBindTexture(GL_TEXTURE_2D, fieldTextures[layer]);
+        glTexImage2D(GL_TEXTURE_2D, 0, fieldLayerFormats[layer].internalFormat, mapWidth, mapHeight, 0, GL_RED,
+                     fieldLayerFormats[layer].type, nullptr);
+        // Filtered, so lighting stays smooth across the flat-colored triangles
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    fieldTextureWidth = mapWidth;
+    fieldTextureHeight = mapHeight;
+}
 
-    // Add trees on grassy areas (restore this block after mesh generation)
-    int vertexCount = vertices.size() / 6;  // Current count of vertices (since each vertex is 6 floats)
-    const float grassLevel = 0.35f;
-    const float rockLevel = 0.4f;
-    const float treeDensity = 0.9f;
-    srand(42);
-
-    // Use the original map grid for tree placement, not the reduced mesh grid
-    for (int z = 2; z < mapHeight - 2; z += 2) {
-        for (int x = 2; x < mapWidth - 2; x += 2) {
-            float height = heightMap.getHeight(x, z);
-            if (height >= grassLevel && height < rockLevel) {
-                if (rand() / static_cast<float>(RAND_MAX) < treeDensity) {
-                    float xPos = (static_cast<float>(x) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
-                    float yPos = flattenWaterAreas(height) * verticalScale;
-                    float zPos = (static_cast<float>(z) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
-                    float treeScale = 0.1f + (rand() / static_cast<float>(RAND_MAX)) * 0.1f;
-                    addTreeAt(vertices, indices, xPos, yPos, zPos, treeScale, vertexCount);
-                }
-            }
-        }
+// Upload the heightmap as a single-channel texture in the map's own format.
+// Same-sized maps of the same storage are updated in place with a sub-upload.
+void Renderer::uploadHeightTexture(const HeightMap& heightMap) {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    HeightStorage storage = heightMap.getStorage();
+    
+    if (heightTexture == 0 || mapWidth != heightTextureWidth || mapHeight != heightTextureHeight ||
+        storage != heightTextureStorage) {
+        allocateHeightTexture(mapWidth, mapHeight, storage);
     }
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, static_cast<GLint>(HeightMap::getTexelBytes(storage)));
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mapWidth, mapHeight, GL_RED, getHeightTexelType(storage),
+                    heightMap.getRawData());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    totalIndicesCount = indices.size();
+// (Re)create the height texture storage without filling it
+void Renderer::allocateHeightTexture(int mapWidth, int mapHeight, HeightStorage storage) {
+    if (heightTexture == 0) {
+        glGenTextures(1, &heightTexture);
+    }
+    
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, getHeightTextureFormat(storage), mapWidth, mapHeight, 0, GL_RED,
+                 getHeightTexelType(storage), nullptr);
+    // Heights are fetched per texel, no filtering or mipmaps needed
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    heightTextureWidth = mapWidth;
+    heightTextureHeight = mapHeight;
+    heightTextureStorage = storage;
+}
 
-    // Create OpenGL buffers
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ibo);
+// Build the shared index grid used by the displacement path. It holds no
+// vertex data; the shader reconstructs positions from gl_VertexID.
+void Renderer::setupDisplacementGrid(int mapWidth, int mapHeight) {
+    int step = getDetailStepSize();
+    gridStep = step;
     
-    // Bind VAO
-    glBindVertexArray(vao);
+    gridColumns = (mapWidth + step - 1) / step;
+    gridRows = (mapHeight + step - 1) / step;
     
-    // Vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    std::vector<unsigned int> indices;
+    indices.reserve(static_cast<size_t>(gridColumns - 1) * (gridRows - 1) * 6);
+    
+    for (int z = 0; z < gridRows - 1; ++z) {
+        for (int x = 0; x < gridColumns - 1; ++x) {
+            unsigned int topLeft = z * gridColumns + x;
+            unsigned int topRight = topLeft + 1;
+            unsigned int bottomLeft = topLeft + gridColumns;
+            unsigned int bottomRight = bottomLeft + 1;
+            
+            // Same winding as the CPU mesh
+            indices.push_back(topLeft);
+            indices.push_back(bottomLeft);
+            indices.push_back(topRight);
+            
+            indices.push_back(topRight);
+            indices.push_back(bottomLeft);
+            indices.push_back(bottomRight);
+        }
+    }
     
-    // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    // Scan order misses the cache on every row; reorder for vertex reuse
+    unsigned int gridVertexCount = static_cast<unsigned int>(gridColumns * gridRows);
+    MeshOptimizer::Stats stats;
+    stats.triangleCount = static_cast<unsigned int>(indices.size() / 3);
+    stats.acmrBefore = MeshOptimizer::computeACMR(indices, gridVertexCount);
+    MeshOptimizer::optimizeVertexCache(indices, gridVertexCount);
+    stats.acmrAfter = MeshOptimizer::computeACMR(indices, gridVertexCount);
+    logOptimization("Displacement grid", stats);
     
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    gridIndicesCount = indices.size();
     
-    // Color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // Core profile still requires a bound VAO, even without attributes
+    glGenVertexArrays(1, &gridVao);
+    glGenBuffers(1, &gridIbo);
     
-    // Unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(gridVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
     glBindVertexArray(0);
 }
 
 void Renderer::renderMesh() {
-    if (vao == 0) return;
+    bool useDisplacement = renderMode == TerrainRenderMode::GpuDisplacement;
+    
+    // On first load, show streamed chunks as they arrive
+    ChunkBatch* terrain = terrainBatch.get();
+    ChunkBatch* trees = treeBatch.get();
+    if (!terrain->isUploaded() && pendingTerrainBatch) terrain = pendingTerrainBatch.get();
+    if (!trees->isUploaded() && pendingTreeBatch) trees = pendingTreeBatch.get();
     
-    // Use shader program
-    glUseProgram(shaderProgram);
+    if (useDisplacement ? gridVao == 0 : !terrain->isUploaded()) return;
     
     // Set up transformations (simple for this example)
     // Model matrix (identity for now)
-    float model[16] = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
+    glm::mat4 model(1.0f);
     
     // View matrix (simple camera looking from above)
     glm::mat4 view = camera.getViewMatrix();  // Use camera view matrix
@@ -722,29 +1313,81 @@ void Renderer::renderMesh() {
     float aspect = static_cast<float>(width) / static_cast<float>(height);
     float fov = 45.0f * 3.14159f / 180.0f;
     float near = 0.1f;
-    float far = 100.0f;
+    float far = governor.getDetail().drawDistance;
     float tanHalfFov = tan(fov / 2.0f);
     
-    float projection[16] = {
-        1.0f / (aspect * tanHalfFov), 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f / tanHalfFov, 0.0f, 0.0f,
-        0.0f, 0.0f, -(far + near) / (far - near), -1.0f,
-        0.0f, 0.0f, -(2.0f * far * near) / (far - near), 0.0f
-    };
-    
-    // Set uniforms
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, projection);
+    glm::mat4 projection(0.0f);
+    projection[0][0] = 1.0f / (aspect * tanHalfFov);
+    projection[1][1] = 1.0f / tanHalfFov;
+    projection[2][2] = -(far + near) / (far - near);
+    projection[2][3] = -1.0f;
+    projection[3][2] = -(2.0f * far * near) / (far - near);
+    
+    // Chunks are culled against this (the model matrix is identity)
+    glm::mat4 viewProjection = projection * view;
+    
+    // Terrain: colored in the fragment shader from the lookup texture
+    unsigned int terrainProgram = useDisplacement ? displacementProgram : shaderProgram;
+    const ProgramUniforms& uniforms = useDisplacement ? displacementUniforms : terrainUniforms;
+    glUseProgram(terrainProgram);
+    
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform1i(uniforms.colorLookup, 0);
+    glUniform1i(uniforms.biomeTexture, 2);
+    glUniform1f(uniforms.horizontalScale, TerrainMeshBuilder::horizontalScale);
+    glUniform3f(uniforms.waterParams, TerrainMeshBuilder::waterLevel,
+                TerrainMeshBuilder::waterTransitionZone, TerrainMeshBuilder::waterDepthOffset);
+    glm::vec3 sun = TerrainMeshBuilder::getSunDirection();
+    glUniform4f(uniforms.lightParams, sun.x, sun.y, sun.z, TerrainMeshBuilder::ambientLight);
+    
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, biomeTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorLookupTexture);
+    
+    if (useDisplacement) {
+        glUniform1i(uniforms.heightTexture, 1);
+        glUniform2i(uniforms.gridSize, gridColumns, gridRows);
+        glUniform1i(uniforms.gridStep, gridStep);
+        glUniform2i(uniforms.mapSize, heightTextureWidth, heightTextureHeight);
+        glUniform1f(uniforms.verticalScale, TerrainMeshBuilder::verticalScale);
+        
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        
+        glBindVertexArray(gridVao);
+        glDrawElements(GL_TRIANGLES, gridIndicesCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    } else {
+        // Field layers on the units after the biome texture
+        GLint fieldUnits[fieldLayerCount];
+        for (int layer = 0; layer < fieldLayerCount; ++layer) {
+            fieldUnits[layer] = 3 + layer;
+            glActiveTexture(GL_TEXTURE3 + layer);
+            glBindTexture(GL_TEXTURE_2D, fieldTextures[layer]);
+        }
+        glUniform1iv(uniforms.fieldTextures, fieldLayerCount, fieldUnits);
+        glActiveTexture(GL_TEXTURE0);
+        
+        // All visible terrain chunks in one multi-draw
+        terrain->draw(viewProjection);
+    }
     
-    // Draw mesh with all indices including trees
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, totalIndicesCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    // Trees: baked per-vertex colors, also one multi-draw
+    if (trees->isUploaded()) {
+        glUseProgram(treeShaderProgram);
+        
+        glUniformMatrix4fv(treeUniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+        glUniformMatrix4fv(treeUniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(treeUniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+        
+        trees->draw(viewProjection);
+    }
 }
 
 void Renderer::handleInput(float deltaTime) {
@@ -761,6 +1404,156 @@ void Renderer::handleInput(float deltaTime) {
         camera.moveForward(deltaTime);
     if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
         camera.moveBackward(deltaTime);
+    
+    handleSculptInput(deltaTime);
+}
+
+void Renderer::handleSculptInput(float deltaTime) {
+    if (!editor) return;
+    
+    // A remesh in flight reads the heights on the meshing thread. Strokes
+    // and undo are queued until the streamer releases the heightmap, rather
+    // than the remesh taking a copy; picking only reads, so it goes on.
+    bool sourceInUse = streamer && streamer->isSourceInUse(sourceRequestId);
+    if (!sourceInUse) {
+        for (const SculptOp& op : deferredSculpt) {
+            applySculptOp(op);
+        }
+        deferredSculpt.clear();
+    }
+    auto sculpt = [&](const SculptOp& op) {
+        if (sourceInUse) {
+            deferredSculpt.push_back(op);
+        } else {
+            applySculptOp(op);
+        }
+    };
+    
+    // Undo and redo fire once per key press
+    bool undoDown = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+    bool redoDown = glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+    if (undoDown && !undoKeyDown && !sculpting) sculpt({ SculptOp::Type::Undo, Brush(), glm::vec2(0.0f) });
+    if (redoDown && !redoKeyDown && !sculpting) sculpt({ SculptOp::Type::Redo, Brush(), glm::vec2(0.0f) });
+    undoKeyDown = undoDown;
+    redoKeyDown = redoDown;
+    
+    // Holding a brush key is one stroke
+    bool brushDown = true;
+    BrushMode mode = BrushMode::Raise;
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+        mode = BrushMode::Raise;
+    else if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+        mode = BrushMode::Lower;
+    else if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+        mode = BrushMode::Smooth;
+    else if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
+        mode = BrushMode::Flatten;
+    else if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
+        mode = BrushMode::NoiseStamp;
+    else
+        brushDown = false;
+    
+    glm::vec2 texel;
+    if (brushDown && pickTerrain(*streamedHeightMap, *streamedPyramid, texel)) {
+        if (!sculpting) {
+            sculpt({ SculptOp::Type::BeginStroke, Brush(), texel });
+            sculpting = true;
+            // Flatten levels to the height where the stroke started
+            sculptBrush.targetHeight = streamedHeightMap->getHeight(static_cast<int>(texel.x + 0.5f),
+                                                                    static_cast<int>(texel.y + 0.5f));
+        }
+        
+        // Strength is per second, so strokes don't depend on frame rate
+        Brush brush = sculptBrush;
+        brush.mode = mode;
+        brush.strength *= deltaTime;
+        if (mode == BrushMode::Smooth || mode == BrushMode::Flatten) {
+            brush.strength *= 20.0f;
+        }
+        sculpt({ SculptOp::Type::ApplyBrush, brush, texel });
+    } else if (!brushDown && sculpting) {
+        sculpt({ SculptOp::Type::EndStroke, Brush(), glm::vec2(0.0f) });
+        sculpting = false;
+    }
+    
+    // Strokes and undo both land here; picking sees the new heights next frame
+    HeightMapRect dirty = editor->takeDirtyRect();
+    streamedPyramid->update(*streamedHeightMap, dirty, JobSystem::instance());
+    updateHeightRegion(*streamedHeightMap, dirty);
+    
+    // Strokes land only once a remesh has finished meshing, but before its
+    // meshes are uploaded; those catch up when they are installed
+    if (shownRequestId != streamingRequest.id) {
+        remeshDirty.include(dirty);
+    }
+}
+
+void Renderer::applySculptOp(const SculptOp& op) {
+    switch (op.type) {
+        case SculptOp::Type::BeginStroke:
+            editor->beginStroke();
+            break;
+        case SculptOp::Type::ApplyBrush:
+            editor->applyBrush(op.brush, op.texel.x, op.texel.y);
+            break;
+        case SculptOp::Type::EndStroke:
+            editor->endStroke();
+            break;
+        case SculptOp::Type::Undo:
+            editor->undo();
+            break;
+        case SculptOp::Type::Redo:
+            editor->redo();
+            break;
+    }
+}
+
+// Cast the camera's view ray through the heightmap's pyramid. Water areas
+// are drawn flattened, so the lake surface is hit separately and the nearer
+// of the two wins.
+bool Renderer::pickTerrain(const HeightMap& heightMap, const HeightPyramid& pyramid, glm::vec2& texel) const {
+    const float maxDistance = 4.0f * TerrainMeshBuilder::horizontalScale;
+    
+    glm::vec3 origin = camera.getPosition();
+    glm::vec3 direction = camera.getFront();
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    
+    // World x/z span [-horizontalScale, horizontalScale] across the map and
+    // y spans verticalScale; scaling the direction with them keeps t a world
+    // distance
+    float texelsPerUnitX = 0.5f * (mapWidth - 1) / TerrainMeshBuilder::horizontalScale;
+    float texelsPerUnitY = 0.5f * (mapHeight - 1) / TerrainMeshBuilder::horizontalScale;
+    HeightRay ray;
+    ray.originX = (origin.x + TerrainMeshBuilder::horizontalScale) * texelsPerUnitX;
+    ray.originY = (origin.z + TerrainMeshBuilder::horizontalScale) * texelsPerUnitY;
+    ray.originZ = origin.y / TerrainMeshBuilder::verticalScale;
+    ray.directionX = direction.x * texelsPerUnitX;
+    ray.directionY = direction.z * texelsPerUnitY;
+    ray.directionZ = direction.y / TerrainMeshBuilder::verticalScale;
+    ray.maxDistance = maxDistance;
+    
+    HeightRayHit hit;
+    bool found = pyramid.raycast(heightMap, ray, hit);
+    float distance = found ? hit.distance : maxDistance;
+    glm::vec2 point = found ? glm::vec2(hit.x, hit.y) : glm::vec2(0.0f);
+    
+    if (ray.directionZ != 0.0f) {
+        float waterHeight = TerrainMeshBuilder::flattenWaterAreas(0.0f);
+        float t = (waterHeight - ray.originZ) / ray.directionZ;
+        float x = ray.originX + ray.directionX * t;
+        float y = ray.originY + ray.directionY * t;
+        if (t >= 0.0f && t < distance && x >= 0.0f && y >= 0.0f && x <= mapWidth - 1 && y <= mapHeight - 1 &&
+            heightMap.sampleBilinear(x, y) < TerrainMeshBuilder::waterLevel) {
+            found = true;
+            point = glm::vec2(x, y);
+        }
+    }
+    
+    if (found) {
+        texel = point;
+    }
+    return found;
 }
 
 unsigned int Renderer::compileShader(const char* source, unsigned int type) {
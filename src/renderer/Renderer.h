@@ -1,13 +1,28 @@
 #pragma once
 
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>  // Add this include for std::vector
 #include "../terrain/HeightMap.h"
 #include "../camera/Camera.h"  // Add camera include
+#include "FrameGovernor.h"
+#include "MeshOptimizer.h"
+#include "ChunkBatch.h"
+#include "TerrainMeshBuilder.h"
+#include "TerrainStreamer.h"
+#include "UploadRing.h"
+#include "../terrain/TerrainEditor.h"
 
 // Forward declarations for GLFW types
 struct GLFWwindow;
 
+// How terrain geometry reaches the GPU
+enum class TerrainRenderMode {
+    CpuMesh,          // Mesh built on the CPU from the heightmap and uploaded
+    GpuDisplacement   // Shared grid displaced in the vertex shader by a height texture
+};
+
 class Renderer {
 public:
     Renderer();
@@ -16,12 +31,71 @@ public:
     bool initialize(int width, int height, const std::string& title);
     bool shouldClose();
     void renderTerrain(const HeightMap& heightMap);
+    
+    // Generate and mesh terrain on background threads. It streams in over the
+    // following renderFrame calls; the current terrain stays up until then.
+    int requestTerrain(int width, int height, float scale, int octaves, float persistence, float lacunarity);
+    
+    // Draw a frame, uploading finished streamed terrain within the budget
+    void renderFrame();
+    
+    // Show coarse, low-octave previews of requested terrain first and refine
+    // them in the background; a new request abandons the old refinement
+    void setProgressivePreview(bool enabled) { progressivePreview = enabled; }
+    
+    // Hydraulic erosion applied to requested terrain (off by default)
+    void setErosion(const ErosionSettings& settings) { erosion = settings; }
+    void setThermalErosion(const ThermalErosionSettings& settings) { thermalErosion = settings; }
+    
+    // Damp noise octaves on steep slopes (0 = plain fractal noise)
+    void setSlopeDamping(float damping) { slopeDamping = damping; }
+    
+    // Storage of streamed heightmaps; 16-bit maps upload as R16 / R16F
+    // height textures (default Float32)
+    void setHeightStorage(HeightStorage storage) { heightStorage = storage; }
+    
+    // Noise backend of each octave; the last one repeats (default: Perlin)
+    void setNoiseLayers(const std::vector<NoiseType>& types) { noiseLayers = types; }
+    
+    // Terrain design to generate instead of the octave sum (see TerrainShapes)
+    void setTerrainShape(TerrainShapeFactory factory) { terrainShape = factory; }
+    
+    // Moisture and temperature generated with requested terrain; their biomes
+    // pick the ground colors (off by default: all grassland)
+    void setClimate(const ClimateSettings& settings) { climate = settings; }
+    
+    // Upper bound on streamed bytes uploaded per frame
+    void setUploadBudget(size_t bytesPerFrame) { uploadBudget = bytesPerFrame; }
     void update();
     void handleInput(float deltaTime);  
     void cleanup();
     
+    // Select the terrain rendering path (takes effect on the next frame)
+    void setRenderMode(TerrainRenderMode mode);
+    
+    // Replace the terrain being drawn. In GpuDisplacement mode this is a
+    // texture upload; in CpuMesh mode the mesh is rebuilt on the next frame.
+    void updateHeightMap(const HeightMap& heightMap);
+    
+    // Push an edit of part of the drawn heightmap: a texture sub-upload in
+    // GpuDisplacement mode, otherwise only the mesh chunks the rect touches
+    // are rebuilt and written over their old buffer ranges.
+    void updateHeightRegion(const HeightMap& heightMap, const HeightMapRect& rect);
+    
+    // Re-sample the height color bands into the lookup texture (no mesh rebuild)
+    void rebuildColorLookup();
+    
+    // Maximum vertical error (world units) for the adaptive terrain mesh.
+    // 0 keeps the regular two-triangles-per-cell grid.
+    void setMaxMeshError(float maxError);
+    
     // Add a setter method for triangle step size
-    void setTriangleStepSize(int stepSize) { triangleStepSize = stepSize > 0 ? stepSize : 1; }
+    void setTriangleStepSize(int stepSize);
+    
+    // Shed mesh resolution, trees and draw distance when frames run over the
+    // target time, and restore them when there is room again. Changes
+    // remesh in the background; a 0 ms target keeps full detail.
+    void setFrameBudget(const FrameBudgetSettings& settings);
     
 private:
     GLFWwindow* window;
@@ -29,14 +103,182 @@ private:
     int height;
     
     void setupTerrainMesh(const HeightMap& heightMap);
+    void setupTreeMesh(const HeightMap& heightMap);
+    
+    // Derived fields of the drawn terrain, which light the terrain mesh and
+    // place the trees; updated in place when the terrain is sculpted
+    std::unique_ptr<TerrainFields> terrainFields;
+    void updateTerrainFields(const HeightMap& heightMap);
+    
+    // Vertex cache statistics, printed for the first mesh of each kind only:
+    // governor remeshes, sculpt rebuilds and later terrains stay quiet
+    std::set<std::string> loggedMeshes;
+    void logOptimization(const std::string& meshName, const MeshOptimizer::Stats& stats);
+    
     void renderMesh();
     
+    // Release helpers for GL objects (ids are reset to 0)
+    void releaseTerrainMesh();
+    void releaseBuffers(unsigned int& vertexArray, unsigned int& buffer);
+    
+    // Uniform locations, looked up once per program after linking
+    struct ProgramUniforms {
+        int model;
+        int view;
+        int projection;
+        int colorLookup;
+        int biomeTexture;
+        int fieldTextures;
+        int heightTexture;
+        int gridSize;
+        int gridStep;
+        int mapSize;
+        int horizontalScale;
+        int verticalScale;
+        int waterParams;
+        int lightParams;
+    };
+    void cacheUniforms(unsigned int program, ProgramUniforms& uniforms);
+    
     // OpenGL resource IDs
-    unsigned int vao;
-    unsigned int vbo;
-    unsigned int ibo;
     unsigned int shaderProgram;
-    unsigned int totalIndicesCount; // Add this to track total indices
+    
+    // Terrain and tree chunks, each drawn with one multi-draw call
+    std::unique_ptr<ChunkBatch> terrainBatch;
+    std::unique_ptr<ChunkBatch> treeBatch;
+    
+    // Trees are drawn with their own shader using baked vertex colors
+    unsigned int treeShaderProgram;
+    
+    ProgramUniforms terrainUniforms;
+    ProgramUniforms treeUniforms;
+    ProgramUniforms displacementUniforms;
+    
+    // 2D texture mapping terrain height (across) and biome (down) to color
+    unsigned int colorLookupTexture;
+    
+    // Biome of each texel of the drawn terrain
+    unsigned int biomeTexture;
+    void uploadBiomeTexture(const ClimateMap* climate);
+    
+    // terrainFields layers the mesh path lights its fragments with: normal
+    // x and z, and occlusion, one single-channel texture each. Only the
+    // rect a sculpt edit changed is uploaded again.
+    static const int fieldLayerCount = 3;
+    unsigned int fieldTextures[fieldLayerCount];
+    int fieldTextureWidth;
+    int fieldTextureHeight;
+    void uploadFieldTextures(const TerrainFields& fields, const HeightMapRect& rect);
+    void allocateFieldTextures(int mapWidth, int mapHeight);
+    
+    // GPU displacement path: height texture plus one shared index grid
+    TerrainRenderMode renderMode;
+    unsigned int displacementProgram;
+    unsigned int heightTexture;
+    unsigned int gridVao;
+    unsigned int gridIbo;
+    unsigned int gridIndicesCount;
+    int heightTextureWidth;
+    int heightTextureHeight;
+    HeightStorage heightTextureStorage;
+    int gridColumns;
+    int gridRows;
+    
+    void uploadHeightTexture(const HeightMap& heightMap);
+    void allocateHeightTexture(int mapWidth, int mapHeight, HeightStorage storage);
+    void setupDisplacementGrid(int mapWidth, int mapHeight);
+    
+    // Asynchronous terrain streaming
+    std::unique_ptr<TerrainStreamer> streamer;
+    UploadRing uploadRing;
+    size_t uploadBudget;
+    bool progressivePreview;
+    float slopeDamping;
+    HeightStorage heightStorage;
+    std::vector<NoiseType> noiseLayers;
+    TerrainShapeFactory terrainShape;
+    ErosionSettings erosion;
+    ThermalErosionSettings thermalErosion;
+    ClimateSettings climate;
+    
+    // Terrain currently streaming in, and the GPU batches it fills
+    std::unique_ptr<StreamedTerrain> pendingTerrain;
+    std::unique_ptr<ChunkBatch> pendingTerrainBatch;
+    std::unique_ptr<ChunkBatch> pendingTreeBatch;
+    size_t pendingTerrainChunk;
+    size_t pendingTreeChunk;
+    bool pendingIndicesNext;    // Chunk vertices uploaded, indices still to go
+    int pendingTextureRow;
+    int pendingFieldRow;        // Through every field layer's rows in turn
+    
+    // Heightmap of the streamed terrain on screen, and its min/max pyramid
+    // for picking. A remesh in flight shares the heightmap and reads it on
+    // the meshing thread until the streamer releases it.
+    std::shared_ptr<HeightMap> streamedHeightMap;
+    std::unique_ptr<HeightPyramid> streamedPyramid;
+    
+    void pumpStreaming();
+    void beginPendingTerrain();
+    bool uploadPendingChunks(ChunkBatch& batch, const std::vector<MeshChunk>& chunks, size_t& cursor);
+    bool uploadPendingHeightRows();
+    bool uploadPendingFieldRows();
+    
+    // Sculpting the streamed terrain (R/F/T/G/N brushes, Z/Y undo/redo)
+    std::unique_ptr<TerrainEditor> editor;
+    Brush sculptBrush;
+    bool sculpting;
+    bool undoKeyDown;
+    bool redoKeyDown;
+    
+    // Editor calls made while a remesh still reads the heightmap, replayed
+    // in order once the streamer releases it (sourceRequestId)
+    struct SculptOp {
+        enum class Type { BeginStroke, ApplyBrush, EndStroke, Undo, Redo };
+        Type type;
+        Brush brush;
+        glm::vec2 texel;
+    };
+    std::vector<SculptOp> deferredSculpt;
+    int sourceRequestId;        // Newest request sharing streamedHeightMap
+    
+    void handleSculptInput(float deltaTime);
+    void applySculptOp(const SculptOp& op);
+    
+    // Detail the governor currently allows, applied to the configured mesh
+    // settings (which stay as set)
+    FrameGovernor governor;
+    float maxMeshError;
+    int gridStep;               // Step the displacement grid was built with
+    int getDetailStepSize() const;
+    float getDetailMeshError() const;
+    float getDetailTreeDensity() const;
+    
+    // Bring the drawn meshes to the current detail: the displacement grid is
+    // rebuilt on the spot, terrain and tree meshes in the background
+    void applyDetail();
+    bool needsRemesh() const;
+    void remeshTerrain();
+    
+    // Latest request sent to the streamer, and the newest one whose full
+    // level is on screen. Sculpting while a remesh is in flight is replayed
+    // onto its meshes when they land.
+    TerrainRequest streamingRequest;
+    int shownRequestId;
+    HeightMapRect remeshDirty;
+    
+    // Work time of a frame without the vsync wait: CPU time up to the swap,
+    // GPU time from a ring of timer queries read a few frames late
+    static const int frameTimerCount = 3;
+    unsigned int frameTimerQueries[frameTimerCount];
+    int frameTimerIndex;
+    int frameTimersIssued;
+    bool frameTimerRunning;
+    double frameStartTime;
+    float gpuFrameMs;
+    void beginFrameTimer();
+    float endFrameTimer();      // Returns the frame's work time in ms
+    // Heightmap texel under the screen center, if the view ray hits terrain
+    bool pickTerrain(const HeightMap& heightMap, const HeightPyramid& pyramid, glm::vec2& texel) const;
     
     // Shader helper methods
     unsigned int compileShader(const char* source, unsigned int type);
@@ -54,12 +296,8 @@ private:
 
     int triangleStepSize; // Controls terrain mesh resolution
     
-    glm::vec3 getTerrainColor(float height) const;
-    
-    // Height processing
-    float flattenWaterAreas(float height) const;
+    // GL-free terrain and tree mesh generation
+    TerrainMeshBuilder meshBuilder;
     
-    // Tree generation
-    void addTreeAt(std::vector<float>& vertices, std::vector<unsigned int>& indices, 
-                 float x, float y, float z, float scale, int& vertexCount);
+    glm::vec3 getTerrainColor(float height, Biome biome) const;
 };
\ No newline at end of file
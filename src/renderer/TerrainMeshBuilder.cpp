@@ -0,0 +1,812 @@
+#include "TerrainMeshBuilder.h"
+#include "AdaptiveMesher.h"
+#include "MeshChunkPool.h"
+#include "../utils/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+TerrainMeshBuilder::TerrainMeshBuilder()
+    : triangleStepSize(1), maxMeshError(0.0f), treeDensity(1.0f), jobs(nullptr) {}
+
+JobSystem& TerrainMeshBuilder::getJobSystem() const {
+    return jobs ? *jobs : JobSystem::instance();
+}
+
+// Helper function to flatten water areas
+float TerrainMeshBuilder::flattenWaterAreas(float height) {
+    // Water parameters are class constants so the displacement shader can share them
+    const float transitionZone = waterTransitionZone;
+    
+    if (height < waterLevel) {
+        // All underwater terrain gets flattened to a constant level
+        return waterLevel - waterDepthOffset;
+    } 
+    else if (height < waterLevel + transitionZone) {
+        // Transition zone - gradually blend from flat to original height
+        float t = (height - waterLevel) / transitionZone;
+        float smoothT = t * t * (3.0f - 2.0f * t); // Smooth interpolation
+        return (waterLevel - waterDepthOffset) * (1.0f - smoothT) + height * smoothT;
+    }
+    
+    // Above water transition zone - leave unchanged
+    return height;
+}
+
+TerrainFieldBuilder TerrainMeshBuilder::getFieldBuilder(const HeightMap& heightMap) const {
+    // The mesh spans 2 * horizontalScale across the map
+    float texelSpacing = 2.0f * horizontalScale / std::max(1, heightMap.getWidth() - 1);
+    return TerrainFieldBuilder(texelSpacing, verticalScale);
+}
+
+void TerrainMeshBuilder::buildFields(const HeightMap& heightMap, TerrainFields& fields) const {
+    getFieldBuilder(heightMap).build(heightMap, fields, getJobSystem());
+}
+
+HeightMapRect TerrainMeshBuilder::updateFields(const HeightMap& heightMap, const HeightMapRect& rect,
+                                               TerrainFields& fields) const {
+    return getFieldBuilder(heightMap).update(heightMap, rect, fields, getJobSystem());
+}
+
+// Add triangular trees to vertices and indices arrays at specified position
+void TerrainMeshBuilder::addTreeAt(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+                                   float x, float y, float z, float scale, int& vertexCount) {
+    // Tree colors - dark to light green
+    glm::vec3 darkGreen(0.0f, 0.25f, 0.0f);   // Darker
+    glm::vec3 midGreen(0.0f, 0.3f, 0.0f);  // Darker
+    glm::vec3 lightGreen(0.0f, 0.35f, 0.0f); // Darker
+    
+    float treeHeight = 0.8f * scale;
+    float baseWidth = 0.2f * scale;
+    
+    // Tree trunk (brown)
+    float trunkHeight = 0.2f * scale;
+    glm::vec3 brown(0.45f, 0.30f, 0.15f);
+    
+    // Add trunk vertices
+    // Base of trunk
+    vertices.push_back(x - 0.05f * scale);  // x
+    vertices.push_back(y);                  // y
+    vertices.push_back(z - 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x + 0.05f * scale);  // x
+    vertices.push_back(y);                  // y
+    vertices.push_back(z - 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x + 0.05f * scale);  // x
+    vertices.push_back(y);                  // y
+    vertices.push_back(z + 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x - 0.05f * scale);  // x
+    vertices.push_back(y);                  // y
+    vertices.push_back(z + 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    // Top of trunk
+    vertices.push_back(x - 0.05f * scale);  // x
+    vertices.push_back(y + trunkHeight);    // y
+    vertices.push_back(z - 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x + 0.05f * scale);  // x
+    vertices.push_back(y + trunkHeight);    // y
+    vertices.push_back(z - 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x + 0.05f * scale);  // x
+    vertices.push_back(y + trunkHeight);    // y
+    vertices.push_back(z + 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    vertices.push_back(x - 0.05f * scale);  // x
+    vertices.push_back(y + trunkHeight);    // y
+    vertices.push_back(z + 0.05f * scale);  // z
+    vertices.push_back(brown.r);            // r
+    vertices.push_back(brown.g);            // g
+    vertices.push_back(brown.b);            // b
+    
+    // Trunk indices
+    unsigned int trunkBase = vertexCount;
+    
+    // Front face
+    indices.push_back(trunkBase);
+    indices.push_back(trunkBase + 1);
+    indices.push_back(trunkBase + 5);
+    
+    indices.push_back(trunkBase);
+    indices.push_back(trunkBase + 5);
+    indices.push_back(trunkBase + 4);
+    
+    // Right face
+    indices.push_back(trunkBase + 1);
+    indices.push_back(trunkBase + 2);
+    indices.push_back(trunkBase + 6);
+    
+    indices.push_back(trunkBase + 1);
+    indices.push_back(trunkBase + 6);
+    indices.push_back(trunkBase + 5);
+    
+    // Back face
+    indices.push_back(trunkBase + 2);
+    indices.push_back(trunkBase + 3);
+    indices.push_back(trunkBase + 7);
+    
+    indices.push_back(trunkBase + 2);
+    indices.push_back(trunkBase + 7);
+    indices.push_back(trunkBase + 6);
+    
+    // Left face
+    indices.push_back(trunkBase + 3);
+    indices.push_back(trunkBase);
+    indices.push_back(trunkBase + 4);
+    
+    indices.push_back(trunkBase + 3);
+    indices.push_back(trunkBase + 4);
+    indices.push_back(trunkBase + 7);
+    
+    vertexCount += 8;
+    
+    // Tree foliage (green triangular pyramids stacked)
+    // First layer (bottom)
+    float baseY = y + trunkHeight;
+    
+    // Bottom pyramid apex
+    vertices.push_back(x);                  // x
+    vertices.push_back(baseY + treeHeight * 0.6f); // y
+    vertices.push_back(z);                  // z
+    vertices.push_back(darkGreen.r);        // r
+    vertices.push_back(darkGreen.g);        // g
+    vertices.push_back(darkGreen.b);        // b
+    
+    // Bottom pyramid base vertices
+    vertices.push_back(x - baseWidth);      // x
+    vertices.push_back(baseY);              // y
+    vertices.push_back(z - baseWidth);      // z
+    vertices.push_back(darkGreen.r);        // r
+    vertices.push_back(darkGreen.g);        // g
+    vertices.push_back(darkGreen.b);        // b
+    
+    vertices.push_back(x + baseWidth);      // x
+    vertices.push_back(baseY);              // y
+    vertices.push_back(z - baseWidth);      // z
+    vertices.push_back(darkGreen.r);        // r
+    vertices.push_back(darkGreen.g);        // g
+    vertices.push_back(darkGreen.b);        // b
+    
+    vertices.push_back(x + baseWidth);      // x
+    vertices.push_back(baseY);              // y
+    vertices.push_back(z + baseWidth);      // z
+    vertices.push_back(darkGreen.r);        // r
+    vertices.push_back(darkGreen.g);        // g
+    vertices.push_back(darkGreen.b);        // b
+    
+    vertices.push_back(x - baseWidth);      // x
+    vertices.push_back(baseY);              // y
+    vertices.push_back(z + baseWidth);      // z
+    vertices.push_back(darkGreen.r);        // r
+    vertices.push_back(darkGreen.g);        // g
+    vertices.push_back(darkGreen.b);        // b
+    
+    // Add lower pyramid triangles
+    unsigned int lowerPyramidBase = vertexCount;
+    unsigned int lowerPyramidApex = lowerPyramidBase;
+    unsigned int lowerPyramidBottomLeft = lowerPyramidBase + 1;
+    unsigned int lowerPyramidBottomRight = lowerPyramidBase + 2;
+    unsigned int lowerPyramidTopRight = lowerPyramidBase + 3;
+    unsigned int lowerPyramidTopLeft = lowerPyramidBase + 4;
+    
+    // Four faces of the pyramid
+    indices.push_back(lowerPyramidApex);
+    indices.push_back(lowerPyramidBottomLeft);
+    indices.push_back(lowerPyramidBottomRight);
+    
+    indices.push_back(lowerPyramidApex);
+    indices.push_back(lowerPyramidBottomRight);
+    indices.push_back(lowerPyramidTopRight);
+    
+    indices.push_back(lowerPyramidApex);
+    indices.push_back(lowerPyramidTopRight);
+    indices.push_back(lowerPyramidTopLeft);
+    
+    indices.push_back(lowerPyramidApex);
+    indices.push_back(lowerPyramidTopLeft);
+    indices.push_back(lowerPyramidBottomLeft);
+    
+    vertexCount += 5;
+    
+    // Second layer (middle)
+    float midY = baseY + treeHeight * 0.4f;
+    float midWidth = baseWidth * 0.7f;
+    
+    // Middle pyramid apex
+    vertices.push_back(x);                  // x
+    vertices.push_back(midY + treeHeight * 0.4f); // y
+    vertices.push_back(z);                  // z
+    vertices.push_back(midGreen.r);         // r
+    vertices.push_back(midGreen.g);         // g
+    vertices.push_back(midGreen.b);         // b
+    
+    // Middle pyramid base vertices
+    vertices.push_back(x - midWidth);       // x
+    vertices.push_back(midY);               // y
+    vertices.push_back(z - midWidth);       // z
+    vertices.push_back(midGreen.r);         // r
+    vertices.push_back(midGreen.g);         // g
+    vertices.push_back(midGreen.b);         // b
+    
+    vertices.push_back(x + midWidth);       // x
+    vertices.push_back(midY);               // y
+    vertices.push_back(z - midWidth);       // z
+    vertices.push_back(midGreen.r);         // r
+    vertices.push_back(midGreen.g);         // g
+    vertices.push_back(midGreen.b);         // b
+    
+    vertices.push_back(x + midWidth);       // x
+    vertices.push_back(midY);               // y
+    vertices.push_back(z + midWidth);       // z
+    vertices.push_back(midGreen.r);         // r
+    vertices.push_back(midGreen.g);         // g
+    vertices.push_back(midGreen.b);         // b
+    
+    vertices.push_back(x - midWidth);       // x
+    vertices.push_back(midY);               // y
+    vertices.push_back(z + midWidth);       // z
+    vertices.push_back(midGreen.r);         // r
+    vertices.push_back(midGreen.g);         // g
+    vertices.push_back(midGreen.b);         // b
+    
+    // Add middle pyramid triangles
+    unsigned int midPyramidBase = vertexCount;
+    unsigned int midPyramidApex = midPyramidBase;
+    unsigned int midPyramidBottomLeft = midPyramidBase + 1;
+    unsigned int midPyramidBottomRight = midPyramidBase + 2;
+    unsigned int midPyramidTopRight = midPyramidBase + 3;
+    unsigned int midPyramidTopLeft = midPyramidBase + 4;
+    
+    // Four faces of the pyramid
+    indices.push_back(midPyramidApex);
+    indices.push_back(midPyramidBottomLeft);
+    indices.push_back(midPyramidBottomRight);
+    
+    indices.push_back(midPyramidApex);
+    indices.push_back(midPyramidBottomRight);
+    indices.push_back(midPyramidTopRight);
+    
+    indices.push_back(midPyramidApex);
+    indices.push_back(midPyramidTopRight);
+    indices.push_back(midPyramidTopLeft);
+    
+    indices.push_back(midPyramidApex);
+    indices.push_back(midPyramidTopLeft);
+    indices.push_back(midPyramidBottomLeft);
+    
+    vertexCount += 5;
+    
+    // Top layer (pointed top)
+    float topY = midY + treeHeight * 0.3f;
+    float topWidth = midWidth * 0.5f;
+    
+    // Top pyramid apex
+    vertices.push_back(x);                  // x
+    vertices.push_back(topY + treeHeight * 0.3f); // y
+    vertices.push_back(z);                  // z
+    vertices.push_back(lightGreen.r);       // r
+    vertices.push_back(lightGreen.g);       // g
+    vertices.push_back(lightGreen.b);       // b
+    
+    // Top pyramid base vertices
+    vertices.push_back(x - topWidth);       // x
+    vertices.push_back(topY);               // y
+    vertices.push_back(z - topWidth);       // z
+    vertices.push_back(lightGreen.r);       // r
+    vertices.push_back(lightGreen.g);       // g
+    vertices.push_back(lightGreen.b);       // b
+    
+    vertices.push_back(x + topWidth);       // x
+    vertices.push_back(topY);               // y
+    vertices.push_back(z - topWidth);       // z
+    vertices.push_back(lightGreen.r);       // r
+    vertices.push_back(lightGreen.g);       // g
+    vertices.push_back(lightGreen.b);       // b
+    
+    vertices.push_back(x + topWidth);       // x
+    vertices.push_back(topY);               // y
+    vertices.push_back(z + topWidth);       // z
+    vertices.push_back(lightGreen.r);       // r
+    vertices.push_back(lightGreen.g);       // g
+    vertices.push_back(lightGreen.b);       // b
+    
+    vertices.push_back(x - topWidth);       // x
+    vertices.push_back(topY);               // y
+    vertices.push_back(z + topWidth);       // z
+    vertices.push_back(lightGreen.r);       // r
+    vertices.push_back(lightGreen.g);       // g
+    vertices.push_back(lightGreen.b);       // b
+    
+    // Add top pyramid triangles
+    unsigned int topPyramidBase = vertexCount;
+    unsigned int topPyramidApex = topPyramidBase;
+    unsigned int topPyramidBottomLeft = topPyramidBase + 1;
+    unsigned int topPyramidBottomRight = topPyramidBase + 2;
+    unsigned int topPyramidTopRight = topPyramidBase + 3;
+    unsigned int topPyramidTopLeft = topPyramidBase + 4;
+    
+    // Four faces of the pyramid
+    indices.push_back(topPyramidApex);
+    indices.push_back(topPyramidBottomLeft);
+    indices.push_back(topPyramidBottomRight);
+    
+    indices.push_back(topPyramidApex);
+    indices.push_back(topPyramidBottomRight);
+    indices.push_back(topPyramidTopRight);
+    
+    indices.push_back(topPyramidApex);
+    indices.push_back(topPyramidTopRight);
+    indices.push_back(topPyramidTopLeft);
+    
+    indices.push_back(topPyramidApex);
+    indices.push_back(topPyramidTopLeft);
+    indices.push_back(topPyramidBottomLeft);
+    
+    vertexCount += 5;
+}
+
+std::vector<MeshChunk> TerrainMeshBuilder::buildTerrainChunks(const HeightMap& heightMap,
+                                                              MeshOptimizer::Stats* stats) const {
+    if (maxMeshError > 0.0f) {
+        return buildAdaptiveTerrainChunks(heightMap, stats);
+    }
+    
+    RegularGrid grid = getRegularGrid(heightMap);
+    std::vector<MeshChunk> chunks(static_cast<size_t>(grid.chunksX) * grid.chunksZ);
+    
+    // Chunks are independent, so each one is a job
+    getJobSystem().parallelFor(0, grid.chunksX * grid.chunksZ, 1, [&](int firstChunk, int endChunk) {
+        for (int chunkIndex = firstChunk; chunkIndex < endChunk; ++chunkIndex) {
+            chunks[chunkIndex] = buildTerrainChunk(heightMap, chunkIndex);
+        }
+    });
+    
+    if (stats) {
+        // No shared vertices: every vertex misses the cache
+        stats->triangleCount = 0;
+        for (const MeshChunk& chunk : chunks) {
+            stats->triangleCount += static_cast<unsigned int>(chunk.indices.size() / 3);
+        }
+        stats->acmrBefore = stats->acmrAfter = 3.0f;
+    }
+    
+    return chunks;
+}
+
+TerrainMeshBuilder::RegularGrid TerrainMeshBuilder::getRegularGrid(const HeightMap& heightMap) const {
+    RegularGrid grid;
+    grid.step = std::max(1, triangleStepSize);
+    grid.columns = (heightMap.getWidth() + grid.step - 1) / grid.step;
+    grid.rows = (heightMap.getHeight() + grid.step - 1) / grid.step;
+    
+    // Mesh cells per chunk side, so chunks cover the same area at any step
+    grid.chunkCells = std::max(1, chunkTexels / grid.step);
+    grid.chunksX = std::max(0, (grid.columns - 1 + grid.chunkCells - 1) / grid.chunkCells);
+    grid.chunksZ = std::max(0, (grid.rows - 1 + grid.chunkCells - 1) / grid.chunkCells);
+    return grid;
+}
+
+int TerrainMeshBuilder::getTerrainChunkCount(const HeightMap& heightMap) const {
+    if (maxMeshError > 0.0f) {
+        return AdaptiveMesher::getTileCount(heightMap.getWidth()) * AdaptiveMesher::getTileCount(heightMap.getHeight());
+    }
+    
+    RegularGrid grid = getRegularGrid(heightMap);
+    return grid.chunksX * grid.chunksZ;
+}
+
+std::vector<int> TerrainMeshBuilder::getTerrainChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const {
+    std::vector<int> chunkIds;
+    if (maxMeshError > 0.0f) {
+        return getAdaptiveChunksInRect(heightMap, rect);
+    }
+    
+    RegularGrid grid = getRegularGrid(heightMap);
+    if (rect.isEmpty() || grid.chunksX == 0 || grid.chunksZ == 0) return chunkIds;
+    
+    // A texel feeds the cells on both sides of it, and each cell's triangles
+    // carry heights from its corners
+    int cellX0 = std::max(0, (rect.x0 - 1) / grid.step);
+    int cellZ0 = std::max(0, (rect.y0 - 1) / grid.step);
+    int cellX1 = std::min(grid.columns - 2, (rect.x1 - 1) / grid.step);
+    int cellZ1 = std::min(grid.rows - 2, (rect.y1 - 1) / grid.step);
+    
+    for (int chunkZ = cellZ0 / grid.chunkCells; chunkZ <= cellZ1 / grid.chunkCells; ++chunkZ) {
+        for (int chunkX = cellX0 / grid.chunkCells; chunkX <= cellX1 / grid.chunkCells; ++chunkX) {
+            chunkIds.push_back(chunkZ * grid.chunksX + chunkX);
+        }
+    }
+    return chunkIds;
+}
+
+MeshChunk TerrainMeshBuilder::buildTerrainChunk(const HeightMap& heightMap, int chunkIndex) const {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    RegularGrid grid = getRegularGrid(heightMap);
+    int step = grid.step;
+    
+    int chunkX = (chunkIndex % grid.chunksX) * grid.chunkCells;
+    int chunkZ = (chunkIndex / grid.chunksX) * grid.chunkCells;
+    int endZ = std::min(chunkZ + grid.chunkCells, grid.rows - 1);
+    int endX = std::min(chunkX + grid.chunkCells, grid.columns - 1);
+    
+    // Terrain vertices are x, y, z and the height used for the color lookup.
+    // Two triangles of three vertices per cell, in recycled buffers of
+    // exactly that size or more.
+    size_t cells = static_cast<size_t>(std::max(0, endX - chunkX)) * std::max(0, endZ - chunkZ);
+    MeshChunk chunk = MeshChunkPool::instance().acquire(cells * 24, cells * 6);
+    std::vector<float>& vertices = chunk.vertices;
+    std::vector<unsigned int>& indices = chunk.indices;
+    glm::vec3 boundsMin(1e30f);
+    glm::vec3 boundsMax(-1e30f);
+    
+    // Flat-shaded: each triangle gets its own vertices (no sharing), so
+    // vertex cache reordering cannot help this mesh
+    for (int z = chunkZ; z < endZ; ++z) {
+        for (int x = chunkX; x < endX; ++x) {
+            int x0 = x * step;
+            int x1 = std::min((x + 1) * step, mapWidth - 1);
+            int z0 = z * step;
+            int z1 = std::min((z + 1) * step, mapHeight - 1);
+            
+            float h00 = heightMap.getHeight(x0, z0);
+            float h10 = heightMap.getHeight(x1, z0);
+            float h01 = heightMap.getHeight(x0, z1);
+            float h11 = heightMap.getHeight(x1, z1);
+            
+            float x00 = (static_cast<float>(x0) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
+            float z00 = (static_cast<float>(z0) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
+            float y00 = flattenWaterAreas(h00) * verticalScale;
+            
+            float x10 = (static_cast<float>(x1) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
+            float z10 = z00;
+            float y10 = flattenWaterAreas(h10) * verticalScale;
+            
+            float x01 = x00;
+            float z01 = (static_cast<float>(z1) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
+            float y01 = flattenWaterAreas(h01) * verticalScale;
+            
+            float x11 = x10;
+            float z11 = z01;
+            float y11 = flattenWaterAreas(h11) * verticalScale;
+            
+            // Flat coloring: every vertex of a triangle carries the triangle's
+            // average height, so the shader picks one color per triangle.
+            // Lighting is per fragment and stays smooth.
+            
+            // First triangle (topLeft, bottomLeft, topRight)
+            float avgHeight1 = (h00 + h01 + h10) / 3.0f;
+            
+            unsigned int idx = vertices.size() / 4;
+            vertices.insert(vertices.end(), {
+                x00, y00, z00, avgHeight1,
+                x01, y01, z01, avgHeight1,
+                x10, y10, z10, avgHeight1
+            });
+            indices.push_back(idx);
+            indices.push_back(idx + 1);
+            indices.push_back(idx + 2);
+            
+            // Second triangle (topRight, bottomLeft, bottomRight)
+            float avgHeight2 = (h10 + h01 + h11) / 3.0f;
+            
+            idx = vertices.size() / 4;
+            vertices.insert(vertices.end(), {
+                x10, y10, z10, avgHeight2,
+                x01, y01, z01, avgHeight2,
+                x11, y11, z11, avgHeight2
+            });
+            indices.push_back(idx);
+            indices.push_back(idx + 1);
+            indices.push_back(idx + 2);
+            
+            float cellMinY = std::min(std::min(y00, y10), std::min(y01, y11));
+            float cellMaxY = std::max(std::max(y00, y10), std::max(y01, y11));
+            boundsMin = glm::min(boundsMin, glm::vec3(x00, cellMinY, z00));
+            boundsMax = glm::max(boundsMax, glm::vec3(x11, cellMaxY, z11));
+        }
+    }
+    
+    chunk.boundsMin = boundsMin;
+    chunk.boundsMax = boundsMax;
+    return chunk;
+}
+
+std::vector<MeshChunk> TerrainMeshBuilder::rebuildTerrainChunks(const HeightMap& heightMap,
+                                                                const std::vector<int>& chunkIds) const {
+    std::vector<MeshChunk> chunks(chunkIds.size());
+    if (chunkIds.empty()) return chunks;
+    
+    if (maxMeshError <= 0.0f) {
+        getJobSystem().parallelFor(0, static_cast<int>(chunkIds.size()), 1, [&](int first, int end) {
+            for (int i = first; i < end; ++i) {
+                chunks[i] = buildTerrainChunk(heightMap, chunkIds[i]);
+            }
+        });
+        return chunks;
+    }
+    
+    // One error pass over the chunks' tiles and a ring of tiles around them,
+    // which the splits on their outer edges take in
+    int tilesX = AdaptiveMesher::getTileCount(heightMap.getWidth());
+    int tilesZ = AdaptiveMesher::getTileCount(heightMap.getHeight());
+    int tileX0 = tilesX, tileZ0 = tilesZ, tileX1 = 0, tileZ1 = 0;
+    for (int chunkIndex : chunkIds) {
+        tileX0 = std::min(tileX0, chunkIndex % tilesX);
+        tileZ0 = std::min(tileZ0, chunkIndex / tilesX);
+        tileX1 = std::max(tileX1, chunkIndex % tilesX + 1);
+        tileZ1 = std::max(tileZ1, chunkIndex / tilesX + 1);
+    }
+    AdaptiveMesher mesher(heightMap.getWidth(), heightMap.getHeight(), std::max(0, tileX0 - 1), std::max(0, tileZ0 - 1),
+                          std::min(tilesX, tileX1 + 1), std::min(tilesZ, tileZ1 + 1), getDisplayRowReader(heightMap));
+    
+    // Triangles stay in traversal order: the vertex cache pass would cost
+    // several times the rest of the rebuild
+    getJobSystem().parallelFor(0, static_cast<int>(chunkIds.size()), 1, [&](int first, int end) {
+        for (int i = first; i < end; ++i) {
+            chunks[i] = buildAdaptiveTile(mesher, heightMap, chunkIds[i] % tilesX, chunkIds[i] / tilesX, false, nullptr);
+        }
+    });
+    return chunks;
+}
+
+AdaptiveMesher::RowReader TerrainMeshBuilder::getDisplayRowReader(const HeightMap& heightMap) {
+    // Measure the error on the displayed surface, in world units
+    return [&heightMap](int z, int x0, int x1, float* row) {
+        // Widen the row in bulk, then scale it in place
+        heightMap.readRow(z, x0, x1 - x0, row);
+        for (int x = 0; x < x1 - x0; ++x) {
+            row[x] = flattenWaterAreas(row[x]) * verticalScale;
+        }
+    };
+}
+
+// Error-bounded terrain mesh: vertices are shared between triangles and flat
+// regions (flattened water, plains) collapse into a few large triangles.
+// Each mesher tile is one chunk, so chunk ids match the regular grid's.
+std::vector<MeshChunk> TerrainMeshBuilder::buildAdaptiveTerrainChunks(const HeightMap& heightMap,
+                                                                      MeshOptimizer::Stats* stats) const {
+    int tilesX = AdaptiveMesher::getTileCount(heightMap.getWidth());
+    int tilesZ = AdaptiveMesher::getTileCount(heightMap.getHeight());
+    AdaptiveMesher mesher(heightMap.getWidth(), heightMap.getHeight(), 0, 0, tilesX, tilesZ,
+                          getDisplayRowReader(heightMap));
+    
+    std::vector<MeshChunk> chunks(static_cast<size_t>(tilesX) * tilesZ);
+    std::vector<MeshOptimizer::Stats> chunkStats(chunks.size());
+    
+    // Chunk extraction and cache optimization run as jobs
+    getJobSystem().parallelFor(0, static_cast<int>(chunks.size()), 1, [&](int firstChunk, int endChunk) {
+        for (int chunkIndex = firstChunk; chunkIndex < endChunk; ++chunkIndex) {
+            chunks[chunkIndex] = buildAdaptiveTile(mesher, heightMap, chunkIndex % tilesX, chunkIndex / tilesX,
+                                                   true, &chunkStats[chunkIndex]);
+        }
+    });
+    
+    MeshOptimizer::Stats totals = { 0, 0.0f, 0.0f };
+    for (const MeshOptimizer::Stats& chunk : chunkStats) {
+        totals.acmrBefore += chunk.acmrBefore * chunk.triangleCount;
+        totals.acmrAfter += chunk.acmrAfter * chunk.triangleCount;
+        totals.triangleCount += chunk.triangleCount;
+    }
+    
+    if (totals.triangleCount > 0) {
+        totals.acmrBefore /= totals.triangleCount;
+        totals.acmrAfter /= totals.triangleCount;
+    }
+    if (stats) {
+        *stats = totals;
+    }
+    
+    return chunks;
+}
+
+std::vector<int> TerrainMeshBuilder::getAdaptiveChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const {
+    std::vector<int> chunkIds;
+    if (rect.isEmpty()) return chunkIds;
+    
+    // Tiles holding an edited texel (edge texels belong to both sides), and
+    // the tiles beside them, whose splits along the shared edges follow them
+    const int tileCells = AdaptiveMesher::tileCells;
+    int tilesX = AdaptiveMesher::getTileCount(heightMap.getWidth());
+    int tilesZ = AdaptiveMesher::getTileCount(heightMap.getHeight());
+    int tileX0 = std::max(0, (rect.x0 - 1) / tileCells - 1);
+    int tileZ0 = std::max(0, (rect.y0 - 1) / tileCells - 1);
+    int tileX1 = std::min(tilesX - 1, (rect.x1 - 1) / tileCells + 1);
+    int tileZ1 = std::min(tilesZ - 1, (rect.y1 - 1) / tileCells + 1);
+    
+    for (int tileZ = tileZ0; tileZ <= tileZ1; ++tileZ) {
+        for (int tileX = tileX0; tileX <= tileX1; ++tileX) {
+            chunkIds.push_back(tileZ * tilesX + tileX);
+        }
+    }
+    return chunkIds;
+}
+
+MeshChunk TerrainMeshBuilder::buildAdaptiveTile(const AdaptiveMesher& mesher, const HeightMap& heightMap,
+                                                int tileX, int tileZ, bool optimize, MeshOptimizer::Stats* stats) const {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    
+    std::vector<int> vertexTexels;
+    MeshChunk chunk = MeshChunkPool::instance().acquire();
+    std::vector<float>& vertices = chunk.vertices;
+    std::vector<unsigned int>& indices = chunk.indices;
+    mesher.buildTile(tileX, tileZ, maxMeshError, vertexTexels, indices);
+    
+    // Vertices are x, y, z and the raw height for the color lookup, in
+    // first-use order; bounds come from the actual vertices so large
+    // triangles still cull correctly
+    glm::vec3 boundsMin(1e30f);
+    glm::vec3 boundsMax(-1e30f);
+    vertices.reserve(vertexTexels.size() * 4);
+    for (int texel : vertexTexels) {
+        int x = texel % mapWidth;
+        int z = texel / mapWidth;
+        float height = heightMap.getHeight(x, z);
+        glm::vec3 position((static_cast<float>(x) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale,
+                           flattenWaterAreas(height) * verticalScale,
+                           (static_cast<float>(z) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale);
+        vertices.insert(vertices.end(), { position.x, position.y, position.z, height });
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    
+    // Shared vertices make cache-friendly triangle order worthwhile here
+    if (optimize) {
+        MeshOptimizer::Stats chunkStats = MeshOptimizer::optimize(vertices, 4, indices, true);
+        if (stats) {
+            *stats = chunkStats;
+        }
+    }
+    
+    chunk.boundsMin = boundsMin;
+    chunk.boundsMax = boundsMax;
+    return chunk;
+}
+
+// Trees live in their own chunked mesh since they keep baked per-vertex colors
+std::vector<MeshChunk> TerrainMeshBuilder::buildTreeChunks(const HeightMap& heightMap, const TerrainFields& fields,
+                                                           MeshOptimizer::Stats* stats) const {
+    // Chunks place their trees independently, so each one is a job. Chunks
+    // without trees stay in the list (empty) to keep chunk ids stable.
+    std::vector<MeshChunk> chunks(getTreeChunkCount(heightMap));
+    std::vector<MeshOptimizer::Stats> chunkStats(chunks.size(), MeshOptimizer::Stats{ 0, 0.0f, 0.0f });
+    getJobSystem().parallelFor(0, static_cast<int>(chunks.size()), 1, [&](int firstChunk, int endChunk) {
+        for (int chunkIndex = firstChunk; chunkIndex < endChunk; ++chunkIndex) {
+            chunks[chunkIndex] = buildTreeChunk(heightMap, fields, chunkIndex, true, &chunkStats[chunkIndex]);
+        }
+    });
+    
+    MeshOptimizer::Stats totals = { 0, 0.0f, 0.0f };
+    for (const MeshOptimizer::Stats& chunk : chunkStats) {
+        totals.acmrBefore += chunk.acmrBefore * chunk.triangleCount;
+        totals.acmrAfter += chunk.acmrAfter * chunk.triangleCount;
+        totals.triangleCount += chunk.triangleCount;
+    }
+    
+    if (totals.triangleCount > 0) {
+        totals.acmrBefore /= totals.triangleCount;
+        totals.acmrAfter /= totals.triangleCount;
+    }
+    if (stats) {
+        *stats = totals;
+    }
+    
+    return chunks;
+}
+
+int TerrainMeshBuilder::getTreeChunkCount(const HeightMap& heightMap) const {
+    int chunksX = (heightMap.getWidth() + chunkTexels - 1) / chunkTexels;
+    int chunksZ = (heightMap.getHeight() + chunkTexels - 1) / chunkTexels;
+    return chunksX * chunksZ;
+}
+
+std::vector<int> TerrainMeshBuilder::getTreeChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const {
+    // A tree only reads the height and fields at its own texel
+    std::vector<int> chunkIds;
+    if (rect.isEmpty()) return chunkIds;
+    
+    int chunksX = (heightMap.getWidth() + chunkTexels - 1) / chunkTexels;
+    for (int chunkZ = rect.y0 / chunkTexels; chunkZ <= (rect.y1 - 1) / chunkTexels; ++chunkZ) {
+        for (int chunkX = rect.x0 / chunkTexels; chunkX <= (rect.x1 - 1) / chunkTexels; ++chunkX) {
+            chunkIds.push_back(chunkZ * chunksX + chunkX);
+        }
+    }
+    return chunkIds;
+}
+
+std::vector<MeshChunk> TerrainMeshBuilder::rebuildTreeChunks(const HeightMap& heightMap, const TerrainFields& fields,
+                                                             const std::vector<int>& chunkIds) const {
+    std::vector<MeshChunk> chunks(chunkIds.size());
+    getJobSystem().parallelFor(0, static_cast<int>(chunkIds.size()), 1, [&](int first, int end) {
+        for (int i = first; i < end; ++i) {
+            chunks[i] = buildTreeChunk(heightMap, fields, chunkIds[i], false, nullptr);
+        }
+    });
+    return chunks;
+}
+
+MeshChunk TerrainMeshBuilder::buildTreeChunk(const HeightMap& heightMap, const TerrainFields& fields, int chunkIndex,
+                                             bool optimize, MeshOptimizer::Stats* stats) const {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    int chunksX = (mapWidth + chunkTexels - 1) / chunkTexels;
+    int chunkX = (chunkIndex % chunksX) * chunkTexels;
+    int chunkZ = (chunkIndex / chunksX) * chunkTexels;
+    
+    const float grassLevel = 0.35f;
+    const float rockLevel = 0.4f;
+    const float fullTreeDensity = 0.9f;
+    const float maxTreeSlope = 0.2f;    // About 35 degrees
+    // Seeded per chunk, so a chunk places the same trees whether the map is
+    // built whole or the chunk alone after an edit
+    std::mt19937 random(42u + static_cast<unsigned int>(chunkIndex));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    
+    // Takes recycled buffers when its first tree lands
+    MeshChunk mesh;
+    mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+    bool acquired = false;
+    int vertexCount = 0;
+    
+    // Use the original map grid for tree placement, not the reduced mesh grid
+    for (int z = std::max(2, chunkZ); z < std::min(chunkZ + chunkTexels, mapHeight - 2); z += 2) {
+        for (int x = std::max(2, chunkX); x < std::min(chunkX + chunkTexels, mapWidth - 2); x += 2) {
+            float height = heightMap.getHeight(x, z);
+            // No trees on steep ground, and fewer along ridge lines
+            if (height >= grassLevel && height < rockLevel && fields.getSlope(x, z) < maxTreeSlope) {
+                float density = fullTreeDensity * treeDensity * (1.0f + std::min(0.0f, fields.getCurvature(x, z)));
+                if (unit(random) < density) {
+                    float xPos = (static_cast<float>(x) / (mapWidth - 1) * 2.0f - 1.0f) * horizontalScale;
+                    float yPos = flattenWaterAreas(height) * verticalScale;
+                    float zPos = (static_cast<float>(z) / (mapHeight - 1) * 2.0f - 1.0f) * horizontalScale;
+                    float treeScale = 0.1f + unit(random) * 0.1f;
+                    
+                    if (!acquired) {
+                        mesh = MeshChunkPool::instance().acquire();
+                        mesh.boundsMin = glm::vec3(1e30f);
+                        mesh.boundsMax = glm::vec3(-1e30f);
+                        acquired = true;
+                    }
+                    addTreeAt(mesh.vertices, mesh.indices, xPos, yPos, zPos, treeScale, vertexCount);
+                    
+                    // Trees span at most 0.2 * scale sideways and 1.2 * scale up
+                    float radius = 0.2f * treeScale;
+                    mesh.boundsMin = glm::min(mesh.boundsMin, glm::vec3(xPos - radius, yPos, zPos - radius));
+                    mesh.boundsMax = glm::max(mesh.boundsMax, glm::vec3(xPos + radius, yPos + 1.2f * treeScale, zPos + radius));
+                }
+            }
+        }
+    }
+    
+    if (optimize && !mesh.indices.empty()) {
+        MeshOptimizer::Stats chunkStats = MeshOptimizer::optimize(mesh.vertices, 6, mesh.indices);
+        if (stats) {
+            *stats = chunkStats;
+        }
+    }
+    return mesh;
+}
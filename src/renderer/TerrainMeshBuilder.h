@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../terrain/HeightMap.h"
+#include "../terrain/TerrainFields.h"
+#include "AdaptiveMesher.h"
+#include "MeshOptimizer.h"
+
+// One drawable piece of a mesh: local vertices/indices plus world bounds
+struct MeshChunk {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+class JobSystem;
+
+// Builds terrain and tree geometry from a heightmap without touching GL, so
+// meshing can run on worker threads or offline.
+class TerrainMeshBuilder {
+public:
+    TerrainMeshBuilder();
+    
+    // Derived fields (normals, slope, curvature, occlusion) at the mesh's
+    // world scale; tree placement and the terrain shader read them
+    void buildFields(const HeightMap& heightMap, TerrainFields& fields) const;
+    // Refresh fields after an edit of rect; returns the fields that changed
+    HeightMapRect updateFields(const HeightMap& heightMap, const HeightMapRect& rect, TerrainFields& fields) const;
+    
+    // Terrain vertices: x, y, z, color lookup height (4 floats). Slope and
+    // shading come from the fields, sampled per fragment.
+    std::vector<MeshChunk> buildTerrainChunks(const HeightMap& heightMap, MeshOptimizer::Stats* stats = nullptr) const;
+    
+    // The chunks (as ids into buildTerrainChunks' result) that a heightmap
+    // edit touches, and a rebuild of them as jobs. A rebuilt regular grid
+    // chunk has the same size, so it can be updated in place. An adaptive
+    // chunk is one mesher tile: an edit also reshapes the tiles beside it,
+    // its size changes, and rebuilt chunks skip the vertex cache pass.
+    int getTerrainChunkCount(const HeightMap& heightMap) const;
+    std::vector<int> getTerrainChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const;
+    std::vector<MeshChunk> rebuildTerrainChunks(const HeightMap& heightMap, const std::vector<int>& chunkIds) const;
+    
+    // Regular grid meshes only: build one chunk, so a mesh can be streamed
+    // with bounded memory
+    MeshChunk buildTerrainChunk(const HeightMap& heightMap, int chunkIndex) const;
+    
+    // Tree vertices: x, y, z, r, g, b (6 floats). Every chunk of the grid
+    // is listed, empty where no tree stands.
+    std::vector<MeshChunk> buildTreeChunks(const HeightMap& heightMap, const TerrainFields& fields,
+                                           MeshOptimizer::Stats* stats = nullptr) const;
+    
+    // The tree chunks that a heightmap edit touches (fields included), and a
+    // rebuild of them as jobs that places the same trees a full build would
+    int getTreeChunkCount(const HeightMap& heightMap) const;
+    std::vector<int> getTreeChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const;
+    std::vector<MeshChunk> rebuildTreeChunks(const HeightMap& heightMap, const TerrainFields& fields,
+                                             const std::vector<int>& chunkIds) const;
+    
+    void setTriangleStepSize(int stepSize) { triangleStepSize = stepSize > 0 ? stepSize : 1; }
+    int getTriangleStepSize() const { return triangleStepSize; }
+    
+    // Maximum vertical error (world units) for the adaptive terrain mesh.
+    // 0 keeps the regular two-triangles-per-cell grid.
+    void setMaxMeshError(float maxError) { maxMeshError = maxError > 0.0f ? maxError : 0.0f; }
+    float getMaxMeshError() const { return maxMeshError; }
+    
+    // Share of suitable tree sites that get a tree (default 1)
+    void setTreeDensity(float density) { treeDensity = std::min(1.0f, std::max(0.0f, density)); }
+    float getTreeDensity() const { return treeDensity; }
+    
+    // Scheduler for per-chunk meshing (default: JobSystem::instance())
+    void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+    
+    // Height processing
+    static float flattenWaterAreas(float height);
+    
+    // World-space terrain extents, shared with the displacement shader
+    static constexpr float horizontalScale = 5.0f;
+    static constexpr float verticalScale = 4.0f;
+    
+    // Water flattening parameters, shared with the displacement shader
+    static constexpr float waterLevel = 0.3f;          // Changed from 0.0f to make more terrain underwater
+    static constexpr float waterTransitionZone = 0.2f;
+    static constexpr float waterDepthOffset = 0.03f;   // Smaller offset for a more subtle effect
+    
+    // Terrain lighting, shared with the terrain shaders: ambient share and
+    // the direction towards the sun
+    static constexpr float ambientLight = 0.35f;
+    static glm::vec3 getSunDirection() { return glm::normalize(glm::vec3(0.5f, 0.8f, 0.3f)); }
+    
+    // Heightmap texels per terrain / tree chunk side; adaptive chunks are
+    // mesher tiles
+    static constexpr int chunkTexels = AdaptiveMesher::tileCells;
+
+private:
+    int triangleStepSize; // Controls terrain mesh resolution
+    float maxMeshError;   // Adaptive mesh error bound, 0 = regular grid
+    float treeDensity;
+    JobSystem* jobs;
+    
+    JobSystem& getJobSystem() const;
+    
+    // Layout of the regular grid mesh and its chunks
+    struct RegularGrid {
+        int step;
+        int columns;        // Vertices per row
+        int rows;
+        int chunkCells;     // Cells per chunk side
+        int chunksX;
+        int chunksZ;
+    };
+    RegularGrid getRegularGrid(const HeightMap& heightMap) const;
+    
+    std::vector<MeshChunk> buildAdaptiveTerrainChunks(const HeightMap& heightMap, MeshOptimizer::Stats* stats) const;
+    std::vector<int> getAdaptiveChunksInRect(const HeightMap& heightMap, const HeightMapRect& rect) const;
+    MeshChunk buildAdaptiveTile(const AdaptiveMesher& mesher, const HeightMap& heightMap, int tileX, int tileZ,
+                                bool optimize, MeshOptimizer::Stats* stats) const;
+    static AdaptiveMesher::RowReader getDisplayRowReader(const HeightMap& heightMap);
+    TerrainFieldBuilder getFieldBuilder(const HeightMap& heightMap) const;
+    
+    // Tree generation
+    MeshChunk buildTreeChunk(const HeightMap& heightMap, const TerrainFields& fields, int chunkIndex,
+                             bool optimize, MeshOptimizer::Stats* stats) const;
+    static void addTreeAt(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+                          float x, float y, float z, float scale, int& vertexCount);
+};
@@ -0,0 +1,228 @@
+#include "TerrainStreamer.h"
+#include "MeshChunkPool.h"
+#include "../terrain/TerrainGenerator.h"
+#include "../utils/JobSystem.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // Requests and results in flight between stages
+    const size_t queueCapacity = 8;
+    
+    // Sample steps of the progressive preview levels, coarse to full
+    const int previewSteps[] = { 8, 4, 2, 1 };
+    const int previewLevelCount = sizeof(previewSteps) / sizeof(previewSteps[0]);
+}
+
+StreamedTerrain::~StreamedTerrain() {
+    // Terrain chunks go last, so the next terrain's take them back first
+    MeshChunkPool::instance().recycle(treeChunks);
+    MeshChunkPool::instance().recycle(terrainChunks);
+}
+
+TerrainStreamer::TerrainStreamer()
+    : requests(queueCapacity), generated(queueCapacity), finished(queueCapacity),
+      running(true), nextRequestId(1), latestRequestId(0), releasedSourceId(0) {
+    generationThread = std::thread(&TerrainStreamer::generationLoop, this);
+    meshingThread = std::thread(&TerrainStreamer::meshingLoop, this);
+}
+
+TerrainStreamer::~TerrainStreamer() {
+    stop();
+}
+
+int TerrainStreamer::request(TerrainRequest request) {
+    request.id = nextRequestId;
+    if (!requests.push(std::move(request))) {
+        return -1;
+    }
+    
+    // Whatever is being generated now is out of date
+    latestRequestId = nextRequestId;
+    {
+        std::lock_guard<std::mutex> lock(activeMutex);
+        if (activeTask.isValid()) {
+            activeTask.cancel();
+        }
+    }
+    
+    wake(generationWake);
+    return nextRequestId++;
+}
+
+std::unique_ptr<StreamedTerrain> TerrainStreamer::poll() {
+    std::unique_ptr<StreamedTerrain> terrain;
+    finished.pop(terrain);
+    return terrain;
+}
+
+void TerrainStreamer::stop() {
+    if (!running.exchange(false)) return;
+    
+    wake(generationWake);
+    wake(meshingWake);
+    if (generationThread.joinable()) generationThread.join();
+    if (meshingThread.joinable()) meshingThread.join();
+}
+
+void TerrainStreamer::releaseSource(TerrainRequest& request) {
+    if (!request.source) return;
+    
+    // The release store orders every read of the source before the render
+    // thread's acquire load in isSourceInUse, and so before its next edit
+    request.source.reset();
+    releasedSourceId.store(request.id, std::memory_order_release);
+}
+
+void TerrainStreamer::wake(std::condition_variable& condition) {
+    // Taking the lock orders this after a worker's emptiness check, so the
+    // notification cannot slip in before it starts waiting
+    { std::lock_guard<std::mutex> lock(wakeMutex); }
+    condition.notify_one();
+}
+
+void TerrainStreamer::generationLoop() {
+    TerrainGenerator generator;
+    
+    while (running) {
+        TerrainRequest request;
+        if (!requests.pop(request)) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            generationWake.wait(lock, [this] { return !running || !requests.empty(); });
+            continue;
+        }
+        
+        // Remeshing skips straight to the meshing stage, superseded or not:
+        // the meshing thread is the one that lets go of sources, in order
+        if (request.source) {
+            std::unique_ptr<GeneratedTerrain> terrain(new GeneratedTerrain());
+            terrain->request = request;
+            terrain->level = 0;
+            terrain->levelCount = 1;
+            while (running && !generated.push(std::move(terrain))) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            wake(meshingWake);
+            continue;
+        }
+        
+        if (isSuperseded(request)) continue;
+        
+        // Every level shares one seed so refinements sharpen the same landscape
+        generator.setNoiseLayers(request.noiseLayers);
+        generator.setShape(request.shape);
+        TerrainSeed seed = generator.createSeed(request.octaves);
+        generator.setErosion(request.erosion);
+        generator.setThermalErosion(request.thermalErosion);
+        generator.setSlopeDamping(request.slopeDamping);
+        generator.setHeightStorage(request.heightStorage);
+        generator.setClimate(request.climate);
+        int levelCount = request.progressive ? previewLevelCount : 1;
+        
+        for (int level = 0; level < levelCount && running; ++level) {
+            int step = request.progressive ? previewSteps[level] : 1;
+            
+            // Coarse levels also drop octaves; the full level uses them all
+            int octaves = std::max(1, request.octaves * (level + 1) / levelCount);
+            
+            TerrainTask task = generator.generateTerrainAsync(
+                seed, request.originX, request.originY, (request.width - 1) / step + 1,
+                (request.height - 1) / step + 1, step, request.scale, octaves, request.persistence, request.lacunarity);
+            {
+                std::lock_guard<std::mutex> lock(activeMutex);
+                activeTask = task;
+            }
+            
+            // Re-check after publishing, in case request() ran in between
+            if (isSuperseded(request) || !running) {
+                task.cancel();
+            }
+            
+            std::unique_ptr<HeightMap> heightMap = task.take();
+            {
+                std::lock_guard<std::mutex> lock(activeMutex);
+                activeTask = TerrainTask();
+            }
+            if (!heightMap) break;
+            
+            std::unique_ptr<GeneratedTerrain> terrain(new GeneratedTerrain());
+            terrain->request = request;
+            terrain->level = level;
+            terrain->levelCount = levelCount;
+            terrain->heightMap = std::move(heightMap);
+            terrain->climate = task.takeClimate();
+            
+            // The meshing stage is bounded; wait for room rather than drop work
+            while (running && !generated.push(std::move(terrain))) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            wake(meshingWake);
+        }
+    }
+}
+
+void TerrainStreamer::meshingLoop() {
+    while (running) {
+        std::unique_ptr<GeneratedTerrain> terrain;
+        if (!generated.pop(terrain)) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            meshingWake.wait(lock, [this] { return !running || !generated.empty(); });
+            continue;
+        }
+        
+        // A newer request was issued since this one; its terrain replaces this
+        if (isSuperseded(terrain->request)) {
+            releaseSource(terrain->request);
+            continue;
+        }
+        
+        const TerrainRequest& request = terrain->request;
+        const HeightMap& heightMap = request.source ? *request.source : *terrain->heightMap;
+        bool fullLevel = terrain->level == terrain->levelCount - 1;
+        int step = request.progressive ? previewSteps[terrain->level] : 1;
+        
+        // Preview levels keep their triangles about the size of the final mesh
+        TerrainMeshBuilder builder;
+        builder.setTriangleStepSize(std::max(1, request.triangleStepSize / step));
+        builder.setMaxMeshError(request.maxMeshError);
+        builder.setTreeDensity(request.treeDensity);
+        
+        std::unique_ptr<StreamedTerrain> result(new StreamedTerrain());
+        result->requestId = request.id;
+        result->level = terrain->level;
+        result->levelCount = terrain->levelCount;
+        result->remeshed = request.source != nullptr;
+        result->triangleStepSize = request.triangleStepSize;
+        result->maxMeshError = request.maxMeshError;
+        result->treeDensity = request.treeDensity;
+        result->terrainStats = { 0, 0.0f, 0.0f };
+        result->treeStats = { 0, 0.0f, 0.0f };
+        
+        // One fused pass derives the fields the terrain shader and the trees read
+        if (request.buildTerrainMesh || fullLevel) {
+            result->fields.reset(new TerrainFields());
+            builder.buildFields(heightMap, *result->fields);
+        }
+        if (request.buildTerrainMesh) {
+            result->terrainChunks = builder.buildTerrainChunks(heightMap, &result->terrainStats);
+        }
+        
+        // Trees only appear once the terrain is final
+        if (fullLevel) {
+            result->treeChunks = builder.buildTreeChunks(heightMap, *result->fields, &result->treeStats);
+        }
+        if (!request.source) {
+            result->pyramid.reset(new HeightPyramid());
+            result->pyramid->build(heightMap, JobSystem::instance());
+            result->heightMap = std::move(terrain->heightMap);
+            result->climate = std::move(terrain->climate);
+        } else {
+            releaseSource(terrain->request);
+        }
+        
+        // The render thread drains this every frame
+        while (running && !finished.push(std::move(result))) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
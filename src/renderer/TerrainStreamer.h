@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../terrain/HeightMap.h"
+#include "../terrain/HeightPyramid.h"
+#include "../terrain/TerrainTask.h"
+#include "../utils/SpscQueue.h"
+#include "TerrainMeshBuilder.h"
+
+// Everything needed to generate and mesh one terrain
+struct TerrainRequest {
+    int id;
+    int64_t originX;        // World texel of the terrain's corner
+    int64_t originY;
+    int width;
+    int height;
+    float scale;
+    int octaves;
+    float persistence;
+    float lacunarity;
+    int triangleStepSize;
+    float maxMeshError;
+    float treeDensity;
+    bool buildTerrainMesh;  // False when the GPU displaces the terrain itself
+    bool progressive;       // Deliver coarse preview levels before the full map
+    ErosionSettings erosion;
+    ThermalErosionSettings thermalErosion;
+    float slopeDamping;
+    HeightStorage heightStorage;          // Of the streamed heightmaps
+    std::vector<NoiseType> noiseLayers;   // Noise backend per octave
+    TerrainShapeFactory shape;            // Empty: octave sum
+    ClimateSettings climate;              // Moisture, temperature and biomes (off by default)
+    
+    // Set to mesh this heightmap again (with the mesh settings above)
+    // instead of generating one. The streamer only reads it, until
+    // TerrainStreamer::isSourceInUse(id) turns false; don't write it before.
+    std::shared_ptr<const HeightMap> source;
+};
+
+// A finished terrain, ready for upload on the render thread
+struct StreamedTerrain {
+    int requestId;
+    int level;              // Preview level, levelCount - 1 is full resolution
+    int levelCount;
+    bool remeshed;          // Meshed from a request's source map: no heightMap or pyramid
+    int triangleStepSize;   // Mesh settings of the request
+    float maxMeshError;
+    float treeDensity;
+    std::unique_ptr<HeightMap> heightMap;
+    std::unique_ptr<TerrainFields> fields;   // Null when nothing was meshed
+    std::unique_ptr<HeightPyramid> pyramid;  // For picking on the heightmap
+    std::unique_ptr<ClimateMap> climate;     // Null when climate is off or remeshed
+    std::vector<MeshChunk> terrainChunks;
+    std::vector<MeshChunk> treeChunks;
+    MeshOptimizer::Stats terrainStats;
+    MeshOptimizer::Stats treeStats;
+    
+    // Evicting a terrain (uploaded, superseded or dropped) recycles its
+    // chunk buffers for the next one
+    ~StreamedTerrain();
+};
+
+// Two-stage background pipeline: a generation thread turns requests into
+// heightmaps and a meshing thread turns heightmaps into mesh chunks. Stages
+// hand work to each other and to the render thread through lock-free SPSC
+// queues, so the render thread never waits on either of them.
+//
+// A new request supersedes older ones: in-flight generation is cancelled at
+// the next tile and queued older requests are skipped.
+//
+// A request with a source heightmap skips generation and only remeshes it,
+// so the renderer can change mesh detail without a stall.
+class TerrainStreamer {
+public:
+    TerrainStreamer();
+    ~TerrainStreamer();
+    
+    TerrainStreamer(const TerrainStreamer&) = delete;
+    TerrainStreamer& operator=(const TerrainStreamer&) = delete;
+    
+    // Render thread: queue a request (request.id is assigned). Returns the id,
+    // or -1 if the request queue is full.
+    int request(TerrainRequest request);
+    
+    // Render thread: take the next finished terrain, or nullptr
+    std::unique_ptr<StreamedTerrain> poll();
+    
+    // Render thread: whether the streamer may still read the source of
+    // request requestId. Once false, every read of it happened before this
+    // call returned, so the caller may write the heightmap again. Sources
+    // are released in request order, whether meshed or superseded.
+    bool isSourceInUse(int requestId) const {
+        return releasedSourceId.load(std::memory_order_acquire) < requestId;
+    }
+    
+    void stop();
+
+private:
+    struct GeneratedTerrain {
+        TerrainRequest request;
+        int level;
+        int levelCount;
+        std::unique_ptr<HeightMap> heightMap;
+        std::unique_ptr<ClimateMap> climate;
+    };
+    
+    SpscQueue<TerrainRequest> requests;
+    SpscQueue<std::unique_ptr<GeneratedTerrain>> generated;
+    SpscQueue<std::unique_ptr<StreamedTerrain>> finished;
+    
+    std::atomic<bool> running;
+    int nextRequestId;
+    std::atomic<int> latestRequestId;
+    std::atomic<int> releasedSourceId;  // Newest request whose source was let go of
+    
+    // Generation in progress, so a newer request can cancel it
+    std::mutex activeMutex;
+    TerrainTask activeTask;
+    
+    // Only used to park idle workers; the queues themselves are lock-free
+    std::mutex wakeMutex;
+    std::condition_variable generationWake;
+    std::condition_variable meshingWake;
+    
+    std::thread generationThread;
+    std::thread meshingThread;
+    
+    void generationLoop();
+    void meshingLoop();
+    void releaseSource(TerrainRequest& request);
+    void wake(std::condition_variable& condition);
+    bool isSuperseded(const TerrainRequest& request) const { return request.id < latestRequestId; }
+};
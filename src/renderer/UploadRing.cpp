@@ -0,0 +1,174 @@
+#include "UploadRing.h"
+#include <cstring>
+
+// Include GLFW and OpenGL headers
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+namespace {
+    // Keeps pixel-unpack and copy offsets suitably aligned
+    const size_t allocationAlignment = 256;
+}
+
+UploadRing::UploadRing(size_t capacity)
+    : capacity(capacity), buffer(0), mapped(nullptr), head(0),
+      frameBudget(0), frameBytes(0) {}
+
+UploadRing::~UploadRing() {
+    release();
+}
+
+void UploadRing::initialize() {
+#ifndef __APPLE__
+    if (!GLEW_ARB_buffer_storage) {
+        return;     // Direct glBufferSubData uploads
+    }
+    
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, capacity, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity, flags));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    
+    if (!mapped) {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+#endif
+}
+
+void UploadRing::release() {
+    for (FrameFence& fence : fences) {
+        glDeleteSync(static_cast<GLsync>(fence.sync));
+    }
+    fences.clear();
+    
+    if (buffer != 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    mapped = nullptr;
+    head = 0;
+}
+
+void UploadRing::beginFrame(size_t budgetBytes) {
+    frameBudget = budgetBytes;
+    frameBytes = 0;
+    frameRanges.clear();
+    
+    // Retire fences the GPU has passed, oldest first, without waiting
+    while (!fences.empty()) {
+        GLenum status = glClientWaitSync(static_cast<GLsync>(fences.front().sync), 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(static_cast<GLsync>(fences.front().sync));
+        fences.pop_front();
+    }
+}
+
+void UploadRing::endFrame() {
+    if (frameRanges.empty()) return;
+    
+    FrameFence fence;
+    fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fence.ranges.swap(frameRanges);
+    fences.push_back(std::move(fence));
+}
+
+bool UploadRing::uploadBuffer(unsigned int target, size_t offset, const void* data, size_t size) {
+    if (size == 0) return true;
+    if (!withinBudget(size)) return false;
+    
+    size_t ringOffset = 0;
+    if (mapped && allocate(size, ringOffset)) {
+        std::memcpy(mapped + ringOffset, data, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ringOffset, offset, size);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    } else if (mapped && size <= capacity) {
+        return false;   // Ring busy with in-flight frames, try again next frame
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    
+    frameBytes += size;
+    return true;
+}
+
+bool UploadRing::uploadTextureRows(unsigned int texture, int y, int width, int rows, const void* data,
+                                   unsigned int type, size_t texelBytes) {
+    size_t size = static_cast<size_t>(width) * rows * texelBytes;
+    if (size == 0) return true;
+    if (!withinBudget(size)) return false;
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, static_cast<GLint>(texelBytes));
+    glBindTexture(GL_TEXTURE_2D, texture);
+    
+    size_t ringOffset = 0;
+    if (mapped && allocate(size, ringOffset)) {
+        // Source the pixels from the ring through a pixel unpack buffer
+        std::memcpy(mapped + ringOffset, data, size);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, GL_RED, type, (void*)ringOffset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else if (mapped && size <= capacity) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return false;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, GL_RED, type, data);
+    }
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+    frameBytes += size;
+    return true;
+}
+
+bool UploadRing::withinBudget(size_t size) const {
+    // The first upload of a frame always goes through so large items progress
+    return frameBytes == 0 || frameBytes + size <= frameBudget;
+}
+
+bool UploadRing::allocate(size_t size, size_t& offset) {
+    size_t aligned = (size + allocationAlignment - 1) / allocationAlignment * allocationAlignment;
+    if (aligned > capacity) return false;
+    
+    size_t candidate = head + aligned > capacity ? 0 : head;
+    if (overlapsInFlight(candidate, aligned)) {
+        return false;
+    }
+    
+    offset = candidate;
+    head = candidate + aligned;
+    frameRanges.push_back({ candidate, aligned });
+    return true;
+}
+
+bool UploadRing::overlapsInFlight(size_t offset, size_t size) const {
+    // This frame's own writes are not fenced yet but are just as live
+    for (const Range& range : frameRanges) {
+        if (offset < range.offset + range.size && range.offset < offset + size) {
+            return true;
+        }
+    }
+    
+    for (const FrameFence& fence : fences) {
+        for (const Range& range : fence.ranges) {
+            if (offset < range.offset + range.size && range.offset < offset + size) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Staging ring for streaming data to the GPU without stalling the render
+// loop. With ARB_buffer_storage the ring is one persistently mapped buffer:
+// data is memcpy'd in and copied GPU-side into its destination, and each
+// frame's region is fenced so it is only reused once the GPU is done with
+// it. Without it, uploads go straight through glBufferSubData. Either way a
+// per-frame byte budget bounds how much upload work a single frame takes.
+class UploadRing {
+public:
+    explicit UploadRing(size_t capacity = 16 * 1024 * 1024);
+    ~UploadRing();
+    
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+    
+    // Requires a current GL context
+    void initialize();
+    void release();
+    
+    // Start a frame: retire finished fences and reset the byte budget
+    void beginFrame(size_t budgetBytes);
+    
+    // Fence everything written since beginFrame
+    void endFrame();
+    
+    // Copy size bytes into buffer at offset. Returns false when the budget or
+    // the ring is exhausted for this frame; the caller retries next frame.
+    bool uploadBuffer(unsigned int buffer, size_t offset, const void* data, size_t size);
+    
+    // Upload rows [y, y + rows) of a single-channel texture from tightly
+    // packed texels of the given GL type (GL_FLOAT, GL_HALF_FLOAT,
+    // GL_UNSIGNED_SHORT) and size
+    bool uploadTextureRows(unsigned int texture, int y, int width, int rows, const void* data,
+                           unsigned int type, size_t texelBytes);
+    
+    bool isPersistent() const { return mapped != nullptr; }
+    size_t getFrameBytes() const { return frameBytes; }
+    
+private:
+    struct Range {
+        size_t offset;
+        size_t size;
+    };
+    
+    // Ring regions the GPU may still be reading, one entry per frame
+    struct FrameFence {
+        void* sync;
+        std::vector<Range> ranges;
+    };
+    
+    size_t capacity;
+    unsigned int buffer;
+    unsigned char* mapped;
+    size_t head;
+    
+    size_t frameBudget;
+    size_t frameBytes;
+    std::vector<Range> frameRanges;
+    std::deque<FrameFence> fences;
+    
+    bool withinBudget(size_t size) const;
+    bool allocate(size_t size, size_t& offset);
+    bool overlapsInFlight(size_t offset, size_t size) const;
+};
@@ -0,0 +1,75 @@
+#include "ClimateMap.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace {
+    // Rows: temperature band, cold to hot. Columns: moisture band, arid to wet.
+    const uint8_t biomeTable[16] = {
+        static_cast<uint8_t>(Biome::Tundra), static_cast<uint8_t>(Biome::Tundra),
+        static_cast<uint8_t>(Biome::BorealForest), static_cast<uint8_t>(Biome::BorealForest),
+        
+        static_cast<uint8_t>(Biome::Shrubland), static_cast<uint8_t>(Biome::Grassland),
+        static_cast<uint8_t>(Biome::TemperateForest), static_cast<uint8_t>(Biome::BorealForest),
+        
+        static_cast<uint8_t>(Biome::Savanna), static_cast<uint8_t>(Biome::Grassland),
+        static_cast<uint8_t>(Biome::Grassland), static_cast<uint8_t>(Biome::TemperateForest),
+        
+        static_cast<uint8_t>(Biome::Desert), static_cast<uint8_t>(Biome::Savanna),
+        static_cast<uint8_t>(Biome::TropicalForest), static_cast<uint8_t>(Biome::TropicalForest),
+    };
+}
+
+ClimateSettings::ClimateSettings()
+    : scale(0.0f), octaves(3), contrast(2.0f), lapseHeight(0.35f), lapseRate(1.0f) {}
+
+void ClimateMap::resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    size_t texels = static_cast<size_t>(width) * height;
+    moisture.resize(texels);
+    temperature.resize(texels);
+    biome.resize(texels);
+}
+
+Biome Biomes::classify(uint8_t temperature, uint8_t moisture) {
+    return static_cast<Biome>(biomeTable[(temperature >> 6) << 2 | moisture >> 6]);
+}
+
+void Biomes::classify(const uint8_t* temperature, const uint8_t* moisture, size_t texelCount, uint8_t* biome) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(biomeTable));
+    const __m128i bandMask = _mm_set1_epi8(0x03);
+    for (; i + 16 <= texelCount; i += 16) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(temperature + i));
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(moisture + i));
+        
+        // There are no byte shifts; shift 16-bit lanes and mask off what
+        // crossed over from the neighboring byte
+        __m128i temperatureBand = _mm_and_si128(_mm_srli_epi16(t, 6), bandMask);
+        __m128i moistureBand = _mm_and_si128(_mm_srli_epi16(m, 6), bandMask);
+        __m128i index = _mm_or_si128(_mm_slli_epi16(temperatureBand, 2), moistureBand);
+        
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(biome + i), _mm_shuffle_epi8(table, index));
+    }
+#endif
+    for (; i < texelCount; ++i) {
+        biome[i] = biomeTable[(temperature[i] >> 6) << 2 | moisture[i] >> 6];
+    }
+}
+
+const char* Biomes::getName(Biome biome) {
+    switch (biome) {
+        case Biome::TemperateForest: return "temperate forest";
+        case Biome::Tundra: return "tundra";
+        case Biome::BorealForest: return "boreal forest";
+        case Biome::Shrubland: return "shrubland";
+        case Biome::Savanna: return "savanna";
+        case Biome::Desert: return "desert";
+        case Biome::TropicalForest: return "tropical forest";
+        case Biome::Grassland:
+        default: return "grassland";
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Land cover picked from temperature and moisture, Whittaker style. Water,
+// beaches, bare rock and snow still follow height and slope alone.
+enum class Biome : uint8_t {
+    Grassland,        // Temperate and middling: the look terrain had before climate
+    TemperateForest,
+    Tundra,
+    BorealForest,
+    Shrubland,
+    Savanna,
+    Desert,
+    TropicalForest
+};
+
+// Climate generated alongside the heights (see TerrainGenerator::setClimate)
+struct ClimateSettings {
+    ClimateSettings();
+    
+    float scale;            // Size of a climate noise cell in the units the terrain
+                            // noise samples in (texels / terrain scale); 0 = no climate
+    int octaves;            // Fractal octaves of both fields
+    float contrast;         // Spread of the raw noise over the 0..255 range
+    float lapseHeight;      // Normalized height where temperature starts to drop
+    float lapseRate;        // Share of the temperature range lost per unit of height above it
+};
+
+// Climate of a terrain as a structure of arrays: one 8-bit channel per
+// field, row-major like the heightmap, so a pass reads only the fields it
+// needs and rows of each channel stream through SIMD loops.
+struct ClimateMap {
+    int width;
+    int height;
+    
+    std::vector<uint8_t> moisture;      // 0 arid .. 255 wet
+    std::vector<uint8_t> temperature;   // 0 cold .. 255 hot, after the drop with altitude
+    std::vector<uint8_t> biome;         // Biome per texel
+    
+    ClimateMap() : width(0), height(0) {}
+    
+    void resize(int newWidth, int newHeight);
+    
+    float getMoisture(int x, int y) const { return moisture[index(x, y)] * (1.0f / 255.0f); }
+    float getTemperature(int x, int y) const { return temperature[index(x, y)] * (1.0f / 255.0f); }
+    Biome getBiome(int x, int y) const { return static_cast<Biome>(biome[index(x, y)]); }
+    
+    size_t index(int x, int y) const { return static_cast<size_t>(y) * width + x; }
+};
+
+// Biome classification. Temperature and moisture each fall into one of four
+// equal bands (their top two bits), and a 16-entry table maps the band pair
+// to a biome. With SSSE3 (TERRAIN_ENABLE_SSSE3) the bulk call looks up 16
+// texels per table shuffle; results match the scalar call either way.
+class Biomes {
+public:
+    static const int count = 8;
+    
+    static Biome classify(uint8_t temperature, uint8_t moisture);
+    static void classify(const uint8_t* temperature, const uint8_t* moisture, size_t texelCount, uint8_t* biome);
+    
+    static const char* getName(Biome biome);
+};
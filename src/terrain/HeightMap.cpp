@@ -1,41 +1,181 @@
 #include "HeightMap.h"
+#include "../utils/MemoryPool.h"
+#include <cstring>
 
-HeightMap::HeightMap(int width, int height, float* data) 
-    : width(width), height(height) {
-    this->data = new float[width * height];
-    for (int i = 0; i < width * height; i++) {
-        this->data[i] = data[i];
+namespace {
+    // Texel reads per storage, so the sampling loop is compiled once for each
+    struct ReadFloat32 {
+        const float* data;
+        float operator()(size_t index) const { return data[index]; }
+    };
+    
+    struct ReadFloat16 {
+        const uint16_t* data;
+        float operator()(size_t index) const { return HeightConversion::halfToFloat(data[index]); }
+    };
+    
+    struct ReadUNorm16 {
+        const uint16_t* data;
+        float operator()(size_t index) const { return HeightConversion::unorm16ToFloat(data[index]); }
+    };
+    
+    template <typename Read>
+    void sampleBilinearBatch(Read read, int width, int height, const float* x, const float* y, int count, float* out) {
+        float maxX = static_cast<float>(width - 1);
+        float maxY = static_cast<float>(height - 1);
+        // The last cell's upper corner is clamped for 1-texel-wide maps
+        int lastX = std::max(0, width - 2);
+        int lastY = std::max(0, height - 2);
+        int stepX = width > 1 ? 1 : 0;
+        size_t stepY = height > 1 ? static_cast<size_t>(width) : 0;
+        
+        for (int i = 0; i < count; ++i) {
+            // NaN coordinates fail both compares and land on texel 0
+            float sx = x[i] > 0.0f ? (x[i] < maxX ? x[i] : maxX) : 0.0f;
+            float sy = y[i] > 0.0f ? (y[i] < maxY ? y[i] : maxY) : 0.0f;
+            int x0 = std::min(static_cast<int>(sx), lastX);
+            int y0 = std::min(static_cast<int>(sy), lastY);
+            float fx = sx - x0;
+            float fy = sy - y0;
+            
+            size_t index = static_cast<size_t>(y0) * width + x0;
+            float h00 = read(index);
+            float h10 = read(index + stepX);
+            float h01 = read(index + stepY);
+            float h11 = read(index + stepY + stepX);
+            float top = h00 + (h10 - h00) * fx;
+            float bottom = h01 + (h11 - h01) * fx;
+            out[i] = top + (bottom - top) * fy;
+        }
     }
 }
 
-HeightMap::HeightMap(const HeightMap& other) 
-    : width(other.width), height(other.height) {
-    data = new float[width * height];
-    for (int i = 0; i < width * height; i++) {
-        data[i] = other.data[i];
+HeightMap::HeightMap(int width, int height, const float* data, HeightStorage storage)
+    : width(width), height(height), storage(storage) {
+    allocate();
+    for (int y = 0; y < height; ++y) {
+        writeRow(y, 0, width, data + static_cast<size_t>(y) * width);
     }
 }
 
+HeightMap::HeightMap(int width, int height, HeightStorage storage)
+    : width(width), height(height), storage(storage) {
+    allocate();
+}
+
+HeightMap::HeightMap(const HeightMap& other)
+    : width(other.width), height(other.height), storage(other.storage) {
+    allocate();
+    std::memcpy(data, other.data, getRawSize());
+}
+
 HeightMap& HeightMap::operator=(const HeightMap& other) {
     if (this != &other) {
-        delete[] data;
+        // Same byte size: keep the block, whatever the shape
+        bool resize = getRawSize() != other.getRawSize();
+        if (resize) {
+            release();
+        }
         width = other.width;
         height = other.height;
-        data = new float[width * height];
-        for (int i = 0; i < width * height; i++) {
-            data[i] = other.data[i];
+        storage = other.storage;
+        if (resize) {
+            allocate();
         }
+        std::memcpy(data, other.data, getRawSize());
     }
     return *this;
 }
 
 HeightMap::~HeightMap() {
-    delete[] data;
+    release();
+}
+
+void HeightMap::allocate() {
+    pool = &BufferPool::forSize(MemorySubsystem::HeightMaps, std::max<size_t>(1, getRawSize()));
+    data = pool->acquire();
+}
+
+void HeightMap::release() {
+    pool->release(data);
+    data = nullptr;
+}
+
+size_t HeightMap::getTexelBytes(HeightStorage storage) {
+    return storage == HeightStorage::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+void HeightMap::readRow(int y, int x0, int count, float* out) const {
+    size_t offset = static_cast<size_t>(y) * width + x0;
+    switch (storage) {
+        case HeightStorage::Float16:
+            HeightConversion::fromHalf(static_cast<const uint16_t*>(data) + offset, out, count);
+            break;
+        case HeightStorage::UNorm16:
+            HeightConversion::fromUNorm16(static_cast<const uint16_t*>(data) + offset, out, count);
+            break;
+        default:
+            std::memcpy(out, static_cast<const float*>(data) + offset, sizeof(float) * count);
+            break;
+    }
+}
+
+void HeightMap::writeRow(int y, int x0, int count, const float* in) {
+    size_t offset = static_cast<size_t>(y) * width + x0;
+    switch (storage) {
+        case HeightStorage::Float16:
+            HeightConversion::toHalf(in, static_cast<uint16_t*>(data) + offset, count);
+            break;
+        case HeightStorage::UNorm16:
+            HeightConversion::toUNorm16(in, static_cast<uint16_t*>(data) + offset, count);
+            break;
+        default:
+            std::memcpy(static_cast<float*>(data) + offset, in, sizeof(float) * count);
+            break;
+    }
+}
+
+float HeightMap::sampleBilinear(float x, float y) const {
+    float height;
+    sampleBilinear(&x, &y, 1, &height);
+    return height;
+}
+
+void HeightMap::sampleBilinear(const float* x, const float* y, int count, float* out) const {
+    switch (storage) {
+        case HeightStorage::Float16:
+            sampleBilinearBatch(ReadFloat16{ static_cast<const uint16_t*>(data) }, width, height, x, y, count, out);
+            break;
+        case HeightStorage::UNorm16:
+            sampleBilinearBatch(ReadUNorm16{ static_cast<const uint16_t*>(data) }, width, height, x, y, count, out);
+            break;
+        default:
+            sampleBilinearBatch(ReadFloat32{ static_cast<const float*>(data) }, width, height, x, y, count, out);
+            break;
+    }
+}
+
+void HeightMap::setStorage(HeightStorage newStorage) {
+    if (newStorage == storage) return;
+    
+    // Convert into a block of the new size, a row at a time through floats
+    HeightMap converted(width, height, newStorage);
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    float* row = arena.allocate<float>(width);
+    for (int y = 0; y < height; ++y) {
+        readRow(y, 0, width, row);
+        converted.writeRow(y, 0, width, row);
+    }
+    
+    std::swap(data, converted.data);
+    std::swap(pool, converted.pool);
+    storage = newStorage;
 }
 
-float HeightMap::getHeight(int x, int y) const {
+void HeightMap::setHeight(int x, int y, float value) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
-        return 0.0f;
+        return;
     }
-    return data[y * width + x];
+    writeRow(y, x, 1, &value);
 }
\ No newline at end of file
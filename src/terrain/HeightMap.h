@@ -1,19 +1,98 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include "../utils/HeightConversion.h"
+
+class BufferPool;
+
+// How a HeightMap keeps its [0, 1] heights. The 16-bit forms halve memory
+// and upload bandwidth; reads widen to float either way.
+enum class HeightStorage {
+    Float32,    // Exact
+    Float16,    // IEEE half: 11 significant bits, finest near 0
+    UNorm16     // Steps of 1/65535 across [0, 1]; values outside clamp
+};
+
+// Half-open texel rectangle [x0, x1) x [y0, y1), e.g. a region that changed
+struct HeightMapRect {
+    int x0, y0, x1, y1;
+    
+    bool isEmpty() const { return x0 >= x1 || y0 >= y1; }
+    
+    void include(const HeightMapRect& other) {
+        if (other.isEmpty()) return;
+        if (isEmpty()) {
+            *this = other;
+            return;
+        }
+        x0 = std::min(x0, other.x0);
+        y0 = std::min(y0, other.y0);
+        x1 = std::max(x1, other.x1);
+        y1 = std::max(y1, other.y1);
+    }
+};
+
+// Heights are stored in a block from the shared heightmap BufferPool, so a
+// map of the size just evicted reuses its memory rather than the heap's.
+// Maps hold 32-bit floats unless created with (or converted to) a 16-bit
+// storage; getHeight and readRow widen on read whatever the storage.
 class HeightMap {
 public:
-    HeightMap(int width, int height, float* data);
+    HeightMap(int width, int height, const float* data, HeightStorage storage = HeightStorage::Float32);
+    // Uninitialized heights, for producers that write every texel
+    HeightMap(int width, int height, HeightStorage storage = HeightStorage::Float32);
     HeightMap(const HeightMap& other);
     HeightMap& operator=(const HeightMap& other);
     ~HeightMap();
     
-    float getHeight(int x, int y) const;
+    float getHeight(int x, int y) const {
+        if (x < 0 || x >= width || y < 0 || y >= height) {
+            return 0.0f;
+        }
+        size_t index = static_cast<size_t>(y) * width + x;
+        switch (storage) {
+            case HeightStorage::Float16: return HeightConversion::halfToFloat(static_cast<const uint16_t*>(data)[index]);
+            case HeightStorage::UNorm16: return HeightConversion::unorm16ToFloat(static_cast<const uint16_t*>(data)[index]);
+            default: return static_cast<const float*>(data)[index];
+        }
+    }
     int getWidth() const { return width; }
     int getHeight() const { return height; }
-    const float* getData() const { return data; }
+    HeightStorage getStorage() const { return storage; }
     
+    // Bilinear height at fractional texel coordinates, clamped to the map
+    float sampleBilinear(float x, float y) const;
+    // count samples at (x[i], y[i]); the storage is dispatched once per batch
+    void sampleBilinear(const float* x, const float* y, int count, float* out) const;
+    
+    // The heights as floats; null unless the storage is Float32
+    const float* getData() const { return storage == HeightStorage::Float32 ? static_cast<const float*>(data) : nullptr; }
+    // Texels in their stored form, rows packed (e.g. for texture uploads)
+    const void* getRawData() const { return data; }
+    size_t getRawSize() const { return getTexelBytes(storage) * width * height; }
+    static size_t getTexelBytes(HeightStorage storage);
+    
+    // count heights of row y from column x0 on, widened to / narrowed from
+    // floats in bulk. The range must lie within the map.
+    void readRow(int y, int x0, int count, float* out) const;
+    void writeRow(int y, int x0, int count, const float* in);
+    
+    // Convert the heights in place; narrowing rounds them
+    void setStorage(HeightStorage newStorage);
+    
+    // Editing access; null unless the storage is Float32 (setStorage first).
+    // Callers track what they change (see TerrainEditor).
+    float* getMutableData() { return storage == HeightStorage::Float32 ? static_cast<float*>(data) : nullptr; }
+    void setHeight(int x, int y, float value);
+
 private:
     int width;
     int height;
-    float* data;
+    HeightStorage storage;
+    void* data;
+    BufferPool* pool;
+    
+    void allocate();
+    void release();
 };
\ No newline at end of file
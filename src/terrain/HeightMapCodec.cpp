@@ -0,0 +1,638 @@
+#include "HeightMapCodec.h"
+#include "../utils/JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const uint8_t magic[4] = { 'H', 'M', 'C', '2' };
+    const size_t headerSize = 24;
+    
+    // rANS with 12-bit probabilities and a 64-bit state renormalized 32
+    // bits at a time (after Giesen's rans64), so each decoded symbol reads
+    // at most one word
+    const int probabilityBits = 12;
+    const uint32_t probabilityScale = 1u << probabilityBits;
+    const uint64_t ransLowerBound = 1ull << 31;
+    
+    // Residual tokens: 0-15 code themselves, the rest a bit length and the
+    // bit below the leading one, up to 32-bit residuals
+    const int directTokens = 16;
+    const int tokenCount = directTokens + 2 * 28;
+    
+    enum Predictor { PredictPlane = 0, PredictMedian = 1 };
+    
+    void writeUint16(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+    
+    void writeUint32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+    
+    void writeUint64(uint8_t* out, uint64_t value) {
+        writeUint32(out, static_cast<uint32_t>(value));
+        writeUint32(out + 4, static_cast<uint32_t>(value >> 32));
+    }
+    
+    uint32_t readUint16(const uint8_t* in) {
+        return in[0] | (static_cast<uint32_t>(in[1]) << 8);
+    }
+    
+    uint32_t readUint32(const uint8_t* in) {
+        return in[0] | (static_cast<uint32_t>(in[1]) << 8) | (static_cast<uint32_t>(in[2]) << 16) |
+               (static_cast<uint32_t>(in[3]) << 24);
+    }
+    
+    // The format is little-endian, like every platform the renderer runs
+    // on, so the bit reader's hot loop can load words directly
+    uint64_t readUint64(const uint8_t* in) {
+        uint64_t value;
+        std::memcpy(&value, in, sizeof(value));
+        return value;
+    }
+    
+    float floatFromBits(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+    uint32_t bitsFromFloat(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    
+    // Float bits reordered so that larger floats give larger integers, which
+    // keeps neighbouring heights close for the predictors
+    uint32_t orderedFromFloat(float value) {
+        uint32_t bits = bitsFromFloat(value);
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+    
+    float floatFromOrdered(uint32_t ordered) {
+        return floatFromBits((ordered & 0x80000000u) ? ordered & 0x7FFFFFFFu : ~ordered);
+    }
+    
+    // Signed residual (mod 2^32) to 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+    uint32_t zigzag(uint32_t residual) {
+        int32_t value = static_cast<int32_t>(residual);
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+    
+    uint32_t unzigzag(uint32_t value) {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+    
+    int bitLength(uint32_t value) {
+        int length = 0;
+        while (length < 32 && (value >> length) != 0) {
+            ++length;
+        }
+        return length;
+    }
+    
+    // Residual to token plus extraBits raw bits
+    int tokenize(uint32_t value, int& extraBits) {
+        if (value < directTokens) {
+            extraBits = 0;
+            return static_cast<int>(value);
+        }
+        int length = bitLength(value);
+        extraBits = length - 2;
+        return directTokens + (length - 5) * 2 + static_cast<int>((value >> (length - 2)) & 1);
+    }
+    
+    // The plane is not clamped to the value range: residuals wrap mod 2^32
+    // either way, and one add is all the decoder's serial chain pays for it
+    uint32_t predict(Predictor predictor, uint32_t left, uint32_t above, uint32_t aboveLeft) {
+        int64_t plane = static_cast<int64_t>(left) + above - aboveLeft;
+        if (predictor == PredictMedian) {
+            // LOCO-I: the plane clamped between the two neighbours, which
+            // takes the smaller one above an edge and the larger below one
+            int64_t low = std::min(left, above);
+            int64_t high = std::max(left, above);
+            return static_cast<uint32_t>(std::min(high, std::max(low, plane)));
+        }
+        return static_cast<uint32_t>(plane);
+    }
+    
+    // Prediction for texel (x, y) of a tile row-major in values, width wide
+    uint32_t predictAt(Predictor predictor, const uint32_t* values, int width, int x, int y) {
+        if (y == 0) return x == 0 ? 0 : values[x - 1];
+        const uint32_t* row = values + static_cast<size_t>(y) * width;
+        if (x == 0) return row[-width];
+        return predict(predictor, row[x - 1], row[x - width], row[x - width - 1]);
+    }
+    
+    // Scale counts to frequencies summing to probabilityScale, keeping every
+    // used symbol at 1 or more
+    void normalizeFrequencies(const uint32_t* counts, int symbolCount, uint32_t total, uint32_t* frequencies) {
+        uint32_t sum = 0;
+        int largest = 0;
+        for (int i = 0; i < symbolCount; ++i) {
+            if (counts[i] == 0) {
+                frequencies[i] = 0;
+                continue;
+            }
+            frequencies[i] = std::max<uint32_t>(1, static_cast<uint32_t>(
+                static_cast<uint64_t>(counts[i]) * probabilityScale / total));
+            sum += frequencies[i];
+            if (frequencies[i] > frequencies[largest]) {
+                largest = i;
+            }
+        }
+        
+        // Rounding leaves the sum a little off; the most frequent symbol
+        // absorbs it, and the rest give up 1 each if that is not enough
+        while (sum != probabilityScale) {
+            if (sum < probabilityScale) {
+                frequencies[largest] += probabilityScale - sum;
+                sum = probabilityScale;
+            } else if (frequencies[largest] > sum - probabilityScale) {
+                frequencies[largest] -= sum - probabilityScale;
+                sum = probabilityScale;
+            } else {
+                for (int i = 0; i < symbolCount && sum > probabilityScale; ++i) {
+                    if (frequencies[i] > 1) {
+                        --frequencies[i];
+                        --sum;
+                    }
+                }
+            }
+        }
+    }
+    
+    void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    
+    bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (in == end) return false;
+            uint8_t byte = *in++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+    
+    struct BitWriter {
+        std::vector<uint8_t>& out;
+        uint64_t buffer;
+        int count;
+        
+        explicit BitWriter(std::vector<uint8_t>& out) : out(out), buffer(0), count(0) {}
+        
+        void write(uint32_t value, int bits) {
+            buffer |= static_cast<uint64_t>(value) << count;
+            count += bits;
+            while (count >= 8) {
+                out.push_back(static_cast<uint8_t>(buffer));
+                buffer >>= 8;
+                count -= 8;
+            }
+        }
+        
+        void flush() {
+            if (count > 0) {
+                out.push_back(static_cast<uint8_t>(buffer));
+            }
+            buffer = 0;
+            count = 0;
+        }
+    };
+    
+    // Residual token to its leading bits and the raw bits that follow
+    struct TokenCode {
+        uint32_t base;
+        uint32_t extraMask;
+        int extraBits;
+    };
+    
+    TokenCode tokenCode(int token) {
+        if (token < directTokens) return { static_cast<uint32_t>(token), 0, 0 };
+        int length = 5 + (token - directTokens) / 2;
+        return { (2u | (token & 1)) << (length - 2), (1u << (length - 2)) - 1, length - 2 };
+    }
+    
+    // Slot of the 12-bit probability range, packed as its symbol's frequency
+    // (13 bits, a lone symbol has all 4096), the slot's offset from the
+    // symbol's start (12) and the symbol (7)
+    uint32_t decodeEntry(uint32_t frequency, uint32_t offset, uint32_t symbol) {
+        return frequency | (offset << 13) | (symbol << 25);
+    }
+    
+    // Decode the tile's residuals. stream holds the rANS words, then the raw
+    // bits, then zero padding for a row's worth of reads (4 bytes a texel),
+    // so bounds are checked once per row rather than per texel. Texel x of
+    // each row uses rANS state x % 4: the four chains are independent, so
+    // their multiplies and table loads overlap.
+    bool decodeResiduals(const uint32_t* table, const TokenCode* codes, const uint8_t* stream, size_t ransSize,
+                         size_t rawSize, uint32_t* residuals, int width, int height) {
+        if (ransSize < 32) return false;
+        uint64_t state0 = readUint64(stream);
+        uint64_t state1 = readUint64(stream + 8);
+        uint64_t state2 = readUint64(stream + 16);
+        uint64_t state3 = readUint64(stream + 24);
+        size_t offset = 32;
+        const uint8_t* raw = stream + ransSize;
+        size_t position = 0;    // In raw bits
+        const uint32_t mask = probabilityScale - 1;
+        
+        // Renormalization is branch-free: whether a state needs a word is a
+        // coin flip at high bit depths. Each raw read loads the 8 bytes at
+        // the bit position, so reads only depend on each other through it.
+        auto step = [&](uint64_t& state) {
+            uint32_t entry = table[state & mask];
+            state = (entry & 0x1FFF) * (state >> probabilityBits) + ((entry >> 13) & 0xFFF);
+            uint64_t word = readUint32(stream + offset);
+            bool renormalize = state < ransLowerBound;
+            state = renormalize ? (state << 32) | word : state;
+            offset += renormalize ? 4 : 0;
+            const TokenCode& code = codes[entry >> 25];
+            uint64_t window = readUint64(raw + (position >> 3));
+            uint32_t extra = static_cast<uint32_t>(window >> (position & 7)) & code.extraMask;
+            position += code.extraBits;
+            return unzigzag(code.base | extra);
+        };
+        
+        for (int y = 0; y < height; ++y) {
+            // Corrupt data ran past the end
+            if (offset > ransSize || (position >> 3) > rawSize) return false;
+            
+            uint32_t* row = residuals + static_cast<size_t>(y) * width;
+            int x = 0;
+            for (; x + 4 <= width; x += 4) {
+                row[x] = step(state0);
+                row[x + 1] = step(state1);
+                row[x + 2] = step(state2);
+                row[x + 3] = step(state3);
+            }
+            if (x < width) row[x++] = step(state0);
+            if (x < width) row[x++] = step(state1);
+            if (x < width) row[x++] = step(state2);
+        }
+        return offset <= ransSize && position <= rawSize * 8;
+    }
+    
+    // Undo the prediction in place, turning residuals into values. The
+    // predictor is a template argument so the per-texel loop has no
+    // dispatch in it.
+    template <Predictor predictor>
+    void unpredict(uint32_t* values, int width, int height) {
+        for (int x = 1; x < width; ++x) {
+            values[x] += values[x - 1];
+        }
+        for (int y = 1; y < height; ++y) {
+            uint32_t* row = values + static_cast<size_t>(y) * width;
+            const uint32_t* above = row - width;
+            uint32_t left = row[0] + above[0];
+            row[0] = left;
+            for (int x = 1; x < width; ++x) {
+                left = row[x] + predict(predictor, left, above[x], above[x - 1]);
+                row[x] = left;
+            }
+        }
+    }
+}
+
+HeightMapCodecSettings::HeightMapCodecSettings() : bitDepth(16), tileSize(128) {}
+
+HeightMapCodec::HeightMapCodec(const HeightMapCodecSettings& settings) : settings(settings) {
+    this->settings.bitDepth = settings.bitDepth >= 32 ? 32 : std::min(24, std::max(1, settings.bitDepth));
+    this->settings.tileSize = std::min(static_cast<int>(maxTileSize), std::max(8, settings.tileSize));
+}
+
+std::vector<uint8_t> HeightMapCodec::encode(const HeightMap& heightMap, JobSystem& jobs) const {
+    if (heightMap.getData()) {
+        return encode(heightMap.getData(), heightMap.getWidth(), heightMap.getHeight(), jobs);
+    }
+    
+    // 16-bit storage: quantize from the widened heights
+    int width = heightMap.getWidth();
+    int height = heightMap.getHeight();
+    std::vector<float> heights(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+        heightMap.readRow(y, 0, width, heights.data() + static_cast<size_t>(y) * width);
+    }
+    return encode(heights.data(), width, height, jobs);
+}
+
+std::vector<uint8_t> HeightMapCodec::encode(const float* heights, int width, int height, JobSystem& jobs) const {
+    Info info;
+    info.width = std::max(0, width);
+    info.height = std::max(0, height);
+    info.tileSize = settings.tileSize;
+    info.bitDepth = settings.bitDepth;
+    info.minHeight = 0.0f;
+    info.maxHeight = 0.0f;
+    
+    size_t texelCount = static_cast<size_t>(info.width) * info.height;
+    if (texelCount > 0) {
+        auto range = std::minmax_element(heights, heights + texelCount);
+        info.minHeight = *range.first;
+        info.maxHeight = *range.second;
+    }
+    
+    int tilesX = info.getTilesX();
+    int tileCount = tilesX * info.getTilesY();
+    std::vector<std::vector<uint8_t>> tiles(tileCount);
+    jobs.parallelFor(0, tileCount, 1, [&](int firstTile, int endTile) {
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            encodeTile(heights, info.width, info, tile % tilesX, tile / tilesX, tiles[tile]);
+        }
+    });
+    
+    // Header, tile offsets from the end of the offset table, then the tiles
+    size_t tableSize = (static_cast<size_t>(tileCount) + 1) * 4;
+    size_t payloadSize = 0;
+    for (const std::vector<uint8_t>& tile : tiles) {
+        payloadSize += tile.size();
+    }
+    std::vector<uint8_t> out(headerSize + tableSize + payloadSize);
+    
+    uint8_t* header = out.data();
+    std::memcpy(header, magic, 4);
+    writeUint32(header + 4, info.width);
+    writeUint32(header + 8, info.height);
+    writeUint16(header + 12, info.tileSize);
+    header[14] = static_cast<uint8_t>(info.bitDepth);
+    header[15] = 0;
+    writeUint32(header + 16, bitsFromFloat(info.minHeight));
+    writeUint32(header + 20, bitsFromFloat(info.maxHeight));
+    
+    uint8_t* table = header + headerSize;
+    uint8_t* payload = table + tableSize;
+    size_t offset = 0;
+    for (int tile = 0; tile < tileCount; ++tile) {
+        writeUint32(table + tile * 4, static_cast<uint32_t>(offset));
+        if (!tiles[tile].empty()) {
+            std::memcpy(payload + offset, tiles[tile].data(), tiles[tile].size());
+        }
+        offset += tiles[tile].size();
+    }
+    writeUint32(table + tileCount * 4, static_cast<uint32_t>(offset));
+    
+    return out;
+}
+
+void HeightMapCodec::encodeTile(const float* heights, int width, const Info& info, int tileX, int tileY,
+                                std::vector<uint8_t>& out) {
+    int x0 = tileX * info.tileSize;
+    int y0 = tileY * info.tileSize;
+    int tileWidth = std::min(info.tileSize, info.width - x0);
+    int tileHeight = std::min(info.tileSize, info.height - y0);
+    int count = tileWidth * tileHeight;
+    bool exact = info.bitDepth == 32;
+    uint32_t maxValue = exact ? 0xFFFFFFFFu : (1u << info.bitDepth) - 1;
+    
+    // Quantize
+    std::vector<uint32_t> values(count);
+    double range = static_cast<double>(info.maxHeight) - info.minHeight;
+    double toLevels = range > 0.0 ? maxValue / range : 0.0;
+    for (int y = 0; y < tileHeight; ++y) {
+        const float* row = heights + static_cast<size_t>(y0 + y) * width + x0;
+        for (int x = 0; x < tileWidth; ++x) {
+            if (exact) {
+                values[y * tileWidth + x] = orderedFromFloat(row[x]);
+            } else {
+                double level = std::floor((row[x] - static_cast<double>(info.minHeight)) * toLevels + 0.5);
+                values[y * tileWidth + x] = static_cast<uint32_t>(std::min<double>(maxValue, std::max(0.0, level)));
+            }
+        }
+    }
+    
+    // Pick the predictor that leaves the fewest residual bits
+    Predictor predictor = PredictPlane;
+    uint64_t bestCost = ~0ull;
+    for (Predictor candidate : { PredictPlane, PredictMedian }) {
+        uint64_t cost = 0;
+        for (int y = 0; y < tileHeight; ++y) {
+            for (int x = 0; x < tileWidth; ++x) {
+                uint32_t prediction = predictAt(candidate, values.data(), tileWidth, x, y);
+                cost += bitLength(zigzag(values[y * tileWidth + x] - prediction));
+            }
+        }
+        if (cost < bestCost) {
+            bestCost = cost;
+            predictor = candidate;
+        }
+    }
+    
+    // Residual tokens, their statistics and the raw bits after them
+    std::vector<uint8_t> tokens(count);
+    std::vector<uint8_t> rawBits;
+    BitWriter bits(rawBits);
+    uint32_t counts[tokenCount] = {};
+    for (int y = 0; y < tileHeight; ++y) {
+        for (int x = 0; x < tileWidth; ++x) {
+            uint32_t prediction = predictAt(predictor, values.data(), tileWidth, x, y);
+            uint32_t residual = zigzag(values[y * tileWidth + x] - prediction);
+            int extraBits;
+            int token = tokenize(residual, extraBits);
+            tokens[y * tileWidth + x] = static_cast<uint8_t>(token);
+            ++counts[token];
+            if (extraBits > 0) {
+                bits.write(residual & ((1u << extraBits) - 1), extraBits);
+            }
+        }
+    }
+    bits.flush();
+    
+    int symbolCount = tokenCount;
+    while (symbolCount > 1 && counts[symbolCount - 1] == 0) {
+        --symbolCount;
+    }
+    uint32_t frequencies[tokenCount] = {};
+    uint32_t starts[tokenCount] = {};
+    normalizeFrequencies(counts, symbolCount, static_cast<uint32_t>(count), frequencies);
+    for (int i = 1; i < symbolCount; ++i) {
+        starts[i] = starts[i - 1] + frequencies[i - 1];
+    }
+    
+    // rANS runs backwards: the last token is encoded first, into the end
+    // of the buffer, so the decoder reads tokens and bytes front to back.
+    // Texel x of each row uses state x % 4.
+    std::vector<uint8_t> rans(static_cast<size_t>(count) * 4 + 32);
+    uint8_t* ransEnd = rans.data() + rans.size();
+    uint8_t* cursor = ransEnd;
+    uint64_t states[4] = { ransLowerBound, ransLowerBound, ransLowerBound, ransLowerBound };
+    for (int i = count - 1; i >= 0; --i) {
+        uint64_t& state = states[(i % tileWidth) & 3];
+        uint64_t frequency = frequencies[tokens[i]];
+        uint64_t limit = ((ransLowerBound >> probabilityBits) << 32) * frequency;
+        if (state >= limit) {
+            cursor -= 4;
+            writeUint32(cursor, static_cast<uint32_t>(state));
+            state >>= 32;
+        }
+        state = ((state / frequency) << probabilityBits) + state % frequency + starts[tokens[i]];
+    }
+    cursor -= 32;
+    for (int i = 0; i < 4; ++i) {
+        writeUint64(cursor + 8 * i, states[i]);
+    }
+    
+    // Predictor, frequency table, rANS stream, raw bits
+    out.push_back(static_cast<uint8_t>(predictor));
+    out.push_back(static_cast<uint8_t>(symbolCount));
+    for (int i = 0; i < symbolCount; ++i) {
+        writeVarint(out, frequencies[i]);
+    }
+    size_t ransSize = ransEnd - cursor;
+    size_t ransOffset = out.size();
+    out.resize(ransOffset + 4 + ransSize);
+    writeUint32(&out[ransOffset], static_cast<uint32_t>(ransSize));
+    std::memcpy(&out[ransOffset + 4], cursor, ransSize);
+    out.insert(out.end(), rawBits.begin(), rawBits.end());
+}
+
+bool HeightMapCodec::readInfo(const uint8_t* data, size_t size, Info& info) {
+    if (size < headerSize || std::memcmp(data, magic, 4) != 0) return false;
+    
+    info.width = static_cast<int>(readUint32(data + 4));
+    info.height = static_cast<int>(readUint32(data + 8));
+    info.tileSize = static_cast<int>(readUint16(data + 12));
+    info.bitDepth = data[14];
+    info.minHeight = floatFromBits(readUint32(data + 16));
+    info.maxHeight = floatFromBits(readUint32(data + 20));
+    if (info.width < 0 || info.height < 0 || info.tileSize < 1 || info.tileSize > maxTileSize ||
+        (info.bitDepth > 24 && info.bitDepth != 32) || info.bitDepth < 1) {
+        return false;
+    }
+    
+    // Half a quantization step, plus the float rounding of min + level * step
+    float largest = std::max(std::fabs(info.minHeight), std::fabs(info.maxHeight));
+    float ulp = std::nextafter(largest, INFINITY) - largest;
+    info.maxError = info.bitDepth == 32 ? 0.0f :
+        (info.maxHeight - info.minHeight) / static_cast<float>((1u << info.bitDepth) - 1) * 0.5f + 2.0f * ulp;
+    
+    // The offset table must fit too
+    size_t tileCount = static_cast<size_t>(info.getTilesX()) * info.getTilesY();
+    return size >= headerSize + (tileCount + 1) * 4;
+}
+
+bool HeightMapCodec::decode(const uint8_t* data, size_t size, float* heights, JobSystem& jobs) {
+    Info info;
+    if (!readInfo(data, size, info)) return false;
+    
+    int tilesX = info.getTilesX();
+    int tileCount = tilesX * info.getTilesY();
+    std::atomic<bool> valid(true);
+    jobs.parallelFor(0, tileCount, 1, [&](int firstTile, int endTile) {
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            int tileX = tile % tilesX;
+            int tileY = tile / tilesX;
+            float* out = heights + static_cast<size_t>(tileY) * info.tileSize * info.width + tileX * info.tileSize;
+            if (!decodeTile(data, size, tileX, tileY, out, info.width)) {
+                valid = false;
+            }
+        }
+    });
+    return valid;
+}
+
+std::unique_ptr<HeightMap> HeightMapCodec::decode(const std::vector<uint8_t>& data, JobSystem& jobs,
+                                                  HeightStorage storage) {
+    Info info;
+    if (!readInfo(data.data(), data.size(), info)) return nullptr;
+    
+    std::vector<float> heights(static_cast<size_t>(info.width) * info.height);
+    if (!decode(data.data(), data.size(), heights.data(), jobs)) return nullptr;
+    return std::unique_ptr<HeightMap>(new HeightMap(info.width, info.height, heights.data(), storage));
+}
+
+bool HeightMapCodec::decodeTile(const uint8_t* data, size_t size, int tileX, int tileY, float* out, int stride) {
+    Info info;
+    if (!readInfo(data, size, info)) return false;
+    if (tileX < 0 || tileY < 0 || tileX >= info.getTilesX() || tileY >= info.getTilesY()) return false;
+    
+    size_t tileCount = static_cast<size_t>(info.getTilesX()) * info.getTilesY();
+    size_t tile = static_cast<size_t>(tileY) * info.getTilesX() + tileX;
+    const uint8_t* table = data + headerSize;
+    const uint8_t* payload = table + (tileCount + 1) * 4;
+    size_t begin = readUint32(table + tile * 4);
+    size_t end = readUint32(table + (tile + 1) * 4);
+    if (begin > end || end > static_cast<size_t>(data + size - payload)) return false;
+    
+    return decodeTile(payload + begin, end - begin, info, tileX, tileY, out, stride);
+}
+
+bool HeightMapCodec::decodeTile(const uint8_t* tile, size_t size, const Info& info, int tileX, int tileY,
+                                float* out, int stride) {
+    const uint8_t* end = tile + size;
+    if (size < 2) return false;
+    int predictor = tile[0];
+    int symbolCount = tile[1];
+    if (predictor > PredictMedian || symbolCount < 1 || symbolCount > tokenCount) return false;
+    
+    // Frequency table to decode slots
+    const uint8_t* in = tile + 2;
+    uint32_t table[probabilityScale];
+    uint32_t start = 0;
+    for (int symbol = 0; symbol < symbolCount; ++symbol) {
+        uint32_t frequency;
+        if (!readVarint(in, end, frequency) || frequency > probabilityScale - start) return false;
+        for (uint32_t offset = 0; offset < frequency; ++offset) {
+            table[start + offset] = decodeEntry(frequency, offset, symbol);
+        }
+        start += frequency;
+    }
+    if (start != probabilityScale || end - in < 4) return false;
+    
+    TokenCode codes[tokenCount];
+    for (int token = 0; token < tokenCount; ++token) {
+        codes[token] = tokenCode(token);
+    }
+    
+    size_t ransSize = readUint32(in);
+    in += 4;
+    if (ransSize > static_cast<size_t>(end - in)) return false;
+    size_t rawSize = end - (in + ransSize);
+    
+    int tileWidth = std::min(info.tileSize, info.width - tileX * info.tileSize);
+    int tileHeight = std::min(info.tileSize, info.height - tileY * info.tileSize);
+    bool exact = info.bitDepth == 32;
+    uint32_t maxValue = exact ? 0xFFFFFFFFu : (1u << info.bitDepth) - 1;
+    
+    std::vector<uint8_t> stream(in, end);
+    stream.resize(stream.size() + static_cast<size_t>(tileWidth) * 4 + 8);
+    std::vector<uint32_t> values(static_cast<size_t>(tileWidth) * tileHeight);
+    if (!decodeResiduals(table, codes, stream.data(), ransSize, rawSize, values.data(), tileWidth, tileHeight)) {
+        return false;
+    }
+    if (predictor == PredictPlane) {
+        unpredict<PredictPlane>(values.data(), tileWidth, tileHeight);
+    } else {
+        unpredict<PredictMedian>(values.data(), tileWidth, tileHeight);
+    }
+    
+    // Back to heights
+    float step = exact ? 0.0f : (info.maxHeight - info.minHeight) / static_cast<float>(maxValue);
+    for (int y = 0; y < tileHeight; ++y) {
+        const uint32_t* row = values.data() + static_cast<size_t>(y) * tileWidth;
+        float* target = out + static_cast<size_t>(y) * stride;
+        if (exact) {
+            for (int x = 0; x < tileWidth; ++x) {
+                target[x] = floatFromOrdered(row[x]);
+            }
+        } else {
+            // Levels stay below 2^24, so the signed conversion is exact
+            for (int x = 0; x < tileWidth; ++x) {
+                target[x] = info.minHeight + static_cast<float>(static_cast<int32_t>(row[x])) * step;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "HeightMap.h"
+
+class JobSystem;
+
+struct HeightMapCodecSettings {
+    HeightMapCodecSettings();
+    
+    int bitDepth;   // 1-24: heights quantized over the map's range; 32: exact float bits
+    int tileSize;   // Texels per tile side; tiles encode and decode independently
+};
+
+// Dependency-free compression for heightmaps, for storage and transfer.
+//
+// Heights are quantized to bitDepth bits over the map's [min, max] range
+// (32 keeps the float bits themselves, so decoding is exact), and each
+// value is predicted from its left, upper and upper-left neighbours. Per
+// tile, whichever of the plane (left + above - upper left) and LOCO-I
+// median edge predictors fits better is used. Residuals are coded as a
+// token (small values exactly, larger ones as a bit length plus the next
+// bit) entropy coded with four interleaved rANS states, followed by the
+// remaining bits raw. Smooth terrain mostly codes as one rANS symbol per
+// texel and no raw bits at all.
+//
+// Tiles have their own frequency tables and an offset table points at
+// each, so they can be decoded alone (random access) or all in parallel.
+// Decoding reproduces the quantized levels exactly, so heights are off by
+// at most Info::maxError (and not at all at 32 bits).
+//
+// Measured decode speed (--benchmark codec, 2048^2 map, one 2.2 GHz VM
+// core) is 0.6-0.65 GB/s of float heights at best, up from 0.45-0.5 with
+// two states. That is short of 1 GB/s per core. The rANS step and writing
+// the output take most of the time. Tiles decode in parallel, so
+// throughput grows with the number of cores.
+class HeightMapCodec {
+public:
+    struct Info {
+        int width;
+        int height;
+        int tileSize;
+        int bitDepth;
+        float minHeight;
+        float maxHeight;
+        float maxError;     // Largest quantization error, 0 for 32 bits
+        
+        int getTilesX() const { return (width + tileSize - 1) / tileSize; }
+        int getTilesY() const { return (height + tileSize - 1) / tileSize; }
+    };
+    
+    explicit HeightMapCodec(const HeightMapCodecSettings& settings);
+    
+    // Encode heights (width * height, row-major), one job per tile
+    std::vector<uint8_t> encode(const float* heights, int width, int height, JobSystem& jobs) const;
+    std::vector<uint8_t> encode(const HeightMap& heightMap, JobSystem& jobs) const;
+    
+    // Read the header of an encoded map. Returns false if it is not one.
+    static bool readInfo(const uint8_t* data, size_t size, Info& info);
+    
+    // Decode a whole map into heights (width * height), one job per tile.
+    // Returns false if the data is truncated or corrupt.
+    static bool decode(const uint8_t* data, size_t size, float* heights, JobSystem& jobs);
+    
+    // Decode into a new heightmap in the given storage; nullptr if the data
+    // is truncated or corrupt. UNorm16 keeps about what a 16-bit encoding holds.
+    static std::unique_ptr<HeightMap> decode(const std::vector<uint8_t>& data, JobSystem& jobs,
+                                             HeightStorage storage = HeightStorage::Float32);
+    
+    // Decode one tile into out, whose rows are stride floats apart
+    static bool decodeTile(const uint8_t* data, size_t size, int tileX, int tileY, float* out, int stride);
+    
+    static const int maxTileSize = 1024;
+
+private:
+    HeightMapCodecSettings settings;
+    
+    static void encodeTile(const float* heights, int width, const Info& info, int tileX, int tileY,
+                           std::vector<uint8_t>& out);
+    static bool decodeTile(const uint8_t* tile, size_t size, const Info& info, int tileX, int tileY,
+                           float* out, int stride);
+};
@@ -0,0 +1,378 @@
+#include "HeightPyramid.h"
+#include "../utils/JobSystem.h"
+#include "../utils/MemoryPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // Upper levels are cheap; rows of nodes per job when reducing them
+    const int reduceRowGrain = 16;
+    
+    // Front-to-back traversal defers at most two siblings per level
+    const int maxStackDepth = 128;
+    
+    // A ray with its reciprocal direction, for clipping against node boxes
+    struct ClipRay {
+        float originX, originY;
+        float inverseX, inverseY;
+        bool flatX, flatY;
+        
+        explicit ClipRay(const HeightRay& ray)
+            : originX(ray.originX), originY(ray.originY),
+              inverseX(1.0f / ray.directionX), inverseY(1.0f / ray.directionY),
+              flatX(ray.directionX == 0.0f), flatY(ray.directionY == 0.0f) {}
+    };
+    
+    // Narrow [tEnter, tExit] to where the ray lies in [lo, hi] on one axis.
+    // A ray parallel to the axis is tested directly, as 0 * inf is NaN.
+    bool clipAxis(float origin, float inverse, bool flat, float lo, float hi, float& tEnter, float& tExit) {
+        if (flat) {
+            return origin >= lo && origin <= hi && tEnter <= tExit;
+        }
+        float t0 = (lo - origin) * inverse;
+        float t1 = (hi - origin) * inverse;
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        return tEnter <= tExit;
+    }
+    
+    bool clipBox(const ClipRay& ray, float x0, float y0, float x1, float y1, float& tEnter, float& tExit) {
+        return clipAxis(ray.originX, ray.inverseX, ray.flatX, x0, x1, tEnter, tExit) &&
+               clipAxis(ray.originY, ray.inverseY, ray.flatY, y0, y1, tEnter, tExit);
+    }
+    
+    // Smallest s in [0, length] where the ray drops to the bilinear patch
+    // (corners h00, h10, h01, h11) it crosses. The ray is rebased to its
+    // entry point (u, v, z) so the coefficients stay small far from the
+    // origin. Along the ray, ray height minus surface height is quadratic.
+    bool intersectPatch(float h00, float h10, float h01, float h11, float u, float v, float z,
+                        float du, float dv, float dz, float length, float& s) {
+        float b = h10 - h00;
+        float c = h01 - h00;
+        float d = h00 - h10 - h01 + h11;
+        
+        float qa = -d * du * dv;
+        float qb = dz - b * du - c * dv - d * (u * dv + v * du);
+        float qc = z - (h00 + b * u + c * v + d * u * v);
+        if (qc <= 0.0f) {
+            s = 0.0f;
+            return true;
+        }
+        
+        float best = std::numeric_limits<float>::infinity();
+        if (std::fabs(qa) <= 1e-12f * (std::fabs(qb) + std::fabs(qc))) {
+            if (qb < 0.0f) best = -qc / qb;
+        } else {
+            float discriminant = qb * qb - 4.0f * qa * qc;
+            if (discriminant >= 0.0f) {
+                // The stable pair of roots; the first positive one is the entry
+                float q = -0.5f * (qb + std::copysign(std::sqrt(discriminant), qb));
+                float roots[2] = { q / qa, q != 0.0f ? qc / q : best };
+                for (float root : roots) {
+                    if (root >= 0.0f && root < best) best = root;
+                }
+            }
+        }
+        if (best <= length) {
+            s = best;
+            return true;
+        }
+        
+        // A root rounded just past the exit still counts if the ray ends below
+        float end = qc + length * (qb + length * qa);
+        if (end <= 0.0f) {
+            s = length;
+            return true;
+        }
+        return false;
+    }
+}
+
+HeightPyramid::HeightPyramid() : mapWidth(0), mapHeight(0) {}
+
+void HeightPyramid::build(const HeightMap& heightMap, JobSystem& jobs) {
+    mapWidth = heightMap.getWidth();
+    mapHeight = heightMap.getHeight();
+    levels.clear();
+    if (mapWidth <= 0 || mapHeight <= 0) return;
+    
+    int cellsX = std::max(1, mapWidth - 1);
+    int cellsY = std::max(1, mapHeight - 1);
+    int width = (cellsX + leafCells - 1) / leafCells;
+    int height = (cellsY + leafCells - 1) / leafCells;
+    int cellSize = leafCells;
+    while (true) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.cellSize = cellSize;
+        level.nodes.resize(static_cast<size_t>(width) * height);
+        levels.push_back(std::move(level));
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        cellSize *= 2;
+    }
+    
+    buildLeaves(heightMap, 0, 0, levels[0].width, levels[0].height, jobs);
+    for (size_t level = 1; level < levels.size(); ++level) {
+        reduceLevel(static_cast<int>(level), 0, 0, levels[level].width, levels[level].height, jobs);
+    }
+}
+
+void HeightPyramid::update(const HeightMap& heightMap, const HeightMapRect& rect, JobSystem& jobs) {
+    if (rect.isEmpty()) return;
+    if (heightMap.getWidth() != mapWidth || heightMap.getHeight() != mapHeight || levels.empty()) {
+        build(heightMap, jobs);
+        return;
+    }
+    
+    // A texel on a leaf edge belongs to the leaves on both sides
+    int x0 = std::max(0, (rect.x0 - 1) / leafCells);
+    int y0 = std::max(0, (rect.y0 - 1) / leafCells);
+    int x1 = std::min(levels[0].width, (rect.x1 - 1) / leafCells + 1);
+    int y1 = std::min(levels[0].height, (rect.y1 - 1) / leafCells + 1);
+    if (x0 >= x1 || y0 >= y1) return;
+    buildLeaves(heightMap, x0, y0, x1, y1, jobs);
+    
+    for (size_t level = 1; level < levels.size(); ++level) {
+        x0 /= 2;
+        y0 /= 2;
+        x1 = (x1 + 1) / 2;
+        y1 = (y1 + 1) / 2;
+        reduceLevel(static_cast<int>(level), x0, y0, x1, y1, jobs);
+    }
+}
+
+void HeightPyramid::buildLeaves(const HeightMap& heightMap, int x0, int y0, int x1, int y1, JobSystem& jobs) {
+    Level& leaves = levels[0];
+    
+    jobs.parallelFor(y0, y1, 0, [&](int firstRow, int endRow) {
+        // The texels under leaves [x0, x1), widened a row at a time
+        int texelX0 = x0 * leafCells;
+        int texelX1 = std::min(x1 * leafCells, mapWidth - 1);
+        ScratchArena& arena = ScratchArena::forThread();
+        ScratchArena::Scope arenaScope(arena);
+        float* row = arena.allocate<float>(texelX1 - texelX0 + 1);
+        
+        for (int leafY = firstRow; leafY < endRow; ++leafY) {
+            Bounds* nodes = leaves.nodes.data() + static_cast<size_t>(leafY) * leaves.width;
+            for (int leafX = x0; leafX < x1; ++leafX) {
+                nodes[leafX] = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+            }
+            
+            int texelY1 = std::min((leafY + 1) * leafCells, mapHeight - 1);
+            for (int y = leafY * leafCells; y <= texelY1; ++y) {
+                heightMap.readRow(y, texelX0, texelX1 - texelX0 + 1, row);
+                for (int leafX = x0; leafX < x1; ++leafX) {
+                    int first = leafX * leafCells - texelX0;
+                    int last = std::min((leafX + 1) * leafCells, mapWidth - 1) - texelX0;
+                    Bounds& node = nodes[leafX];
+                    for (int x = first; x <= last; ++x) {
+                        node.minHeight = std::min(node.minHeight, row[x]);
+                        node.maxHeight = std::max(node.maxHeight, row[x]);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void HeightPyramid::reduceLevel(int level, int x0, int y0, int x1, int y1, JobSystem& jobs) {
+    const Level& below = levels[level - 1];
+    Level& target = levels[level];
+    
+    jobs.parallelFor(y0, y1, reduceRowGrain, [&](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            int childY1 = std::min(2 * y + 1, below.height - 1);
+            for (int x = x0; x < x1; ++x) {
+                int childX1 = std::min(2 * x + 1, below.width - 1);
+                const Bounds& a = below.nodes[static_cast<size_t>(2 * y) * below.width + 2 * x];
+                const Bounds& b = below.nodes[static_cast<size_t>(2 * y) * below.width + childX1];
+                const Bounds& c = below.nodes[static_cast<size_t>(childY1) * below.width + 2 * x];
+                const Bounds& d = below.nodes[static_cast<size_t>(childY1) * below.width + childX1];
+                
+                Bounds& node = target.nodes[static_cast<size_t>(y) * target.width + x];
+                node.minHeight = std::min(std::min(a.minHeight, b.minHeight), std::min(c.minHeight, d.minHeight));
+                node.maxHeight = std::max(std::max(a.maxHeight, b.maxHeight), std::max(c.maxHeight, d.maxHeight));
+            }
+        }
+    });
+}
+
+bool HeightPyramid::raycast(const HeightMap& heightMap, const HeightRay& ray, HeightRayHit& hit) const {
+    hit.hit = false;
+    if (levels.empty() || mapWidth < 2 || mapHeight < 2) return false;
+    
+    ClipRay clipRay(ray);
+    float tEnter = 0.0f;
+    float tExit = ray.maxDistance;
+    if (!clipBox(clipRay, 0.0f, 0.0f, static_cast<float>(mapWidth - 1), static_cast<float>(mapHeight - 1), tEnter, tExit)) {
+        return false;
+    }
+    
+    struct Entry {
+        int level;
+        int x, y;
+        float tEnter, tExit;
+    };
+    Entry stack[maxStackDepth];
+    int depth = 0;
+    stack[depth++] = { static_cast<int>(levels.size()) - 1, 0, 0, tEnter, tExit };
+    
+    while (depth > 0) {
+        Entry entry = stack[--depth];
+        const Level& level = levels[entry.level];
+        const Bounds& bounds = level.nodes[static_cast<size_t>(entry.y) * level.width + entry.x];
+        
+        // Height is linear along the ray: skip nodes it passes over
+        float zEnter = ray.originZ + ray.directionZ * entry.tEnter;
+        float zExit = ray.originZ + ray.directionZ * entry.tExit;
+        if (std::min(zEnter, zExit) > bounds.maxHeight) continue;
+        // and stop at nodes it enters already below the lowest point
+        if (std::max(zEnter, zExit) < bounds.minHeight) {
+            hit.hit = true;
+            hit.distance = entry.tEnter;
+            hit.x = ray.originX + ray.directionX * entry.tEnter;
+            hit.y = ray.originY + ray.directionY * entry.tEnter;
+            hit.z = zEnter;
+            return true;
+        }
+        
+        if (entry.level == 0) {
+            if (intersectLeaf(heightMap, ray, entry.x, entry.y, entry.tEnter, entry.tExit, hit)) return true;
+            continue;
+        }
+        
+        // The children meet at one x and one y plane. Where the ray crosses
+        // them cuts its interval into at most three pieces, in order, each
+        // inside one child.
+        const Level& below = levels[entry.level - 1];
+        float splitX = static_cast<float>((2 * entry.x + 1) * below.cellSize);
+        float splitY = static_cast<float>((2 * entry.y + 1) * below.cellSize);
+        float crossX = clipRay.flatX ? entry.tExit : (splitX - ray.originX) * clipRay.inverseX;
+        float crossY = clipRay.flatY ? entry.tExit : (splitY - ray.originY) * clipRay.inverseY;
+        crossX = std::min(std::max(crossX, entry.tEnter), entry.tExit);
+        crossY = std::min(std::max(crossY, entry.tEnter), entry.tExit);
+        float cuts[4] = { entry.tEnter, std::min(crossX, crossY), std::max(crossX, crossY), entry.tExit };
+        
+        Entry children[3];
+        int childCount = 0;
+        for (int i = 0; i < 3; ++i) {
+            // Empty pieces are skipped, unless the whole interval is a point
+            if (cuts[i + 1] <= cuts[i] && (i > 0 || entry.tEnter < entry.tExit)) continue;
+            float middle = 0.5f * (cuts[i] + cuts[i + 1]);
+            int cx = 2 * entry.x + (ray.originX + ray.directionX * middle >= splitX ? 1 : 0);
+            int cy = 2 * entry.y + (ray.originY + ray.directionY * middle >= splitY ? 1 : 0);
+            if (cx >= below.width || cy >= below.height) continue;
+            children[childCount++] = { entry.level - 1, cx, cy, cuts[i], cuts[i + 1] };
+        }
+        for (int i = childCount - 1; i >= 0; --i) {
+            stack[depth++] = children[i];
+        }
+    }
+    return false;
+}
+
+int HeightPyramid::raycast(const HeightMap& heightMap, const HeightRay* rays, int count, HeightRayHit* hits,
+                           JobSystem& jobs) const {
+    jobs.parallelFor(0, count, 0, [&](int first, int end) {
+        for (int i = first; i < end; ++i) {
+            raycast(heightMap, rays[i], hits[i]);
+        }
+    });
+    return static_cast<int>(std::count_if(hits, hits + count, [](const HeightRayHit& hit) { return hit.hit; }));
+}
+
+// Walk the leaf's cells along the ray (a 2D DDA) and test each bilinear patch
+bool HeightPyramid::intersectLeaf(const HeightMap& heightMap, const HeightRay& ray, int leafX, int leafY,
+                                  float tEnter, float tExit, HeightRayHit& hit) const {
+    int cellX0 = leafX * leafCells;
+    int cellY0 = leafY * leafCells;
+    int cellX1 = std::min(cellX0 + leafCells, mapWidth - 1);
+    int cellY1 = std::min(cellY0 + leafCells, mapHeight - 1);
+    
+    int cellX = std::min(cellX1 - 1, std::max(cellX0, static_cast<int>(std::floor(ray.originX + ray.directionX * tEnter))));
+    int cellY = std::min(cellY1 - 1, std::max(cellY0, static_cast<int>(std::floor(ray.originY + ray.directionY * tEnter))));
+    int stepX = ray.directionX > 0.0f ? 1 : -1;
+    int stepY = ray.directionY > 0.0f ? 1 : -1;
+    const float never = std::numeric_limits<float>::infinity();
+    float inverseX = 1.0f / ray.directionX;
+    float inverseY = 1.0f / ray.directionY;
+    
+    float t = tEnter;
+    while (true) {
+        float nextX = ray.directionX != 0.0f ? (cellX + (stepX > 0 ? 1 : 0) - ray.originX) * inverseX : never;
+        float nextY = ray.directionY != 0.0f ? (cellY + (stepY > 0 ? 1 : 0) - ray.originY) * inverseY : never;
+        float cellExit = std::min(std::min(nextX, nextY), tExit);
+        
+        if (cellExit >= t) {
+            float u = ray.originX + ray.directionX * t - cellX;
+            float v = ray.originY + ray.directionY * t - cellY;
+            float z = ray.originZ + ray.directionZ * t;
+            float s;
+            if (intersectPatch(heightMap.getHeight(cellX, cellY), heightMap.getHeight(cellX + 1, cellY),
+                               heightMap.getHeight(cellX, cellY + 1), heightMap.getHeight(cellX + 1, cellY + 1),
+                               u, v, z, ray.directionX, ray.directionY, ray.directionZ, cellExit - t, s)) {
+                hit.hit = true;
+                hit.distance = t + s;
+                hit.x = ray.originX + ray.directionX * hit.distance;
+                hit.y = ray.originY + ray.directionY * hit.distance;
+                hit.z = ray.originZ + ray.directionZ * hit.distance;
+                return true;
+            }
+        }
+        if (cellExit >= tExit) return false;
+        
+        if (nextX <= nextY) {
+            cellX += stepX;
+        } else {
+            cellY += stepY;
+        }
+        if (cellX < cellX0 || cellX >= cellX1 || cellY < cellY0 || cellY >= cellY1) return false;
+        t = std::max(t, cellExit);
+    }
+}
+
+bool HeightPyramid::getBounds(const HeightMapRect& rect, float& minHeight, float& maxHeight) const {
+    if (rect.isEmpty() || levels.empty()) return false;
+    
+    // Leaves touching the rectangle, then coarser levels until at most 4x4
+    // nodes cover it
+    int x0 = std::max(0, (rect.x0 - 1) / leafCells);
+    int y0 = std::max(0, (rect.y0 - 1) / leafCells);
+    int x1 = std::min(levels[0].width, (rect.x1 - 1) / leafCells + 1);
+    int y1 = std::min(levels[0].height, (rect.y1 - 1) / leafCells + 1);
+    if (x0 >= x1 || y0 >= y1) return false;
+    
+    size_t level = 0;
+    while ((x1 - x0 > 4 || y1 - y0 > 4) && level + 1 < levels.size()) {
+        x0 /= 2;
+        y0 /= 2;
+        x1 = (x1 + 1) / 2;
+        y1 = (y1 + 1) / 2;
+        level++;
+    }
+    
+    minHeight = std::numeric_limits<float>::infinity();
+    maxHeight = -std::numeric_limits<float>::infinity();
+    const Level& nodes = levels[level];
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const Bounds& bounds = nodes.nodes[static_cast<size_t>(y) * nodes.width + x];
+            minHeight = std::min(minHeight, bounds.minHeight);
+            maxHeight = std::max(maxHeight, bounds.maxHeight);
+        }
+    }
+    return true;
+}
+
+size_t HeightPyramid::getByteSize() const {
+    size_t bytes = 0;
+    for (const Level& level : levels) {
+        bytes += level.nodes.size() * sizeof(Bounds);
+    }
+    return bytes;
+}
@@ -0,0 +1,225 @@
+#include "HydraulicErosion.h"
+#include "../utils/JobSystem.h"
+#include "../utils/MemoryPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+    // SplitMix64: cheap, well mixed, and seedable per tile
+    struct TileRandom {
+        uint64_t state;
+        
+        explicit TileRandom(uint64_t seed) : state(seed) {}
+        
+        uint64_t next() {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        
+        // Uniform in [0, 1)
+        float nextFloat() {
+            return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f);
+        }
+    };
+    
+    // Bilinear height at (posX, posY) and its gradient within the cell
+    float sampleHeight(const float* heights, int width, float posX, float posY, float& gradientX, float& gradientY) {
+        int cellX = static_cast<int>(posX);
+        int cellY = static_cast<int>(posY);
+        float offsetX = posX - cellX;
+        float offsetY = posY - cellY;
+        
+        const float* cell = heights + cellY * width + cellX;
+        float heightNW = cell[0];
+        float heightNE = cell[1];
+        float heightSW = cell[width];
+        float heightSE = cell[width + 1];
+        
+        gradientX = (heightNE - heightNW) * (1.0f - offsetY) + (heightSE - heightSW) * offsetY;
+        gradientY = (heightSW - heightNW) * (1.0f - offsetX) + (heightSE - heightNE) * offsetX;
+        
+        return heightNW * (1.0f - offsetX) * (1.0f - offsetY) + heightNE * offsetX * (1.0f - offsetY) +
+               heightSW * (1.0f - offsetX) * offsetY + heightSE * offsetX * offsetY;
+    }
+}
+
+ErosionSettings::ErosionSettings()
+    : dropletsPerTexel(0.0f), maxLifetime(30), inertia(0.05f),
+      sedimentCapacity(4.0f), minSedimentCapacity(0.01f),
+      erodeSpeed(0.3f), depositSpeed(0.3f), evaporateSpeed(0.01f),
+      gravity(4.0f), radius(3) {}
+
+HydraulicErosion::HydraulicErosion(const ErosionSettings& settings) : settings(settings) {
+    // Weights fall off linearly with distance from the droplet's cell
+    int radius = std::max(0, settings.radius);
+    float weightSum = 0.0f;
+    for (int y = -radius; y <= radius; ++y) {
+        for (int x = -radius; x <= radius; ++x) {
+            float distance = std::sqrt(static_cast<float>(x * x + y * y));
+            if (distance > radius) continue;
+            
+            brushOffsetX.push_back(x);
+            brushOffsetY.push_back(y);
+            brushWeights.push_back(radius > 0 ? 1.0f - distance / (radius + 1) : 1.0f);
+            weightSum += brushWeights.back();
+        }
+    }
+    for (float& weight : brushWeights) {
+        weight /= weightSum;
+    }
+    
+    this->settings.radius = radius;
+}
+
+bool HydraulicErosion::erode(float* heights, int width, int height, uint32_t seed, JobSystem& jobs,
+                             Stats* stats, const std::function<bool(float)>& onProgress) const {
+    if (stats) {
+        *stats = { 0, 0 };
+    }
+    if (settings.dropletsPerTexel <= 0.0f || width < 2 || height < 2) return true;
+    
+    const int margin = tileSize / 2;
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    
+    std::atomic<long long> totalDroplets(0);
+    std::atomic<long long> totalSteps(0);
+    
+    for (int round = 0; round < rounds; ++round) {
+        for (int parity = 0; parity < 4; ++parity) {
+            ScratchArena& arena = ScratchArena::forThread();
+            ScratchArena::Scope arenaScope(arena);
+            int* tiles = arena.allocate<int>(tilesX * tilesY);
+            int tileCount = 0;
+            for (int tileY = parity / 2; tileY < tilesY; tileY += 2) {
+                for (int tileX = parity % 2; tileX < tilesX; tileX += 2) {
+                    tiles[tileCount++] = tileY * tilesX + tileX;
+                }
+            }
+            
+            jobs.parallelFor(0, tileCount, 1, [&](int first, int end) {
+                for (int i = first; i < end; ++i) {
+                    int tile = tiles[i];
+                    int x0 = (tile % tilesX) * tileSize;
+                    int y0 = (tile / tilesX) * tileSize;
+                    int x1 = std::min(x0 + tileSize, width);
+                    int y1 = std::min(y0 + tileSize, height);
+                    
+                    // Tiles of one parity are two tiles apart, so regions
+                    // reaching half a tile past each side never overlap
+                    Region region = { std::max(0, x0 - margin), std::max(0, y0 - margin),
+                                      std::min(width, x1 + margin), std::min(height, y1 + margin) };
+                    
+                    // This round's share of the tile's droplets
+                    double tileDroplets = static_cast<double>(settings.dropletsPerTexel) * (x1 - x0) * (y1 - y0);
+                    long long count = static_cast<long long>(tileDroplets * (round + 1) / rounds) -
+                                      static_cast<long long>(tileDroplets * round / rounds);
+                    
+                    TileRandom random((static_cast<uint64_t>(seed) << 32) ^
+                                      (static_cast<uint64_t>(round) * tilesX * tilesY + tile) * 0xD1B54A32D192ED03ull);
+                    
+                    long long steps = 0;
+                    for (long long droplet = 0; droplet < count; ++droplet) {
+                        float posX = x0 + random.nextFloat() * (x1 - x0 - 1);
+                        float posY = y0 + random.nextFloat() * (y1 - y0 - 1);
+                        steps += simulateDroplet(heights, width, region, posX, posY);
+                    }
+                    
+                    totalDroplets += count;
+                    totalSteps += steps;
+                }
+            });
+            
+            if (onProgress && !onProgress(static_cast<float>(round * 4 + parity + 1) / (rounds * 4))) {
+                return false;
+            }
+        }
+    }
+    
+    if (stats) {
+        stats->droplets = totalDroplets;
+        stats->steps = totalSteps;
+    }
+    return true;
+}
+
+int HydraulicErosion::simulateDroplet(float* heights, int width, const Region& region, float posX, float posY) const {
+    const int radius = settings.radius;
+    const size_t brushSize = brushWeights.size();
+    
+    float directionX = 0.0f;
+    float directionY = 0.0f;
+    float speed = 1.0f;
+    float water = 1.0f;
+    float sediment = 0.0f;
+    
+    int steps = 0;
+    for (; steps < settings.maxLifetime; ++steps) {
+        int cellX = static_cast<int>(posX);
+        int cellY = static_cast<int>(posY);
+        
+        // The brush and the bilinear footprint must stay inside the region
+        if (cellX - radius < region.x0 || cellY - radius < region.y0 ||
+            cellX + radius + 1 >= region.x1 || cellY + radius + 1 >= region.y1) {
+            break;
+        }
+        
+        float offsetX = posX - cellX;
+        float offsetY = posY - cellY;
+        
+        float gradientX;
+        float gradientY;
+        float currentHeight = sampleHeight(heights, width, posX, posY, gradientX, gradientY);
+        
+        // Blend the old direction with the downhill direction
+        directionX = directionX * settings.inertia - gradientX * (1.0f - settings.inertia);
+        directionY = directionY * settings.inertia - gradientY * (1.0f - settings.inertia);
+        float length = std::sqrt(directionX * directionX + directionY * directionY);
+        if (length < 1e-8f) break;    // Flat ground, nowhere to go
+        directionX /= length;
+        directionY /= length;
+        
+        posX += directionX;
+        posY += directionY;
+        if (posX < region.x0 || posY < region.y0 || posX + 1.0f >= region.x1 || posY + 1.0f >= region.y1) {
+            break;
+        }
+        
+        float unused;
+        float deltaHeight = sampleHeight(heights, width, posX, posY, unused, unused) - currentHeight;
+        
+        // Faster, wetter droplets running downhill carry more
+        float capacity = std::max(-deltaHeight * speed * water * settings.sedimentCapacity,
+                                  settings.minSedimentCapacity);
+        
+        float* cell = heights + cellY * width + cellX;
+        if (sediment > capacity || deltaHeight > 0.0f) {
+            // Uphill: fill the pit behind the droplet. Overloaded: drop some.
+            float amount = deltaHeight > 0.0f ? std::min(deltaHeight, sediment)
+                                              : (sediment - capacity) * settings.depositSpeed;
+            sediment -= amount;
+            
+            cell[0] += amount * (1.0f - offsetX) * (1.0f - offsetY);
+            cell[1] += amount * offsetX * (1.0f - offsetY);
+            cell[width] += amount * (1.0f - offsetX) * offsetY;
+            cell[width + 1] += amount * offsetX * offsetY;
+        } else {
+            // Never dig deeper than the drop, or the droplet would carve a pit
+            float amount = std::min((capacity - sediment) * settings.erodeSpeed, -deltaHeight);
+            for (size_t i = 0; i < brushSize; ++i) {
+                float& texel = cell[brushOffsetY[i] * width + brushOffsetX[i]];
+                float eroded = std::min(texel, amount * brushWeights[i]);
+                texel -= eroded;
+                sediment += eroded;
+            }
+        }
+        
+        speed = std::sqrt(std::max(0.0f, speed * speed - deltaHeight * settings.gravity));
+        water *= 1.0f - settings.evaporateSpeed;
+    }
+    
+    return steps;
+}
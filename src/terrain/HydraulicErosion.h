@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class JobSystem;
+
+// Droplet erosion parameters. Heights are in the generator's normalized
+// [0, 1] range with texels one unit apart.
+struct ErosionSettings {
+    ErosionSettings();
+    
+    float dropletsPerTexel;     // 0 disables erosion
+    int maxLifetime;            // Steps per droplet, each moves one texel
+    float inertia;              // 0 follows the slope, 1 keeps the direction
+    float sedimentCapacity;     // Sediment carried per unit of speed, water and drop
+    float minSedimentCapacity;
+    float erodeSpeed;
+    float depositSpeed;
+    float evaporateSpeed;
+    float gravity;
+    int radius;                 // Erosion brush radius in texels
+};
+
+// Particle-based hydraulic erosion. Droplets run downhill, picking up
+// sediment where they speed up and dropping it where they slow down or
+// climb, which carves valleys and fills basins.
+//
+// The map is split into 64x64 tiles. A droplet spawned in a tile stays within
+// half a tile of it, so tiles two apart in both directions never touch the
+// same texels: the four tile parities run one after another, the tiles of
+// each parity in parallel with no locking. Every tile draws its droplets from
+// its own random stream, so a seed gives the same result at any thread count.
+class HydraulicErosion {
+public:
+    struct Stats {
+        long long droplets;
+        long long steps;
+    };
+    
+    explicit HydraulicErosion(const ErosionSettings& settings);
+    
+    // Erode heights (width * height, row-major) in place. onProgress is called
+    // between tile passes with progress in [0, 1]; returning false stops the
+    // erosion early, in which case erode returns false.
+    bool erode(float* heights, int width, int height, uint32_t seed, JobSystem& jobs,
+               Stats* stats = nullptr, const std::function<bool(float)>& onProgress = std::function<bool(float)>()) const;
+    
+    static const int tileSize = 64;
+    
+    // Droplets are spread over this many sweeps of all four parities, so no
+    // parity gets to erode the whole map before the others
+    static const int rounds = 4;
+
+private:
+    // Texels a droplet may read or write, half-open
+    struct Region {
+        int x0, y0, x1, y1;
+    };
+    
+    ErosionSettings settings;
+    
+    // Erosion brush as parallel arrays of texel offsets and weights (sum 1)
+    std::vector<int> brushOffsetX;
+    std::vector<int> brushOffsetY;
+    std::vector<float> brushWeights;
+    
+    // Returns the number of steps the droplet took
+    int simulateDroplet(float* heights, int width, const Region& region, float posX, float posY) const;
+};
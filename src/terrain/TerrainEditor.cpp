@@ -0,0 +1,238 @@
+#include "TerrainEditor.h"
+#include "../utils/JobSystem.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+    uint32_t floatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    
+    float bitsFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+    // Brush rows per job; small brushes run inline
+    const int brushRowGrain = 32;
+}
+
+TerrainEditor::TerrainEditor(HeightMap& heightMap)
+    : heightMap(heightMap), appliedStrokes(0), strokeActive(false),
+      strokeBounds{ 0, 0, 0, 0 }, dirty{ 0, 0, 0, 0 } {}
+
+void TerrainEditor::beginStroke() {
+    if (strokeActive) return;
+    
+    // Deltas are taken on float bits, so sculpting needs 32-bit heights
+    heightMap.setStorage(HeightStorage::Float32);
+    
+    strokeActive = true;
+    strokeOriginals.clear();
+    strokeBounds = { 0, 0, 0, 0 };
+}
+
+void TerrainEditor::endStroke() {
+    if (!strokeActive) return;
+    strokeActive = false;
+    
+    int mapWidth = heightMap.getWidth();
+    int tilesX = getTilesX();
+    const float* data = heightMap.getData();
+    
+    // Keep only the texels that actually changed
+    Stroke stroke;
+    stroke.bounds = strokeBounds;
+    for (const auto& entry : strokeOriginals) {
+        int tileX0 = (entry.first % tilesX) * tileSize;
+        int tileY0 = (entry.first / tilesX) * tileSize;
+        
+        TileDelta delta;
+        delta.tile = entry.first;
+        for (int i = 0; i < tileSize * tileSize; ++i) {
+            int x = tileX0 + i % tileSize;
+            int y = tileY0 + i / tileSize;
+            if (x >= mapWidth || y >= heightMap.getHeight()) continue;
+            
+            uint32_t change = floatBits(entry.second[i]) ^ floatBits(data[y * mapWidth + x]);
+            if (change != 0) {
+                delta.offsets.push_back(static_cast<uint16_t>(i));
+                delta.bits.push_back(change);
+            }
+        }
+        if (!delta.offsets.empty()) {
+            stroke.tiles.push_back(std::move(delta));
+        }
+    }
+    strokeOriginals.clear();
+    
+    if (stroke.tiles.empty()) return;
+    
+    // A new stroke discards the redo branch
+    history.resize(appliedStrokes);
+    history.push_back(std::move(stroke));
+    if (history.size() > maxHistory) {
+        history.erase(history.begin());
+    }
+    appliedStrokes = history.size();
+}
+
+HeightMapRect TerrainEditor::applyBrush(const Brush& brush, float centerX, float centerY) {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    
+    HeightMapRect rect;
+    rect.x0 = std::max(0, static_cast<int>(std::floor(centerX - brush.radius)));
+    rect.y0 = std::max(0, static_cast<int>(std::floor(centerY - brush.radius)));
+    rect.x1 = std::min(mapWidth, static_cast<int>(std::ceil(centerX + brush.radius)) + 1);
+    rect.y1 = std::min(mapHeight, static_cast<int>(std::ceil(centerY + brush.radius)) + 1);
+    if (rect.isEmpty() || brush.radius <= 0.0f) return { 0, 0, 0, 0 };
+    
+    bool ownStroke = !strokeActive;
+    if (ownStroke) beginStroke();
+    saveTiles(rect);
+    
+    float* data = heightMap.getMutableData();
+    
+    // Smoothing reads the unmodified neighborhood, one texel beyond the brush
+    HeightMapRect source = { std::max(0, rect.x0 - 1), std::max(0, rect.y0 - 1),
+                             std::min(mapWidth, rect.x1 + 1), std::min(mapHeight, rect.y1 + 1) };
+    int sourceWidth = source.x1 - source.x0;
+    if (brush.mode == BrushMode::Smooth) {
+        smoothSource.resize(static_cast<size_t>(sourceWidth) * (source.y1 - source.y0));
+        for (int y = source.y0; y < source.y1; ++y) {
+            std::memcpy(&smoothSource[(y - source.y0) * sourceWidth], &data[y * mapWidth + source.x0],
+                        sourceWidth * sizeof(float));
+        }
+    }
+    
+    float inverseRadius = 1.0f / brush.radius;
+    float noiseFrequency = 1.0f / std::max(brush.noiseScale, 1.0f);
+    
+    JobSystem::instance().parallelFor(rect.y0, rect.y1, brushRowGrain, [&](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                float dx = (x - centerX) * inverseRadius;
+                float dy = (y - centerY) * inverseRadius;
+                float distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared >= 1.0f) continue;
+                
+                // Smooth falloff to zero at the rim
+                float weight = (1.0f - distanceSquared) * (1.0f - distanceSquared);
+                float& height = data[y * mapWidth + x];
+                
+                switch (brush.mode) {
+                    case BrushMode::Raise:
+                        height += brush.strength * weight;
+                        break;
+                    case BrushMode::Lower:
+                        height -= brush.strength * weight;
+                        break;
+                    case BrushMode::Smooth: {
+                        float sum = 0.0f;
+                        int count = 0;
+                        for (int ny = std::max(source.y0, y - 1); ny <= std::min(source.y1 - 1, y + 1); ++ny) {
+                            for (int nx = std::max(source.x0, x - 1); nx <= std::min(source.x1 - 1, x + 1); ++nx) {
+                                sum += smoothSource[(ny - source.y0) * sourceWidth + (nx - source.x0)];
+                                count++;
+                            }
+                        }
+                        height += (sum / count - height) * std::min(1.0f, brush.strength * weight);
+                        break;
+                    }
+                    case BrushMode::Flatten:
+                        height += (brush.targetHeight - height) * std::min(1.0f, brush.strength * weight);
+                        break;
+                    case BrushMode::NoiseStamp:
+                        height += brush.strength * weight * noise.noise(x * noiseFrequency, y * noiseFrequency);
+                        break;
+                }
+                
+                // Heights stay in the generator's normalized range
+                height = std::min(1.0f, std::max(0.0f, height));
+            }
+        }
+    });
+    
+    strokeBounds.include(rect);
+    dirty.include(rect);
+    
+    if (ownStroke) endStroke();
+    return rect;
+}
+
+bool TerrainEditor::undo() {
+    if (strokeActive || !canUndo()) return false;
+    
+    appliedStrokes--;
+    toggleStroke(history[appliedStrokes]);
+    return true;
+}
+
+bool TerrainEditor::redo() {
+    if (strokeActive || !canRedo()) return false;
+    
+    toggleStroke(history[appliedStrokes]);
+    appliedStrokes++;
+    return true;
+}
+
+HeightMapRect TerrainEditor::takeDirtyRect() {
+    HeightMapRect rect = dirty;
+    dirty = { 0, 0, 0, 0 };
+    return rect;
+}
+
+size_t TerrainEditor::getHistoryBytes() const {
+    size_t bytes = 0;
+    for (const Stroke& stroke : history) {
+        for (const TileDelta& tile : stroke.tiles) {
+            bytes += sizeof(TileDelta) + tile.offsets.size() * sizeof(uint16_t) + tile.bits.size() * sizeof(uint32_t);
+        }
+    }
+    return bytes;
+}
+
+// Save every tile overlapping rect that this stroke has not touched yet
+void TerrainEditor::saveTiles(const HeightMapRect& rect) {
+    int mapWidth = heightMap.getWidth();
+    int mapHeight = heightMap.getHeight();
+    int tilesX = getTilesX();
+    const float* data = heightMap.getData();
+    
+    for (int tileY = rect.y0 / tileSize; tileY <= (rect.y1 - 1) / tileSize; ++tileY) {
+        for (int tileX = rect.x0 / tileSize; tileX <= (rect.x1 - 1) / tileSize; ++tileX) {
+            int tile = tileY * tilesX + tileX;
+            if (strokeOriginals.count(tile)) continue;
+            
+            std::vector<float>& original = strokeOriginals[tile];
+            original.assign(tileSize * tileSize, 0.0f);
+            for (int y = tileY * tileSize; y < std::min((tileY + 1) * tileSize, mapHeight); ++y) {
+                int x0 = tileX * tileSize;
+                int count = std::min(tileSize, mapWidth - x0);
+                std::memcpy(&original[(y - tileY * tileSize) * tileSize], &data[y * mapWidth + x0], count * sizeof(float));
+            }
+        }
+    }
+}
+
+// Flip a stroke's texels between their before and after values
+void TerrainEditor::toggleStroke(const Stroke& stroke) {
+    int mapWidth = heightMap.getWidth();
+    int tilesX = getTilesX();
+    float* data = heightMap.getMutableData();
+    
+    for (const TileDelta& tile : stroke.tiles) {
+        int tileX0 = (tile.tile % tilesX) * tileSize;
+        int tileY0 = (tile.tile / tilesX) * tileSize;
+        for (size_t i = 0; i < tile.offsets.size(); ++i) {
+            float& height = data[(tileY0 + tile.offsets[i] / tileSize) * mapWidth + tileX0 + tile.offsets[i] % tileSize];
+            height = bitsFloat(floatBits(height) ^ tile.bits[i]);
+        }
+    }
+    
+    dirty.include(stroke.bounds);
+}
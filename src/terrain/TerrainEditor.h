@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "HeightMap.h"
+#include "../noise/PerlinNoise.h"
+
+enum class BrushMode {
+    Raise,
+    Lower,
+    Smooth,       // Blend toward the 3x3 neighborhood average
+    Flatten,      // Blend toward targetHeight
+    NoiseStamp    // Add Perlin detail
+};
+
+struct Brush {
+    BrushMode mode;
+    float radius;         // In texels
+    float strength;       // Height change at the center (Smooth/Flatten: blend factor 0-1)
+    float targetHeight;   // Flatten only
+    float noiseScale;     // NoiseStamp feature size, in texels
+};
+
+// Sculpts a heightmap in place. Each brush application touches only the
+// texels under the brush and grows a dirty rectangle, so the renderer can
+// rebuild just the affected mesh patches. Strokes are undoable: the first
+// time a stroke touches a 32x32 tile its contents are saved, and when the
+// stroke ends only the texels that changed are kept, as XOR deltas of their
+// bit patterns. XOR is its own inverse, so one delta serves undo and redo
+// and restores heights bit-exactly. A map in 16-bit storage is widened to
+// Float32 when the first stroke begins.
+class TerrainEditor {
+public:
+    explicit TerrainEditor(HeightMap& heightMap);
+    
+    // Group brush applications into one undo step. applyBrush outside a
+    // stroke is its own step.
+    void beginStroke();
+    void endStroke();
+    
+    // Apply the brush once, centered on texel coordinates. Returns the
+    // rectangle that changed.
+    HeightMapRect applyBrush(const Brush& brush, float centerX, float centerY);
+    
+    bool undo();
+    bool redo();
+    bool canUndo() const { return appliedStrokes > 0; }
+    bool canRedo() const { return appliedStrokes < history.size(); }
+    
+    // Everything changed since the last call (brushes, undo and redo)
+    HeightMapRect takeDirtyRect();
+    
+    // Bytes held by the undo history
+    size_t getHistoryBytes() const;
+    
+    static constexpr int tileSize = 32;
+    static const size_t maxHistory = 64;
+
+private:
+    struct TileDelta {
+        int tile;
+        std::vector<uint16_t> offsets;   // Texel index within the tile
+        std::vector<uint32_t> bits;      // before ^ after
+    };
+    
+    struct Stroke {
+        std::vector<TileDelta> tiles;
+        HeightMapRect bounds;
+    };
+    
+    HeightMap& heightMap;
+    PerlinNoise noise;
+    
+    std::vector<Stroke> history;
+    size_t appliedStrokes;      // Strokes in history not undone
+    
+    // Stroke in progress: tile contents before the stroke first touched them
+    bool strokeActive;
+    std::map<int, std::vector<float>> strokeOriginals;
+    HeightMapRect strokeBounds;
+    
+    HeightMapRect dirty;
+    std::vector<float> smoothSource;
+    
+    void saveTiles(const HeightMapRect& rect);
+    void toggleStroke(const Stroke& stroke);
+    int getTilesX() const { return (heightMap.getWidth() + tileSize - 1) / tileSize; }
+};
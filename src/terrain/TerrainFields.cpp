@@ -0,0 +1,164 @@
+#include "TerrainFields.h"
+#include "../utils/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Horizon search: eight directions, samples at growing distances
+    const int directionCount = 8;
+    const int directionX[directionCount] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int directionY[directionCount] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+    const int sampleCount = 5;
+    const int sampleDistances[sampleCount] = { 1, 2, 4, 8, 16 };
+    
+    int8_t toSnorm8(float value) {
+        return static_cast<int8_t>(std::lrint(std::min(1.0f, std::max(-1.0f, value)) * 127.0f));
+    }
+    
+    uint8_t toUnorm8(float value) {
+        return static_cast<uint8_t>(std::min(1.0f, std::max(0.0f, value)) * 255.0f + 0.5f);
+    }
+}
+
+void TerrainFields::getNormal(int x, int y, float& nx, float& ny, float& nz) const {
+    size_t i = index(x, y);
+    nx = normalX[i] * (1.0f / 127.0f);
+    nz = normalZ[i] * (1.0f / 127.0f);
+    ny = std::sqrt(std::max(0.0f, 1.0f - nx * nx - nz * nz));
+}
+
+TerrainFieldBuilder::TerrainFieldBuilder(float texelSpacing, float verticalScale)
+    : texelSpacing(texelSpacing), verticalScale(verticalScale) {}
+
+void TerrainFieldBuilder::build(const HeightMap& heightMap, TerrainFields& fields, JobSystem& jobs) const {
+    size_t texels = static_cast<size_t>(heightMap.getWidth()) * heightMap.getHeight();
+    fields.width = heightMap.getWidth();
+    fields.height = heightMap.getHeight();
+    fields.normalX.resize(texels);
+    fields.normalZ.resize(texels);
+    fields.slope.resize(texels);
+    fields.curvature.resize(texels);
+    fields.occlusion.resize(texels);
+    
+    buildRect(heightMap, { 0, 0, fields.width, fields.height }, fields, jobs);
+}
+
+HeightMapRect TerrainFieldBuilder::update(const HeightMap& heightMap, const HeightMapRect& rect, TerrainFields& fields,
+                                          JobSystem& jobs) const {
+    if (rect.isEmpty()) return rect;
+    
+    // Horizon rays reach horizonRadius texels, so that far around the edit
+    // sees different heights
+    HeightMapRect affected = { std::max(0, rect.x0 - horizonRadius), std::max(0, rect.y0 - horizonRadius),
+                               std::min(fields.width, rect.x1 + horizonRadius),
+                               std::min(fields.height, rect.y1 + horizonRadius) };
+    buildRect(heightMap, affected, fields, jobs);
+    return affected;
+}
+
+void TerrainFieldBuilder::buildRect(const HeightMap& heightMap, const HeightMapRect& rect, TerrainFields& fields,
+                                    JobSystem& jobs) const {
+    int tilesX = (rect.x1 - rect.x0 + tileSize - 1) / tileSize;
+    int tilesY = (rect.y1 - rect.y0 + tileSize - 1) / tileSize;
+    
+    jobs.parallelFor(0, tilesX * tilesY, 1, [&](int firstTile, int endTile) {
+        // Kept per thread, so steady-state updates never reallocate it
+        static thread_local std::vector<float> scratch;
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            int x0 = rect.x0 + (tile % tilesX) * tileSize;
+            int y0 = rect.y0 + (tile / tilesX) * tileSize;
+            HeightMapRect tileRect = { x0, y0, std::min(x0 + tileSize, rect.x1), std::min(y0 + tileSize, rect.y1) };
+            buildTile(heightMap, tileRect, fields, scratch);
+        }
+    });
+}
+
+void TerrainFieldBuilder::buildTile(const HeightMap& heightMap, const HeightMapRect& tile, TerrainFields& fields,
+                                    std::vector<float>& scratch) const {
+    const int halo = horizonRadius;
+    const int mapWidth = heightMap.getWidth();
+    const int mapHeight = heightMap.getHeight();
+    const int tileWidth = tile.x1 - tile.x0;
+    const int tileHeight = tile.y1 - tile.y0;
+    const int paddedWidth = tileWidth + 2 * halo;
+    const int paddedHeight = tileHeight + 2 * halo;
+    
+    // Padded heights, then per-row working arrays
+    scratch.resize(static_cast<size_t>(paddedWidth) * paddedHeight + 6 * tileWidth);
+    float* padded = scratch.data();
+    float* normalX = padded + paddedWidth * paddedHeight;
+    float* normalZ = normalX + tileWidth;
+    float* slope = normalZ + tileWidth;
+    float* curvature = slope + tileWidth;
+    float* horizon = curvature + tileWidth;
+    float* occlusion = horizon + tileWidth;
+    
+    // Copy the tile and its halo, widening 16-bit heights a row at a time;
+    // texels past the map edge repeat the edge
+    int left = tile.x0 - halo;
+    int copyX0 = std::max(0, left);
+    int copyX1 = std::min(mapWidth, left + paddedWidth);
+    for (int py = 0; py < paddedHeight; ++py) {
+        int y = std::min(mapHeight - 1, std::max(0, tile.y0 - halo + py));
+        float* row = padded + py * paddedWidth;
+        heightMap.readRow(y, copyX0, copyX1 - copyX0, row + (copyX0 - left));
+        std::fill(row, row + (copyX0 - left), row[copyX0 - left]);
+        std::fill(row + (copyX1 - left), row + paddedWidth, row[copyX1 - 1 - left]);
+    }
+    
+    // Heights in world units over distances in world units
+    const float gradientScale = verticalScale / (2.0f * texelSpacing);
+    const float curvatureScale = verticalScale / texelSpacing;
+    float horizonScale[directionCount][sampleCount];
+    for (int d = 0; d < directionCount; ++d) {
+        float length = std::sqrt(static_cast<float>(directionX[d] * directionX[d] + directionY[d] * directionY[d]));
+        for (int s = 0; s < sampleCount; ++s) {
+            horizonScale[d][s] = verticalScale / (sampleDistances[s] * length * texelSpacing);
+        }
+    }
+    
+    for (int y = 0; y < tileHeight; ++y) {
+        const float* center = padded + (y + halo) * paddedWidth + halo;
+        const float* above = center - paddedWidth;
+        const float* below = center + paddedWidth;
+        
+        // Normal, slope and curvature from the 3x3 neighborhood
+        for (int x = 0; x < tileWidth; ++x) {
+            float gradientX = (center[x + 1] - center[x - 1]) * gradientScale;
+            float gradientZ = (below[x] - above[x]) * gradientScale;
+            float inverseLength = 1.0f / std::sqrt(gradientX * gradientX + 1.0f + gradientZ * gradientZ);
+            normalX[x] = -gradientX * inverseLength;
+            normalZ[x] = -gradientZ * inverseLength;
+            slope[x] = 1.0f - inverseLength;
+            
+            float neighborMean = 0.25f * (center[x - 1] + center[x + 1] + above[x] + below[x]);
+            curvature[x] = (neighborMean - center[x]) * curvatureScale;
+        }
+        
+        // Horizon-based occlusion: per direction, the steepest rise seen
+        // from this texel; its sine is the share of sky it hides
+        std::fill(occlusion, occlusion + tileWidth, 0.0f);
+        for (int d = 0; d < directionCount; ++d) {
+            std::fill(horizon, horizon + tileWidth, 0.0f);
+            for (int s = 0; s < sampleCount; ++s) {
+                const float* sample = center + (directionY[d] * paddedWidth + directionX[d]) * sampleDistances[s];
+                float scale = horizonScale[d][s];
+                for (int x = 0; x < tileWidth; ++x) {
+                    horizon[x] = std::max(horizon[x], (sample[x] - center[x]) * scale);
+                }
+            }
+            for (int x = 0; x < tileWidth; ++x) {
+                occlusion[x] += horizon[x] / std::sqrt(1.0f + horizon[x] * horizon[x]);
+            }
+        }
+        
+        size_t out = fields.index(tile.x0, tile.y0 + y);
+        for (int x = 0; x < tileWidth; ++x) {
+            fields.normalX[out + x] = toSnorm8(normalX[x]);
+            fields.normalZ[out + x] = toSnorm8(normalZ[x]);
+            fields.slope[out + x] = toUnorm8(slope[x]);
+            fields.curvature[out + x] = toSnorm8(curvature[x]);
+            fields.occlusion[out + x] = toUnorm8(1.0f - occlusion[x] * (1.0f / directionCount));
+        }
+    }
+}
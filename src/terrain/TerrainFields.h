@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "HeightMap.h"
+
+class JobSystem;
+
+// Per-texel surface attributes derived from a heightmap, one 8-bit layer per
+// attribute (5 bytes per texel) so meshing, tree placement and shading can
+// read just the layers they need.
+struct TerrainFields {
+    int width;
+    int height;
+    
+    std::vector<int8_t> normalX;     // Unit normal x and z as snorm8; y is up
+    std::vector<int8_t> normalZ;     // and implied by the other two
+    std::vector<uint8_t> slope;      // 1 - normal y: 0 flat, 1 vertical
+    std::vector<int8_t> curvature;   // Mean neighbor height minus own, per texel
+                                     // spacing: > 0 in hollows, < 0 on ridges
+    std::vector<uint8_t> occlusion;  // Horizon-based ambient occlusion, 1 = open sky
+    
+    TerrainFields() : width(0), height(0) {}
+    
+    void getNormal(int x, int y, float& nx, float& ny, float& nz) const;
+    float getSlope(int x, int y) const { return slope[index(x, y)] * (1.0f / 255.0f); }
+    float getCurvature(int x, int y) const { return curvature[index(x, y)] * (1.0f / 127.0f); }
+    float getOcclusion(int x, int y) const { return occlusion[index(x, y)] * (1.0f / 255.0f); }
+    
+    size_t index(int x, int y) const { return static_cast<size_t>(y) * width + x; }
+};
+
+// Computes every TerrainFields layer in one fused sweep: each 64x64 tile is
+// copied with a 16-texel halo (clamped at the map edges) into a padded
+// buffer, and all stencils run over that copy with branch-free row loops.
+// Tiles are independent jobs.
+class TerrainFieldBuilder {
+public:
+    // texelSpacing and verticalScale convert texels and normalized heights
+    // to world units, so slopes and horizon angles match the rendered mesh
+    TerrainFieldBuilder(float texelSpacing, float verticalScale);
+    
+    void build(const HeightMap& heightMap, TerrainFields& fields, JobSystem& jobs) const;
+    
+    // Recompute the texels whose stencils read rect after an edit. Returns
+    // the rectangle of fields that changed.
+    HeightMapRect update(const HeightMap& heightMap, const HeightMapRect& rect, TerrainFields& fields,
+                         JobSystem& jobs) const;
+    
+    static const int tileSize = 64;
+    
+    // Horizon search distance in texels, also the halo width
+    static const int horizonRadius = 16;
+
+private:
+    float texelSpacing;
+    float verticalScale;
+    
+    void buildRect(const HeightMap& heightMap, const HeightMapRect& rect, TerrainFields& fields, JobSystem& jobs) const;
+    void buildTile(const HeightMap& heightMap, const HeightMapRect& tile, TerrainFields& fields,
+                   std::vector<float>& scratch) const;
+};
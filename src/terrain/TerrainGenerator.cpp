@@ -1,88 +1,540 @@
 #include "TerrainGenerator.h"
-#include "../noise/PerlinNoise.h"
+#include "../noise/NoiseSource.h"
+#include "../utils/JobSystem.h"
+#include "../utils/MemoryPool.h"
 #include <cstdlib>
 #include <ctime>
 #include <algorithm>
 
-TerrainGenerator::TerrainGenerator() {
+TerrainGenerator::TerrainGenerator()
+    : jobs(nullptr), noiseLayers(1, NoiseType::Perlin), slopeDamping(0.0f),
+      heightStorage(HeightStorage::Float32), nextSequence(0), running(false) {
     // Seed the random number generator
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
 }
 
-TerrainGenerator::~TerrainGenerator() {}
+TerrainGenerator::~TerrainGenerator() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        running = false;
+        
+        // Queued tasks will never run; release anyone waiting on them
+        for (const std::shared_ptr<TerrainTaskState>& task : queue) {
+            finishTask(*task, TerrainTaskStatus::Cancelled);
+        }
+        queue.clear();
+        
+        // Stop the running task at its next tile
+        if (activeTask) {
+            activeTask->cancelRequested = true;
+        }
+    }
+    queueWake.notify_all();
+    
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
 
 HeightMap TerrainGenerator::generateTerrain(
     int width, int height, float scale, int octaves, float persistence, float lacunarity
 ) {
-    float* noiseMap = generateNoiseMap(width, height, scale, octaves, persistence, lacunarity);
-    HeightMap heightMap(width, height, noiseMap);
-    return heightMap;
+    std::shared_ptr<TerrainTaskState> task = createTask(
+        createSeed(octaves), 0, 0, width, height, 1, scale, octaves, persistence, lacunarity);
+    runTask(*task);
+    return *task->result;
 }
 
-float* TerrainGenerator::generateNoiseMap(
-    int width, int height, float scale, int octaves, float persistence, float lacunarity
+TerrainTask TerrainGenerator::generateTerrainAsync(
+    int width, int height, float scale, int octaves, float persistence, float lacunarity,
+    float priority, TerrainProgressCallback onProgress
 ) {
-    PerlinNoise noise;
-    float* noiseMap = new float[width * height];
+    // Random state is drawn here, on the caller's thread, never on the worker
+    return submit(createTask(createSeed(octaves), 0, 0, width, height, 1, scale, octaves, persistence, lacunarity),
+                  priority, onProgress);
+}
+
+TerrainTask TerrainGenerator::generateTerrainAsync(
+    const TerrainSeed& seed, int64_t originX, int64_t originY, int width, int height, int sampleStep,
+    float scale, int octaves, float persistence, float lacunarity,
+    float priority, TerrainProgressCallback onProgress
+) {
+    return submit(createTask(seed, originX, originY, width, height, sampleStep, scale, octaves, persistence,
+                             lacunarity),
+                  priority, onProgress);
+}
+
+TerrainTask TerrainGenerator::submit(std::shared_ptr<TerrainTaskState> task, float priority,
+                                     TerrainProgressCallback onProgress) {
+    task->priority = priority;
+    task->onProgress = onProgress;
+    
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        task->sequence = nextSequence++;
+        queue.push_back(task);
+        
+        if (!running) {
+            running = true;
+            worker = std::thread(&TerrainGenerator::workerLoop, this);
+        }
+    }
+    queueWake.notify_one();
+    
+    return TerrainTask(task);
+}
+
+TerrainSeed TerrainGenerator::createSeed(int octaves) {
+    TerrainSeed seed;
+    
+    // One source per backend in use; octaves sharing a backend differ by offset
+    std::vector<NoiseType> types;
+    std::vector<std::shared_ptr<const NoiseSource>> sources;
+    for (int i = 0; i < octaves; i++) {
+        NoiseType type = noiseLayers[std::min(static_cast<size_t>(i), noiseLayers.size() - 1)];
+        size_t source = std::find(types.begin(), types.end(), type) - types.begin();
+        if (source == types.size()) {
+            uint32_t noiseSeed = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+            types.push_back(type);
+            sources.push_back(NoiseSource::create(type, noiseSeed));
+        }
+        seed.layers.push_back(sources[source]);
+    }
     
     // Random offsets for each octave
-    float* octaveOffsets = new float[octaves * 2];
+    seed.octaveOffsets.resize(octaves * 2);
     for (int i = 0; i < octaves; i++) {
         float offsetX = static_cast<float>(rand() % 100000) - 50000.0f;
         float offsetY = static_cast<float>(rand() % 100000) - 50000.0f;
-        octaveOffsets[i * 2] = offsetX;
-        octaveOffsets[i * 2 + 1] = offsetY;
+        seed.octaveOffsets[i * 2] = offsetX;
+        seed.octaveOffsets[i * 2 + 1] = offsetY;
     }
     
+    seed.erosionSeed = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+    
+    if (shape) {
+        seed.shape = shape((static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand()));
+    }
+    
+    // Drawn last so the rest of the seed stays what it was without climate
+    uint32_t climateSeed = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+    seed.climate = NoiseSource::create(NoiseType::OpenSimplex2, climateSeed);
+    seed.climateOffsets.resize(4);
+    for (float& offset : seed.climateOffsets) {
+        offset = static_cast<float>(rand() % 100000) - 50000.0f;
+    }
+    
+    return seed;
+}
+
+std::shared_ptr<TerrainTaskState> TerrainGenerator::createTask(
+    const TerrainSeed& seed, int64_t originX, int64_t originY, int width, int height, int sampleStep,
+    float scale, int octaves, float persistence, float lacunarity
+) {
+    std::shared_ptr<TerrainTaskState> task = std::make_shared<TerrainTaskState>();
+    task->originX = originX;
+    task->originY = originY;
+    task->width = width;
+    task->height = height;
+    task->scale = scale;
+    task->octaves = octaves;
+    task->persistence = persistence;
+    task->lacunarity = lacunarity;
+    task->sampleStep = std::max(1, sampleStep);
+    task->seed = seed;
+    task->erosion = erosion;
+    task->thermalErosion = thermalErosion;
+    task->slopeDamping = slopeDamping;
+    task->heightStorage = heightStorage;
+    task->climate = climate;
+    task->sequence = 0;
+    task->priority = 0.0f;
+    task->cancelRequested = false;
+    task->progress = 0.0f;
+    task->status = TerrainTaskStatus::Pending;
+    
+    // A seed drawn for fewer octaves cannot drive more
+    task->octaves = std::min(octaves, static_cast<int>(seed.octaveOffsets.size() / 2));
+    
+    return task;
+}
+
+void TerrainGenerator::runTask(TerrainTaskState& task) {
+    {
+        std::lock_guard<std::mutex> lock(task.mutex);
+        task.status = TerrainTaskStatus::Running;
+    }
+    
+    const int width = task.width;
+    const int height = task.height;
+    const int sampleStep = task.sampleStep;
+    const std::shared_ptr<const NoiseSource>* layers = task.seed.layers.data();
+    const float* octaveOffsets = task.seed.octaveOffsets.data();
+    const NoiseKernel* shape = task.seed.shape.get();
+    
+    // Each octave layer is itself fractal noise with these settings, and
+    // layers step by the same persistence and lacunarity
+    const int layerOctaves = 10;          // More octaves add more detail but take longer to compute
+    const float layerPersistence = 0.9f;  // (0 - 1) Higher values make details more prominent
+    const float layerLacunarity = 2.0f;   // How quickly frequency increases; higher adds more small details
+    const float layerScale = 450.0f;      // Higher = smoother; smaller values create more jagged terrain
+    
     // Ensure scale is valid
+    float scale = task.scale;
     if (scale <= 0) {
         scale = 0.0001f;
     }
     
-    float maxNoiseHeight = 0.0f;
-    float minNoiseHeight = 1.0f;
+    // Sample positions are world texels / scale. They stay double down to
+    // the noise lattice; as floats they would lose sub-cell detail a few
+    // thousand cells from the origin.
+    auto worldX = [&task, sampleStep, scale](int x) {
+        return static_cast<double>(task.originX + static_cast<int64_t>(x) * sampleStep) / scale;
+    };
+    auto worldY = [&task, sampleStep, scale](int y) {
+        return static_cast<double>(task.originY + static_cast<int64_t>(y) * sampleStep) / scale;
+    };
+    
+    // Heights go straight into the result, whose storage comes from the
+    // heightmap pool; a cancelled task hands it back
+    std::unique_ptr<HeightMap> heightMap(new HeightMap(width, height));
+    float* noiseMap = heightMap->getMutableData();
+    
+    // Climate channels, filled by the same tiles
+    const ClimateSettings& climateSettings = task.climate;
+    const NoiseSource* climateNoise = task.seed.climate.get();
+    const float* climateOffsets = task.seed.climateOffsets.data();
+    std::unique_ptr<ClimateMap> climate;
+    if (climateSettings.scale > 0.0f && climateNoise && task.seed.climateOffsets.size() >= 4) {
+        climate.reset(new ClimateMap());
+        climate->resize(width, height);
+    }
+    
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    int tileCount = tilesX * tilesY;
+    
+    // Per-tile extremes, reduced once all tiles are done. Every tile writes
+    // its own, so they need no initial value.
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    float* tileMax = arena.allocate<float>(tileCount);
+    float* tileMin = arena.allocate<float>(tileCount);
     
-    // Generate noise map
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float amplitude = 1.0f;
-            float frequency = 1.0f;
-            float noiseHeight = 0.0f;
+    std::atomic<int> tilesDone(0);
+    std::mutex progressMutex;
+    
+    // Erosion runs on full-resolution maps only. Noise and each erosion
+    // stage that runs get an equal share of the progress range.
+    bool hydraulic = sampleStep == 1 && task.erosion.dropletsPerTexel > 0.0f;
+    bool thermal = sampleStep == 1 && task.thermalErosion.iterations > 0;
+    float stageShare = 1.0f / (1 + hydraulic + thermal);
+    
+    JobSystem& jobSystem = jobs ? *jobs : JobSystem::instance();
+    
+    // Tiles are independent jobs; each checks for cancellation before it starts
+    jobSystem.parallelFor(0, tileCount, 1, [&](int firstTile, int endTile) {
+        // Row temporaries from this thread's arena; the noise scratch keeps
+        // its rows between tasks
+        ScratchArena& jobArena = ScratchArena::forThread();
+        ScratchArena::Scope jobScope(jobArena);
+        double* sampleX = jobArena.allocate<double>(tileSize);
+        double* sampleY = jobArena.allocate<double>(tileSize);
+        float* layer = jobArena.allocate<float>(tileSize);
+        // Coarse climate grid of a tile, moisture samples then temperature
+        const int climateGridMax = (tileSize / climateStride + 1) * (tileSize / climateStride + 1);
+        double* climateX = climate ? jobArena.allocate<double>(2 * climateGridMax) : nullptr;
+        double* climateY = climate ? jobArena.allocate<double>(2 * climateGridMax) : nullptr;
+        float* climateValues = climate ? jobArena.allocate<float>(2 * climateGridMax) : nullptr;
+        static thread_local FractalScratch scratch;
+        static thread_local NoiseRowScratch shapeScratch;
+        
+        for (int tile = firstTile; tile < endTile; tile++) {
+            if (task.cancelRequested) return;
+            
+            float maxNoiseHeight = 0.0f;
+            float minNoiseHeight = 1.0f;
+            
+            int tileX0 = (tile % tilesX) * tileSize;
+            int tileY0 = (tile / tilesX) * tileSize;
+            int tileX1 = std::min(tileX0 + tileSize, width);
+            int tileY1 = std::min(tileY0 + tileSize, height);
+            
+            int count = tileX1 - tileX0;
             
-            // Sum octaves
-            for (int i = 0; i < octaves; i++) {
-                float sampleX = x / scale * frequency + octaveOffsets[i * 2];
-                float sampleY = y / scale * frequency + octaveOffsets[i * 2 + 1];
+            for (int y = tileY0; y < tileY1; y++) {
+                float* row = &noiseMap[y * width + tileX0];
                 
-                int octaves = 10;          // Number of layers (adjust for more/less detail) More octaves add more detail but take longer to compute
-                float persistence = 0.9f; // (0 - 1)) Higher values (closer to 1) make details more prominent, Lower values make the terrain smoother with less detailed features
-                float lacunarity = 2.0f;  // How quickly frequency increases (typically 2) Higher values add more small details
-                float scale = 450.0f;     // Base terrain scale (higher = smoother) Smaller values create more jagged terrain with smaller features
-
-                // Replace the single noise call with fractal noise
-                float height = noise.fractalNoise(sampleX, sampleY, octaves, persistence, lacunarity, scale);
-                noiseHeight += height * amplitude;
+                if (shape) {
+                    // The whole design in one fused pass over the row
+                    for (int x = tileX0; x < tileX1; x++) {
+                        sampleX[x - tileX0] = worldX(x);
+                    }
+                    std::fill(sampleY, sampleY + count, worldY(y));
+                    shape->sample(sampleX, sampleY, count, row, shapeScratch);
+                } else if (task.slopeDamping > 0.0f) {
+                    for (int x = tileX0; x < tileX1; x++) {
+                        float amplitude = 1.0f;
+                        double frequency = 1.0;
+                        float noiseHeight = 0.0f;
+                        float slopeX = 0.0f;
+                        float slopeY = 0.0f;
+                        
+                        for (int i = 0; i < task.octaves; i++) {
+                            double sampleX = worldX(x) * frequency + octaveOffsets[i * 2];
+                            double sampleY = worldY(y) * frequency + octaveOffsets[i * 2 + 1];
+                            
+                            // Slope per unit of x / scale, so the damping is the same
+                            // at every scale and sample step
+                            float dx, dy;
+                            float height = layers[i]->fractalNoise(sampleX, sampleY, layerOctaves, layerPersistence,
+                                                                   layerLacunarity, layerScale, dx, dy);
+                            slopeX += dx * static_cast<float>(frequency) * amplitude;
+                            slopeY += dy * static_cast<float>(frequency) * amplitude;
+                            noiseHeight += height * amplitude /
+                                           (1.0f + task.slopeDamping * (slopeX * slopeX + slopeY * slopeY));
+                            
+                            amplitude *= layerPersistence;
+                            frequency *= layerLacunarity;
+                        }
+                        row[x - tileX0] = noiseHeight;
+                    }
+                } else {
+                    // A row of each octave at a time, through the batch path
+                    std::fill(row, row + count, 0.0f);
+                    float amplitude = 1.0f;
+                    double frequency = 1.0;
+                    
+                    for (int i = 0; i < task.octaves; i++) {
+                        for (int x = tileX0; x < tileX1; x++) {
+                            sampleX[x - tileX0] = worldX(x) * frequency + octaveOffsets[i * 2];
+                            sampleY[x - tileX0] = worldY(y) * frequency + octaveOffsets[i * 2 + 1];
+                        }
+                        layers[i]->fractalNoise(sampleX, sampleY, count, layerOctaves, layerPersistence,
+                                                layerLacunarity, layerScale, layer, scratch);
+                        for (int x = 0; x < count; x++) {
+                            row[x] += layer[x] * amplitude;
+                        }
+                        
+                        amplitude *= layerPersistence;
+                        frequency *= layerLacunarity;
+                    }
+                }
                 
-                amplitude *= persistence;
-                frequency *= lacunarity;
+                // Update min and max values
+                for (int x = 0; x < count; x++) {
+                    maxNoiseHeight = std::max(maxNoiseHeight, row[x]);
+                    minNoiseHeight = std::min(minNoiseHeight, row[x]);
+                }
             }
             
-            // Update min and max values
-            maxNoiseHeight = std::max(maxNoiseHeight, noiseHeight);
-            minNoiseHeight = std::min(minNoiseHeight, noiseHeight);
+            tileMax[tile] = maxNoiseHeight;
+            tileMin[tile] = minNoiseHeight;
             
-            noiseMap[y * width + x] = noiseHeight;
+            if (climate) {
+                // Both fields share the grid's coordinates and go through one
+                // batch call. Grid corners sit on multiples of the stride, so
+                // neighboring tiles compute the same edge samples.
+                int gridColumns = (count + climateStride - 1) / climateStride + 1;
+                int gridRows = (tileY1 - tileY0 + climateStride - 1) / climateStride + 1;
+                int gridCount = gridColumns * gridRows;
+                for (int j = 0; j < gridRows; j++) {
+                    double y = worldY(tileY0 + j * climateStride) / climateSettings.scale;
+                    for (int i = 0; i < gridColumns; i++) {
+                        double x = worldX(tileX0 + i * climateStride) / climateSettings.scale;
+                        int sample = j * gridColumns + i;
+                        climateX[sample] = x + climateOffsets[0];
+                        climateY[sample] = y + climateOffsets[1];
+                        climateX[gridCount + sample] = x + climateOffsets[2];
+                        climateY[gridCount + sample] = y + climateOffsets[3];
+                    }
+                }
+                climateNoise->fractalNoise(climateX, climateY, 2 * gridCount, climateSettings.octaves, 0.5f, 2.0f,
+                                           1.0f, climateValues, scratch);
+                for (int sample = 0; sample < 2 * gridCount; sample++) {
+                    float value = 127.5f + climateValues[sample] * climateSettings.contrast * 127.5f;
+                    climateValues[sample] = std::min(std::max(value, 0.0f), 255.0f);
+                }
+                
+                // Climate varies slowly; bilinear upsampling is enough
+                const float invStride = 1.0f / climateStride;
+                for (int y = tileY0; y < tileY1; y++) {
+                    int j = (y - tileY0) / climateStride;
+                    float fy = (y - tileY0 - j * climateStride) * invStride;
+                    const float* moisture0 = climateValues + j * gridColumns;
+                    const float* moisture1 = moisture0 + gridColumns;
+                    const float* temperature0 = moisture0 + gridCount;
+                    const float* temperature1 = temperature0 + gridColumns;
+                    uint8_t* moistureRow = &climate->moisture[climate->index(tileX0, y)];
+                    uint8_t* temperatureRow = &climate->temperature[climate->index(tileX0, y)];
+                    
+                    for (int x = 0; x < count; x++) {
+                        int i = x / climateStride;
+                        float fx = (x - i * climateStride) * invStride;
+                        float moistureTop = moisture0[i] + (moisture0[i + 1] - moisture0[i]) * fx;
+                        float moistureBottom = moisture1[i] + (moisture1[i + 1] - moisture1[i]) * fx;
+                        float temperatureTop = temperature0[i] + (temperature0[i + 1] - temperature0[i]) * fx;
+                        float temperatureBottom = temperature1[i] + (temperature1[i + 1] - temperature1[i]) * fx;
+                        moistureRow[x] = static_cast<uint8_t>(moistureTop + (moistureBottom - moistureTop) * fy + 0.5f);
+                        temperatureRow[x] = static_cast<uint8_t>(temperatureTop + (temperatureBottom - temperatureTop) * fy + 0.5f);
+                    }
+                }
+            }
+            
+            // Callbacks come from worker threads; serialize them for the caller
+            float progress = stageShare * static_cast<float>(++tilesDone) / tileCount;
+            std::lock_guard<std::mutex> lock(progressMutex);
+            task.progress = std::max(task.progress.load(), progress);
+            if (task.onProgress) {
+                task.onProgress(progress);
+            }
+        }
+    });
+    
+    if (task.cancelRequested) {
+        finishTask(task, TerrainTaskStatus::Cancelled);
+        return;
+    }
+    
+    // Normalize noise map; shapes already produce final heights
+    if (!shape) {
+        float maxNoiseHeight = *std::max_element(tileMax, tileMax + tileCount);
+        float minNoiseHeight = *std::min_element(tileMin, tileMin + tileCount);
+        
+        jobSystem.parallelFor(0, height, 0, [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; y++) {
+                for (int x = 0; x < width; x++) {
+                    float normalizedHeight = (noiseMap[y * width + x] - minNoiseHeight) / (maxNoiseHeight - minNoiseHeight);
+                    noiseMap[y * width + x] = normalizedHeight;
+                }
+            }
+        });
+    }
+    
+    // Progress callback for an erosion stage; it also polls for cancellation
+    auto stageProgress = [&task, stageShare](int stage) {
+        return [&task, stageShare, stage](float stageDone) {
+            float progress = stageShare * (stage + stageDone);
+            task.progress = progress;
+            if (task.onProgress) {
+                task.onProgress(progress);
+            }
+            return !task.cancelRequested;
+        };
+    };
+    int stage = 1;
+    
+    if (hydraulic) {
+        HydraulicErosion hydraulicErosion(task.erosion);
+        if (!hydraulicErosion.erode(noiseMap, width, height, task.seed.erosionSeed, jobSystem,
+                                    nullptr, stageProgress(stage++))) {
+            finishTask(task, TerrainTaskStatus::Cancelled);
+            return;
         }
     }
     
-    // Normalize noise map
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float normalizedHeight = (noiseMap[y * width + x] - minNoiseHeight) / (maxNoiseHeight - minNoiseHeight);
-            noiseMap[y * width + x] = normalizedHeight;
+    // Talus relaxation after the droplets, to soften the ridges they leave
+    if (thermal) {
+        ThermalErosion thermalErosion(task.thermalErosion);
+        if (!thermalErosion.erode(noiseMap, width, height, jobSystem, nullptr, stageProgress(stage++))) {
+            finishTask(task, TerrainTaskStatus::Cancelled);
+            return;
         }
     }
     
-    delete[] octaveOffsets;
-    return noiseMap;
+    // Temperature drops with the final heights, then every row is classified
+    if (climate) {
+        float lapse = climateSettings.lapseRate * 255.0f;
+        float lapseHeight = climateSettings.lapseHeight;
+        jobSystem.parallelFor(0, height, 0, [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; y++) {
+                const float* heights = noiseMap + static_cast<size_t>(y) * width;
+                uint8_t* temperatureRow = &climate->temperature[climate->index(0, y)];
+                for (int x = 0; x < width; x++) {
+                    float temperature = temperatureRow[x] - lapse * std::max(heights[x] - lapseHeight, 0.0f);
+                    temperatureRow[x] = static_cast<uint8_t>(std::max(temperature, 0.0f) + 0.5f);
+                }
+                Biomes::classify(temperatureRow, &climate->moisture[climate->index(0, y)], width,
+                                 &climate->biome[climate->index(0, y)]);
+            }
+        });
+    }
+    
+    // Narrow into a block from the smaller pool; the float one goes back
+    if (task.heightStorage != HeightStorage::Float32) {
+        std::unique_ptr<HeightMap> narrowed(new HeightMap(width, height, task.heightStorage));
+        jobSystem.parallelFor(0, height, 0, [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; y++) {
+                narrowed->writeRow(y, 0, width, noiseMap + static_cast<size_t>(y) * width);
+            }
+        });
+        heightMap = std::move(narrowed);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(task.mutex);
+        task.result = std::move(heightMap);
+        task.climateResult = std::move(climate);
+    }
+    finishTask(task, TerrainTaskStatus::Finished);
+}
+
+void TerrainGenerator::finishTask(TerrainTaskState& task, TerrainTaskStatus status) {
+    {
+        std::lock_guard<std::mutex> lock(task.mutex);
+        task.status = status;
+    }
+    task.done.notify_all();
+}
+
+void TerrainGenerator::workerLoop() {
+    while (true) {
+        std::shared_ptr<TerrainTaskState> task = popNextTask();
+        if (!task) return;
+        runTask(*task);
+        
+        std::lock_guard<std::mutex> lock(queueMutex);
+        activeTask.reset();
+    }
+}
+
+// Take the most urgent queued task, dropping cancelled ones on the way.
+// Returns nullptr once the generator shuts down.
+std::shared_ptr<TerrainTaskState> TerrainGenerator::popNextTask() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    
+    while (true) {
+        // Cancelled tasks leave the queue without doing any work
+        for (size_t i = 0; i < queue.size();) {
+            if (queue[i]->cancelRequested) {
+                finishTask(*queue[i], TerrainTaskStatus::Cancelled);
+                queue[i] = queue.back();
+                queue.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        
+        if (!running) return nullptr;
+        
+        if (!queue.empty()) {
+            // Priorities can change while queued, so pick at pop time
+            size_t best = 0;
+            for (size_t i = 1; i < queue.size(); ++i) {
+                float priority = queue[i]->priority;
+                float bestPriority = queue[best]->priority;
+                if (priority > bestPriority ||
+                    (priority == bestPriority && queue[i]->sequence < queue[best]->sequence)) {
+                    best = i;
+                }
+            }
+            
+            activeTask = queue[best];
+            queue[best] = queue.back();
+            queue.pop_back();
+            return activeTask;
+        }
+        
+        queueWake.wait(lock);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,16 @@
 #pragma once
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "HeightMap.h"
+#include "HydraulicErosion.h"
+#include "ThermalErosion.h"
+#include "TerrainTask.h"
+
+class JobSystem;
 
 class TerrainGenerator {
 public:
@@ -16,13 +26,129 @@ public:
         float lacunarity
     );
     
-private:
-    float* generateNoiseMap(
+    // Queue a generation on the background worker and return at once. The
+    // highest-priority queued task runs next; cancelled tasks are dropped
+    // without running. The worker starts on first use.
+    TerrainTask generateTerrainAsync(
         int width, 
         int height, 
         float scale, 
         int octaves, 
         float persistence, 
-        float lacunarity
+        float lacunarity,
+        float priority = 0.0f,
+        TerrainProgressCallback onProgress = TerrainProgressCallback()
+    );
+    
+    // Draw fresh random state for up to the given number of octaves
+    TerrainSeed createSeed(int octaves);
+    
+    // Queue a generation with fixed random state, sampling every sampleStep-th
+    // texel of the full-resolution terrain from world texel (originX,
+    // originY) on. width and height are the output size. Progressive
+    // previews use this to refine one landscape, and chunks of a large world
+    // pass their own origins: noise is evaluated in 64-bit lattice cells, so
+    // a chunk a million texels out is as detailed as one at the origin.
+    // Octave sums are still normalized per map, so chunks that must meet
+    // seamlessly should use a shape (see setShape).
+    TerrainTask generateTerrainAsync(
+        const TerrainSeed& seed,
+        int64_t originX,
+        int64_t originY,
+        int width, 
+        int height, 
+        int sampleStep,
+        float scale, 
+        int octaves, 
+        float persistence, 
+        float lacunarity,
+        float priority = 0.0f,
+        TerrainProgressCallback onProgress = TerrainProgressCallback()
+    );
+    
+    // Hydraulic erosion for tasks created from now on (off by default). It
+    // runs on the normalized noise before the heightmap is handed out;
+    // previews with a sample step above 1 skip it.
+    void setErosion(const ErosionSettings& settings) { erosion = settings; }
+    const ErosionSettings& getErosion() const { return erosion; }
+    
+    // Thermal erosion for tasks created from now on (off by default); it
+    // runs after hydraulic erosion, also at full resolution only
+    void setThermalErosion(const ThermalErosionSettings& settings) { thermalErosion = settings; }
+    const ThermalErosionSettings& getThermalErosion() const { return thermalErosion; }
+    
+    // Noise backend of each octave layer for seeds created from now on;
+    // octaves past the end of the list use its last entry. Default: Perlin.
+    void setNoiseLayers(const std::vector<NoiseType>& types) {
+        if (!types.empty()) noiseLayers = types;
+    }
+    const std::vector<NoiseType>& getNoiseLayers() const { return noiseLayers; }
+    
+    // Terrain design for seeds created from now on, in place of the octave
+    // sum. It is sampled at texel / scale and its [0, 1] output is used
+    // as is, without min/max normalization. An empty factory (the default)
+    // keeps the octave sum.
+    void setShape(TerrainShapeFactory factory) { shape = factory; }
+    
+    // Damp each octave by the slope of the octaves before it, for tasks
+    // created from now on (0, the default, sums them plainly). The slope
+    // comes from the noise's analytic derivatives, so previews match.
+    void setSlopeDamping(float damping) { slopeDamping = damping; }
+    float getSlopeDamping() const { return slopeDamping; }
+    
+    // Storage of the heightmaps handed out by tasks created from now on
+    // (default Float32). Generation and erosion run in floats either way;
+    // the finished map is narrowed in parallel before it is handed out.
+    void setHeightStorage(HeightStorage storage) { heightStorage = storage; }
+    HeightStorage getHeightStorage() const { return heightStorage; }
+    
+    // Moisture and temperature fields, and the biomes they classify to, for
+    // tasks created from now on (off by default). They come out of the same
+    // tile pass as the heights: both fields are one batch of noise over a
+    // coarse grid of each tile, upsampled into the ClimateMap's channels.
+    // Temperature then drops with the final (eroded) heights. Take them with
+    // TerrainTask::takeClimate.
+    void setClimate(const ClimateSettings& settings) { climate = settings; }
+    const ClimateSettings& getClimate() const { return climate; }
+    
+    // Scheduler that runs the noise tiles (default: JobSystem::instance())
+    void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+    
+    // Rows and columns of noise computed between cancellation checks
+    static const int tileSize = 32;
+    
+    // Texels between climate noise samples; a divisor of tileSize
+    static const int climateStride = 4;
+    
+private:
+    std::shared_ptr<TerrainTaskState> createTask(
+        const TerrainSeed& seed, int64_t originX, int64_t originY, int width, int height, int sampleStep,
+        float scale, int octaves, float persistence, float lacunarity
     );
+    TerrainTask submit(std::shared_ptr<TerrainTaskState> task, float priority, TerrainProgressCallback onProgress);
+    
+    // Fill the task's heightmap tile by tile; stops early if cancelled
+    void runTask(TerrainTaskState& task);
+    
+    JobSystem* jobs;
+    ErosionSettings erosion;
+    ThermalErosionSettings thermalErosion;
+    std::vector<NoiseType> noiseLayers;
+    TerrainShapeFactory shape;
+    float slopeDamping;
+    HeightStorage heightStorage;
+    ClimateSettings climate;
+    
+    // Async worker; it hands the tiles of each task to the job system
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable queueWake;
+    std::vector<std::shared_ptr<TerrainTaskState>> queue;
+    std::shared_ptr<TerrainTaskState> activeTask;
+    unsigned long long nextSequence;
+    bool running;
+    
+    void workerLoop();
+    std::shared_ptr<TerrainTaskState> popNextTask();
+    static void finishTask(TerrainTaskState& task, TerrainTaskStatus status);
 };
\ No newline at end of file
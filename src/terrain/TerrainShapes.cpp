@@ -0,0 +1,23 @@
+#include "TerrainShapes.h"
+
+std::shared_ptr<const NoiseKernel> TerrainShapes::continents(uint32_t seed) {
+    std::shared_ptr<const NoiseSource> simplex = NoiseSource::create(NoiseType::OpenSimplex2, seed);
+    std::shared_ptr<const NoiseSource> perlin = NoiseSource::create(NoiseType::Perlin, seed ^ 0x5bd1e995u);
+    
+    // Low-frequency landmass; the smoothstep turns it into a coastline mask
+    auto continent = noiseFractal(simplex, 4, 0.5f, 2.0f, 4.0f);
+    auto land = noiseSmoothstep(continent, -0.2f, 0.1f);
+    auto inland = noiseSmoothstep(continent, 0.0f, 0.4f);
+    
+    auto mountains = noiseRidged(perlin, 6, 0.5f, 2.0f, 1.2f);
+    auto hills = noiseFractal(perlin, 4, 0.5f, 2.0f, 0.6f, 91.7f, 37.1f) * 0.5f + 0.5f;
+    
+    // Land rises from the coast; mountains only where it is well inland
+    auto relief = land * (0.3f + 0.2f * hills) + inland * mountains * 0.5f;
+    
+    // Two offset copies of the continent noise bend coasts and ridgelines
+    auto warpX = noiseFractal(simplex, 3, 0.5f, 2.0f, 1.5f, 17.3f, -41.9f);
+    auto warpY = noiseFractal(simplex, 3, 0.5f, 2.0f, 1.5f, -63.2f, 12.8f);
+    
+    return makeNoiseKernel(noiseClamp(noiseWarp(0.04f + relief, warpX, warpY, 0.6f), 0.0f, 1.0f));
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "../noise/NoiseGraph.h"
+
+// Ready-made terrain designs for TerrainGenerator::setShape. Inputs are in
+// texels / scale, outputs are heights in [0, 1].
+class TerrainShapes {
+public:
+    // Domain-warped continents over a sea floor; ridged mountains rise
+    // inland, rolling hills fill the lowlands near the coast
+    static std::shared_ptr<const NoiseKernel> continents(uint32_t seed);
+};
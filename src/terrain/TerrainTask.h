@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ClimateMap.h"
+#include "HeightMap.h"
+#include "HydraulicErosion.h"
+#include "ThermalErosion.h"
+#include "../noise/NoiseGraph.h"
+#include "../noise/NoiseSource.h"
+
+// Called after each finished tile with progress in [0, 1]. Tiles run on job
+// system threads, but calls are serialized.
+typedef std::function<void(float)> TerrainProgressCallback;
+
+// Builds a terrain design (see TerrainShapes) from a random seed
+typedef std::function<std::shared_ptr<const NoiseKernel>(uint32_t seed)> TerrainShapeFactory;
+
+// Random state of a terrain. Generating with the same seed gives the same
+// landscape at any sample step, so preview levels line up.
+struct TerrainSeed {
+    std::vector<std::shared_ptr<const NoiseSource>> layers;   // Noise per octave
+    std::vector<float> octaveOffsets;   // x, y per octave
+    std::shared_ptr<const NoiseKernel> shape;   // Replaces the octave sum when set
+    uint32_t erosionSeed;
+    std::shared_ptr<const NoiseSource> climate; // Moisture and temperature noise
+    std::vector<float> climateOffsets;  // x, y for moisture, then temperature
+};
+
+enum class TerrainTaskStatus {
+    Pending,    // Queued, no work done yet
+    Running,
+    Finished,
+    Cancelled
+};
+
+// State shared between a TerrainTask handle and the generator's worker
+struct TerrainTaskState {
+    // Parameters, fixed at submission
+    int width;
+    int height;
+    float scale;
+    int octaves;
+    float persistence;
+    float lacunarity;
+    int sampleStep;                // Full-resolution texels between samples
+    int64_t originX;               // World texel of the first sample, at full resolution
+    int64_t originY;
+    TerrainSeed seed;
+    ErosionSettings erosion;       // Full-resolution tasks only
+    ThermalErosionSettings thermalErosion;
+    float slopeDamping;            // Octave damping by the slope below it
+    HeightStorage heightStorage;   // Storage of the result
+    ClimateSettings climate;
+    TerrainProgressCallback onProgress;
+    unsigned long long sequence;   // Submission order, breaks priority ties
+
+    std::atomic<float> priority;
+    std::atomic<bool> cancelRequested;
+    std::atomic<float> progress;
+
+    // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable done;
+    TerrainTaskStatus status;
+    std::unique_ptr<HeightMap> result;
+    std::unique_ptr<ClimateMap> climateResult;   // Null when climate is off
+
+    TerrainTaskStatus getStatus() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return status;
+    }
+};
+
+// Handle to an asynchronous terrain generation. Copies share the same task.
+// Higher priority values run first; cancelling a queued task drops it before
+// it uses any CPU (it reports Cancelled when the worker next picks a task),
+// and a running task stops at the next tile boundary.
+class TerrainTask {
+public:
+    TerrainTask() {}
+    explicit TerrainTask(std::shared_ptr<TerrainTaskState> state) : state(state) {}
+
+    bool isValid() const { return state != nullptr; }
+
+    // Finished or cancelled
+    bool isDone() const {
+        TerrainTaskStatus status = state->getStatus();
+        return status == TerrainTaskStatus::Finished || status == TerrainTaskStatus::Cancelled;
+    }
+
+    TerrainTaskStatus getStatus() const { return state->getStatus(); }
+    float getProgress() const { return state->progress; }
+
+    // Reorder a task that has not started yet (e.g. by distance to the camera)
+    void setPriority(float priority) { state->priority = priority; }
+    float getPriority() const { return state->priority; }
+
+    void cancel() { state->cancelRequested = true; }
+
+    // Block until the task is done. Returns false if it was cancelled.
+    bool wait() const {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [this] {
+            return state->status == TerrainTaskStatus::Finished || state->status == TerrainTaskStatus::Cancelled;
+        });
+        return state->status == TerrainTaskStatus::Finished;
+    }
+
+    // Wait for and take the heightmap; nullptr if cancelled or already taken
+    std::unique_ptr<HeightMap> take() {
+        wait();
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return std::move(state->result);
+    }
+
+    // Wait for and take the climate fields; nullptr if climate was off, the
+    // task was cancelled or they were already taken
+    std::unique_ptr<ClimateMap> takeClimate() {
+        wait();
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return std::move(state->climateResult);
+    }
+
+private:
+    std::shared_ptr<TerrainTaskState> state;
+};
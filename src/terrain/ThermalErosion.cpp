@@ -0,0 +1,151 @@
+#include "ThermalErosion.h"
+#include "../utils/JobSystem.h"
+#include "../utils/MemoryPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ThermalErosionSettings::ThermalErosionSettings()
+    : iterations(0), talus(0.01f), strength(0.5f), convergenceThreshold(1e-5f) {}
+
+ThermalErosion::ThermalErosion(const ThermalErosionSettings& settings) : settings(settings) {
+    this->settings.strength = std::min(1.0f, std::max(0.0f, settings.strength));
+}
+
+bool ThermalErosion::erode(float* heights, int width, int height, JobSystem& jobs,
+                           Stats* stats, const std::function<bool(float)>& onProgress) const {
+    if (stats) {
+        *stats = { 0, 0.0f };
+    }
+    if (settings.iterations <= 0 || width < 2 || height < 2) return true;
+    
+    // A few bands per thread, but never so thin that saved rows add up
+    int threads = jobs.getThreadCount();
+    int bandRows = std::max(minBandRows, (height + threads * 4 - 1) / (threads * 4));
+    int bandCount = (height + bandRows - 1) / bandRows;
+    
+    // Per band: the row above it and the row below it, before the iteration
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope arenaScope(arena);
+    float* savedRows = arena.allocate<float>(static_cast<size_t>(bandCount) * 2 * width);
+    float* bandChange = arena.allocate<float>(bandCount);
+    
+    int iteration = 0;
+    float maxChange = 0.0f;
+    while (iteration < settings.iterations) {
+        for (int band = 0; band < bandCount; ++band) {
+            int y0 = band * bandRows;
+            int y1 = std::min(y0 + bandRows, height);
+            if (y0 > 0) {
+                std::memcpy(&savedRows[(band * 2) * width], &heights[(y0 - 1) * width], width * sizeof(float));
+            }
+            if (y1 < height) {
+                std::memcpy(&savedRows[(band * 2 + 1) * width], &heights[y1 * width], width * sizeof(float));
+            }
+        }
+        
+        jobs.parallelFor(0, bandCount, 1, [&](int firstBand, int endBand) {
+            static thread_local std::vector<float> scratch;
+            for (int band = firstBand; band < endBand; ++band) {
+                int y0 = band * bandRows;
+                int y1 = std::min(y0 + bandRows, height);
+                bandChange[band] = relaxBand(heights, width, height, y0, y1,
+                                             &savedRows[(band * 2) * width], &savedRows[(band * 2 + 1) * width], scratch);
+            }
+        });
+        
+        maxChange = *std::max_element(bandChange, bandChange + bandCount);
+        iteration++;
+        
+        if (onProgress && !onProgress(static_cast<float>(iteration) / settings.iterations)) {
+            return false;
+        }
+        
+        // Every slope is within the talus (or close enough)
+        if (maxChange < settings.convergenceThreshold) break;
+    }
+    
+    if (stats) {
+        stats->iterations = iteration;
+        stats->maxChange = maxChange;
+    }
+    return true;
+}
+
+bool ThermalErosion::erode(HeightMap& heightMap, JobSystem& jobs, Stats* stats) const {
+    HeightStorage storage = heightMap.getStorage();
+    heightMap.setStorage(HeightStorage::Float32);
+    bool finished = erode(heightMap.getMutableData(), heightMap.getWidth(), heightMap.getHeight(), jobs, stats);
+    heightMap.setStorage(storage);
+    return finished;
+}
+
+float ThermalErosion::relaxBand(float* heights, int width, int height, int y0, int y1,
+                                const float* savedAbove, const float* savedBelow, std::vector<float>& scratch) const {
+    const float diagonalTalus = settings.talus * 1.41421356f;
+    
+    // Three pre-iteration rows rolling down the band, plus the change buffer
+    scratch.resize(static_cast<size_t>(width) * 4);
+    float* above = &scratch[0];
+    float* row = &scratch[width];
+    float* below = &scratch[width * 2];
+    float* change = &scratch[width * 3];
+    
+    if (y0 > 0) {
+        std::memcpy(above, savedAbove, width * sizeof(float));
+    }
+    std::memcpy(row, &heights[y0 * width], width * sizeof(float));
+    
+    float maxChange = 0.0f;
+    for (int y = y0; y < y1; ++y) {
+        bool hasAbove = y > 0;
+        bool hasBelow = y + 1 < height;
+        
+        // The next band may already have updated its first row
+        if (hasBelow) {
+            const float* source = y + 1 == y1 ? savedBelow : &heights[(y + 1) * width];
+            std::memcpy(below, source, width * sizeof(float));
+        }
+        
+        std::fill(change, change + width, 0.0f);
+        addFlow(change, row, row, width, -1, settings.talus);
+        addFlow(change, row, row, width, 1, settings.talus);
+        if (hasAbove) {
+            addFlow(change, row, above, width, 0, settings.talus);
+            addFlow(change, row, above, width, -1, diagonalTalus);
+            addFlow(change, row, above, width, 1, diagonalTalus);
+        }
+        if (hasBelow) {
+            addFlow(change, row, below, width, 0, settings.talus);
+            addFlow(change, row, below, width, -1, diagonalTalus);
+            addFlow(change, row, below, width, 1, diagonalTalus);
+        }
+        
+        float* output = &heights[y * width];
+        for (int x = 0; x < width; ++x) {
+            output[x] = row[x] + change[x];
+            maxChange = std::max(maxChange, std::fabs(change[x]));
+        }
+        
+        // Slide the window down a row
+        std::swap(above, row);
+        std::swap(row, below);
+    }
+    
+    return maxChange;
+}
+
+void ThermalErosion::addFlow(float* change, const float* row, const float* neighbors, int width, int offset,
+                             float talus) const {
+    // Split between up to eight neighbors, so a texel never gives away more
+    // than strength times its excess
+    const float rate = settings.strength * 0.125f;
+    
+    int begin = std::max(0, -offset);
+    int end = std::min(width, width - offset);
+    for (int x = begin; x < end; ++x) {
+        // Odd in the height difference, so each pair's flows cancel
+        float difference = neighbors[x + offset] - row[x];
+        change[x] += rate * (std::max(0.0f, difference - talus) - std::max(0.0f, -difference - talus));
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "HeightMap.h"
+
+class JobSystem;
+
+// Talus relaxation parameters. Heights are in the generator's normalized
+// [0, 1] range with texels one unit apart.
+struct ThermalErosionSettings {
+    ThermalErosionSettings();
+    
+    int iterations;             // 0 disables thermal erosion
+    float talus;                // Steepest stable height difference between neighbors
+    float strength;             // Share of the excess moved per iteration (0-1)
+    float convergenceThreshold; // Stop once no texel changes by more than this
+};
+
+// Thermal weathering: wherever a texel stands more than the talus above a
+// neighbor (diagonals: talus * sqrt(2)), part of the excess slides down to
+// it. Sharp ridges slump into scree slopes, and gentle terrain is untouched.
+//
+// Each iteration is a Jacobi step: a texel's change depends only on the
+// heights before the iteration, and the flow between two texels is equal and
+// opposite, so material is conserved. Bands of rows update in place in
+// parallel; each keeps a rolling window of three pre-iteration rows, and the
+// two rows bordering each band are saved beforehand, so no full-map copy is
+// needed. The per-row loops are branch-free and vectorize.
+class ThermalErosion {
+public:
+    struct Stats {
+        int iterations;         // Iterations run (fewer than asked when converged)
+        float maxChange;        // Largest texel change in the last iteration
+    };
+    
+    explicit ThermalErosion(const ThermalErosionSettings& settings);
+    
+    // Relax heights (width * height, row-major) in place. onProgress is called
+    // after each iteration with progress in [0, 1]; returning false stops
+    // early, in which case erode returns false.
+    bool erode(float* heights, int width, int height, JobSystem& jobs,
+               Stats* stats = nullptr, const std::function<bool(float)>& onProgress = std::function<bool(float)>()) const;
+    // A map in 16-bit storage is relaxed in floats and narrowed back
+    bool erode(HeightMap& heightMap, JobSystem& jobs, Stats* stats = nullptr) const;
+    
+    // Fewest rows per parallel band
+    static constexpr int minBandRows = 32;
+
+private:
+    ThermalErosionSettings settings;
+    
+    // One iteration over rows [y0, y1); returns the largest change
+    float relaxBand(float* heights, int width, int height, int y0, int y1,
+                    const float* savedAbove, const float* savedBelow, std::vector<float>& scratch) const;
+    
+    // change[x] += flow from neighbors[x + offset] into row[x]
+    void addFlow(float* change, const float* row, const float* neighbors, int width, int offset, float talus) const;
+};
@@ -0,0 +1,134 @@
+#include "HeightConversion.h"
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE2__)
+namespace {
+    // Eight 32-bit values below 65536 to eight uint16s; the SSE2 pack
+    // saturates signed, so the values are biased into its range and back
+    __m128i packUnsigned16(__m128i low, __m128i high) {
+        const __m128i bias = _mm_set1_epi32(0x8000);
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias));
+        return _mm_xor_si128(packed, _mm_set1_epi16(static_cast<short>(0x8000)));
+    }
+
+#if !defined(__F16C__)
+    __m128i select(__m128i mask, __m128i ifSet, __m128i ifClear) {
+        return _mm_or_si128(_mm_and_si128(mask, ifSet), _mm_andnot_si128(mask, ifClear));
+    }
+    
+    // floatToHalf for four values, before packing
+    __m128i floatToHalf4(__m128 value) {
+        __m128i bits = _mm_castps_si128(value);
+        __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+        bits = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+        
+        __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+        __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(static_cast<int>(0xc8000fffu))), odd), 13);
+        __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_set1_ps(0.5f))),
+                                          _mm_set1_epi32(0x3f000000));
+        __m128i special = select(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7f800000)), _mm_set1_epi32(0x7e00),
+                                 _mm_set1_epi32(0x7c00));
+        
+        // Magnitudes are non-negative, so signed compares order them
+        __m128i half = select(_mm_cmplt_epi32(bits, _mm_set1_epi32(0x47800000)), normal, special);
+        half = select(_mm_cmplt_epi32(bits, _mm_set1_epi32(0x38800000)), subnormal, half);
+        return _mm_or_si128(half, sign);
+    }
+    
+    // halfToFloat for four halves held in 32-bit lanes
+    __m128 halfToFloat4(__m128i value) {
+        __m128i bits = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x7fff)), 13);
+        __m128i exponent = _mm_and_si128(bits, _mm_set1_epi32(0x0f800000));
+        
+        __m128 subnormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(0x38800000))),
+                                      _mm_castsi128_ps(_mm_set1_epi32(0x38800000)));
+        __m128i widened = select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x0f800000)),
+                                 _mm_add_epi32(bits, _mm_set1_epi32(0x70000000)),
+                                 _mm_add_epi32(bits, _mm_set1_epi32(0x38000000)));
+        widened = select(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()), _mm_castps_si128(subnormal), widened);
+        __m128i sign = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x8000)), 16);
+        return _mm_castsi128_ps(_mm_or_si128(widened, sign));
+    }
+#endif
+}
+#endif
+
+void HeightConversion::toHalf(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = packUnsigned16(floatToHalf4(_mm_loadu_ps(in + i)), floatToHalf4(_mm_loadu_ps(in + i + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+void HeightConversion::fromHalf(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_ps(out + i, halfToFloat4(_mm_unpacklo_epi16(half, _mm_setzero_si128())));
+        _mm_storeu_ps(out + i + 4, halfToFloat4(_mm_unpackhi_epi16(half, _mm_setzero_si128())));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+void HeightConversion::toUNorm16(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 levels = _mm_set1_ps(65535.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 8 <= count; i += 8) {
+        // maxps returns its second operand for NaN, so NaN becomes 0 here too
+        __m128 low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), zero), one);
+        __m128 high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), zero), one);
+        __m128i lowLevels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(low, levels), half));
+        __m128i highLevels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(high, levels), half));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packUnsigned16(lowLevels, highLevels));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = floatToUNorm16(in[i]);
+    }
+}
+
+void HeightConversion::fromUNorm16(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i levels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(levels, _mm_setzero_si128()));
+        __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(levels, _mm_setzero_si128()));
+        _mm_storeu_ps(out + i, _mm_mul_ps(low, scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(high, scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = unorm16ToFloat(in[i]);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Conversions between 32-bit heights and the 16-bit forms a HeightMap can
+// store. UNorm16 maps [0, 1] onto 0..65535 (out-of-range values clamp);
+// half floats follow IEEE 754 binary16 with round-to-nearest-even.
+//
+// The bulk calls are the fast path: with SSE2 (any x86-64 build) they
+// convert eight heights at a time, and with F16C (-mf16c or -march=native)
+// half conversion uses the hardware instructions. Results match the scalar
+// calls, which serve single texels, bit for bit (F16C keeps NaN payloads
+// the scalar code drops).
+class HeightConversion {
+public:
+    static void toHalf(const float* in, uint16_t* out, size_t count);
+    static void fromHalf(const uint16_t* in, float* out, size_t count);
+    static void toUNorm16(const float* in, uint16_t* out, size_t count);
+    static void fromUNorm16(const uint16_t* in, float* out, size_t count);
+    
+    static uint16_t floatToHalf(float value) {
+        uint32_t bits = asBits(value);
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        bits &= 0x7fffffffu;
+        
+        // Normal range: rebias the exponent and round off 13 mantissa bits
+        uint32_t normal = (bits + 0xc8000fffu + ((bits >> 13) & 1u)) >> 13;
+        // Below the smallest normal half: an add lines the bits up, the
+        // float unit rounding them
+        uint32_t subnormal = asBits(asFloat(bits) + 0.5f) - 0x3f000000u;
+        // Too large is infinity; NaN stays a (quiet) NaN
+        uint32_t special = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+        
+        uint32_t half = bits < 0x38800000u ? subnormal : (bits < 0x47800000u ? normal : special);
+        return static_cast<uint16_t>(half | sign);
+    }
+    
+    static float halfToFloat(uint16_t value) {
+        uint32_t bits = (static_cast<uint32_t>(value) & 0x7fffu) << 13;
+        uint32_t exponent = bits & 0x0f800000u;
+        
+        // Zero and subnormals: scale the mantissa as a float instead
+        float subnormal = asFloat(bits + 0x38800000u) - asFloat(0x38800000u);
+        uint32_t widened = exponent == 0x0f800000u ? bits + 0x70000000u : bits + 0x38000000u;
+        widened = exponent == 0 ? asBits(subnormal) : widened;
+        return asFloat(widened | (static_cast<uint32_t>(value) & 0x8000u) << 16);
+    }
+    
+    static uint16_t floatToUNorm16(float value) {
+        // NaN fails both compares and becomes 0
+        float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<uint16_t>(clamped * 65535.0f + 0.5f);
+    }
+    
+    static float unorm16ToFloat(uint16_t value) {
+        return static_cast<float>(value) * (1.0f / 65535.0f);
+    }
+
+private:
+    static uint32_t asBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    
+    static float asFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
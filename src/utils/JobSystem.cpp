@@ -0,0 +1,243 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    // The queue a thread pushes to, when it is one of a JobSystem's workers
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local int currentWorker = -1;
+    
+    std::atomic<int>& maxThreadsCap() {
+        static std::atomic<int> cap([] {
+            const char* value = std::getenv("TERRAIN_MAX_THREADS");
+            return value ? std::max(0, std::atoi(value)) : 0;
+        }());
+        return cap;
+    }
+    
+    void pinToCore(std::thread& thread, int core) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+        // Affinity is only implemented for Linux
+        (void)thread;
+        (void)core;
+#endif
+    }
+}
+
+JobSystem::JobSystem(int threadCount, bool pinThreads)
+    : queuedJobs(0), idleWorkers(0), waiters(0), stopping(false) {
+    int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    if (threadCount <= 0) {
+        threadCount = hardwareThreads;
+    }
+    
+    int cap = getMaxThreads();
+    if (cap > 0) {
+        threadCount = std::min(threadCount, cap);
+    }
+    
+    // The last queue takes jobs submitted from outside the workers
+    int workerCount = threadCount - 1;
+    for (int i = 0; i <= workerCount; ++i) {
+        queues.emplace_back(new WorkerQueue());
+    }
+    
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+        if (pinThreads) {
+            // Core 0 is left to the thread that created the system
+            pinToCore(workers.back(), (i + 1) % hardwareThreads);
+        }
+    }
+}
+
+JobSystem::~JobSystem() {
+    // Queued jobs that have not started are dropped
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workCondition.notify_all();
+    doneCondition.notify_all();
+    
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+void JobSystem::setMaxThreads(int maxThreads) {
+    maxThreadsCap() = std::max(0, maxThreads);
+}
+
+int JobSystem::getMaxThreads() {
+    return maxThreadsCap();
+}
+
+JobHandle JobSystem::submit(std::function<void()> work, const std::vector<JobHandle>& dependencies) {
+    JobHandle job = std::make_shared<Job>();
+    job->work = std::move(work);
+    job->done = false;
+    
+    // Hold one count ourselves so the job cannot start while being wired up
+    job->pendingDependencies = 1;
+    for (const JobHandle& dependency : dependencies) {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->done) {
+            dependency->continuations.push_back(job);
+            job->pendingDependencies++;
+        }
+    }
+    
+    if (--job->pendingDependencies == 0) {
+        enqueue(job);
+    }
+    return job;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    int queueIndex = currentQueueIndex();
+    
+    while (!job->done) {
+        if (runOne(queueIndex)) continue;
+        
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        waiters++;
+        doneCondition.wait(lock, [&] { return job->done || queuedJobs > 0 || stopping; });
+        waiters--;
+    }
+}
+
+void JobSystem::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+    int count = end - begin;
+    if (count <= 0) return;
+    
+    if (grain <= 0) {
+        grain = std::max(1, count / (getThreadCount() * 4));
+    }
+    
+    if (count <= grain || workers.empty()) {
+        body(begin, end);
+        return;
+    }
+    
+    std::vector<JobHandle> pieces;
+    pieces.reserve((count + grain - 1) / grain);
+    for (int pieceBegin = begin; pieceBegin < end; pieceBegin += grain) {
+        int pieceEnd = std::min(pieceBegin + grain, end);
+        pieces.push_back(submit([&body, pieceBegin, pieceEnd] { body(pieceBegin, pieceEnd); }));
+    }
+    
+    for (const JobHandle& piece : pieces) {
+        wait(piece);
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    currentSystem = this;
+    currentWorker = index;
+    
+    while (!stopping) {
+        if (runOne(index)) continue;
+        
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        idleWorkers++;
+        workCondition.wait(lock, [this] { return queuedJobs > 0 || stopping; });
+        idleWorkers--;
+    }
+}
+
+int JobSystem::currentQueueIndex() const {
+    return currentSystem == this ? currentWorker : static_cast<int>(queues.size()) - 1;
+}
+
+void JobSystem::enqueue(const JobHandle& job) {
+    WorkerQueue& queue = *queues[currentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    queuedJobs++;
+    
+    // One idle worker is enough; waiters also run jobs while they wait
+    if (idleWorkers > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        workCondition.notify_one();
+    }
+    wakeWaiters();
+}
+
+// Run the newest job from our own queue, or steal the oldest from another.
+// Returns false when every queue is empty.
+bool JobSystem::runOne(int queueIndex) {
+    JobHandle job;
+    
+    {
+        WorkerQueue& own = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+        }
+    }
+    
+    int queueCount = static_cast<int>(queues.size());
+    for (int i = 1; !job && i < queueCount; ++i) {
+        WorkerQueue& victim = *queues[(queueIndex + i) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+        }
+    }
+    
+    if (!job) return false;
+    
+    queuedJobs--;
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(const JobHandle& job) {
+    job->work();
+    job->work = nullptr;   // Release captures now rather than with the handle
+    
+    std::vector<JobHandle> ready;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        ready.swap(job->continuations);
+    }
+    
+    for (const JobHandle& continuation : ready) {
+        if (--continuation->pendingDependencies == 0) {
+            enqueue(continuation);
+        }
+    }
+    
+    // Threads waiting on this job may be asleep
+    wakeWaiters();
+}
+
+void JobSystem::wakeWaiters() {
+    // Sleepers register before re-checking their condition, so skipping the
+    // lock when nobody is registered cannot lose a wakeup
+    if (waiters > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work plus the jobs that wait on it
+struct Job {
+    std::function<void()> work;
+    std::atomic<int> pendingDependencies;
+    std::atomic<bool> done;
+    
+    std::mutex mutex;                              // Guards continuations
+    std::vector<std::shared_ptr<Job>> continuations;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work-stealing task scheduler shared by generation, meshing and terrain
+// post-processing, so subsystems never spawn their own threads. Each worker
+// owns a deque: it pops its newest job, idle workers steal the oldest job
+// from someone else. Threads waiting on a job run other jobs meanwhile, so
+// the waiting thread counts as one of the scheduler's threads.
+class JobSystem {
+public:
+    // threadCount includes the waiting caller, so 1 runs everything inline
+    // in wait(). 0 uses every hardware thread (subject to the global cap).
+    explicit JobSystem(int threadCount = 0, bool pinThreads = false);
+    ~JobSystem();
+    
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    
+    // Process-wide scheduler, created on first use
+    static JobSystem& instance();
+    
+    // Cap the threads any JobSystem may use, for co-tenanted machines. Call
+    // before instance() is first used; 0 removes the cap. The
+    // TERRAIN_MAX_THREADS environment variable sets the initial cap.
+    static void setMaxThreads(int maxThreads);
+    static int getMaxThreads();
+    
+    int getThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+    
+    // Run work once every dependency has finished
+    JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies = {});
+    
+    // Block until the job is done, running other jobs meanwhile
+    void wait(const JobHandle& job);
+    
+    // Call body(rangeBegin, rangeEnd) over [begin, end) in pieces of at most
+    // grain items and wait for all of them. grain <= 0 picks one that gives
+    // every thread a few pieces to balance.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+    
+    // One queue per worker plus a shared one for outside threads
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    
+    // Idle workers sleep on workCondition, threads in wait() on doneCondition
+    std::atomic<int> queuedJobs;
+    std::atomic<int> idleWorkers;
+    std::atomic<int> waiters;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable workCondition;
+    std::condition_variable doneCondition;
+    
+    void workerLoop(int index);
+    void enqueue(const JobHandle& job);
+    bool runOne(int queueIndex);
+    void execute(const JobHandle& job);
+    void wakeWaiters();
+    int currentQueueIndex() const;
+};
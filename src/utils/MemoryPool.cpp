@@ -0,0 +1,314 @@
+#include "MemoryPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    const size_t blockAlignment = 64;
+    const size_t minSizeClass = 4096;
+    const size_t minArenaBlock = 1 << 20;
+    const size_t arenaRetainBytes = 32 << 20;
+    
+    struct SubsystemCounters {
+        std::atomic<int64_t> liveBytes;
+        std::atomic<int64_t> pooledBytes;
+        std::atomic<int64_t> peakBytes;
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> reuses;
+    };
+    
+    // Zero-initialized before any constructor runs, so pools created during
+    // static initialization can already record
+    SubsystemCounters counters[static_cast<int>(MemorySubsystem::Count)];
+    
+    std::atomic<uint64_t> heapAllocations(0);
+    std::atomic<uint64_t> heapBytes(0);
+    
+    SubsystemCounters& countersFor(MemorySubsystem subsystem) {
+        return counters[static_cast<int>(subsystem)];
+    }
+    
+    void updatePeak(SubsystemCounters& counter) {
+        int64_t total = counter.liveBytes + counter.pooledBytes;
+        int64_t peak = counter.peakBytes;
+        while (total > peak && !counter.peakBytes.compare_exchange_weak(peak, total)) {
+        }
+    }
+    
+    // Shared pools live until exit, deliberately never destroyed: a static
+    // heightmap may return its block during static destruction
+    struct PoolRegistry {
+        std::mutex mutex;
+        std::vector<BufferPool*> pools;
+        size_t cacheLimit = 64 << 20;
+    };
+    
+    PoolRegistry& registry() {
+        static PoolRegistry* pools = new PoolRegistry();
+        return *pools;
+    }
+    
+    void* allocateBlock(size_t bytes) {
+        return ::operator new(bytes, std::align_val_t(blockAlignment));
+    }
+    
+    void freeBlock(void* block) {
+        ::operator delete(block, std::align_val_t(blockAlignment));
+    }
+}
+
+MemoryStats MemoryTracker::getStats(MemorySubsystem subsystem) {
+    SubsystemCounters& counter = countersFor(subsystem);
+    MemoryStats stats;
+    // Threads record independently, so a snapshot can catch a move half done
+    stats.liveBytes = static_cast<size_t>(std::max<int64_t>(0, counter.liveBytes));
+    stats.pooledBytes = static_cast<size_t>(std::max<int64_t>(0, counter.pooledBytes));
+    stats.peakBytes = static_cast<size_t>(std::max<int64_t>(0, counter.peakBytes));
+    stats.allocations = counter.allocations;
+    stats.reuses = counter.reuses;
+    return stats;
+}
+
+const char* MemoryTracker::getName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+        case MemorySubsystem::HeightMaps: return "heightmaps";
+        case MemorySubsystem::Scratch: return "scratch";
+        case MemorySubsystem::MeshStaging: return "mesh staging";
+        default: return "unknown";
+    }
+}
+
+void MemoryTracker::resetCounters() {
+    for (SubsystemCounters& counter : counters) {
+        counter.allocations = 0;
+        counter.reuses = 0;
+        counter.peakBytes = counter.liveBytes + counter.pooledBytes;
+    }
+}
+
+void MemoryTracker::recordAllocation(MemorySubsystem subsystem) {
+    countersFor(subsystem).allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::recordReuse(MemorySubsystem subsystem) {
+    countersFor(subsystem).reuses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::recordBytes(MemorySubsystem subsystem, int64_t liveChange, int64_t pooledChange) {
+    SubsystemCounters& counter = countersFor(subsystem);
+    counter.liveBytes += liveChange;
+    counter.pooledBytes += pooledChange;
+    if (liveChange + pooledChange > 0) {
+        updatePeak(counter);
+    }
+}
+
+bool MemoryTracker::isCountingHeap() {
+#ifdef TERRAIN_COUNT_HEAP_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t MemoryTracker::getHeapAllocationCount() {
+    return heapAllocations;
+}
+
+uint64_t MemoryTracker::getHeapAllocatedBytes() {
+    return heapBytes;
+}
+
+BufferPool::BufferPool(MemorySubsystem subsystem, size_t blockBytes, int maxCachedBlocks)
+    : subsystem(subsystem), blockBytes(blockBytes), maxCachedBlocks(std::max(0, maxCachedBlocks)) {
+    freeBlocks.reserve(this->maxCachedBlocks);
+}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+void* BufferPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeBlocks.empty()) {
+            void* block = freeBlocks.back();
+            freeBlocks.pop_back();
+            MemoryTracker::recordReuse(subsystem);
+            MemoryTracker::recordBytes(subsystem, blockBytes, -static_cast<int64_t>(blockBytes));
+            return block;
+        }
+    }
+    
+    MemoryTracker::recordAllocation(subsystem);
+    MemoryTracker::recordBytes(subsystem, blockBytes, 0);
+    return allocateBlock(blockBytes);
+}
+
+void BufferPool::release(void* block) {
+    if (!block) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeBlocks.size() < static_cast<size_t>(maxCachedBlocks)) {
+            freeBlocks.push_back(block);
+            MemoryTracker::recordBytes(subsystem, -static_cast<int64_t>(blockBytes), blockBytes);
+            return;
+        }
+    }
+    
+    MemoryTracker::recordBytes(subsystem, -static_cast<int64_t>(blockBytes), 0);
+    freeBlock(block);
+}
+
+void BufferPool::trim() {
+    std::vector<void*> blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.swap(freeBlocks);
+        freeBlocks.reserve(maxCachedBlocks);
+    }
+    
+    for (void* block : blocks) {
+        MemoryTracker::recordBytes(subsystem, 0, -static_cast<int64_t>(blockBytes));
+        freeBlock(block);
+    }
+}
+
+size_t BufferPool::getSizeClass(size_t bytes) {
+    if (bytes <= minSizeClass) return minSizeClass;
+    
+    // Four classes per power of two: at most a quarter of a block is slack
+    size_t power = minSizeClass;
+    while (power < bytes) {
+        power *= 2;
+    }
+    size_t step = power / 8;
+    return (bytes + step - 1) / step * step;
+}
+
+BufferPool& BufferPool::forSize(MemorySubsystem subsystem, size_t bytes) {
+    size_t blockBytes = getSizeClass(bytes);
+    PoolRegistry& pools = registry();
+    
+    std::lock_guard<std::mutex> lock(pools.mutex);
+    for (BufferPool* pool : pools.pools) {
+        if (pool->subsystem == subsystem && pool->blockBytes == blockBytes) {
+            return *pool;
+        }
+    }
+    
+    int maxCachedBlocks = static_cast<int>(std::max<size_t>(2, pools.cacheLimit / blockBytes));
+    pools.pools.push_back(new BufferPool(subsystem, blockBytes, maxCachedBlocks));
+    return *pools.pools.back();
+}
+
+void BufferPool::trimAll() {
+    PoolRegistry& pools = registry();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+    for (BufferPool* pool : pools.pools) {
+        pool->trim();
+    }
+}
+
+void BufferPool::setCacheLimit(size_t bytes) {
+    PoolRegistry& pools = registry();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+    pools.cacheLimit = bytes;
+}
+
+ScratchArena::ScratchArena() : currentBlock(0), offset(0) {}
+
+ScratchArena::~ScratchArena() {
+    for (const Block& block : blocks) {
+        MemoryTracker::recordBytes(MemorySubsystem::Scratch, -static_cast<int64_t>(block.size), 0);
+        freeBlock(block.data);
+    }
+}
+
+ScratchArena& ScratchArena::forThread() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+void* ScratchArena::allocateBytes(size_t bytes) {
+    bytes = (std::max<size_t>(bytes, 1) + blockAlignment - 1) / blockAlignment * blockAlignment;
+    
+    // The rest of the current block, else the first later block it fits in
+    for (; currentBlock < blocks.size(); ++currentBlock, offset = 0) {
+        if (offset + bytes <= blocks[currentBlock].size) {
+            void* memory = blocks[currentBlock].data + offset;
+            offset += bytes;
+            // Arena blocks count as live for as long as the thread holds them
+            MemoryTracker::recordReuse(MemorySubsystem::Scratch);
+            return memory;
+        }
+    }
+    
+    // Grow geometrically, so a thread settles after a few blocks
+    size_t size = std::max(std::max(bytes, minArenaBlock), blocks.empty() ? 0 : blocks.back().size * 2);
+    Block block = { static_cast<char*>(allocateBlock(size)), size };
+    MemoryTracker::recordAllocation(MemorySubsystem::Scratch);
+    MemoryTracker::recordBytes(MemorySubsystem::Scratch, size, 0);
+    blocks.push_back(block);
+    
+    currentBlock = blocks.size() - 1;
+    offset = bytes;
+    return block.data;
+}
+
+void ScratchArena::releaseExcess() {
+    // Nothing is in use; keep blocks up to the retained size
+    size_t kept = 0;
+    size_t keep = 0;
+    while (keep < blocks.size() && kept + blocks[keep].size <= arenaRetainBytes) {
+        kept += blocks[keep].size;
+        keep++;
+    }
+    for (size_t i = keep; i < blocks.size(); ++i) {
+        MemoryTracker::recordBytes(MemorySubsystem::Scratch, -static_cast<int64_t>(blocks[i].size), 0);
+        freeBlock(blocks[i].data);
+    }
+    blocks.resize(keep);
+}
+
+size_t ScratchArena::getCapacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+#ifdef TERRAIN_COUNT_HEAP_ALLOCATIONS
+// Counting replacements for the global allocation functions; the nothrow
+// forms call these, so every heap allocation in the process is counted
+namespace {
+    void* countedAllocate(size_t bytes, size_t alignment) {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        heapBytes.fetch_add(bytes, std::memory_order_relaxed);
+        
+        bytes = std::max<size_t>(bytes, 1);
+        void* memory = alignment > alignof(std::max_align_t)
+                           ? std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment)
+                           : std::malloc(bytes);
+        if (!memory) throw std::bad_alloc();
+        return memory;
+    }
+}
+
+void* operator new(size_t bytes) { return countedAllocate(bytes, 0); }
+void* operator new[](size_t bytes) { return countedAllocate(bytes, 0); }
+void* operator new(size_t bytes, std::align_val_t alignment) { return countedAllocate(bytes, static_cast<size_t>(alignment)); }
+void* operator new[](size_t bytes, std::align_val_t alignment) { return countedAllocate(bytes, static_cast<size_t>(alignment)); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Where pooled memory goes, for the per-subsystem counters
+enum class MemorySubsystem {
+    HeightMaps,     // Heightmap storage (BufferPool)
+    Scratch,        // Per-thread job temporaries (ScratchArena)
+    MeshStaging,    // Mesh chunk vertex and index buffers (MeshChunkPool)
+    Count
+};
+
+struct MemoryStats {
+    size_t liveBytes;       // Handed out and not yet returned (mesh chunks
+                            // grow once out of the pool, so none for them)
+    size_t pooledBytes;     // Returned and kept for reuse
+    size_t peakBytes;       // Highest liveBytes + pooledBytes
+    uint64_t allocations;   // Requests that had to go to the heap
+    uint64_t reuses;        // Requests served from pooled memory
+};
+
+// Byte and allocation counters per subsystem, kept by the pools below. A
+// streaming workload in steady state should show reuses climbing while
+// allocations stay put.
+//
+// Built with TERRAIN_COUNT_HEAP_ALLOCATIONS, global operator new is also
+// replaced with a counting one, so tests and benchmarks can check that a
+// loop makes no heap allocations at all, pooled or not.
+class MemoryTracker {
+public:
+    static MemoryStats getStats(MemorySubsystem subsystem);
+    static const char* getName(MemorySubsystem subsystem);
+    
+    // Zero the allocation and reuse counts; peaks restart from the current size
+    static void resetCounters();
+    
+    // Pool bookkeeping: a request served by the heap or by pooled memory,
+    // and bytes moving between live, pooled and freed
+    static void recordAllocation(MemorySubsystem subsystem);
+    static void recordReuse(MemorySubsystem subsystem);
+    static void recordBytes(MemorySubsystem subsystem, int64_t liveChange, int64_t pooledChange);
+    
+    // Process-wide operator new calls and bytes since startup; always 0
+    // unless built with TERRAIN_COUNT_HEAP_ALLOCATIONS
+    static bool isCountingHeap();
+    static uint64_t getHeapAllocationCount();
+    static uint64_t getHeapAllocatedBytes();
+};
+
+// Fixed-size blocks recycled between owners of the same size, such as the
+// heightmaps of successive streamed terrains. Sizes are rounded up to a
+// size class (a quarter of the next power of two, 4 KB at least), so maps
+// of nearly the same size share blocks. Up to maxCachedBlocks freed blocks
+// are kept; the free list is reserved up front, so returning a block never
+// allocates. Thread safe.
+class BufferPool {
+public:
+    BufferPool(MemorySubsystem subsystem, size_t blockBytes, int maxCachedBlocks);
+    ~BufferPool();
+    
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    
+    // A block of getBlockBytes() bytes, 64-byte aligned, contents undefined
+    void* acquire();
+    void release(void* block);
+    
+    // Free every cached block
+    void trim();
+    
+    size_t getBlockBytes() const { return blockBytes; }
+    
+    // The shared pool for blocks of at least bytes, created on first use
+    static BufferPool& forSize(MemorySubsystem subsystem, size_t bytes);
+    static size_t getSizeClass(size_t bytes);
+    
+    // Trim every shared pool, e.g. after leaving a large terrain behind
+    static void trimAll();
+    
+    // Bytes each shared pool created from now on may keep cached (at least
+    // two blocks); default 64 MB
+    static void setCacheLimit(size_t bytes);
+
+private:
+    MemorySubsystem subsystem;
+    size_t blockBytes;
+    int maxCachedBlocks;
+    
+    std::mutex mutex;
+    std::vector<void*> freeBlocks;
+};
+
+// Per-thread bump allocator for temporaries that live as long as a job or
+// a call: sample rows, per-tile reductions, saved rows. Allocation moves a
+// pointer; a Scope rewinds it on exit. Blocks stay with the thread, so once
+// a thread has seen its largest job it never touches the heap again; only
+// past 32 MB are the extra blocks freed, when the outermost scope ends.
+//
+// Scopes nest, including across jobs that a waiting thread runs in the
+// middle of another job, since those finish before the wait returns. Memory
+// is uninitialized and only suits trivially constructible types.
+class ScratchArena {
+public:
+    class Scope {
+    public:
+        explicit Scope(ScratchArena& arena) : arena(arena), block(arena.currentBlock), offset(arena.offset) {}
+        ~Scope() { arena.rewind(block, offset); }
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    
+    private:
+        ScratchArena& arena;
+        size_t block;
+        size_t offset;
+    };
+    
+    ScratchArena();
+    ~ScratchArena();
+    
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+    
+    // The calling thread's arena
+    static ScratchArena& forThread();
+    
+    // count uninitialized values, 64-byte aligned
+    template <typename T>
+    T* allocate(size_t count) { return static_cast<T*>(allocateBytes(count * sizeof(T))); }
+    void* allocateBytes(size_t bytes);
+    
+    size_t getCapacity() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+    
+    std::vector<Block> blocks;
+    size_t currentBlock;
+    size_t offset;
+    
+    void rewind(size_t block, size_t blockOffset) {
+        currentBlock = block;
+        offset = blockOffset;
+        if (block == 0 && blockOffset == 0 && blocks.size() > 1) {
+            releaseExcess();
+        }
+    }
+    void releaseExcess();
+};
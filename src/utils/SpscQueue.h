@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push/pop never block; they return false when full / empty.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots(capacity + 1), head(0), tail(0) {}
+    
+    // Producer side
+    bool push(T&& value) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t nextTail = increment(currentTail);
+        if (nextTail == head.load(std::memory_order_acquire)) {
+            return false;   // Full
+        }
+        
+        slots[currentTail] = std::move(value);
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer side
+    bool pop(T& value) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;   // Empty
+        }
+        
+        value = std::move(slots[currentHead]);
+        slots[currentHead] = T();
+        head.store(increment(currentHead), std::memory_order_release);
+        return true;
+    }
+    
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    
+private:
+    std::vector<T> slots;
+    
+    // Keep the two indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    
+    size_t increment(size_t index) const {
+        return index + 1 == slots.size() ? 0 : index + 1;
+    }
+};